@@ -32,11 +32,12 @@ let () =
          x11_sw_context x11_hw_context
          wl_backend wl_target wl_window
          wl_sw_context wl_hw_context
-         window pixmap image_interpolation filters transform draw_instr
+         window worker_pool buffer_pool pixmap image_interpolation filters
+         transform draw_instr clip_path picture
          sw_context hw_context context
          font_desc gdi_font qtz_font unx_font font
          gdi_impexp qtz_impexp unx_impexp impexp
-         path arc path2d polygon polygonize
+         path arc path2d polygon polygonize mask_cache
          gradient pattern draw_style color_composition poly_render
          state canvas backend
          ml_convert ml_canvas)
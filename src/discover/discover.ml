@@ -20,6 +20,9 @@ let c_test c ?(c_flags=[]) ?(link_flags=[])
 let march_config _c =
   [ "-march=native" ], [ ]
 
+let thr_config _c =
+  [ "-DHAS_PTHREAD"; "-pthread" ], [ "-lpthread" ]
+
 let gdi_config _c =
   [ "-DHAS_GDI"; "-DUNICODE"; "-D_UNICODE" ],
   [ "-lkernel32"; "-lgdi32"; "-lgdiplus" ]
@@ -76,6 +79,18 @@ int main()
 }
 |}
 
+let thr_test = {|
+#include <pthread.h>
+static void *f(void *arg) { return arg; }
+int main()
+{
+  pthread_t t;
+  pthread_create(&t, NULL, f, NULL);
+  pthread_join(t, NULL);
+  return 0;
+}
+|}
+
 let gdi_test = {|
 #include <windows.h>
 int main()
@@ -164,6 +179,7 @@ let () =
             options
         ) ([], [])
         [ (march_config, march_test);
+          (thr_config, thr_test);
           (gdi_config, gdi_test);
           (qtz_config, qtz_test);
           (x11_config, x11_test);
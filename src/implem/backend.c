@@ -22,6 +22,7 @@
 #include "canvas.h"
 #include "canvas_internal.h"
 #include "poly_render.h"
+#include "image_interpolation.h"
 #include "impexp.h"
 
 #ifdef HAS_GDI
@@ -71,6 +72,7 @@ _backend_process_event(
     case EVENT_PRESENT: /* internal event */
       if ((canvas->autocommit == true) || (canvas->committed == true)) {
         canvas->committed = false;
+        _canvas_flush(canvas);
         context_present(canvas->context);
       }
       result = true;
@@ -172,6 +174,7 @@ backend_init(
   if (result == true) {
     set_impl_type(impl_type);
     poly_render_init();
+    interpolation_init();
     impexp_init();
 
     switch_IMPL() {
@@ -0,0 +1,273 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef HAS_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "util.h"
+#include "buffer_pool.h"
+
+// Buffers are sorted by the power of two just below their size
+#define BUFFER_POOL_MIN_BUCKET 16 // log2 of BUFFER_POOL_MIN_SIZE
+#define BUFFER_POOL_NB_BUCKETS 32
+#define BUFFER_POOL_BUCKET_ENTRIES 4
+
+typedef struct buffer_pool_entry_t {
+  void *data;
+  size_t size;    // size the buffer was last used with
+  uint64_t stamp; // release order, for eviction
+} buffer_pool_entry_t;
+
+static struct {
+#ifdef HAS_PTHREAD
+  pthread_mutex_t mutex;
+#endif
+  buffer_pool_entry_t
+    buckets[BUFFER_POOL_NB_BUCKETS][BUFFER_POOL_BUCKET_ENTRIES];
+  int32_t nb_entries[BUFFER_POOL_NB_BUCKETS];
+  uint64_t stamp;
+  size_t budget;
+  buffer_pool_stats_t stats;
+} _pool = {
+#ifdef HAS_PTHREAD
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+#endif
+  .budget = BUFFER_POOL_DEFAULT_BUDGET,
+};
+
+static inline void
+_buffer_pool_lock(
+  void)
+{
+#ifdef HAS_PTHREAD
+  pthread_mutex_lock(&_pool.mutex);
+#endif
+}
+
+static inline void
+_buffer_pool_unlock(
+  void)
+{
+#ifdef HAS_PTHREAD
+  pthread_mutex_unlock(&_pool.mutex);
+#endif
+}
+
+static int32_t
+_buffer_pool_bucket(
+  size_t size)
+{
+  assert(size >= BUFFER_POOL_MIN_SIZE);
+
+  int32_t b = -BUFFER_POOL_MIN_BUCKET;
+  while (size > 1) {
+    size >>= 1;
+    ++b;
+  }
+  return min(b, BUFFER_POOL_NB_BUCKETS - 1);
+}
+
+// Removes an entry and returns its buffer; called with the mutex held
+static void *
+_buffer_pool_remove(
+  int32_t b,
+  int32_t i)
+{
+  assert((b >= 0) && (b < BUFFER_POOL_NB_BUCKETS));
+  assert((i >= 0) && (i < _pool.nb_entries[b]));
+
+  buffer_pool_entry_t *e = &_pool.buckets[b][i];
+  void *data = e->data;
+
+  _pool.stats.entries--;
+  _pool.stats.bytes -= e->size;
+
+  *e = _pool.buckets[b][--_pool.nb_entries[b]];
+
+  return data;
+}
+
+// Frees the least recently released buffer of a bucket, or of
+// the whole pool if b is negative; called with the mutex held
+static void
+_buffer_pool_evict(
+  int32_t b)
+{
+  int32_t first = (b < 0) ? 0 : b;
+  int32_t last = (b < 0) ? BUFFER_POOL_NB_BUCKETS - 1 : b;
+  int32_t ob = -1, oi = -1;
+
+  for (int32_t k = first; k <= last; ++k) {
+    for (int32_t i = 0; i < _pool.nb_entries[k]; ++i) {
+      if ((ob < 0) ||
+          (_pool.buckets[k][i].stamp < _pool.buckets[ob][oi].stamp)) {
+        ob = k;
+        oi = i;
+      }
+    }
+  }
+
+  if (ob >= 0) {
+    free(_buffer_pool_remove(ob, oi));
+    _pool.stats.evictions++;
+  }
+}
+
+// Returns a buffer of at least size bytes, recycling a released
+// buffer of a close size when possible; only zeroes it if asked to
+void *
+buffer_pool_acquire(
+  size_t size,
+  bool zero)
+{
+  if (size < BUFFER_POOL_MIN_SIZE) {
+    return zero ? calloc(size, 1) : malloc(size);
+  }
+
+  void *data = NULL;
+
+  _buffer_pool_lock();
+
+  // Best fit among buffers no more than twice as large,
+  // which are found in the same bucket or the next one
+  int32_t b = _buffer_pool_bucket(size);
+  int32_t fb = -1, fi = -1;
+  for (int32_t k = b; k <= min(b + 1, BUFFER_POOL_NB_BUCKETS - 1); ++k) {
+    for (int32_t i = 0; i < _pool.nb_entries[k]; ++i) {
+      size_t s = _pool.buckets[k][i].size;
+      if ((s >= size) && (s / 2 <= size) &&
+          ((fb < 0) || (s < _pool.buckets[fb][fi].size))) {
+        fb = k;
+        fi = i;
+      }
+    }
+  }
+
+  if (fb >= 0) {
+    data = _buffer_pool_remove(fb, fi);
+    _pool.stats.hits++;
+  } else {
+    _pool.stats.misses++;
+  }
+
+  _buffer_pool_unlock();
+
+  if (data == NULL) {
+    return zero ? calloc(size, 1) : malloc(size);
+  }
+
+  if (zero == true) {
+    memset(data, 0, size);
+  }
+
+  return data;
+}
+
+void *
+buffer_pool_dup(
+  const void *data,
+  size_t size)
+{
+  assert(data != NULL);
+
+  void *copy = buffer_pool_acquire(size, false);
+  if (copy != NULL) {
+    memcpy(copy, data, size);
+  }
+  return copy;
+}
+
+// Hands a buffer of at least size bytes back to the pool; buffers
+// obtained from the pool may also be freed directly
+void
+buffer_pool_release(
+  void *data,
+  size_t size)
+{
+  if (data == NULL) {
+    return;
+  }
+
+  _buffer_pool_lock();
+
+  if ((size < BUFFER_POOL_MIN_SIZE) || (size > _pool.budget)) {
+    _buffer_pool_unlock();
+    free(data);
+    return;
+  }
+
+  int32_t b = _buffer_pool_bucket(size);
+  if (_pool.nb_entries[b] >= BUFFER_POOL_BUCKET_ENTRIES) {
+    _buffer_pool_evict(b);
+  }
+
+  _pool.buckets[b][_pool.nb_entries[b]++] = (buffer_pool_entry_t){
+    .data = data, .size = size, .stamp = ++_pool.stamp };
+  _pool.stats.entries++;
+  _pool.stats.bytes += size;
+
+  while (_pool.stats.bytes > _pool.budget) {
+    _buffer_pool_evict(-1);
+  }
+
+  _buffer_pool_unlock();
+}
+
+// Frees all the buffers held by the pool
+void
+buffer_pool_trim(
+  void)
+{
+  _buffer_pool_lock();
+  while (_pool.stats.entries > 0) {
+    _buffer_pool_evict(-1);
+  }
+  _buffer_pool_unlock();
+}
+
+size_t
+buffer_pool_get_budget(
+  void)
+{
+  _buffer_pool_lock();
+  size_t budget = _pool.budget;
+  _buffer_pool_unlock();
+  return budget;
+}
+
+void
+buffer_pool_set_budget(
+  size_t budget)
+{
+  _buffer_pool_lock();
+  _pool.budget = budget;
+  while (_pool.stats.bytes > _pool.budget) {
+    _buffer_pool_evict(-1);
+  }
+  _buffer_pool_unlock();
+}
+
+void
+buffer_pool_get_stats(
+  buffer_pool_stats_t *stats)
+{
+  assert(stats != NULL);
+
+  _buffer_pool_lock();
+  *stats = _pool.stats;
+  _buffer_pool_unlock();
+}
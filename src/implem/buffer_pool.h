@@ -0,0 +1,62 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef __BUFFER_POOL_H
+#define __BUFFER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Smaller buffers are left to the allocator
+#define BUFFER_POOL_MIN_SIZE (64 * 1024)
+
+#define BUFFER_POOL_DEFAULT_BUDGET (32 * 1024 * 1024)
+
+typedef struct buffer_pool_stats_t {
+  int64_t hits;
+  int64_t misses;
+  int64_t evictions;
+  int32_t entries;
+  size_t bytes;
+} buffer_pool_stats_t;
+
+void *
+buffer_pool_acquire(
+  size_t size,
+  bool zero);
+
+void *
+buffer_pool_dup(
+  const void *data,
+  size_t size);
+
+void
+buffer_pool_release(
+  void *data,
+  size_t size);
+
+void
+buffer_pool_trim(
+  void);
+
+size_t
+buffer_pool_get_budget(
+  void);
+
+void
+buffer_pool_set_budget(
+  size_t budget);
+
+void
+buffer_pool_get_stats(
+  buffer_pool_stats_t *stats);
+
+#endif /* __BUFFER_POOL_H */
@@ -16,6 +16,7 @@
 #include <assert.h>
 
 #include "util.h"
+#include "object.h"
 #include "unicode.h"
 #include "tuples.h"
 #include "point.h"
@@ -31,6 +32,7 @@
 #include "font_desc.h"
 #include "font.h"
 #include "draw_style.h"
+#include "color_composition.h"
 #include "gradient.h"
 #include "transform.h"
 #include "path2d.h"
@@ -39,7 +41,9 @@
 #include "polygon_internal.h"
 #include "polygonize.h"
 #include "poly_render.h"
-#include "draw_instr.h"
+#include "mask_cache.h"
+#include "clip_path.h"
+#include "picture.h"
 #include "image_interpolation.h"
 #include "filters.h"
 #include "backend.h"
@@ -88,11 +92,16 @@ _canvas_create_internal(
     goto error_state;
   }
 
-  canvas->state_stack = list_new((free_val_fun_t *)state_destroy);
+  canvas->state_stack = list_new((free_val_fun_t *)state_release);
   if (canvas->state_stack == NULL) {
     goto error_state_stack;
   }
 
+  canvas->mask_cache = mask_cache_create(MASK_CACHE_DEFAULT_BUDGET);
+  if (canvas->mask_cache == NULL) {
+    goto error_mask_cache;
+  }
+
   if (type == CANVAS_OFFSCREEN) {
     canvas->window = NULL;
 
@@ -138,6 +147,14 @@ _canvas_create_internal(
   canvas->width = width;
   canvas->height = height;
   canvas->clip_region_dirty = false;
+  canvas->filtering = false;
+  canvas->picture = NULL;
+  canvas->deferred = NULL;
+  canvas->layer = NULL;
+  canvas->state_depth = 0;
+  canvas->locked = false;
+  canvas->lock_data = NULL;
+  canvas->path_tolerance = 0.0;
 
   canvas->autocommit = autocommit;
   canvas->committed = false;
@@ -158,9 +175,11 @@ error_target:
   window_destroy(canvas->window);
 error_window:
 error_offscreen_context:
+  mask_cache_destroy(canvas->mask_cache);
+error_mask_cache:
   list_delete(canvas->state_stack);
 error_state_stack:
-  state_destroy(canvas->state);
+  state_release(canvas->state);
 error_state:
   path2d_release(canvas->path_2d);
 error_path:
@@ -248,6 +267,8 @@ _canvas_destroy(
   assert(canvas->state_stack != NULL);
   assert(canvas->path_2d != NULL);
 
+  canvas_unlock_pixels(canvas);
+
   if (_canvas_destroy_callback != NULL) {
     _canvas_destroy_callback(canvas);
   }
@@ -265,9 +286,24 @@ _canvas_destroy(
     font_destroy(canvas->font);
   }
 
+  if (canvas->picture != NULL) {
+    picture_release(canvas->picture);
+  }
+
+  if (canvas->deferred != NULL) {
+    picture_release(canvas->deferred);
+  }
+
+  while (canvas->layer != NULL) {
+    canvas_layer_t *layer = canvas->layer;
+    canvas->layer = layer->below;
+    free(layer);
+  }
+
   path2d_release(canvas->path_2d);
+  mask_cache_destroy(canvas->mask_cache);
   list_delete(canvas->state_stack);
-  state_destroy(canvas->state);
+  state_release(canvas->state);
   free(canvas);
 }
 
@@ -332,6 +368,8 @@ canvas_commit(
 {
   assert(canvas != NULL);
 
+  _canvas_flush(canvas);
+
   if (canvas->window != NULL) {
     canvas->committed = true;
   }
@@ -378,8 +416,18 @@ _canvas_reset_state(
   assert(canvas->state != NULL);
   assert(canvas->state_stack != NULL);
 
-  state_reset(canvas->state);
+  // Drop the saved states first, so that the current one is
+  // no longer shared and can be reset in place
   list_reset(canvas->state_stack);
+  canvas->state_depth = 0;
+  if ((object_is_shared(canvas->state) == true) ||
+      (state_reset(canvas->state) == false)) {
+    state_t *s = state_create();
+    if (s != NULL) {
+      state_release(canvas->state);
+      canvas->state = s;
+    }
+  }
   path2d_reset(canvas->path_2d);
 
   context_clear_clip(canvas->context);
@@ -395,6 +443,11 @@ _canvas_set_size_internal(
   assert(canvas != NULL);
   assert(canvas->context != NULL);
 
+  canvas_unlock_pixels(canvas);
+  while (canvas->layer != NULL) {
+    canvas_end_layer(canvas);
+  }
+  _canvas_flush(canvas);
   _canvas_reset_state(canvas);
 
   width = max(1, width);
@@ -465,23 +518,44 @@ canvas_set_position(
 
 /* State */
 
-bool
-canvas_save(
+// Gives the canvas its own copy of the current state if it is
+// still shared with the save stack; must be called before any
+// lasting change to the state (temporary overrides that are
+// undone before returning need not)
+static bool
+_canvas_own_state(
   canvas_t *canvas)
 {
   assert(canvas != NULL);
   assert(canvas->state != NULL);
-  assert(canvas->state_stack != NULL);
+
+  if (object_is_shared(canvas->state) == false) {
+    return true;
+  }
 
   state_t *s = state_copy(canvas->state);
   if (s == NULL) {
     return false;
   }
+  state_release(canvas->state);
+  canvas->state = s;
+  return true;
+}
+
+bool
+canvas_save(
+  canvas_t *canvas)
+{
+  assert(canvas != NULL);
+  assert(canvas->state != NULL);
+  assert(canvas->state_stack != NULL);
+
+  // The saved state is shared with the canvas until either is modified
   if (!list_push(canvas->state_stack, (void *)canvas->state)) {
-    state_destroy(s);
     return false;
   }
-  canvas->state = s;
+  state_retain(canvas->state);
+  canvas->state_depth++;
   return true;
 }
 
@@ -493,12 +567,24 @@ canvas_restore(
   assert(canvas->state != NULL);
   assert(canvas->state_stack != NULL);
 
+  // States saved before the innermost layer began are out of reach
+  // until it ends
+  if ((canvas->layer != NULL) &&
+      (canvas->state_depth <= canvas->layer->depth)) {
+    return;
+  }
+
   state_t *s = (state_t *)list_pop(canvas->state_stack);
   if (s != NULL) {
-    state_destroy(canvas->state);
+    canvas->state_depth--;
+    // The clip region only needs to be rebuilt if clipping happened
+    // since the matching save
+    if (s->clip_path != canvas->state->clip_path) {
+      context_clear_clip(canvas->context);
+      canvas->clip_region_dirty = (s->clip_path != NULL);
+    }
+    state_release(canvas->state);
     canvas->state = s;
-    context_clear_clip(canvas->context);
-    canvas->clip_region_dirty = !list_is_empty(canvas->state->clip_path);
   }
 }
 
@@ -515,6 +601,10 @@ canvas_set_transform(
   assert(canvas->state != NULL);
   assert(transform != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   *canvas->state->transform = *transform;
 }
 
@@ -527,6 +617,10 @@ canvas_transform(
   assert(canvas->state != NULL);
   assert(transform != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   transform_mul(canvas->state->transform, transform);
 }
 
@@ -539,6 +633,10 @@ canvas_translate(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   transform_translate(canvas->state->transform, x, y);
 }
 
@@ -551,6 +649,10 @@ canvas_scale(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   transform_scale(canvas->state->transform, x, y);
 }
 
@@ -563,6 +665,10 @@ canvas_shear(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   transform_shear(canvas->state->transform, x, y);
 }
 
@@ -574,6 +680,10 @@ canvas_rotate(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   transform_rotate(canvas->state->transform, a);
 }
 
@@ -599,6 +709,10 @@ canvas_set_line_width(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   canvas->state->line_width = line_width;
 }
 
@@ -620,6 +734,10 @@ canvas_set_join_type(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   canvas->state->join_type = join_type;
 }
 
@@ -641,9 +759,67 @@ canvas_set_cap_type(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   canvas->state->cap_type = cap_type;
 }
 
+double
+canvas_get_path_tolerance(
+  const canvas_t *canvas)
+{
+  assert(canvas != NULL);
+
+  return canvas->path_tolerance;
+}
+
+void
+canvas_set_path_tolerance(
+  canvas_t *canvas,
+  double tolerance)
+{
+  assert(canvas != NULL);
+
+  if (tolerance >= 0.0) {
+    canvas->path_tolerance = tolerance;
+  }
+}
+
+size_t
+canvas_get_mask_cache_budget(
+  const canvas_t *canvas)
+{
+  assert(canvas != NULL);
+  assert(canvas->mask_cache != NULL);
+
+  return mask_cache_get_budget(canvas->mask_cache);
+}
+
+void
+canvas_set_mask_cache_budget(
+  canvas_t *canvas,
+  size_t budget)
+{
+  assert(canvas != NULL);
+  assert(canvas->mask_cache != NULL);
+
+  mask_cache_set_budget(canvas->mask_cache, budget);
+}
+
+void
+canvas_get_mask_cache_stats(
+  const canvas_t *canvas,
+  mask_cache_stats_t *stats)
+{
+  assert(canvas != NULL);
+  assert(canvas->mask_cache != NULL);
+  assert(stats != NULL);
+
+  mask_cache_get_stats(canvas->mask_cache, stats);
+}
+
 double
 canvas_get_miter_limit(
   const canvas_t *canvas)
@@ -662,6 +838,10 @@ canvas_set_miter_limit(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   if (miter_limit <= 0.0) {
     return;
   }
@@ -687,6 +867,10 @@ canvas_set_line_dash_offset(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   canvas->state->line_dash_offset = line_dash_offset;
 }
 
@@ -719,6 +903,10 @@ canvas_set_line_dash(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   if (canvas->state->line_dash != NULL) {
     free(canvas->state->line_dash);
   }
@@ -761,6 +949,10 @@ canvas_set_stroke_color(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   draw_style_destroy(&canvas->state->stroke_style);
   canvas->state->stroke_style.type = DRAW_STYLE_COLOR;
   canvas->state->stroke_style.content.color = color;
@@ -775,6 +967,10 @@ canvas_set_stroke_gradient(
   assert(canvas->state != NULL);
   assert(gradient != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   draw_style_destroy(&canvas->state->stroke_style);
   canvas->state->stroke_style.type = DRAW_STYLE_GRADIENT;
   canvas->state->stroke_style.content.gradient = gradient_retain(gradient);
@@ -789,6 +985,10 @@ canvas_set_stroke_pattern(
   assert(canvas->state != NULL);
   assert(pattern != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   draw_style_destroy(&canvas->state->stroke_style);
   canvas->state->stroke_style.type = DRAW_STYLE_PATTERN;
   canvas->state->stroke_style.content.pattern = pattern_retain(pattern);
@@ -826,6 +1026,10 @@ canvas_set_fill_color(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   draw_style_destroy(&canvas->state->fill_style);
   canvas->state->fill_style.type = DRAW_STYLE_COLOR;
   canvas->state->fill_style.content.color = color;
@@ -840,6 +1044,10 @@ canvas_set_fill_gradient(
   assert(canvas->state != NULL);
   assert(gradient != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   draw_style_destroy(&canvas->state->fill_style);
   canvas->state->fill_style.type = DRAW_STYLE_GRADIENT;
   canvas->state->fill_style.content.gradient = gradient_retain(gradient);
@@ -854,6 +1062,10 @@ canvas_set_fill_pattern(
   assert(canvas->state != NULL);
   assert(pattern != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   draw_style_destroy(&canvas->state->fill_style);
   canvas->state->fill_style.type = DRAW_STYLE_PATTERN;
   canvas->state->fill_style.content.pattern = pattern_retain(pattern);
@@ -887,6 +1099,10 @@ canvas_set_global_alpha(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   if ((global_alpha >= 0.0) && (global_alpha <= 1.0)) {
     canvas->state->global_alpha = global_alpha;
   }
@@ -910,9 +1126,41 @@ canvas_set_comp_operation(
   assert(canvas != NULL);
   assert(canvas->state != NULL);
 
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
   canvas->state->global_composite_operation = op;
 }
 
+// The smoothing quality is kept by the draw styles,
+// so that it reaches the renderer along with them
+image_smoothing_t
+canvas_get_image_smoothing(
+  const canvas_t *canvas)
+{
+  assert(canvas != NULL);
+  assert(canvas->state != NULL);
+
+  return canvas->state->fill_style.smoothing;
+}
+
+void
+canvas_set_image_smoothing(
+  canvas_t *canvas,
+  image_smoothing_t smoothing)
+{
+  assert(canvas != NULL);
+  assert(canvas->state != NULL);
+
+  if (_canvas_own_state(canvas) == false) {
+    return;
+  }
+
+  canvas->state->fill_style.smoothing = smoothing;
+  canvas->state->stroke_style.smoothing = smoothing;
+}
+
 void
 canvas_set_font(
   canvas_t *c,
@@ -927,6 +1175,20 @@ canvas_set_font(
   assert(size > 0.0);
   assert(weight >= 0);
 
+  if (_canvas_own_state(c) == false) {
+    return;
+  }
+
+  // The font description may be shared with saved states or fonts
+  if (object_is_shared(c->state->font_desc) == true) {
+    font_desc_t *fd = font_desc_copy(c->state->font_desc);
+    if (fd == NULL) {
+      return;
+    }
+    font_desc_release(c->state->font_desc);
+    c->state->font_desc = fd;
+  }
+
   font_desc_set(c->state->font_desc, family, size, slant, weight);
 }
 
@@ -948,6 +1210,10 @@ canvas_set_shadow_color(
   assert(c != NULL);
   assert(c->state != NULL);
 
+  if (_canvas_own_state(c) == false) {
+    return;
+  }
+
   c->state->shadow.color = color;
 }
 
@@ -969,6 +1235,10 @@ canvas_set_shadow_blur(
   assert(c != NULL);
   assert(c->state != NULL);
 
+  if (_canvas_own_state(c) == false) {
+    return;
+  }
+
   c->state->shadow.blur = shadow_blur;
 }
 
@@ -991,10 +1261,67 @@ canvas_set_shadow_offset(
   assert(c != NULL);
   assert(c->state != NULL);
 
+  if (_canvas_own_state(c) == false) {
+    return;
+  }
+
   c->state->shadow.offset_x = x;
   c->state->shadow.offset_y = y;
 }
 
+const filter_t *
+canvas_get_filter(
+  const canvas_t *c)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+
+  return c->state->filters;
+}
+
+int32_t
+canvas_get_filter_length(
+  const canvas_t *c)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+
+  return c->state->nb_filters;
+}
+
+bool
+canvas_set_filter(
+  canvas_t *c,
+  const filter_t *filters,
+  int32_t nb_filters)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert((filters != NULL) || (nb_filters == 0));
+  assert(nb_filters >= 0);
+
+  if (_canvas_own_state(c) == false) {
+    return false;
+  }
+
+  filter_t *copy = NULL;
+  if (nb_filters > 0) {
+    copy = (filter_t *)memdup(filters, nb_filters * sizeof(filter_t));
+    if (copy == NULL) {
+      return false;
+    }
+  }
+
+  if (c->state->filters != NULL) {
+    free(c->state->filters);
+  }
+
+  c->state->filters = copy;
+  c->state->nb_filters = nb_filters;
+
+  return true;
+}
+
 
 
 /* Paths */
@@ -1159,12 +1486,13 @@ _canvas_clip_region_ensure(
 {
   assert(c != NULL);
   assert(c->state != NULL);
-  assert(c->state->clip_path != NULL);
 
   if (c->clip_region_dirty == false) {
     return true;
   }
 
+  assert(c->state->clip_path != NULL);
+
   if (context_clip(c->context, c->state->clip_path,
                    c->state->transform) == false) {
     return false;
@@ -1175,96 +1503,407 @@ _canvas_clip_region_ensure(
   return true;
 }
 
-void
-canvas_fill(
-  canvas_t *c,
-  bool non_zero)
+// True if drawing operations currently cast a shadow
+static bool
+_canvas_has_shadow(
+  const canvas_t *c)
 {
   assert(c != NULL);
-  assert(c->path_2d != NULL);
   assert(c->state != NULL);
-  assert(c->context != NULL);
 
-  _canvas_clip_region_ensure(c);
+  const shadow_t *shadow = &c->state->shadow;
+  return
+    (shadow->blur > 0.0 ||
+     shadow->offset_x != 0.0 || shadow->offset_y != 0.0) &&
+    c->state->global_composite_operation != COPY &&
+    shadow->color.a != 0;
+}
 
-// TODO: initial size according to number of primitive
-  polygon_t *p = polygon_create(1024, 16);
-  if (p == NULL) {
-    return;
+// Picture that drawing operations go to instead of the context:
+// the one being recorded, if any, or else the deferred operations,
+// unless drawing to the filter layer or the pixels are locked;
+// NULL to draw directly
+static picture_t *
+_canvas_get_recorder(
+  const canvas_t *c)
+{
+  assert(c != NULL);
+
+  if (c->picture != NULL) {
+    return c->picture;
   }
+  if ((c->filtering == false) && (c->locked == false)) {
+    return c->deferred;
+  }
+  return NULL;
+}
 
-  rect_t bbox = { 0 };
-  if (polygonize(path2d_get_path(c->path_2d), p, &bbox) == true) {
-    context_render_polygon(c->context, p, &bbox, c->state->fill_style,
-                           c->state->global_alpha, &c->state->shadow,
-                           c->state->global_composite_operation,
-                           non_zero, c->state->transform);
+// Renders a device space polygon, or records it
+// if the canvas is recording a picture or deferring
+static void
+_canvas_render_polygon(
+  canvas_t *c,
+  const polygon_t *p,
+  const rect_t *bbox,
+  draw_style_t draw_style,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  bool non_zero,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->context != NULL);
+  assert(p != NULL);
+  assert(bbox != NULL);
+  assert(shadow != NULL);
+  assert(transform != NULL);
+
+  picture_t *recorder = _canvas_get_recorder(c);
+  if (recorder != NULL) {
+    picture_instr_t instr = {
+      .type = PICTURE_INSTR_POLYGON, .poly = (polygon_t *)p,
+      .bbox = *bbox, .style = draw_style, .transform = *transform,
+      .global_alpha = global_alpha, .shadow = *shadow,
+      .compose_op = compose_op, .non_zero = non_zero,
+      .line_width = 0.0, .clip_path = c->state->clip_path };
+    picture_add(recorder, &instr);
+    return;
   }
 
-  polygon_destroy(p);
+  context_render_polygon(c->context, p, bbox, draw_style, global_alpha,
+                         shadow, compose_op, non_zero, transform);
 }
 
-void
-canvas_fill_path(
+// Renders a device space polygon as hairlines, or records it
+// if the canvas is recording a picture or deferring
+static void
+_canvas_render_hairline(
   canvas_t *c,
-  path2d_t *path,
-  bool non_zero)
+  const polygon_t *p,
+  draw_style_t draw_style,
+  double global_alpha,
+  double width,
+  composite_operation_t compose_op,
+  const transform_t *transform)
 {
   assert(c != NULL);
   assert(c->state != NULL);
   assert(c->context != NULL);
-  assert(path != NULL);
-
-  _canvas_clip_region_ensure(c);
+  assert(p != NULL);
+  assert(transform != NULL);
 
-// TODO: initial size according to number of primitive
-  polygon_t *p = polygon_create(1024, 16);
-  if (p == NULL) {
+  picture_t *recorder = _canvas_get_recorder(c);
+  if (recorder != NULL) {
+    rect_t bbox = { 0 };
+    polygon_bbox(p, &bbox);
+    bbox.p1.x -= width; bbox.p1.y -= width;
+    bbox.p2.x += width; bbox.p2.y += width;
+    picture_instr_t instr = {
+      .type = PICTURE_INSTR_HAIRLINE, .poly = (polygon_t *)p,
+      .bbox = bbox, .style = draw_style, .transform = *transform,
+      .global_alpha = global_alpha, .shadow = { 0 },
+      .compose_op = compose_op, .non_zero = true,
+      .line_width = width, .clip_path = c->state->clip_path };
+    picture_add(recorder, &instr);
     return;
   }
 
-  rect_t bbox = { 0 };
-  if (polygonize(path2d_get_path(path), p, &bbox) == true) {
+  context_render_hairline(c->context, p, draw_style, global_alpha,
+                          width, compose_op, transform);
+}
 
-    // Apply transformation
-    for (int i = 0; i < p->nb_points; ++i) {
-      transform_apply(c->state->transform, &(p->points[i]));
+// Maps a user space bounding box to device space
+static rect_t
+_canvas_transform_bbox(
+  const transform_t *t,
+  rect_t bbox)
+{
+  assert(t != NULL);
+
+  point_t p1 = bbox.p1;
+  point_t p2 = point(bbox.p2.x, bbox.p1.y);
+  point_t p3 = bbox.p2;
+  point_t p4 = point(bbox.p1.x, bbox.p2.y);
+  transform_apply(t, &p1);
+  transform_apply(t, &p2);
+  transform_apply(t, &p3);
+  transform_apply(t, &p4);
+
+  bbox = rect(p1, p1);
+  rect_expand(&bbox, p2);
+  rect_expand(&bbox, p3);
+  rect_expand(&bbox, p4);
+  return bbox;
+}
+
+// How far, in device space, the outline of a stroke may extend
+// beyond the path it follows (square caps reach w/2 * sqrt(2))
+static double
+_canvas_stroke_margin(
+  const canvas_t *c)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+
+  const state_t *s = c->state;
+
+  double f = M_SQRT2;
+  if (s->join_type == JOIN_MITER) {
+    f = max(f, s->miter_limit);
+  }
+  return s->line_width / 2.0 * f * transform_get_max_scale(s->transform);
+}
+
+// True if drawing a shape with the given device space bounds
+// cannot change any pixel of the canvas, given the canvas size,
+// the bounds of the clip path, the shadow and the filter;
+// operations that affect the whole canvas are never culled
+static bool
+_canvas_is_culled(
+  const canvas_t *c,
+  rect_t bbox)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+
+  const state_t *s = c->state;
+
+  if (comp_is_full_screen(s->global_composite_operation) == true) {
+    return false;
+  }
+
+  // Leave room for antialiasing
+  bbox.p1.x -= 1.0; bbox.p1.y -= 1.0;
+  bbox.p2.x += 1.0; bbox.p2.y += 1.0;
+
+  if (_canvas_has_shadow(c) == true) {
+    double r = sqrt(3.0) * s->shadow.blur + 1.0;
+    rect_expand(&bbox, point(bbox.p1.x + s->shadow.offset_x - r,
+                             bbox.p1.y + s->shadow.offset_y - r));
+    rect_expand(&bbox, point(bbox.p2.x + s->shadow.offset_x + r,
+                             bbox.p2.y + s->shadow.offset_y + r));
+  }
+
+  if (s->nb_filters > 0) {
+    double m = filter_get_margin(s->filters, s->nb_filters);
+    bbox.p1.x -= m; bbox.p1.y -= m;
+    bbox.p2.x += m; bbox.p2.y += m;
+  }
+
+  // A picture may be replayed anywhere, so only the clip
+  // path culls while recording
+  if (c->picture == NULL) {
+    rect_t canvas_bbox =
+      rect(point(0.0, 0.0), point((double)c->width, (double)c->height));
+    rect_intersect(&bbox, &canvas_bbox);
+  }
+  if (s->clip_path != NULL) {
+    rect_intersect(&bbox, &s->clip_path->bbox);
+  }
+
+  return rect_empty(&bbox);
+}
+
+// True if filling or stroking the given path cannot change any pixel;
+// transformed tells whether the path points still need the current
+// transform applied
+static bool
+_canvas_path_is_culled(
+  const canvas_t *c,
+  path2d_t *path,
+  bool transformed,
+  bool stroke)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(path != NULL);
+
+  rect_t bbox = { 0 };
+  if (path_get_bounds(path2d_get_path(path), &bbox) == false) {
+    return false;
+  }
+
+  if (transformed == true) {
+    bbox = _canvas_transform_bbox(c->state->transform, bbox);
+  }
+
+  if (stroke == true) {
+    double m = _canvas_stroke_margin(c);
+    bbox.p1.x -= m; bbox.p1.y -= m;
+    bbox.p2.x += m; bbox.p2.y += m;
+  }
+
+  return _canvas_is_culled(c, bbox);
+}
+
+// Drawing state overridden while drawing to the filter layer
+typedef struct canvas_filter_layer_t {
+  double global_alpha;
+  composite_operation_t compose_op;
+} canvas_filter_layer_t;
+
+// When a filter is set, redirects drawing to a transparent layer,
+// drawn with full opacity and source-over; the clip, the global
+// alpha and the composite operation apply when the filtered layer
+// is composed back; a canvas drawn onto itself is not filtered,
+// as the layer would hide its content; filters are not recorded
+// into pictures
+static bool
+_canvas_filter_begin(
+  canvas_t *c,
+  const canvas_t *src,
+  canvas_filter_layer_t *fl) // out
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(fl != NULL);
+
+  if ((c->state->nb_filters == 0) || (c->filtering == true) ||
+      (c->picture != NULL) || (src == c)) {
+    return false;
+  }
+
+  // Deferred operations go below the layer, and the clip region
+  // must be set aside along with the surface
+  _canvas_flush(c);
+  _canvas_clip_region_ensure(c);
+
+  if (context_push_layer(c->context) == false) {
+    return false;
+  }
+
+  fl->global_alpha = c->state->global_alpha;
+  fl->compose_op = c->state->global_composite_operation;
+  c->state->global_alpha = 1.0;
+  c->state->global_composite_operation = SOURCE_OVER;
+  c->filtering = true;
+
+  return true;
+}
+
+static void
+_canvas_filter_end(
+  canvas_t *c,
+  const canvas_filter_layer_t *fl)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->filtering == true);
+  assert(fl != NULL);
+
+  c->filtering = false;
+  c->state->global_alpha = fl->global_alpha;
+  c->state->global_composite_operation = fl->compose_op;
+  context_pop_layer(c->context, c->state->filters, c->state->nb_filters,
+                    fl->global_alpha, fl->compose_op);
+}
+
+// Draws through the filter layer: if one is needed, the enclosing
+// drawing function calls itself again with the layer in place,
+// then returns
+#define _canvas_filtered(c, src, call) \
+  do { \
+    canvas_filter_layer_t _fl; \
+    if (_canvas_filter_begin((c), (src), &_fl) == true) { \
+      call; \
+      _canvas_filter_end((c), &_fl); \
+      return; \
+    } \
+  } while (0)
+
+// Fills a path that consists of a single rectangle or full ellipse
+// with the analytic coverage kernels, provided the transform keeps
+// it a rectangle or an axis-aligned ellipse; transformed tells
+// whether the path points still need the current transform applied;
+// returns false if the path should be rendered as a polygon instead
+static bool
+_canvas_fill_shape(
+  canvas_t *c,
+  const path2d_t *path,
+  bool transformed)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->context != NULL);
+  assert(path != NULL);
+
+  path2d_shape_t shape = { 0 };
+  if ((_canvas_get_recorder(c) != NULL) ||
+      (path2d_get_shape(path, &shape) == false) ||
+      (_canvas_has_shadow(c) == true)) {
+    return false;
+  }
+
+  transform_t m = shape.transform;
+  if (transformed == true) {
+    m = *c->state->transform;
+    transform_mul(&m, &shape.transform);
+  }
+
+  if (shape.type == PATH2D_SHAPE_RECT) {
+
+    if (transform_is_axis_aligned(&m) == false) {
+      return false;
     }
+    point_t p1 = point(shape.x, shape.y);
+    point_t p2 = point(shape.x + shape.w, shape.y + shape.h);
+    transform_apply(&m, &p1);
+    transform_apply(&m, &p2);
+    context_render_rect(c->context, p1.x, p1.y, p2.x, p2.y,
+                        c->state->fill_style, c->state->global_alpha,
+                        c->state->global_composite_operation,
+                        c->state->transform);
 
-    // Update bbox
-    point_t pt1 = transform_apply_new(c->state->transform, &bbox.p1);
-    point_t pt2 = transform_apply_new(c->state->transform, &bbox.p2);
-    point_t bp3 = point(bbox.p2.x, bbox.p1.y);
-    point_t bp4 = point(bbox.p1.x, bbox.p2.y);
-    point_t pt3 = transform_apply_new(c->state->transform, &bp3);
-    point_t pt4 = transform_apply_new(c->state->transform, &bp4);
-    double xmin = min(pt1.x, min(pt2.x, min(pt3.x, pt4.x)));
-    double ymin = min(pt1.y, min(pt2.y, min(pt3.y, pt4.y)));
-    double xmax = max(pt1.x, max(pt2.x, max(pt3.x, pt4.x)));
-    double ymax = max(pt1.y, max(pt2.y, max(pt3.y, pt4.y)));
-    bbox.p1 = point(xmin, ymin);
-    bbox.p2 = point(xmax, ymax);
+  } else {
 
-    context_render_polygon(c->context, p, &bbox, c->state->fill_style,
-                           c->state->global_alpha, &c->state->shadow,
+    double rx = 0.0, ry = 0.0;
+    if (transform_is_axis_aligned(&m) == true) {
+      rx = shape.w * m.a;
+      ry = shape.h * m.d;
+    } else if ((shape.w == shape.h) &&
+               (((m.a == m.d) && (m.b == -m.c)) ||
+                ((m.a == -m.d) && (m.b == m.c)))) {
+      // A circle stays a circle under a similarity
+      rx = ry = shape.w * sqrt(m.a * m.a + m.b * m.b);
+    } else {
+      return false;
+    }
+    point_t p = point(shape.x, shape.y);
+    transform_apply(&m, &p);
+    context_render_ellipse(c->context, p.x, p.y, rx, ry,
+                           c->state->fill_style, c->state->global_alpha,
                            c->state->global_composite_operation,
-                           non_zero, c->state->transform);
+                           c->state->transform);
+
   }
 
-  polygon_destroy(p);
+  return true;
 }
 
 void
-canvas_stroke(
-  canvas_t *c)
+canvas_fill(
+  canvas_t *c,
+  bool non_zero)
 {
   assert(c != NULL);
+  assert(c->path_2d != NULL);
   assert(c->state != NULL);
   assert(c->context != NULL);
-  assert(c->path_2d != NULL);
+
+  if (_canvas_path_is_culled(c, c->path_2d, false, false) == true) {
+    return;
+  }
+
+  _canvas_filtered(c, NULL, canvas_fill(c, non_zero));
 
   _canvas_clip_region_ensure(c);
 
+  if (_canvas_fill_shape(c, c->path_2d, false) == true) {
+    return;
+  }
+
 // TODO: initial size according to number of primitive
   polygon_t *p = polygon_create(1024, 16);
   if (p == NULL) {
@@ -1272,33 +1911,174 @@ canvas_stroke(
   }
 
   rect_t bbox = { 0 };
-  if (polygonize_outline(path2d_get_path(c->path_2d),
-                         c->state->line_width, p, &bbox,
-                         c->state->join_type, c->state->cap_type,
-                         c->state->miter_limit,
-                         c->state->transform, true,
-                         c->state->line_dash, c->state->line_dash_len,
-                         c->state->line_dash_offset) == true) {
-    context_render_polygon(c->context, p, &bbox, c->state->stroke_style,
+  if (polygonize(path2d_get_path(c->path_2d), p, &bbox) == true) {
+    polygon_decimate(p, c->path_tolerance);
+    _canvas_render_polygon(c, p, &bbox, c->state->fill_style,
                            c->state->global_alpha, &c->state->shadow,
                            c->state->global_composite_operation,
-                           true, c->state->transform);
+                           non_zero, c->state->transform);
   }
 
   polygon_destroy(p);
 }
 
-void
-canvas_stroke_path(
+// Finds the coverage mask of a path in the mask cache, or builds
+// and caches it; the path is drawn with the current transform followed
+// by a (dx, dy) translation in device space, and if blur is positive,
+// the mask is blurred like a shadow; the integer position to draw the
+// mask at is stored in (x, y); a mask that could not be cached is
+// stored in *uncached, whose data the caller must free in any case;
+// returns NULL if the path should be rendered directly instead
+static const mask_t *
+_canvas_get_path_mask(
   canvas_t *c,
-  path2d_t *path)
+  path2d_t *path,
+  bool non_zero,
+  double dx,
+  double dy,
+  double blur,
+  int32_t *x, // out
+  int32_t *y, // out
+  mask_t *uncached) // out
 {
   assert(c != NULL);
   assert(c->state != NULL);
-  assert(c->context != NULL);
+  assert(c->mask_cache != NULL);
   assert(path != NULL);
+  assert(x != NULL);
+  assert(y != NULL);
+  assert(uncached != NULL);
+
+  *uncached = (mask_t){ 0 };
+
+  mask_key_t key = { 0 };
+  key.stamp = path2d_get_stamp(path);
+  key.non_zero = non_zero;
+  key.tolerance = c->path_tolerance;
+  key.blur = blur;
+  transform_extract_ft(c->state->transform, &key.a, &key.b, &key.c, &key.d);
+
+  // Quantize the translation to the nearest subpixel phase
+  double e, f;
+  transform_extract_translation(c->state->transform, &e, &f);
+  double qx = floor((e + dx) * MASK_SUBPIXEL_PHASES + 0.5);
+  double qy = floor((f + dy) * MASK_SUBPIXEL_PHASES + 0.5);
+  if ((fabs(qx) >= (double)INT32_MAX) || (fabs(qy) >= (double)INT32_MAX)) {
+    return NULL;
+  }
+  *x = (int32_t)floor(qx / MASK_SUBPIXEL_PHASES);
+  *y = (int32_t)floor(qy / MASK_SUBPIXEL_PHASES);
+  key.phase_x = (int32_t)qx - *x * MASK_SUBPIXEL_PHASES;
+  key.phase_y = (int32_t)qy - *y * MASK_SUBPIXEL_PHASES;
+
+  const mask_t *mask = mask_cache_find(c->mask_cache, &key);
+  if (mask != NULL) {
+    return mask;
+  }
 
-  _canvas_clip_region_ensure(c);
+  mask_t new_mask = { 0 };
+
+  if (blur > 0.0) {
+
+    // Blur a padded copy of the coverage mask
+    mask_t cov_uncached = { 0 };
+    const mask_t *cov =
+      _canvas_get_path_mask(c, path, non_zero, dx, dy, 0.0,
+                            x, y, &cov_uncached);
+    if (cov == NULL) {
+      return NULL;
+    }
+
+    int32_t o = (int32_t)(sqrt(3.0 * blur * blur));
+    new_mask.width = cov->width + o * 2;
+    new_mask.height = cov->height + o * 2;
+    new_mask.x = cov->x - o;
+    new_mask.y = cov->y - o;
+    new_mask.data =
+      (uint8_t *)calloc((size_t)new_mask.width * (size_t)new_mask.height, 1);
+    if (new_mask.data != NULL) {
+      for (int32_t i = 0; i < cov->height; ++i) {
+        memcpy(new_mask.data + (i + o) * new_mask.width + o,
+               cov->data + i * cov->width, cov->width);
+      }
+    }
+    free(cov_uncached.data);
+
+    if ((new_mask.data == NULL) ||
+        (filter_gaussian_blur_a8(new_mask.data, new_mask.width,
+                                 new_mask.height, blur / 2.0) == false)) {
+      free(new_mask.data);
+      return NULL;
+    }
+
+  } else {
+
+    polygon_t *p = polygon_create(1024, 16);
+    if (p == NULL) {
+      return NULL;
+    }
+
+    rect_t bbox = { 0 };
+    if (path2d_polygonize(path, p, &bbox) == false) {
+      polygon_destroy(p);
+      return NULL;
+    }
+
+    // Transform relative to the integer part of the translation
+    transform_t *lin = transform_extract_linear(c->state->transform);
+    if (lin == NULL) {
+      polygon_destroy(p);
+      return NULL;
+    }
+    double ox = (double)key.phase_x / MASK_SUBPIXEL_PHASES;
+    double oy = (double)key.phase_y / MASK_SUBPIXEL_PHASES;
+    for (int32_t i = 0; i < p->nb_points; ++i) {
+      transform_apply(lin, &(p->points[i]));
+      p->points[i].x += ox;
+      p->points[i].y += oy;
+    }
+    transform_destroy(lin);
+    polygon_decimate(p, c->path_tolerance);
+    polygon_bbox(p, &bbox);
+
+    // Large shapes are better rendered clipped to the canvas
+    if ((p->nb_points == 0) ||
+        (bbox.p2.x - bbox.p1.x >= MASK_MAX_SIZE) ||
+        (bbox.p2.y - bbox.p1.y >= MASK_MAX_SIZE)) {
+      polygon_destroy(p);
+      return NULL;
+    }
+
+    bool res = poly_render_coverage(p, &bbox, non_zero, &new_mask);
+    polygon_destroy(p);
+    if (res == false) {
+      return NULL;
+    }
+
+  }
+
+  mask = mask_cache_add(c->mask_cache, &key, new_mask);
+  if (mask == NULL) {
+    *uncached = new_mask;
+    return uncached;
+  }
+
+  return mask;
+}
+
+// Fills a path by polygonizing it, casting the given shadow
+static void
+_canvas_fill_path_direct(
+  canvas_t *c,
+  path2d_t *path,
+  bool non_zero,
+  const shadow_t *shadow)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->context != NULL);
+  assert(path != NULL);
+  assert(shadow != NULL);
 
 // TODO: initial size according to number of primitive
   polygon_t *p = polygon_create(1024, 16);
@@ -1307,79 +2087,422 @@ canvas_stroke_path(
   }
 
   rect_t bbox = { 0 };
-  if (polygonize_outline(path2d_get_path(path),
-                         c->state->line_width, p, &bbox,
-                         c->state->join_type, c->state->cap_type,
-                         c->state->miter_limit,
-                         c->state->transform, false,
-                         c->state->line_dash, c->state->line_dash_len,
-                         c->state->line_dash_offset) == true) {
-    context_render_polygon(c->context, p, &bbox, c->state->stroke_style,
-                           c->state->global_alpha, &c->state->shadow,
+  if (path2d_polygonize(path, p, &bbox) == true) {
+
+    // Apply transformation
+    for (int i = 0; i < p->nb_points; ++i) {
+      transform_apply(c->state->transform, &(p->points[i]));
+    }
+    polygon_decimate(p, c->path_tolerance);
+
+    // Update bbox
+    point_t pt1 = transform_apply_new(c->state->transform, &bbox.p1);
+    point_t pt2 = transform_apply_new(c->state->transform, &bbox.p2);
+    point_t bp3 = point(bbox.p2.x, bbox.p1.y);
+    point_t bp4 = point(bbox.p1.x, bbox.p2.y);
+    point_t pt3 = transform_apply_new(c->state->transform, &bp3);
+    point_t pt4 = transform_apply_new(c->state->transform, &bp4);
+    double xmin = min(pt1.x, min(pt2.x, min(pt3.x, pt4.x)));
+    double ymin = min(pt1.y, min(pt2.y, min(pt3.y, pt4.y)));
+    double xmax = max(pt1.x, max(pt2.x, max(pt3.x, pt4.x)));
+    double ymax = max(pt1.y, max(pt2.y, max(pt3.y, pt4.y)));
+    bbox.p1 = point(xmin, ymin);
+    bbox.p2 = point(xmax, ymax);
+
+    _canvas_render_polygon(c, p, &bbox, c->state->fill_style,
+                           c->state->global_alpha, shadow,
                            c->state->global_composite_operation,
-                           true, c->state->transform);
+                           non_zero, c->state->transform);
   }
 
   polygon_destroy(p);
 }
 
-void
-canvas_clip(
+// Fills a path through the coverage mask cache: the mask only depends
+// on the linear part of the transform and on the subpixel phase of its
+// translation, so a path drawn again at another position reuses it;
+// the shadow of a solid color fill is the blurred coverage mask, which
+// is cached as well; returns false if the path should be rendered
+// directly instead
+static bool
+_canvas_fill_path_cached(
   canvas_t *c,
+  path2d_t *path,
   bool non_zero)
 {
   assert(c != NULL);
-  assert(c->path_2d != NULL);
   assert(c->state != NULL);
-  assert(c->state->clip_path != NULL);
+  assert(c->context != NULL);
+  assert(c->mask_cache != NULL);
+  assert(path != NULL);
 
-// TODO: initial size according to number of primitive
-  polygon_t *p = polygon_create(1024, 16);
-  if (p == NULL) {
-    return;
+  bool has_shadow = _canvas_has_shadow(c);
+  if ((_canvas_get_recorder(c) != NULL) ||
+      (mask_cache_get_budget(c->mask_cache) == 0) ||
+      ((has_shadow == true) &&
+       (c->state->fill_style.type != DRAW_STYLE_COLOR))) {
+    return false;
   }
 
-  rect_t bbox = { 0 };
-  if (polygonize(path2d_get_path(c->path_2d), p, &bbox) == true) {
-    list_push(c->state->clip_path, path_fill_instr_create(p, non_zero));
+  int32_t x = 0, y = 0;
+  mask_t uncached = { 0 };
+
+  // Draw the shadow first, as caching the shape mask may evict it
+  if (has_shadow == true) {
+    const shadow_t *shadow = &c->state->shadow;
+    const mask_t *mask =
+      _canvas_get_path_mask(c, path, non_zero,
+                            shadow->offset_x, shadow->offset_y,
+                            shadow->blur, &x, &y, &uncached);
+    if (mask == NULL) {
+      return false;
+    }
+    color_t_ shadow_color = shadow->color;
+    shadow_color.a =
+      (uint8_t)(shadow_color.a * c->state->fill_style.content.color.a / 255);
+    draw_style_t shadow_style = { .type = DRAW_STYLE_COLOR,
+                                  .content.color = shadow_color };
+    context_render_mask(c->context, mask, x, y, shadow_style,
+                        c->state->global_alpha,
+                        c->state->global_composite_operation,
+                        c->state->transform);
+    free(uncached.data);
   }
 
-  polygon_destroy(p);
+  const mask_t *mask =
+    _canvas_get_path_mask(c, path, non_zero, 0.0, 0.0, 0.0,
+                          &x, &y, &uncached);
+  if (mask == NULL) {
+    if (has_shadow == true) {
+      const shadow_t no_shadow = { 0 };
+      _canvas_fill_path_direct(c, path, non_zero, &no_shadow);
+      return true;
+    }
+    return false;
+  }
 
-  c->clip_region_dirty = true;
+  context_render_mask(c->context, mask, x, y, c->state->fill_style,
+                      c->state->global_alpha,
+                      c->state->global_composite_operation,
+                      c->state->transform);
+  free(uncached.data);
+
+  return true;
 }
 
 void
-canvas_clip_path(
+canvas_fill_path(
   canvas_t *c,
   path2d_t *path,
   bool non_zero)
 {
   assert(c != NULL);
   assert(c->state != NULL);
+  assert(c->context != NULL);
   assert(path != NULL);
 
-// TODO: initial size according to number of primitive
-  polygon_t *p = polygon_create(1024, 16);
-  if (p == NULL) {
+  if (_canvas_path_is_culled(c, path, true, false) == true) {
     return;
   }
 
-  rect_t bbox = { 0 };
-  if (polygonize(path2d_get_path(path), p, &bbox) == true) {
-    for (int32_t i = 0; i < p->nb_points; ++i) {
-      transform_apply(c->state->transform, &(p->points[i]));
-    }
-    list_push(c->state->clip_path, path_fill_instr_create(p, non_zero));
-  }
+  _canvas_filtered(c, NULL, canvas_fill_path(c, path, non_zero));
 
-  polygon_destroy(p);
+  _canvas_clip_region_ensure(c);
 
-  c->clip_region_dirty = true;
-}
+  if ((_canvas_fill_shape(c, path, true) == true) ||
+      (_canvas_fill_path_cached(c, path, non_zero) == true)) {
+    return;
+  }
 
+  _canvas_fill_path_direct(c, path, non_zero, &c->state->shadow);
+}
 
-/* Immediate drawing */
+// Thin strokes can be drawn directly as antialiased lines, as long
+// as nothing depends on the exact shape of their outline; miter
+// joins still add spikes to thin strokes, so they are left to the
+// stroker
+static bool
+_canvas_use_hairline(
+  const canvas_t *c)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+
+  const state_t *s = c->state;
+
+  bool has_shadow =
+    (s->shadow.blur > 0.0 ||
+     s->shadow.offset_x != 0.0 || s->shadow.offset_y != 0.0) &&
+    s->shadow.color.a != 0;
+
+  return (s->line_dash_len == 0) &&
+         (s->join_type != JOIN_MITER) &&
+         (has_shadow == false) &&
+         (comp_is_full_screen(s->global_composite_operation) == false) &&
+         (s->line_width * transform_get_max_scale(s->transform) <= 1.0);
+}
+
+// Draws a device space polygon as hairlines, extending
+// the ends of open subpolygons according to the line cap
+static void
+_canvas_stroke_hairline(
+  canvas_t *c,
+  polygon_t *p)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->context != NULL);
+  assert(p != NULL);
+
+  double w =
+    c->state->line_width * transform_get_max_scale(c->state->transform);
+  if (w <= 0.0) {
+    return;
+  }
+
+  if (c->state->cap_type != CAP_BUTT) {
+    for (int32_t ip = 0; ip < p->nb_subpolys; ++ip) {
+      int32_t first = (ip == 0) ? 0 : p->subpolys[ip - 1] + 1;
+      int32_t last = p->subpolys[ip];
+      if ((p->subpoly_closed[ip] == true) || (last <= first)) {
+        continue;
+      }
+      point_t *p1 = &p->points[first];
+      point_t *p2 = &p->points[last];
+      point_t d1 = point(p1->x - p->points[first + 1].x,
+                         p1->y - p->points[first + 1].y);
+      point_t d2 = point(p2->x - p->points[last - 1].x,
+                         p2->y - p->points[last - 1].y);
+      double n1 = sqrt(d1.x * d1.x + d1.y * d1.y);
+      double n2 = sqrt(d2.x * d2.x + d2.y * d2.y);
+      if (n1 > 0.0) {
+        p1->x += d1.x * w / (2.0 * n1); p1->y += d1.y * w / (2.0 * n1);
+      }
+      if (n2 > 0.0) {
+        p2->x += d2.x * w / (2.0 * n2); p2->y += d2.y * w / (2.0 * n2);
+      }
+    }
+  }
+
+  _canvas_render_hairline(c, p, c->state->stroke_style,
+                          c->state->global_alpha, w,
+                          c->state->global_composite_operation,
+                          c->state->transform);
+}
+
+static void
+_canvas_stroke_path_hairline(
+  canvas_t *c,
+  path2d_t *path,
+  bool only_linear)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(path != NULL);
+
+// TODO: initial size according to number of primitive
+  polygon_t *p = polygon_create(1024, 16);
+  if (p == NULL) {
+    return;
+  }
+
+  rect_t bbox = { 0 };
+  bool res = (only_linear == true) ?
+    polygonize(path2d_get_path(path), p, &bbox) :
+    path2d_polygonize(path, p, &bbox);
+  if (res == true) {
+    if (only_linear == false) {
+      for (int i = 0; i < p->nb_points; ++i) {
+        transform_apply(c->state->transform, &(p->points[i]));
+      }
+    }
+    polygon_decimate(p, c->path_tolerance);
+    _canvas_stroke_hairline(c, p);
+  }
+
+  polygon_destroy(p);
+}
+
+void
+canvas_stroke(
+  canvas_t *c)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->context != NULL);
+  assert(c->path_2d != NULL);
+
+  if (_canvas_path_is_culled(c, c->path_2d, false, true) == true) {
+    return;
+  }
+
+  _canvas_filtered(c, NULL, canvas_stroke(c));
+
+  _canvas_clip_region_ensure(c);
+
+  if (_canvas_use_hairline(c) == true) {
+    _canvas_stroke_path_hairline(c, c->path_2d, true);
+    return;
+  }
+
+// TODO: initial size according to number of primitive
+  polygon_t *p = polygon_create(1024, 16);
+  if (p == NULL) {
+    return;
+  }
+
+  rect_t bbox = { 0 };
+  if (polygonize_outline(path2d_get_path(c->path_2d),
+                         c->state->line_width, p, &bbox,
+                         c->state->join_type, c->state->cap_type,
+                         c->state->miter_limit,
+                         c->state->transform, true,
+                         c->state->line_dash, c->state->line_dash_len,
+                         c->state->line_dash_offset,
+                         c->path_tolerance) == true) {
+    _canvas_render_polygon(c, p, &bbox, c->state->stroke_style,
+                           c->state->global_alpha, &c->state->shadow,
+                           c->state->global_composite_operation,
+                           true, c->state->transform);
+  }
+
+  polygon_destroy(p);
+}
+
+void
+canvas_stroke_path(
+  canvas_t *c,
+  path2d_t *path)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->context != NULL);
+  assert(path != NULL);
+
+  if (_canvas_path_is_culled(c, path, true, true) == true) {
+    return;
+  }
+
+  _canvas_filtered(c, NULL, canvas_stroke_path(c, path));
+
+  _canvas_clip_region_ensure(c);
+
+  if (_canvas_use_hairline(c) == true) {
+    _canvas_stroke_path_hairline(c, path, false);
+    return;
+  }
+
+// TODO: initial size according to number of primitive
+  polygon_t *p = polygon_create(1024, 16);
+  if (p == NULL) {
+    return;
+  }
+
+  rect_t bbox = { 0 };
+  if (path2d_polygonize_outline(path,
+                                c->state->line_width, p, &bbox,
+                                c->state->join_type, c->state->cap_type,
+                                c->state->miter_limit,
+                                c->state->transform,
+                                c->state->line_dash, c->state->line_dash_len,
+                                c->state->line_dash_offset,
+                                c->path_tolerance) == true) {
+    _canvas_render_polygon(c, p, &bbox, c->state->stroke_style,
+                           c->state->global_alpha, &c->state->shadow,
+                           c->state->global_composite_operation,
+                           true, c->state->transform);
+  }
+
+  polygon_destroy(p);
+}
+
+// Restricts the clip path of the current state, which shares
+// the previous clip path with the saved states
+static void
+_canvas_clip_polygon(
+  canvas_t *c,
+  const polygon_t *p,
+  bool non_zero)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(p != NULL);
+
+  clip_path_t *cp = clip_path_create(c->state->clip_path, p, non_zero);
+  if (cp == NULL) {
+    return;
+  }
+
+  if (c->state->clip_path != NULL) {
+    clip_path_release(c->state->clip_path);
+  }
+  c->state->clip_path = cp;
+}
+
+void
+canvas_clip(
+  canvas_t *c,
+  bool non_zero)
+{
+  assert(c != NULL);
+  assert(c->path_2d != NULL);
+  assert(c->state != NULL);
+
+  if (_canvas_own_state(c) == false) {
+    return;
+  }
+
+// TODO: initial size according to number of primitive
+  polygon_t *p = polygon_create(1024, 16);
+  if (p == NULL) {
+    return;
+  }
+
+  rect_t bbox = { 0 };
+  if (polygonize(path2d_get_path(c->path_2d), p, &bbox) == true) {
+    _canvas_clip_polygon(c, p, non_zero);
+  }
+
+  polygon_destroy(p);
+
+  c->clip_region_dirty = true;
+}
+
+void
+canvas_clip_path(
+  canvas_t *c,
+  path2d_t *path,
+  bool non_zero)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(path != NULL);
+
+  if (_canvas_own_state(c) == false) {
+    return;
+  }
+
+// TODO: initial size according to number of primitive
+  polygon_t *p = polygon_create(1024, 16);
+  if (p == NULL) {
+    return;
+  }
+
+  rect_t bbox = { 0 };
+  if (path2d_polygonize(path, p, &bbox) == true) {
+    for (int32_t i = 0; i < p->nb_points; ++i) {
+      transform_apply(c->state->transform, &(p->points[i]));
+    }
+    _canvas_clip_polygon(c, p, non_zero);
+  }
+
+  polygon_destroy(p);
+
+  c->clip_region_dirty = true;
+}
+
+
+/* Immediate drawing */
 
 static polygon_t *
 _canvas_build_rect(
@@ -1390,236 +2513,956 @@ _canvas_build_rect(
   double height,
   rect_t *bbox) // out
 {
-  assert(c != NULL);
-  assert(c->state != NULL);
-  assert(bbox != NULL);
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(bbox != NULL);
+
+  polygon_t *p = polygon_create(8, 1);
+  if (p == NULL) {
+    return NULL;
+  }
+
+  point_t p1 = point(x, y);
+  point_t p2 = point(x + width, y);
+  point_t p3 = point(x + width, y + height);
+  point_t p4 = point(x, y + height);
+
+  transform_apply(c->state->transform, &p1);
+  transform_apply(c->state->transform, &p2);
+  transform_apply(c->state->transform, &p3);
+  transform_apply(c->state->transform, &p4);
+
+  polygon_add_point(p, p1);
+  polygon_add_point(p, p2);
+  polygon_add_point(p, p3);
+  polygon_add_point(p, p4);
+  polygon_end_subpoly(p, true);
+
+  *bbox = rect(point(min4(p1.x, p2.x, p3.x, p4.x),
+                     min4(p1.y, p2.y, p3.y, p4.y)),
+               point(max4(p1.x, p2.x, p3.x, p4.x),
+                     max4(p1.y, p2.y, p3.y, p4.y)));
+
+  return p;
+}
+
+void
+canvas_fill_rect(
+  canvas_t *c,
+  double x,
+  double y,
+  double width,
+  double height)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+
+  _canvas_filtered(c, NULL, canvas_fill_rect(c, x, y, width, height));
+
+  _canvas_clip_region_ensure(c);
+
+  if ((_canvas_get_recorder(c) == NULL) &&
+      (transform_is_axis_aligned(c->state->transform) == true) &&
+      (_canvas_has_shadow(c) == false)) {
+    const double r[4] = { x, y, width, height };
+    context_render_rects(c->context, r, 1, NULL,
+                         c->state->fill_style, c->state->global_alpha,
+                         c->state->global_composite_operation,
+                         c->state->transform);
+    return;
+  }
+
+  rect_t bbox = { 0 };
+  polygon_t *p = _canvas_build_rect(c, x, y, width, height, &bbox);
+  if (p == NULL) {
+    return;
+  }
+
+  _canvas_render_polygon(c, p, &bbox, c->state->fill_style,
+                         c->state->global_alpha, &c->state->shadow,
+                         c->state->global_composite_operation,
+                         false, c->state->transform);
+
+  polygon_destroy(p);
+}
+
+// Fills a batch of (x, y, width, height) rectangles, optionally
+// with a color per rectangle, without building any polygon when
+// the transform is axis-aligned, there is no shadow, and the canvas
+// is not recording
+void
+canvas_fill_rects(
+  canvas_t *c,
+  const double *rects,
+  int32_t nb_rects,
+  const int32_t *colors)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(rects != NULL);
+  assert(nb_rects >= 0);
+
+  _canvas_filtered(c, NULL, canvas_fill_rects(c, rects, nb_rects, colors));
+
+  _canvas_clip_region_ensure(c);
+
+  if ((_canvas_get_recorder(c) == NULL) &&
+      (transform_is_axis_aligned(c->state->transform) == true) &&
+      (_canvas_has_shadow(c) == false)) {
+    context_render_rects(c->context, rects, nb_rects, colors,
+                         c->state->fill_style, c->state->global_alpha,
+                         c->state->global_composite_operation,
+                         c->state->transform);
+    return;
+  }
+
+  draw_style_t fill_style = c->state->fill_style;
+
+  for (int32_t i = 0; i < nb_rects; ++i) {
+    const double *r = rects + 4 * i;
+    rect_t bbox = { 0 };
+    polygon_t *p = _canvas_build_rect(c, r[0], r[1], r[2], r[3], &bbox);
+    if (p == NULL) {
+      return;
+    }
+    if (colors != NULL) {
+      fill_style = (draw_style_t){ .type = DRAW_STYLE_COLOR,
+                                   .content.color =
+                                     color_of_int((uint32_t)colors[i]) };
+    }
+    _canvas_render_polygon(c, p, &bbox, fill_style,
+                           c->state->global_alpha, &c->state->shadow,
+                           c->state->global_composite_operation,
+                           false, c->state->transform);
+    polygon_destroy(p);
+  }
+}
+
+// Fills a batch of (x, y, radius) circles, optionally with a color
+// per circle; circles are rendered analytically under the same
+// conditions as rectangles, and flattened otherwise
+void
+canvas_fill_circles(
+  canvas_t *c,
+  const double *circles,
+  int32_t nb_circles,
+  const int32_t *colors)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(circles != NULL);
+  assert(nb_circles >= 0);
+
+  _canvas_filtered(c, NULL, canvas_fill_circles(c, circles, nb_circles,
+                                                colors));
+
+  _canvas_clip_region_ensure(c);
+
+  if ((_canvas_get_recorder(c) == NULL) &&
+      (transform_is_axis_aligned(c->state->transform) == true) &&
+      (_canvas_has_shadow(c) == false)) {
+    context_render_circles(c->context, circles, nb_circles, colors,
+                           c->state->fill_style, c->state->global_alpha,
+                           c->state->global_composite_operation,
+                           c->state->transform);
+    return;
+  }
+
+  path2d_t *path = path2d_create();
+  if (path == NULL) {
+    return;
+  }
+
+  draw_style_t fill_style = c->state->fill_style;
+
+  for (int32_t i = 0; i < nb_circles; ++i) {
+    const double *e = circles + 3 * i;
+    path2d_reset(path);
+    path2d_arc(path, e[0], e[1], e[2], 0.0, 2.0 * M_PI, false, NULL);
+    if (colors != NULL) {
+      c->state->fill_style =
+        (draw_style_t){ .type = DRAW_STYLE_COLOR,
+                        .content.color = color_of_int((uint32_t)colors[i]) };
+    }
+    canvas_fill_path(c, path, true);
+  }
+
+  c->state->fill_style = fill_style;
+
+  path2d_release(path);
+}
+
+void
+canvas_stroke_rect(
+  canvas_t *c,
+  double x,
+  double y,
+  double width,
+  double height)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+
+  _canvas_filtered(c, NULL, canvas_stroke_rect(c, x, y, width, height));
+
+  _canvas_clip_region_ensure(c);
+
+  rect_t bbox = { 0 };
+  polygon_t *p = _canvas_build_rect(c, x, y, width, height, &bbox);
+  if (p == NULL) {
+    return;
+  }
+
+  polygon_t *tp = polygon_create(16, 1);
+  if (tp == NULL) {
+    polygon_destroy(p);
+    return;
+  }
+
+  polygon_offset(p, tp, c->state->line_width, c->state->join_type, CAP_BUTT,
+                 c->state->miter_limit,
+                 c->state->transform, true, c->state->line_dash,
+                 c->state->line_dash_len, c->state->line_dash_offset);
+
+  polygon_bbox(tp, &bbox);
+
+  _canvas_render_polygon(c, tp, &bbox, c->state->stroke_style,
+                         c->state->global_alpha, &c->state->shadow,
+                         c->state->global_composite_operation,
+                         true, c->state->transform);
+
+  polygon_destroy(tp);
+  polygon_destroy(p);
+}
+
+void
+canvas_stroke_polyline(
+  canvas_t *c,
+  const double *coords,
+  int32_t nb_points)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->context != NULL);
+  assert((coords != NULL) || (nb_points == 0));
+  assert(nb_points >= 0);
+
+  if (nb_points < 2) {
+    return;
+  }
+
+  _canvas_filtered(c, NULL, canvas_stroke_polyline(c, coords, nb_points));
+
+  _canvas_clip_region_ensure(c);
+
+  polygon_t *p = polygon_create(nb_points, 1);
+  if (p == NULL) {
+    return;
+  }
+
+  for (int32_t i = 0; i < nb_points; ++i) {
+    point_t pt = point(coords[2 * i], coords[2 * i + 1]);
+    transform_apply(c->state->transform, &pt);
+    polygon_add_point(p, pt);
+  }
+  polygon_end_subpoly(p, false);
+
+  if (c->state->line_dash_len == 0) {
+    polygon_decimate(p, c->path_tolerance);
+  }
+
+  if (_canvas_use_hairline(c) == true) {
+    _canvas_stroke_hairline(c, p);
+    polygon_destroy(p);
+    return;
+  }
+
+  polygon_t *tp = polygon_create(2 * nb_points + 16, 1);
+  if (tp == NULL) {
+    polygon_destroy(p);
+    return;
+  }
+
+  polygon_offset(p, tp, c->state->line_width,
+                 c->state->join_type, c->state->cap_type,
+                 c->state->miter_limit,
+                 c->state->transform, true, c->state->line_dash,
+                 c->state->line_dash_len, c->state->line_dash_offset);
+
+  rect_t bbox = { 0 };
+  polygon_bbox(tp, &bbox);
+
+  _canvas_render_polygon(c, tp, &bbox, c->state->stroke_style,
+                         c->state->global_alpha, &c->state->shadow,
+                         c->state->global_composite_operation,
+                         true, c->state->transform);
+
+  polygon_destroy(tp);
+  polygon_destroy(p);
+}
+
+static bool
+_canvas_prepare_font(
+  canvas_t *c)
+{
+  if (c->font != NULL &&
+      font_matches(c->font, c->state->font_desc) == false) {
+    font_destroy(c->font);
+    c->font = NULL;
+  }
+
+  if (c->font == NULL) {
+    c->font = font_create(c->state->font_desc);
+    if (c->font == NULL) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void
+canvas_fill_text(
+  canvas_t *c,
+  const char *text, // as UTF-8
+  double x,
+  double y,
+  double max_width)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(text != NULL);
+
+// TODO: handle both vector and bitmap fonts
+
+  _canvas_filtered(c, NULL, canvas_fill_text(c, text, x, y, max_width));
+
+  _canvas_clip_region_ensure(c);
+
+  if (_canvas_prepare_font(c) == false) {
+    return;
+  }
+
+  polygon_t *p = polygon_create(256, 8);
+  if (p == NULL) {
+    return;
+  }
+
+  point_t pen = { x, y };
+  while (*text) {
+    polygon_reset(p);
+    uint32_t chr = decode_utf8_char(&text);
+    rect_t bbox = { 0 };
+    if ((font_char_as_poly(c->font, c->state->transform,
+                           chr, &pen, p, &bbox) == true) &&
+        (_canvas_is_culled(c, bbox) == false)) {
+      _canvas_render_polygon(c, p, &bbox, c->state->fill_style,
+                             c->state->global_alpha, &c->state->shadow,
+                             c->state->global_composite_operation,
+                             true, c->state->transform);
+    }
+  }
+
+  polygon_destroy(p);
+}
+
+void
+canvas_stroke_text(
+  canvas_t *c,
+  const char *text, // as UTF-8
+  double x,
+  double y,
+  double max_width)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(text != NULL);
+
+  _canvas_filtered(c, NULL, canvas_stroke_text(c, text, x, y, max_width));
+
+  _canvas_clip_region_ensure(c);
+
+  if (_canvas_prepare_font(c) == false) {
+    return;
+  }
+
+  polygon_t *p = polygon_create(256, 8);
+  if (p == NULL) {
+    return;
+  }
+
+  // The outline bounds do not account for the transform
+  double margin = _canvas_stroke_margin(c);
+
+  point_t pen = { x, y };
+  while (*text) {
+    polygon_reset(p);
+    uint32_t chr = decode_utf8_char(&text);
+    rect_t bbox = { 0 };
+    if ((font_char_as_poly_outline(c->font, c->state->transform,
+                                   chr, c->state->line_width,
+                                   &pen, p, &bbox) == true) &&
+        (_canvas_is_culled(c, rect(point(bbox.p1.x - margin,
+                                         bbox.p1.y - margin),
+                                   point(bbox.p2.x + margin,
+                                         bbox.p2.y + margin))) == false)) {
+      _canvas_render_polygon(c, p, &bbox, c->state->stroke_style,
+                             c->state->global_alpha, &c->state->shadow,
+                             c->state->global_composite_operation,
+                             true, c->state->transform);
+    }
+  }
+
+  polygon_destroy(p);
+}
+
+void
+canvas_blit(
+  canvas_t *dc,
+  int32_t dx,
+  int32_t dy,
+  const canvas_t *sc,
+  int32_t sx,
+  int32_t sy,
+  int32_t width,
+  int32_t height)
+{
+  assert(dc != NULL);
+  assert(dc->context != NULL);
+  assert(dc->state != NULL);
+  assert(dc->state->transform != NULL);
+  assert(sc != NULL);
+  assert(sc->context != NULL);
+
+  _canvas_filtered(dc, sc, canvas_blit(dc, dx, dy, sc, sx, sy, width, height));
+
+  _canvas_flush(dc);
+  _canvas_flush((canvas_t *)sc);
+
+  context_blit(dc->context, dx, dy,
+               sc->context, sx, sy, width, height,
+               dc->state->global_alpha, &dc->state->shadow,
+               dc->state->global_composite_operation,
+               dc->state->fill_style.smoothing,
+               dc->state->transform);
+}
+
+void
+canvas_draw_image(
+  canvas_t *dc,
+  double dx,
+  double dy,
+  double dw,
+  double dh,
+  const canvas_t *sc,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh)
+{
+  assert(dc != NULL);
+  assert(dc->context != NULL);
+  assert(dc->state != NULL);
+  assert(dc->state->transform != NULL);
+  assert(sc != NULL);
+  assert(sc->context != NULL);
+
+  if ((sw <= 0) || (sh <= 0) || (dw <= 0.0) || (dh <= 0.0)) {
+    return;
+  }
+
+  _canvas_filtered(dc, sc, canvas_draw_image(dc, dx, dy, dw, dh,
+                                               sc, sx, sy, sw, sh));
+
+  _canvas_flush(dc);
+  _canvas_flush((canvas_t *)sc);
+
+  context_draw_image(dc->context, dx, dy, dw, dh,
+                     sc->context, sx, sy, sw, sh,
+                     dc->state->global_alpha, &dc->state->shadow,
+                     dc->state->global_composite_operation,
+                     dc->state->fill_style.smoothing,
+                     dc->state->transform);
+}
+
+void
+canvas_draw_sprites(
+  canvas_t *dc,
+  const canvas_t *sc,
+  const double *sprites,
+  int32_t nb_sprites)
+{
+  assert(dc != NULL);
+  assert(dc->context != NULL);
+  assert(dc->state != NULL);
+  assert(dc->state->transform != NULL);
+  assert(sc != NULL);
+  assert(sc->context != NULL);
+  assert(sprites != NULL);
+  assert(nb_sprites >= 0);
+
+  _canvas_filtered(dc, sc, canvas_draw_sprites(dc, sc, sprites, nb_sprites));
+
+  _canvas_flush(dc);
+  _canvas_flush((canvas_t *)sc);
+
+  context_draw_sprites(dc->context, sc->context, NULL,
+                       sprites, nb_sprites,
+                       dc->state->global_alpha, &dc->state->shadow,
+                       dc->state->global_composite_operation,
+                       dc->state->fill_style.smoothing,
+                       dc->state->transform);
+}
+
+void
+canvas_draw_sprites_from_pixmap(
+  canvas_t *dc,
+  const pixmap_t *sp,
+  const double *sprites,
+  int32_t nb_sprites)
+{
+  assert(dc != NULL);
+  assert(dc->context != NULL);
+  assert(dc->state != NULL);
+  assert(dc->state->transform != NULL);
+  assert(sp != NULL);
+  assert(pixmap_valid(*sp) == true);
+  assert(sprites != NULL);
+  assert(nb_sprites >= 0);
+
+  _canvas_filtered(dc, NULL, canvas_draw_sprites_from_pixmap(dc, sp, sprites,
+                                                             nb_sprites));
+
+  _canvas_flush(dc);
+
+  context_draw_sprites(dc->context, NULL, sp,
+                       sprites, nb_sprites,
+                       dc->state->global_alpha, &dc->state->shadow,
+                       dc->state->global_composite_operation,
+                       dc->state->fill_style.smoothing,
+                       dc->state->transform);
+}
+
+/* Layers */
+
+// Redirects drawing to a transparent layer, composed back by the
+// matching canvas_end_layer with the given global alpha and composite
+// operation, within the current clip path and through the current
+// filter; the state is saved, and the global alpha, composite
+// operation and filter are reset within the layer; layers are
+// not recorded into pictures, so returns false while recording
+bool
+canvas_begin_layer(
+  canvas_t *c,
+  double global_alpha,
+  composite_operation_t compose_op)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->context != NULL);
+
+  if (c->picture != NULL) {
+    return false;
+  }
+
+  canvas_layer_t *layer = (canvas_layer_t *)calloc(1, sizeof(canvas_layer_t));
+  if (layer == NULL) {
+    return false;
+  }
+
+  if (canvas_save(c) == false) {
+    free(layer);
+    return false;
+  }
+
+  // Deferred operations go below the layer, and the clip region
+  // must be set aside along with the surface
+  canvas_unlock_pixels(c);
+  _canvas_flush(c);
+  _canvas_clip_region_ensure(c);
+  if (context_push_layer(c->context) == false) {
+    canvas_restore(c);
+    free(layer);
+    return false;
+  }
+
+  layer->global_alpha = min(max(global_alpha, 0.0), 1.0);
+  layer->compose_op = compose_op;
+  layer->depth = c->state_depth;
+  layer->below = c->layer;
+  c->layer = layer;
+
+  canvas_set_global_alpha(c, 1.0);
+  canvas_set_comp_operation(c, SOURCE_OVER);
+  canvas_set_filter(c, NULL, 0);
+
+  return true;
+}
+
+// Composes the innermost layer back, and restores the state saved
+// when it began; does nothing if no layer was begun
+void
+canvas_end_layer(
+  canvas_t *c)
+{
+  assert(c != NULL);
+  assert(c->state != NULL);
+  assert(c->context != NULL);
+
+  canvas_layer_t *layer = c->layer;
+  if (layer == NULL) {
+    return;
+  }
+  c->layer = layer->below;
+
+  canvas_unlock_pixels(c);
+  _canvas_flush(c);
+
+  // Unwind any save left unbalanced within the layer,
+  // then restore the state saved when it began
+  while (c->state_depth >= layer->depth) {
+    canvas_restore(c);
+  }
+
+  context_pop_layer(c->context, c->state->filters, c->state->nb_filters,
+                    layer->global_alpha, layer->compose_op);
+
+  free(layer);
+}
+
+
+
+/* Pictures */
+
+// Starts recording the drawing operations of the canvas into a new
+// picture; until the recording ends, paths, shapes and text are
+// recorded instead of drawn, while image operations still draw
+// directly; returns false if the picture could not be created
+bool
+canvas_begin_recording(
+  canvas_t *c)
+{
+  assert(c != NULL);
+
+  picture_t *pic = picture_create();
+  if (pic == NULL) {
+    return false;
+  }
+
+  if (c->picture != NULL) {
+    picture_release(c->picture);
+  }
+  c->picture = pic;
+
+  return true;
+}
+
+// Ends the recording, and returns the recorded picture, which
+// the caller must release, or NULL if the canvas was not recording
+picture_t *
+canvas_end_recording(
+  canvas_t *c)
+{
+  assert(c != NULL);
+
+  picture_t *pic = c->picture;
+  c->picture = NULL;
+
+  return pic;
+}
+
+// Maps a recorded clip path by the given transform, on top
+// of the given base clip path; *res is NULL if unclipped
+static bool
+_canvas_map_clip_path(
+  const clip_path_t *cp,
+  const transform_t *t,
+  clip_path_t *base,
+  clip_path_t **res) // out
+{
+  assert(t != NULL);
+  assert(res != NULL);
 
-  polygon_t *p = polygon_create(8, 1);
-  if (p == NULL) {
-    return NULL;
+  if (cp == NULL) {
+    *res = (base != NULL) ? clip_path_retain(base) : NULL;
+    return true;
   }
 
-  point_t p1 = point(x, y);
-  point_t p2 = point(x + width, y);
-  point_t p3 = point(x + width, y + height);
-  point_t p4 = point(x, y + height);
-
-  transform_apply(c->state->transform, &p1);
-  transform_apply(c->state->transform, &p2);
-  transform_apply(c->state->transform, &p3);
-  transform_apply(c->state->transform, &p4);
+  clip_path_t *next = NULL;
+  if (_canvas_map_clip_path(cp->next, t, base, &next) == false) {
+    return false;
+  }
 
-  polygon_add_point(p, p1);
-  polygon_add_point(p, p2);
-  polygon_add_point(p, p3);
-  polygon_add_point(p, p4);
-  polygon_end_subpoly(p, true);
+  polygon_t *p = polygon_copy(cp->instr->poly);
+  if (p != NULL) {
+    for (int32_t i = 0; i < p->nb_points; ++i) {
+      transform_apply(t, &(p->points[i]));
+    }
+    *res = clip_path_create(next, p, cp->instr->non_zero);
+    polygon_destroy(p);
+  } else {
+    *res = NULL;
+  }
 
-  *bbox = rect(point(min4(p1.x, p2.x, p3.x, p4.x),
-                     min4(p1.y, p2.y, p3.y, p4.y)),
-               point(max4(p1.x, p2.x, p3.x, p4.x),
-                     max4(p1.y, p2.y, p3.y, p4.y)));
+  if (next != NULL) {
+    clip_path_release(next);
+  }
 
-  return p;
+  return (*res != NULL);
 }
 
-void
-canvas_fill_rect(
+// Sets the clip region of the context from a device space clip path,
+// restoring the one of the current state when they match; changed
+// tells whether the clip region differs from the one of the state
+static void
+_canvas_select_clip_path(
   canvas_t *c,
-  double x,
-  double y,
-  double width,
-  double height)
+  const clip_path_t *clip,
+  bool *changed) // in/out
 {
   assert(c != NULL);
   assert(c->state != NULL);
+  assert(c->context != NULL);
+  assert(changed != NULL);
 
-  _canvas_clip_region_ensure(c);
-
-  rect_t bbox = { 0 };
-  polygon_t *p = _canvas_build_rect(c, x, y, width, height, &bbox);
-  if (p == NULL) {
-    return;
+  if (clip == c->state->clip_path) {
+    if (*changed == true) {
+      context_clear_clip(c->context);
+      c->clip_region_dirty = (clip != NULL);
+      *changed = false;
+    }
+    _canvas_clip_region_ensure(c);
+  } else if (clip == NULL) {
+    context_clear_clip(c->context);
+    *changed = true;
+  } else {
+    context_clip(c->context, clip, c->state->transform);
+    *changed = true;
   }
-
-  context_render_polygon(c->context, p, &bbox, c->state->fill_style,
-                         c->state->global_alpha, &c->state->shadow,
-                         c->state->global_composite_operation,
-                         false, c->state->transform);
-
-  polygon_destroy(p);
 }
 
+// Replays a picture, mapped by the current transform followed
+// by the given one, within the current clip path and with the
+// current global alpha; the recorded polygons are reused as is
+// under an identity transform, and the clip region is only
+// rebuilt when the recorded clip path changes
 void
-canvas_stroke_rect(
+canvas_draw_picture(
   canvas_t *c,
-  double x,
-  double y,
-  double width,
-  double height)
+  const picture_t *pic,
+  const transform_t *transform)
 {
   assert(c != NULL);
   assert(c->state != NULL);
+  assert(c->context != NULL);
+  assert(pic != NULL);
+  assert(transform != NULL);
+
+  _canvas_filtered(c, NULL, canvas_draw_picture(c, pic, transform));
+
+  picture_t *recorder = _canvas_get_recorder(c);
+
+  transform_t m = *c->state->transform;
+  transform_mul(&m, transform);
+  bool identity = transform_is_identity(&m);
+  double scale = transform_get_max_scale(&m);
+
+  rect_t canvas_bbox =
+    rect(point(0.0, 0.0), point((double)c->width, (double)c->height));
 
   _canvas_clip_region_ensure(c);
 
-  rect_t bbox = { 0 };
-  polygon_t *p = _canvas_build_rect(c, x, y, width, height, &bbox);
-  if (p == NULL) {
-    return;
+  const clip_path_t *recorded_clip = NULL;
+  clip_path_t *clip = c->state->clip_path;
+  bool clip_changed = false;
+  if (clip != NULL) {
+    clip_path_retain(clip);
   }
 
-  double d = c->state->line_width;
-  bbox.p1.x -= d; bbox.p1.y -= d;
-  bbox.p2.x += d; bbox.p2.y += d;
+  for (int32_t i = 0; i < pic->nb_instrs; ++i) {
+
+    const picture_instr_t *pi = &pic->instrs[i];
+
+    if (pi->clip_path != recorded_clip) {
+      clip_path_t *new_clip = NULL;
+      if (_canvas_map_clip_path(pi->clip_path, &m, c->state->clip_path,
+                                &new_clip) == false) {
+        continue;
+      }
+      if (clip != NULL) {
+        clip_path_release(clip);
+      }
+      clip = new_clip;
+      recorded_clip = pi->clip_path;
+      // Nothing to rasterize while recording
+      if (recorder == NULL) {
+        _canvas_select_clip_path(c, clip, &clip_changed);
+      }
+    }
 
-  polygon_t *tp = polygon_create(16, 1);
-  if (p == NULL) {
-    polygon_destroy(p);
-    return;
-  }
+    picture_instr_t ri = *pi;
+    ri.global_alpha *= c->state->global_alpha;
+    ri.line_width *= scale;
+    ri.clip_path = clip;
+    ri.transform = m;
+    transform_mul(&ri.transform, &pi->transform);
+    if (identity == false) {
+      ri.bbox = _canvas_transform_bbox(&m, pi->bbox);
+    }
 
-  polygon_offset(p, tp, c->state->line_width, JOIN_ROUND, CAP_BUTT,
-                 c->state->miter_limit,
-                 c->state->transform, true, c->state->line_dash,
-                 c->state->line_dash_len, c->state->line_dash_offset);
+    // Skip what cannot be seen, unless it casts a shadow
+    if ((c->picture == NULL) && (pi->shadow.color.a == 0) &&
+        (comp_is_full_screen(pi->compose_op) == false)) {
+      rect_t bbox = ri.bbox;
+      rect_intersect(&bbox, &canvas_bbox);
+      if (clip != NULL) {
+        rect_intersect(&bbox, &clip->bbox);
+      }
+      if (rect_empty(&bbox) == true) {
+        continue;
+      }
+    }
 
-  context_render_polygon(c->context, p, &bbox, c->state->stroke_style,
-                         c->state->global_alpha, &c->state->shadow,
-                         c->state->global_composite_operation,
-                         true, c->state->transform);
+    if (identity == false) {
+      ri.poly = polygon_copy(pi->poly);
+      if (ri.poly == NULL) {
+        continue;
+      }
+      for (int32_t j = 0; j < ri.poly->nb_points; ++j) {
+        transform_apply(&m, &(ri.poly->points[j]));
+      }
+    }
 
-  polygon_destroy(tp);
-  polygon_destroy(p);
-}
+    if (recorder != NULL) {
+      picture_add(recorder, &ri);
+    } else if (ri.type == PICTURE_INSTR_HAIRLINE) {
+      context_render_hairline(c->context, ri.poly, ri.style,
+                              ri.global_alpha, ri.line_width,
+                              ri.compose_op, &ri.transform);
+    } else {
+      context_render_polygon(c->context, ri.poly, &ri.bbox, ri.style,
+                             ri.global_alpha, &ri.shadow, ri.compose_op,
+                             ri.non_zero, &ri.transform);
+    }
 
-static bool
-_canvas_prepare_font(
-  canvas_t *c)
-{
-  if (c->font != NULL &&
-      font_matches(c->font, c->state->font_desc) == false) {
-    font_destroy(c->font);
-    c->font = NULL;
+    if (identity == false) {
+      polygon_destroy(ri.poly);
+    }
   }
 
-  if (c->font == NULL) {
-    c->font = font_create(c->state->font_desc);
-    if (c->font == NULL) {
-      return false;
-    }
+  if (clip != NULL) {
+    clip_path_release(clip);
   }
 
-  return true;
+  if (clip_changed == true) {
+    context_clear_clip(c->context);
+    c->clip_region_dirty = (c->state->clip_path != NULL);
+  }
 }
 
-void
-canvas_fill_text(
+
+
+/* Deferred rendering */
+
+// In deferred mode, drawing operations are recorded, and only rendered
+// when the canvas content is needed (on commit, on direct pixel access,
+// or when drawing images onto or from the canvas); returns false
+// if the operation list could not be created
+bool
+canvas_set_deferred(
   canvas_t *c,
-  const char *text, // as UTF-8
-  double x,
-  double y,
-  double max_width)
+  bool deferred)
 {
   assert(c != NULL);
-  assert(c->state != NULL);
-  assert(text != NULL);
-
-// TODO: handle both vector and bitmap fonts
-
-  _canvas_clip_region_ensure(c);
 
-  if (_canvas_prepare_font(c) == false) {
-    return;
+  if (deferred == true) {
+    if (c->deferred == NULL) {
+      c->deferred = picture_create();
+    }
+    return (c->deferred != NULL);
   }
 
-  polygon_t *p = polygon_create(256, 8);
-  if (p == NULL) {
-    return;
+  if (c->deferred != NULL) {
+    _canvas_flush(c);
+    picture_release(c->deferred);
+    c->deferred = NULL;
   }
 
-  point_t pen = { x, y };
-  while (*text) {
-    polygon_reset(p);
-    uint32_t chr = decode_utf8_char(&text);
-    rect_t bbox = { 0 };
-    if (font_char_as_poly(c->font, c->state->transform,
-                          chr, &pen, p, &bbox) == true) {
-      context_render_polygon(c->context, p, &bbox, c->state->fill_style,
-                             c->state->global_alpha, &c->state->shadow,
-                             c->state->global_composite_operation,
-                             true, c->state->transform);
-    }
-  }
+  return true;
+}
 
-  polygon_destroy(p);
+bool
+canvas_get_deferred(
+  const canvas_t *c)
+{
+  assert(c != NULL);
+
+  return (c->deferred != NULL);
 }
 
+// Renders the deferred drawing operations, in order; operations that
+// share a clip path are rendered as a batch, which the context may
+// split into screen bands rendered concurrently, while those that
+// may cast a shadow or affect the whole canvas are rendered alone
 void
-canvas_stroke_text(
-  canvas_t *c,
-  const char *text, // as UTF-8
-  double x,
-  double y,
-  double max_width)
+_canvas_flush(
+  canvas_t *c)
 {
   assert(c != NULL);
   assert(c->state != NULL);
-  assert(text != NULL);
+  assert(c->context != NULL);
+
+  picture_t *pic = c->deferred;
+  if ((pic == NULL) || (pic->nb_instrs == 0)) {
+    return;
+  }
 
   _canvas_clip_region_ensure(c);
 
-  if (_canvas_prepare_font(c) == false) {
-    return;
+  const clip_path_t *clip = c->state->clip_path;
+  bool clip_changed = false;
+  int32_t first = 0;
+
+  for (int32_t i = 0; i < pic->nb_instrs; ++i) {
+
+    const picture_instr_t *pi = &pic->instrs[i];
+    bool alone = (pi->shadow.color.a != 0) ||
+                 (comp_is_full_screen(pi->compose_op) == true);
+
+    if ((pi->clip_path != clip) || (alone == true)) {
+      if (i > first) {
+        context_render_batch(c->context, pic->instrs + first, i - first);
+      }
+      first = i;
+    }
+
+    if (pi->clip_path != clip) {
+      clip = pi->clip_path;
+      _canvas_select_clip_path(c, clip, &clip_changed);
+    }
+
+    if (alone == true) {
+      context_render_polygon(c->context, pi->poly, &pi->bbox, pi->style,
+                             pi->global_alpha, &pi->shadow, pi->compose_op,
+                             pi->non_zero, &pi->transform);
+      first = i + 1;
+    }
   }
 
-  polygon_t *p = polygon_create(256, 8);
-  if (p == NULL) {
-    return;
+  if (pic->nb_instrs > first) {
+    context_render_batch(c->context, pic->instrs + first,
+                         pic->nb_instrs - first);
   }
 
-  point_t pen = { x, y };
-  while (*text) {
-    polygon_reset(p);
-    uint32_t chr = decode_utf8_char(&text);
-    rect_t bbox = { 0 };
-    if (font_char_as_poly_outline(c->font, c->state->transform,
-                                  chr, c->state->line_width,
-                                  &pen, p, &bbox) == true) {
-      context_render_polygon(c->context, p, &bbox, c->state->stroke_style,
-                             c->state->global_alpha, &c->state->shadow,
-                             c->state->global_composite_operation,
-                             true, c->state->transform);
-    }
+  if (clip_changed == true) {
+    context_clear_clip(c->context);
+    c->clip_region_dirty = (c->state->clip_path != NULL);
   }
 
-  polygon_destroy(p);
+  picture_reset(pic);
 }
 
-void
-canvas_blit(
-  canvas_t *dc,
-  int32_t dx,
-  int32_t dy,
-  const canvas_t *sc,
-  int32_t sx,
-  int32_t sy,
-  int32_t width,
-  int32_t height)
-{
-  assert(dc != NULL);
-  assert(dc->context != NULL);
-  assert(dc->state != NULL);
-  assert(dc->state->transform != NULL);
-  assert(sc != NULL);
-  assert(sc->context != NULL);
 
-  context_blit(dc->context, dx, dy,
-               sc->context, sx, sy, width, height,
-               dc->state->global_alpha, &dc->state->shadow,
-               dc->state->global_composite_operation,
-               dc->state->transform);
-}
 
 /* Direct pixel access */
 
@@ -1632,6 +3475,8 @@ canvas_get_pixel(
   assert(c != NULL);
   assert(c->context != NULL);
 
+  _canvas_flush((canvas_t *)c);
+
   return context_get_pixel(c->context, x, y);
 }
 
@@ -1645,9 +3490,93 @@ canvas_put_pixel(
   assert(c != NULL);
   assert(c->context != NULL);
 
+  _canvas_flush(c);
+
   context_put_pixel(c->context, x, y, color);
 }
 
+static void (*_canvas_unlock_callback)(canvas_t *, void *) = NULL;
+
+void
+canvas_set_unlock_callback(
+  void (*callback_function)(canvas_t *, void *))
+{
+  _canvas_unlock_callback = callback_function;
+}
+
+// Shares the pixels of the surface drawn to, without copying them;
+// they remain valid until the canvas is unlocked, which happens
+// implicitly when it is locked again, resized or destroyed, or
+// begins or ends a layer, and the unlock callback is then called
+// with lock_data; drawing is never deferred while locked, so that
+// the pixels are always up to date; returns an invalid pixmap if
+// the context has no pixels in memory
+pixmap_t
+canvas_lock_pixels(
+  canvas_t *c,
+  void *lock_data)
+{
+  assert(c != NULL);
+  assert(c->context != NULL);
+
+  canvas_unlock_pixels(c);
+  _canvas_flush(c);
+
+  pixmap_t pm = context_get_raw_pixmap(c->context);
+  if (pixmap_valid(pm) == true) {
+    c->locked = true;
+    c->lock_data = lock_data;
+  }
+
+  return pm;
+}
+
+void
+canvas_unlock_pixels(
+  canvas_t *c)
+{
+  assert(c != NULL);
+
+  if (c->locked == false) {
+    return;
+  }
+
+  void *lock_data = c->lock_data;
+  c->locked = false;
+  c->lock_data = NULL;
+
+  if (_canvas_unlock_callback != NULL) {
+    _canvas_unlock_callback(c, lock_data);
+  }
+}
+
+// Whether canvas_detach_pixels can hand the pixels over, which is
+// not the case for those of onscreen canvases outside of layers
+bool
+canvas_can_detach_pixels(
+  const canvas_t *c)
+{
+  assert(c != NULL);
+  assert(c->context != NULL);
+
+  return context_can_detach_pixels(c->context);
+}
+
+// Hands the pixels of the surface drawn to over to the caller, who
+// must free them, while the canvas goes on with a copy of them; this
+// lets locked pixels outlive the lock, when called from the unlock
+// callback; returns NULL if the pixels cannot be handed over
+color_t_ *
+canvas_detach_pixels(
+  canvas_t *c)
+{
+  assert(c != NULL);
+  assert(c->context != NULL);
+  assert(c->locked == false);
+
+  return context_detach_pixels(c->context);
+}
+
 pixmap_t
 canvas_get_pixmap(
   const canvas_t *c,
@@ -1659,6 +3588,8 @@ canvas_get_pixmap(
   assert(c != NULL);
   assert(c->context != NULL);
 
+  _canvas_flush((canvas_t *)c);
+
   return context_get_pixmap(c->context, sx, sy, width, height);
 }
 
@@ -1678,6 +3609,8 @@ canvas_put_pixmap(
   assert(sp != NULL);
   assert(pixmap_valid(*sp) == true);
 
+  _canvas_flush(c);
+
   context_put_pixmap(c->context, dx, dy, sp, sx, sy, width, height);
 }
 
@@ -1692,6 +3625,8 @@ canvas_export_png(
   assert(c->context != NULL);
   assert(filename != NULL);
 
+  _canvas_flush((canvas_t *)c);
+
   return context_export_png(c->context, filename);
 }
 
@@ -1706,5 +3641,7 @@ canvas_import_png(
   assert(c->context != NULL);
   assert(filename != NULL);
 
+  _canvas_flush(c);
+
   return context_import_png(c->context, x, y, filename);
 }
@@ -25,6 +25,10 @@
 #include "draw_style.h"
 #include "polygonize.h"
 #include "color_composition.h"
+#include "image_interpolation.h"
+#include "mask_cache.h"
+#include "filters.h"
+#include "picture.h"
 
 typedef struct canvas_t canvas_t;
 
@@ -200,6 +204,29 @@ canvas_set_cap_type(
   canvas_t *canvas,
   cap_type_t cap_type);
 
+double
+canvas_get_path_tolerance(
+  const canvas_t *canvas);
+
+void
+canvas_set_path_tolerance(
+  canvas_t *canvas,
+  double tolerance);
+
+size_t
+canvas_get_mask_cache_budget(
+  const canvas_t *canvas);
+
+void
+canvas_set_mask_cache_budget(
+  canvas_t *canvas,
+  size_t budget);
+
+void
+canvas_get_mask_cache_stats(
+  const canvas_t *canvas,
+  mask_cache_stats_t *stats);
+
 double
 canvas_get_miter_limit(
   const canvas_t *canvas);
@@ -304,6 +331,15 @@ canvas_set_comp_operation(
   canvas_t *c,
   composite_operation_t op);
 
+image_smoothing_t
+canvas_get_image_smoothing(
+  const canvas_t *canvas);
+
+void
+canvas_set_image_smoothing(
+  canvas_t *canvas,
+  image_smoothing_t smoothing);
+
 // Sets the canvas font
 // The provided font name is copied
 void
@@ -342,6 +378,20 @@ canvas_set_shadow_offset(
   double x,
   double y);
 
+const filter_t *
+canvas_get_filter(
+  const canvas_t *c);
+
+int32_t
+canvas_get_filter_length(
+  const canvas_t *c);
+
+bool
+canvas_set_filter(
+  canvas_t *c,
+  const filter_t *filters,
+  int32_t nb_filters);
+
 /* Paths */
 
 bool
@@ -464,6 +514,20 @@ canvas_fill_rect(
   double width,
   double height);
 
+void
+canvas_fill_rects(
+  canvas_t *c,
+  const double *rects,
+  int32_t nb_rects,
+  const int32_t *colors);
+
+void
+canvas_fill_circles(
+  canvas_t *c,
+  const double *circles,
+  int32_t nb_circles,
+  const int32_t *colors);
+
 void
 canvas_stroke_rect(
   canvas_t *c,
@@ -472,6 +536,12 @@ canvas_stroke_rect(
   double width,
   double height);
 
+void
+canvas_stroke_polyline(
+  canvas_t *c,
+  const double *coords,
+  int32_t nb_points);
+
 void
 canvas_fill_text(
   canvas_t *c,
@@ -499,6 +569,76 @@ canvas_blit(
   int32_t width,
   int32_t height);
 
+void
+canvas_draw_image(
+  canvas_t *dc,
+  double dx,
+  double dy,
+  double dw,
+  double dh,
+  const canvas_t *sc,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh);
+
+void
+canvas_draw_sprites(
+  canvas_t *dc,
+  const canvas_t *sc,
+  const double *sprites,
+  int32_t nb_sprites);
+
+void
+canvas_draw_sprites_from_pixmap(
+  canvas_t *dc,
+  const pixmap_t *sp,
+  const double *sprites,
+  int32_t nb_sprites);
+
+/* Layers */
+
+bool
+canvas_begin_layer(
+  canvas_t *c,
+  double global_alpha,
+  composite_operation_t compose_op);
+
+void
+canvas_end_layer(
+  canvas_t *c);
+
+/* Pictures */
+
+bool
+canvas_begin_recording(
+  canvas_t *c);
+
+picture_t *
+canvas_end_recording(
+  canvas_t *c);
+
+void
+canvas_draw_picture(
+  canvas_t *c,
+  const picture_t *pic,
+  const transform_t *transform);
+
+/* Deferred rendering */
+
+bool
+canvas_set_deferred(
+  canvas_t *c,
+  bool deferred);
+
+bool
+canvas_get_deferred(
+  const canvas_t *c);
+
+void
+_canvas_flush(
+  canvas_t *c);
+
 /* Direct pixel access */
 
 color_t_
@@ -514,6 +654,27 @@ canvas_put_pixel(
   int32_t y,
   color_t_ color);
 
+void
+canvas_set_unlock_callback(
+  void (*callback_function)(canvas_t *, void *));
+
+pixmap_t
+canvas_lock_pixels(
+  canvas_t *c,
+  void *lock_data);
+
+void
+canvas_unlock_pixels(
+  canvas_t *c);
+
+bool
+canvas_can_detach_pixels(
+  const canvas_t *c);
+
+color_t_ *
+canvas_detach_pixels(
+  canvas_t *c);
+
 // Creates a copy of the context pixels
 // Be sure to free the data pointer when done
 pixmap_t
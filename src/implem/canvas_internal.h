@@ -22,8 +22,18 @@
 #include "font.h"
 #include "path2d.h"
 #include "pixmap.h"
+#include "mask_cache.h"
+#include "picture.h"
 #include "canvas.h"
 
+// Layer begun with canvas_begin_layer
+typedef struct canvas_layer_t {
+  double global_alpha; // applied when composing the layer back
+  composite_operation_t compose_op;
+  int32_t depth; // state stack depth, including the state it saved
+  struct canvas_layer_t *below;
+} canvas_layer_t;
+
 typedef struct canvas_t {
   INHERITS_OBJECT;
   window_t *window;
@@ -33,8 +43,17 @@ typedef struct canvas_t {
   state_t *state;
   font_t *font;
   list_t *state_stack;
+  int32_t state_depth; // number of states in state_stack
   path2d_t *path_2d;
+  double path_tolerance; // device space decimation tolerance, 0 = off
+  mask_cache_t *mask_cache; // coverage masks of translated Path.t fills
   bool clip_region_dirty;
+  bool filtering; // drawing to the filter layer
+  picture_t *picture; // picture being recorded, or NULL
+  picture_t *deferred; // drawing operations not rendered yet, or NULL
+  canvas_layer_t *layer; // innermost layer begun, or NULL
+  bool locked; // pixels exposed by canvas_lock_pixels
+  void *lock_data; // passed to the unlock callback
   bool autocommit;
   bool committed;
   canvas_type_t type;
@@ -0,0 +1,71 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "object.h"
+#include "rect.h"
+#include "polygon.h"
+#include "draw_instr.h"
+#include "clip_path.h"
+
+IMPLEMENT_OBJECT_METHODS(clip_path_t, clip_path, _clip_path_destroy)
+
+clip_path_t *
+clip_path_create(
+  clip_path_t *next,
+  const polygon_t *poly,
+  bool non_zero)
+{
+  assert(poly != NULL);
+
+  clip_path_t *cp = clip_path_alloc();
+  if (cp == NULL) {
+    return NULL;
+  }
+
+  cp->instr = path_fill_instr_create(poly, non_zero);
+  if (cp->instr == NULL) {
+    free(cp);
+    return NULL;
+  }
+  if (cp->instr->poly == NULL) {
+    free(cp->instr);
+    free(cp);
+    return NULL;
+  }
+
+  polygon_bbox(poly, &cp->bbox);
+
+  cp->next = NULL;
+  if (next != NULL) {
+    rect_intersect(&cp->bbox, &next->bbox);
+    cp->next = clip_path_retain(next);
+  }
+
+  return cp;
+}
+
+static void
+_clip_path_destroy(
+  clip_path_t *cp)
+{
+  assert(cp != NULL);
+  assert(cp->instr != NULL);
+
+  if (cp->next != NULL) {
+    clip_path_release(cp->next);
+  }
+
+  path_fill_instr_destroy(cp->instr);
+  free(cp);
+}
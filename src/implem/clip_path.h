@@ -0,0 +1,40 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef __CLIP_PATH_H
+#define __CLIP_PATH_H
+
+#include <stdbool.h>
+
+#include "object.h"
+#include "rect.h"
+#include "polygon.h"
+#include "draw_instr.h"
+
+// Clip paths are immutable chains of fill instructions, so that
+// saved states share them: clipping links a new instruction in
+// front of the current chain, and the resulting clip region is
+// the intersection of all instructions in the chain
+typedef struct clip_path_t {
+  INHERITS_OBJECT;
+  path_fill_instr_t *instr;
+  struct clip_path_t *next; // clip path this one restricts, or NULL
+  rect_t bbox; // device space bounds of the whole chain
+} clip_path_t;
+
+DECLARE_OBJECT_METHODS(clip_path_t, clip_path)
+
+clip_path_t *
+clip_path_create(
+  clip_path_t *next,
+  const polygon_t *poly,
+  bool non_zero);
+
+#endif /* __CLIP_PATH_H */
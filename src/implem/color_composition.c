@@ -113,6 +113,9 @@ comp_destination_out(
   color_t_ dst,
   int draw_alpha)
 {
+  if (draw_alpha == 0) {
+    return dst;
+  }
   color_t_ output = color_transparent_black;
   draw_alpha = (dst.a * (255 - draw_alpha)) / 255;
   if (draw_alpha > 0) {
@@ -600,7 +603,7 @@ comp_is_full_screen(
   case SOURCE_ATOP:      return false;
   case DESTINATION_OVER: return false;
   case DESTINATION_IN:   return true;
-  case DESTINATION_OUT:  return true;
+  case DESTINATION_OUT:  return false;
   case DESTINATION_ATOP: return true;
   case LIGHTER:          return false;
   case COPY:             return true;
@@ -626,3 +629,30 @@ comp_is_full_screen(
     return true;
   }
 }
+
+// Tells how a full screen operation acts on the destination when
+// the source is transparent black, so that pixels outside of a shape
+// can be processed in bulk rather than one by one
+comp_zero_action_t
+comp_zero_source_action(
+  composite_operation_t composite_operation,
+  color_t_ *fill) // out
+{
+  assert(fill != NULL);
+
+  *fill = color_transparent_black;
+
+  switch (composite_operation) {
+  case SOURCE_IN:        return COMP_ZERO_FILL;
+  case SOURCE_OUT:       return COMP_ZERO_FILL;
+  case DESTINATION_IN:   return COMP_ZERO_FILL;
+  case DESTINATION_ATOP: return COMP_ZERO_FILL;
+  case COPY:             return COMP_ZERO_FILL;
+  case ONE_MINUS_SRC:    *fill = color_white; return COMP_ZERO_FILL;
+  default:
+    if (comp_is_full_screen(composite_operation) == false) {
+      return COMP_ZERO_KEEP;
+    }
+    return COMP_ZERO_COMPOSE;
+  }
+}
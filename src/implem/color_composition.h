@@ -45,6 +45,14 @@ typedef enum composite_operation_t {
   ONE_MINUS_SRC    = 100 // For internal use only
 } composite_operation_t;
 
+// What happens to a destination pixel composed
+// with transparent black at zero coverage
+typedef enum comp_zero_action_t {
+  COMP_ZERO_KEEP    = 0, // Destination is left untouched
+  COMP_ZERO_FILL    = 1, // Destination is replaced by a constant color
+  COMP_ZERO_COMPOSE = 2  // Destination must be composed pixel per pixel
+} comp_zero_action_t;
+
 color_t_
 comp_source_over(
   color_t_ src,
@@ -219,4 +227,9 @@ bool
 comp_is_full_screen(
   composite_operation_t comp);
 
+comp_zero_action_t
+comp_zero_source_action(
+  composite_operation_t comp,
+  color_t_ *fill); // out
+
 #endif /* __COLOR_COMPOSITION_H */
@@ -22,7 +22,7 @@
 #include "polygon.h"
 #include "transform.h"
 #include "draw_style.h"
-#include "list.h"
+#include "clip_path.h"
 #include "state.h" // for shadow_t
 
 #ifdef HAS_ACCEL
@@ -124,7 +124,7 @@ context_present(
 bool
 context_clip(
   context_t *c,
-  list_t *clip_path,
+  const clip_path_t *clip_path,
   const transform_t *transform)
 {
   assert(c != NULL);
@@ -177,6 +177,203 @@ context_render_polygon(
   }
 }
 
+void
+context_render_hairline(
+  context_t *c,
+  const polygon_t *p,
+  draw_style_t draw_style,
+  double global_alpha,
+  double width,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(p != NULL);
+  assert(transform != NULL);
+
+  switch_ACCEL() {
+    case_HW(hw_context_render_hairline((hw_context_t *)c, p, draw_style,
+                                       global_alpha, width, compose_op,
+                                       transform));
+    case_SW(sw_context_render_hairline((sw_context_t *)c, p, draw_style,
+                                       global_alpha, width, compose_op,
+                                       transform));
+  }
+}
+
+// Renders instructions that neither cast a shadow nor affect
+// the whole surface, all under the current clip region
+void
+context_render_batch(
+  context_t *c,
+  const picture_instr_t *instrs,
+  int32_t nb_instrs)
+{
+  assert(c != NULL);
+  assert(instrs != NULL);
+  assert(nb_instrs >= 0);
+
+  switch_ACCEL() {
+    case_HW(hw_context_render_batch((hw_context_t *)c, instrs, nb_instrs));
+    case_SW(sw_context_render_batch((sw_context_t *)c, instrs, nb_instrs));
+  }
+}
+
+void
+context_render_mask(
+  context_t *c,
+  const mask_t *mask,
+  int32_t x,
+  int32_t y,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(mask != NULL);
+  assert(transform != NULL);
+
+  switch_ACCEL() {
+    case_HW(hw_context_render_mask((hw_context_t *)c, mask, x, y, draw_style,
+                                   global_alpha, compose_op, transform));
+    case_SW(sw_context_render_mask((sw_context_t *)c, mask, x, y, draw_style,
+                                   global_alpha, compose_op, transform));
+  }
+}
+
+void
+context_render_rects(
+  context_t *c,
+  const double *rects,
+  int32_t nb_rects,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(rects != NULL);
+  assert(nb_rects >= 0);
+  assert(transform != NULL);
+
+  switch_ACCEL() {
+    case_HW(hw_context_render_rects((hw_context_t *)c, rects, nb_rects, colors,
+                                     draw_style, global_alpha, compose_op,
+                                     transform));
+    case_SW(sw_context_render_rects((sw_context_t *)c, rects, nb_rects, colors,
+                                     draw_style, global_alpha, compose_op,
+                                     transform));
+  }
+}
+
+void
+context_render_circles(
+  context_t *c,
+  const double *circles,
+  int32_t nb_circles,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(circles != NULL);
+  assert(nb_circles >= 0);
+  assert(transform != NULL);
+
+  switch_ACCEL() {
+    case_HW(hw_context_render_circles((hw_context_t *)c, circles, nb_circles, colors,
+                                     draw_style, global_alpha, compose_op,
+                                     transform));
+    case_SW(sw_context_render_circles((sw_context_t *)c, circles, nb_circles, colors,
+                                     draw_style, global_alpha, compose_op,
+                                     transform));
+  }
+}
+
+void
+context_render_rect(
+  context_t *c,
+  double x1,
+  double y1,
+  double x2,
+  double y2,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(transform != NULL);
+
+  switch_ACCEL() {
+    case_HW(hw_context_render_rect((hw_context_t *)c, x1, y1, x2, y2,
+                                   draw_style, global_alpha, compose_op,
+                                   transform));
+    case_SW(sw_context_render_rect((sw_context_t *)c, x1, y1, x2, y2,
+                                   draw_style, global_alpha, compose_op,
+                                   transform));
+  }
+}
+
+void
+context_render_ellipse(
+  context_t *c,
+  double cx,
+  double cy,
+  double rx,
+  double ry,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(transform != NULL);
+
+  switch_ACCEL() {
+    case_HW(hw_context_render_ellipse((hw_context_t *)c, cx, cy, rx, ry,
+                                      draw_style, global_alpha, compose_op,
+                                      transform));
+    case_SW(sw_context_render_ellipse((sw_context_t *)c, cx, cy, rx, ry,
+                                      draw_style, global_alpha, compose_op,
+                                      transform));
+  }
+}
+
+bool
+context_push_layer(
+  context_t *c)
+{
+  assert(c != NULL);
+
+  switch_ACCEL() {
+    case_HW(return hw_context_push_layer((hw_context_t *)c));
+    case_SW(return sw_context_push_layer((sw_context_t *)c));
+  }
+}
+
+void
+context_pop_layer(
+  context_t *c,
+  const filter_t *filters,
+  int32_t nb_filters,
+  double global_alpha,
+  composite_operation_t compose_op)
+{
+  assert(c != NULL);
+
+  switch_ACCEL() {
+    case_HW(hw_context_pop_layer((hw_context_t *)c, filters, nb_filters,
+                                 global_alpha, compose_op));
+    case_SW(sw_context_pop_layer((sw_context_t *)c, filters, nb_filters,
+                                 global_alpha, compose_op));
+  }
+}
+
 void
 context_blit(
   context_t *dc,
@@ -190,6 +387,7 @@ context_blit(
   double global_alpha,
   const shadow_t *shadow,
   composite_operation_t compose_op,
+  image_smoothing_t smoothing,
   const transform_t *transform)
 {
   assert(dc != NULL);
@@ -200,10 +398,83 @@ context_blit(
   switch_ACCEL() {
     case_HW(hw_context_blit((hw_context_t *)dc, dx, dy,
                             (hw_context_t *)sc, sx, sy, width, height,
-                            global_alpha, shadow, compose_op, transform));
+                            global_alpha, shadow, compose_op, smoothing,
+                            transform));
     case_SW(sw_context_blit((sw_context_t *)dc, dx, dy,
                             (sw_context_t *)sc, sx, sy, width, height,
-                            global_alpha, shadow, compose_op, transform));
+                            global_alpha, shadow, compose_op, smoothing,
+                            transform));
+  }
+}
+
+void
+context_draw_image(
+  context_t *dc,
+  double dx,
+  double dy,
+  double dw,
+  double dh,
+  const context_t *sc,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform)
+{
+  assert(dc != NULL);
+  assert(sc != NULL);
+  assert(shadow != NULL);
+  assert(transform != NULL);
+
+  switch_ACCEL() {
+    case_HW(hw_context_draw_image((hw_context_t *)dc, dx, dy, dw, dh,
+                                  (hw_context_t *)sc, sx, sy, sw, sh,
+                                  global_alpha, shadow, compose_op,
+                                  smoothing, transform));
+    case_SW(sw_context_draw_image((sw_context_t *)dc, dx, dy, dw, dh,
+                                  (sw_context_t *)sc, sx, sy, sw, sh,
+                                  global_alpha, shadow, compose_op,
+                                  smoothing, transform));
+  }
+}
+
+// Draws a batch of sprites, taken either from the source
+// context sc or, when sc is NULL, from the pixmap sp
+void
+context_draw_sprites(
+  context_t *dc,
+  const context_t *sc,
+  const pixmap_t *sp,
+  const double *sprites,
+  int32_t nb_sprites,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform)
+{
+  assert(dc != NULL);
+  assert((sc != NULL) || (sp != NULL));
+  assert(sprites != NULL);
+  assert(nb_sprites >= 0);
+  assert(shadow != NULL);
+  assert(transform != NULL);
+
+  switch_ACCEL() {
+    case_HW(hw_context_draw_sprites((hw_context_t *)dc,
+                                    (const hw_context_t *)sc, sp,
+                                    sprites, nb_sprites,
+                                    global_alpha, shadow, compose_op,
+                                    smoothing, transform));
+    case_SW(sw_context_draw_sprites((sw_context_t *)dc,
+                                    (const sw_context_t *)sc, sp,
+                                    sprites, nb_sprites,
+                                    global_alpha, shadow, compose_op,
+                                    smoothing, transform));
   }
 }
 
@@ -236,6 +507,42 @@ context_put_pixel(
   }
 }
 
+pixmap_t
+context_get_raw_pixmap(
+  context_t *c)
+{
+  assert(c != NULL);
+
+  switch_ACCEL() {
+    case_HW(return hw_context_get_raw_pixmap((hw_context_t *)c));
+    case_SW(return sw_context_get_raw_pixmap((sw_context_t *)c));
+  }
+}
+
+bool
+context_can_detach_pixels(
+  const context_t *c)
+{
+  assert(c != NULL);
+
+  switch_ACCEL() {
+    case_HW(return hw_context_can_detach_pixels((const hw_context_t *)c));
+    case_SW(return sw_context_can_detach_pixels((const sw_context_t *)c));
+  }
+}
+
+color_t_ *
+context_detach_pixels(
+  context_t *c)
+{
+  assert(c != NULL);
+
+  switch_ACCEL() {
+    case_HW(return hw_context_detach_pixels((hw_context_t *)c));
+    case_SW(return sw_context_detach_pixels((sw_context_t *)c));
+  }
+}
+
 pixmap_t
 context_get_pixmap(
   const context_t *c,
@@ -19,10 +19,13 @@
 
 #include "rect.h"
 #include "polygon.h"
+#include "mask_cache.h"
 #include "transform.h"
 #include "draw_style.h"
-#include "list.h"
+#include "clip_path.h"
 #include "state.h" // for shadow_t
+#include "picture.h"
+#include "filters.h"
 
 typedef struct context_t context_t;
 
@@ -62,7 +65,7 @@ context_present(
 bool
 context_clip(
   context_t *c,
-  list_t *clip_path,
+  const clip_path_t *clip_path,
   const transform_t *transform);
 
 void
@@ -81,6 +84,91 @@ context_render_polygon(
   bool non_zero,
   const transform_t *transform);
 
+void
+context_render_hairline(
+  context_t *c,
+  const polygon_t *p,
+  draw_style_t draw_style,
+  double global_alpha,
+  double width,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+context_render_batch(
+  context_t *c,
+  const picture_instr_t *instrs,
+  int32_t nb_instrs);
+
+void
+context_render_mask(
+  context_t *c,
+  const mask_t *mask,
+  int32_t x,
+  int32_t y,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+context_render_rects(
+  context_t *c,
+  const double *rects,
+  int32_t nb_rects,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+context_render_circles(
+  context_t *c,
+  const double *circles,
+  int32_t nb_circles,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+context_render_rect(
+  context_t *c,
+  double x1,
+  double y1,
+  double x2,
+  double y2,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+context_render_ellipse(
+  context_t *c,
+  double cx,
+  double cy,
+  double rx,
+  double ry,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+bool
+context_push_layer(
+  context_t *c);
+
+void
+context_pop_layer(
+  context_t *c,
+  const filter_t *filters,
+  int32_t nb_filters,
+  double global_alpha,
+  composite_operation_t compose_op);
+
 void
 context_blit(
   context_t *dc,
@@ -94,6 +182,38 @@ context_blit(
   double global_alpha,
   const shadow_t *shadow,
   composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform);
+
+void
+context_draw_image(
+  context_t *dc,
+  double dx,
+  double dy,
+  double dw,
+  double dh,
+  const context_t *sc,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform);
+
+void
+context_draw_sprites(
+  context_t *dc,
+  const context_t *sc,
+  const pixmap_t *sp,
+  const double *sprites,
+  int32_t nb_sprites,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
   const transform_t *transform);
 
 color_t_
@@ -109,6 +229,18 @@ context_put_pixel(
   int32_t y,
   color_t_ color);
 
+pixmap_t
+context_get_raw_pixmap(
+  context_t *c);
+
+bool
+context_can_detach_pixels(
+  const context_t *c);
+
+color_t_ *
+context_detach_pixels(
+  context_t *c);
+
 pixmap_t
 context_get_pixmap(
   const context_t *c,
@@ -14,6 +14,7 @@
 #include "color.h"
 #include "gradient.h"
 #include "pattern.h"
+#include "image_interpolation.h"
 
 typedef enum draw_style_type_t {
   DRAW_STYLE_COLOR    = 0,
@@ -32,6 +33,8 @@ typedef union draw_style_content_t {
 typedef struct draw_style_t {
   draw_style_type_t type;
   draw_style_content_t content;
+  image_smoothing_t smoothing; // for patterns and pixmaps
+  int32_t level; // pattern mipmap level, chosen before rendering
 } draw_style_t;
 
 void
@@ -8,13 +8,18 @@
 /*                                                                        */
 /**************************************************************************/
 
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 
 #include "util.h"
+#include "color.h"
 #include "pixmap.h"
+#include "worker_pool.h"
+#include "filters.h"
 
 static void
 _filter_blur_compute_boxes(
@@ -41,118 +46,689 @@ _filter_blur_compute_boxes(
   }
 }
 
+// Bytes of a row processed together by the vertical pass
+#define FILTER_COLUMN_BLOCK 256
+
+// Below this many bytes per chunk, splitting work over
+// worker threads costs more than it saves
+#define FILTER_GRAIN_BYTES 65536
+
+// One box blur pass over a buffer of interleaved 8-bit channels
+typedef struct filter_box_job_t {
+  uint8_t *dst;
+  const uint8_t *src;
+  int32_t width;  // in pixels
+  int32_t height;
+  int32_t nc;     // number of channels
+  int32_t r;      // box radius
+  uint64_t mul;   // 32-bit fixed point reciprocal of the box size
+} filter_box_job_t;
+
+// Divides a window sum by the box size, rounding to nearest; with
+// a 32-bit reciprocal rounded up, this is exact for boxes up to
+// about 2900 pixels (a 16-bit one breaks down after 250 or so)
+static inline uint8_t
+_filter_box_div(
+  uint32_t val,
+  uint64_t mul)
+{
+  return (uint8_t)((val * mul + 0x80000000) >> 32);
+}
+
+// Sliding window box blur of a single channel row, split in three
+// parts so that the inner loop has no bound checks
 static void
-_filter_blur_box_h(
-  pixmap_t *dst,
-  const pixmap_t *src,
-  int32_t r)
+_filter_box_row_a8(
+  uint8_t *d,
+  const uint8_t *s,
+  int32_t w,
+  int32_t r,
+  uint64_t mul)
 {
-  assert(pixmap_valid(*src));
-  assert(pixmap_valid(*dst));
-  assert(src->width == dst->width);
-  assert(src->height == dst->height);
-  assert(r >= 0);
+  assert(d != NULL);
+  assert(s != NULL);
+
+  uint32_t val = 0;
+  int32_t j = 0;
+  for (int32_t k = 0; k < min(r, w); ++k) {
+    val += s[k];
+  }
+  for (; (j <= r) && (j < w); ++j) {
+    if (j + r < w) {
+      val += s[j + r];
+    }
+    d[j] = _filter_box_div(val, mul);
+  }
+  if (j < w) {
+    val -= s[j - r - 1];
+  }
+  for (; j < w - r; ++j) {
+    val += s[j + r];
+    d[j] = _filter_box_div(val, mul);
+    val -= s[j - r];
+  }
+  for (; j < w; ++j) {
+    d[j] = _filter_box_div(val, mul);
+    val -= s[j - r];
+  }
+}
 
-  int32_t w = src->width;
-  int32_t h = src->height;
-  double iarr = 1.0 / ((double)(2 * r + 1));
+// Same as above for four interleaved channels, with one running
+// sum per channel so that the row is read only once
+static void
+_filter_box_row_rgba(
+  uint8_t *d,
+  const uint8_t *s,
+  int32_t w,
+  int32_t r,
+  uint64_t mul)
+{
+  assert(d != NULL);
+  assert(s != NULL);
 
-  for (int32_t i = 0; i < h; ++i) {
-    int32_t ti = i * w, li = ti, ri = ti + r;
-    int32_t fv = src->data[ti].a;
-    int32_t lv = src->data[ti + w - 1].a;
-    int32_t val = (r + 1) * fv;
-    for (int32_t j = 0; j < r; ++j) {
-      val += src->data[ti + j].a;
+  uint32_t val[4] = { 0 };
+  int32_t j = 0;
+  for (int32_t k = 0; k < min(r, w); ++k) {
+    for (int32_t c = 0; c < 4; ++c) {
+      val[c] += s[k * 4 + c];
+    }
+  }
+  for (; (j <= r) && (j < w); ++j) {
+    for (int32_t c = 0; c < 4; ++c) {
+      if (j + r < w) {
+        val[c] += s[(j + r) * 4 + c];
+      }
+      d[j * 4 + c] = _filter_box_div(val[c], mul);
     }
-    for (int32_t j = 0; j <= r; ++j) {
-      val += src->data[ri++].a - fv;
-      dst->data[ti++].a = fastround(val * iarr);
+  }
+  if (j < w) {
+    for (int32_t c = 0; c < 4; ++c) {
+      val[c] -= s[(j - r - 1) * 4 + c];
     }
-    for (int32_t j = r + 1; j < w - r; ++j) {
-      val += src->data[ri++].a - src->data[li++].a;
-      dst->data[ti++].a = fastround(val * iarr);
+  }
+  for (; j < w - r; ++j) {
+    for (int32_t c = 0; c < 4; ++c) {
+      val[c] += s[(j + r) * 4 + c];
+      d[j * 4 + c] = _filter_box_div(val[c], mul);
+      val[c] -= s[(j - r) * 4 + c];
     }
-    for (int32_t j = w - r; j < w; ++j) {
-      val += lv - src->data[li++].a;
-      dst->data[ti++].a = fastround(val * iarr);
+  }
+  for (; j < w; ++j) {
+    for (int32_t c = 0; c < 4; ++c) {
+      d[j * 4 + c] = _filter_box_div(val[c], mul);
+      val[c] -= s[(j - r) * 4 + c];
     }
   }
 }
 
+// Sliding window box blur of rows [first; last[, treating samples
+// outside the buffer as zero; the division by the window size is
+// done by a fixed point reciprocal multiplication
 static void
-_filter_blur_box_v(
-  pixmap_t *dst,
-  const pixmap_t *src,
-  int32_t r)
+_filter_box_rows(
+  void *data,
+  int32_t first,
+  int32_t last)
 {
-  assert(pixmap_valid(*src));
-  assert(pixmap_valid(*dst));
-  assert(src->width == dst->width);
-  assert(src->height == dst->height);
-  assert(r >= 0);
+  const filter_box_job_t *job = (const filter_box_job_t *)data;
+  assert(job != NULL);
 
-  int32_t w = src->width;
-  int32_t h = src->height;
-  double iarr = 1.0 / ((double)(2 * r + 1));
+  int32_t w = job->width;
+  int32_t nc = job->nc;
+  int32_t r = job->r;
+  uint64_t mul = job->mul;
 
-  for (int32_t i = 0; i < w; ++i) {
-    int32_t ti = i, li = ti, ri = ti + r * w;
-    int32_t fv = src->data[ti].a;
-    int32_t lv = src->data[ti + w * (h-1)].a;
-    int32_t val = (r + 1) * fv;
-    for (int32_t j = 0; j < r; ++j) {
-      val += src->data[ti + j*w].a;
+  for (int32_t i = first; i < last; ++i) {
+    const uint8_t *s = job->src + (size_t)i * w * nc;
+    uint8_t *d = job->dst + (size_t)i * w * nc;
+    if (nc == 1) {
+      _filter_box_row_a8(d, s, w, r, mul);
+      continue;
+    } else if (nc == 4) {
+      _filter_box_row_rgba(d, s, w, r, mul);
+      continue;
     }
-    for (int32_t j = 0; j <= r; ++j) {
-      val += src->data[ri].a - fv;
-      dst->data[ti].a = fastround(val * iarr);
-      ri += w;
-      ti += w;
+    for (int32_t c = 0; c < nc; ++c) {
+      uint32_t val = 0;
+      for (int32_t j = 0; j < min(r, w); ++j) {
+        val += s[j * nc + c];
+      }
+      for (int32_t j = 0; j < w; ++j) {
+        if (j + r < w) {
+          val += s[(j + r) * nc + c];
+        }
+        d[j * nc + c] = _filter_box_div(val, mul);
+        if (j - r >= 0) {
+          val -= s[(j - r) * nc + c];
+        }
+      }
     }
-    for (int32_t j = r + 1; j < h - r; ++j) {
-      val += src->data[ri].a - src->data[li].a;
-      dst->data[ti].a = fastround(val * iarr);
-      li += w;
-      ri += w;
-      ti += w;
+  }
+}
+
+// Same as above for the columns, in blocks [first; last[ of
+// FILTER_COLUMN_BLOCK bytes; the window slides down the buffer
+// one row at a time, with one running sum per byte of the block,
+// so memory is accessed row by row and the inner loops vectorize
+static void
+_filter_box_columns(
+  void *data,
+  int32_t first,
+  int32_t last)
+{
+  const filter_box_job_t *job = (const filter_box_job_t *)data;
+  assert(job != NULL);
+
+  size_t stride = (size_t)job->width * job->nc;
+  int32_t h = job->height;
+  int32_t r = job->r;
+  uint64_t mul = job->mul;
+
+  uint32_t sums[FILTER_COLUMN_BLOCK];
+
+  for (int32_t b = first; b < last; ++b) {
+
+    size_t k = (size_t)b * FILTER_COLUMN_BLOCK;
+    int32_t n = (int32_t)min(stride - k, (size_t)FILTER_COLUMN_BLOCK);
+    const uint8_t *src = job->src + k;
+    uint8_t *dst = job->dst + k;
+
+    memset(sums, 0, n * sizeof(uint32_t));
+    for (int32_t i = 0; i < min(r, h); ++i) {
+      const uint8_t *s = src + i * stride;
+      for (int32_t j = 0; j < n; ++j) {
+        sums[j] += s[j];
+      }
     }
-    for (int32_t j = h - r; j < h; ++j) {
-      val += lv - src->data[li].a;
-      dst->data[ti].a = fastround(val * iarr);
-      li += w;
-      ti += w;
+
+    for (int32_t i = 0; i < h; ++i) {
+      if (i + r < h) {
+        const uint8_t *s = src + (i + r) * stride;
+        for (int32_t j = 0; j < n; ++j) {
+          sums[j] += s[j];
+        }
+      }
+      uint8_t *d = dst + i * stride;
+      for (int32_t j = 0; j < n; ++j) {
+        d[j] = _filter_box_div(sums[j], mul);
+      }
+      if (i - r >= 0) {
+        const uint8_t *s = src + (i - r) * stride;
+        for (int32_t j = 0; j < n; ++j) {
+          sums[j] -= s[j];
+        }
+      }
     }
   }
 }
 
-// Note: dst must be an exact copy of src
+// Box blurs data in place, using tmp (of the same size) as scratch;
+// large buffers are split by rows, then by column blocks, over the
+// worker threads
 static void
-_filter_blur_box(
-  pixmap_t *src,
-  pixmap_t *dst,
+_filter_box_blur(
+  uint8_t *data,
+  uint8_t *tmp,
+  int32_t width,
+  int32_t height,
+  int32_t nc,
   int32_t r)
 {
-  assert(pixmap_valid(*src));
-  assert(pixmap_valid(*dst));
+  assert(data != NULL);
+  assert(tmp != NULL);
+  assert(r >= 0);
+
+  size_t stride = (size_t)width * nc;
+  filter_box_job_t job = {
+    .dst = tmp, .src = data, .width = width, .height = height,
+    .nc = nc, .r = r,
+    .mul = (((uint64_t)1 << 32) + 2 * r) / (uint64_t)(2 * r + 1)
+  };
+
+  int32_t row_grain = (int32_t)max(FILTER_GRAIN_BYTES / stride, (size_t)1);
+  worker_pool_run(_filter_box_rows, &job, height, row_grain);
 
-  _filter_blur_box_h(src, dst, r);
-  _filter_blur_box_v(dst, src, r);
+  job.dst = data;
+  job.src = tmp;
+  int32_t nb_blocks =
+    (int32_t)((stride + FILTER_COLUMN_BLOCK - 1) / FILTER_COLUMN_BLOCK);
+  int32_t block_grain =
+    max(FILTER_GRAIN_BYTES / (FILTER_COLUMN_BLOCK * height), 1);
+  worker_pool_run(_filter_box_columns, &job, nb_blocks, block_grain);
 }
 
+// Approximates a gaussian blur of standard deviation s on a buffer
+// of interleaved 8-bit channels in place, with three box blur passes
 // https://blog.ivank.net/fastest-gaussian-blur.html
+static bool
+_filter_gaussian_blur(
+  uint8_t *data,
+  int32_t width,
+  int32_t height,
+  int32_t nc,
+  double s)
+{
+  assert(data != NULL);
+  assert(width > 0);
+  assert(height > 0);
+  assert(nc > 0);
+
+  uint8_t *tmp = (uint8_t *)malloc((size_t)width * height * nc);
+  if (tmp == NULL) {
+    return false;
+  }
+
+  int32_t boxes[3] = { 0 };
+  _filter_blur_compute_boxes(s, 3, boxes);
+  for (int32_t k = 0; k < 3; ++k) {
+    _filter_box_blur(data, tmp, width, height, nc,
+                     max((boxes[k] - 1) / 2, 0));
+  }
+
+  free(tmp);
+
+  return true;
+}
+
+// Returns a copy of src whose alpha channel is blurred
 pixmap_t
 filter_gaussian_blur_alpha(
   pixmap_t *src,
   double s)
 {
+  assert(src != NULL);
+
   pixmap_t dst = pixmap_copy(*src);
-  if (pixmap_valid(dst) == true) {
-    int32_t boxes[3] = { 0 };
-    _filter_blur_compute_boxes(s, 3, boxes);
-    _filter_blur_box(src, &dst, (boxes[0] - 1) / 2);
-    _filter_blur_box(&dst, src, (boxes[1] - 1) / 2);
-    _filter_blur_box(src, &dst, (boxes[2] - 1) / 2);
+  if (pixmap_valid(dst) == false) {
+    return dst;
+  }
+
+  int32_t n = dst.width * dst.height;
+  uint8_t *a = (uint8_t *)malloc((size_t)n);
+  if (a == NULL) {
+    return dst;
+  }
+  for (int32_t k = 0; k < n; ++k) {
+    a[k] = dst.data[k].a;
+  }
+  if (_filter_gaussian_blur(a, dst.width, dst.height, 1, s) == true) {
+    for (int32_t k = 0; k < n; ++k) {
+      dst.data[k].a = a[k];
+    }
   }
+  free(a);
+
   return dst;
 }
+
+// Blurs an A8 buffer in place
+bool
+filter_gaussian_blur_a8(
+  uint8_t *data,
+  int32_t width,
+  int32_t height,
+  double s)
+{
+  assert(data != NULL);
+
+  return _filter_gaussian_blur(data, width, height, 1, s);
+}
+
+// Rows of pixels processed together by the per-pixel passes
+#define FILTER_PIXEL_GRAIN 16384
+
+// One per-pixel pass over the rows of a pixmap
+typedef struct filter_pixel_job_t {
+  color_t_ *data;
+  int32_t width;
+  const uint8_t *lut;     // table applied to the color channels
+  const int32_t *matrix;  // 3x3 colour matrix, 12-bit fixed point
+  const uint8_t *shadow;  // drop shadow coverage
+  color_t_ color;         // drop shadow color
+  int32_t dx;             // drop shadow offset
+  int32_t dy;
+  int32_t height;
+} filter_pixel_job_t;
+
+static void
+_filter_run_pixel_job(
+  worker_fun_t *fun,
+  filter_pixel_job_t *job)
+{
+  assert(fun != NULL);
+  assert(job != NULL);
+  assert(job->width > 0);
+
+  worker_pool_run(fun, job, job->height,
+                  max(FILTER_PIXEL_GRAIN / job->width, 1));
+}
+
+static void
+_filter_premultiply_rows(
+  void *data,
+  int32_t first,
+  int32_t last)
+{
+  const filter_pixel_job_t *job = (const filter_pixel_job_t *)data;
+  assert(job != NULL);
+
+  for (int32_t i = first; i < last; ++i) {
+    color_t_ *p = job->data + (size_t)i * job->width;
+    for (int32_t j = 0; j < job->width; ++j) {
+      // Rounded division by 255, as (x + 128) * 257 >> 16
+      uint32_t a = p[j].a;
+      p[j].r = (uint8_t)(((p[j].r * a + 128) * 257) >> 16);
+      p[j].g = (uint8_t)(((p[j].g * a + 128) * 257) >> 16);
+      p[j].b = (uint8_t)(((p[j].b * a + 128) * 257) >> 16);
+    }
+  }
+}
+
+// Divides by alpha through a table of 16-bit fixed point
+// reciprocals, so the inner loop only multiplies
+static void
+_filter_unpremultiply_rows(
+  void *data,
+  int32_t first,
+  int32_t last)
+{
+  const filter_pixel_job_t *job = (const filter_pixel_job_t *)data;
+  assert(job != NULL);
+
+  uint32_t recip[256] = { 0 };
+  for (uint32_t a = 1; a < 256; ++a) {
+    recip[a] = ((255 << 16) + a / 2) / a;
+  }
+
+  for (int32_t i = first; i < last; ++i) {
+    color_t_ *p = job->data + (size_t)i * job->width;
+    for (int32_t j = 0; j < job->width; ++j) {
+      uint32_t m = recip[p[j].a];
+      p[j].r = (uint8_t)min((p[j].r * m + 32768) >> 16, 255);
+      p[j].g = (uint8_t)min((p[j].g * m + 32768) >> 16, 255);
+      p[j].b = (uint8_t)min((p[j].b * m + 32768) >> 16, 255);
+    }
+  }
+}
+
+static void
+_filter_lut_rows(
+  void *data,
+  int32_t first,
+  int32_t last)
+{
+  const filter_pixel_job_t *job = (const filter_pixel_job_t *)data;
+  assert(job != NULL);
+  assert(job->lut != NULL);
+
+  const uint8_t *lut = job->lut;
+  for (int32_t i = first; i < last; ++i) {
+    color_t_ *p = job->data + (size_t)i * job->width;
+    for (int32_t j = 0; j < job->width; ++j) {
+      p[j].r = lut[p[j].r];
+      p[j].g = lut[p[j].g];
+      p[j].b = lut[p[j].b];
+    }
+  }
+}
+
+// Branch free integer kernel, so that the compiler
+// can vectorize the inner loop
+static void
+_filter_matrix_rows(
+  void *data,
+  int32_t first,
+  int32_t last)
+{
+  const filter_pixel_job_t *job = (const filter_pixel_job_t *)data;
+  assert(job != NULL);
+  assert(job->matrix != NULL);
+
+  int32_t m[9];
+  memcpy(m, job->matrix, sizeof(m));
+
+  for (int32_t i = first; i < last; ++i) {
+    color_t_ *p = job->data + (size_t)i * job->width;
+    for (int32_t j = 0; j < job->width; ++j) {
+      int32_t r = p[j].r, g = p[j].g, b = p[j].b;
+      int32_t nr = (m[0] * r + m[1] * g + m[2] * b + 2048) >> 12;
+      int32_t ng = (m[3] * r + m[4] * g + m[5] * b + 2048) >> 12;
+      int32_t nb = (m[6] * r + m[7] * g + m[8] * b + 2048) >> 12;
+      p[j].r = (uint8_t)min(max(nr, 0), 255);
+      p[j].g = (uint8_t)min(max(ng, 0), 255);
+      p[j].b = (uint8_t)min(max(nb, 0), 255);
+    }
+  }
+}
+
+// Composes the pixels over the offset shadow coverage,
+// in non-premultiplied space
+static void
+_filter_drop_shadow_rows(
+  void *data,
+  int32_t first,
+  int32_t last)
+{
+  const filter_pixel_job_t *job = (const filter_pixel_job_t *)data;
+  assert(job != NULL);
+  assert(job->shadow != NULL);
+
+  int32_t w = job->width;
+  color_t_ sc = job->color;
+
+  for (int32_t i = first; i < last; ++i) {
+    int32_t si = i - job->dy;
+    if ((si < 0) || (si >= job->height)) {
+      continue;
+    }
+    color_t_ *p = job->data + (size_t)i * w;
+    const uint8_t *a = job->shadow + (size_t)si * w;
+    for (int32_t j = max(job->dx, 0); j < min(w + job->dx, w); ++j) {
+      uint32_t sa = a[j - job->dx] * sc.a / 255;
+      if ((sa == 0) || (p[j].a == 255)) {
+        continue;
+      }
+      uint32_t ws = p[j].a * 255;
+      uint32_t wd = sa * (255 - p[j].a);
+      uint32_t wa = ws + wd;
+      p[j] = color((wa + 127) / 255,
+                   (p[j].r * ws + sc.r * wd) / wa,
+                   (p[j].g * ws + sc.g * wd) / wa,
+                   (p[j].b * ws + sc.b * wd) / wa);
+    }
+  }
+}
+
+// Folds a brightness or contrast filter into a channel table
+static void
+_filter_compose_lut(
+  uint8_t *lut,
+  const filter_t *filter)
+{
+  assert(lut != NULL);
+  assert(filter != NULL);
+  assert((filter->type == FILTER_BRIGHTNESS) ||
+         (filter->type == FILTER_CONTRAST));
+
+  double f = max(filter->amount, 0.0);
+  for (int32_t k = 0; k < 256; ++k) {
+    double v = (double)lut[k];
+    if (filter->type == FILTER_BRIGHTNESS) {
+      v = v * f;
+    } else {
+      v = (v - 127.5) * f + 127.5;
+    }
+    lut[k] = (uint8_t)min(max(round(v), 0.0), 255.0);
+  }
+}
+
+// Colour matrix of a grayscale filter, from the CSS filter effects
+static void
+_filter_grayscale_matrix(
+  int32_t *m,
+  double amount)
+{
+  assert(m != NULL);
+
+  static const double l[3] = { 0.2126, 0.7152, 0.0722 };
+
+  double a = 1.0 - min(max(amount, 0.0), 1.0);
+  for (int32_t i = 0; i < 3; ++i) {
+    for (int32_t j = 0; j < 3; ++j) {
+      double v = l[j] + ((i == j) ? 1.0 - l[j] : -l[j]) * a;
+      m[i * 3 + j] = (int32_t)round(v * 4096.0);
+    }
+    // Keep white white despite rounding
+    m[i * 4] = 4096 - (m[i * 3] + m[i * 3 + 1] + m[i * 3 + 2] - m[i * 4]);
+  }
+}
+
+// Blurs the four channels, premultiplied so that
+// transparent pixels do not bleed their color
+static bool
+_filter_blur(
+  pixmap_t *pm,
+  double s)
+{
+  assert(pm != NULL);
+
+  if (s <= 0.0) {
+    return true;
+  }
+
+  filter_pixel_job_t job = {
+    .data = pm->data, .width = pm->width, .height = pm->height
+  };
+  _filter_run_pixel_job(_filter_premultiply_rows, &job);
+  bool res =
+    _filter_gaussian_blur((uint8_t *)pm->data, pm->width, pm->height, 4, s);
+  _filter_run_pixel_job(_filter_unpremultiply_rows, &job);
+
+  return res;
+}
+
+static bool
+_filter_drop_shadow(
+  pixmap_t *pm,
+  const filter_t *filter)
+{
+  assert(pm != NULL);
+  assert(filter != NULL);
+  assert(filter->type == FILTER_DROP_SHADOW);
+
+  size_t n = (size_t)pm->width * pm->height;
+  uint8_t *a = (uint8_t *)malloc(n);
+  if (a == NULL) {
+    return false;
+  }
+  for (size_t k = 0; k < n; ++k) {
+    a[k] = pm->data[k].a;
+  }
+
+  // As with shadowBlur, the blur is twice the standard deviation
+  if ((filter->amount > 0.0) &&
+      (_filter_gaussian_blur(a, pm->width, pm->height, 1,
+                             filter->amount / 2.0) == false)) {
+    free(a);
+    return false;
+  }
+
+  filter_pixel_job_t job = {
+    .data = pm->data, .width = pm->width, .height = pm->height,
+    .shadow = a, .color = filter->color,
+    .dx = (int32_t)round(filter->offset_x),
+    .dy = (int32_t)round(filter->offset_y)
+  };
+  _filter_run_pixel_job(_filter_drop_shadow_rows, &job);
+
+  free(a);
+
+  return true;
+}
+
+// Applies a list of filters in place, in order; consecutive
+// brightness and contrast filters are folded into a single table
+bool
+filter_apply(
+  pixmap_t *pm,
+  const filter_t *filters,
+  int32_t nb_filters)
+{
+  assert(pm != NULL);
+  assert(pixmap_valid(*pm) == true);
+  assert((filters != NULL) || (nb_filters == 0));
+
+  int32_t k = 0;
+  while (k < nb_filters) {
+
+    bool res = true;
+    filter_pixel_job_t job = {
+      .data = pm->data, .width = pm->width, .height = pm->height
+    };
+
+    switch (filters[k].type) {
+      case FILTER_BLUR:
+        res = _filter_blur(pm, filters[k].amount);
+        ++k;
+        break;
+      case FILTER_BRIGHTNESS:
+      case FILTER_CONTRAST: {
+        uint8_t lut[256];
+        for (int32_t i = 0; i < 256; ++i) {
+          lut[i] = (uint8_t)i;
+        }
+        while ((k < nb_filters) &&
+               ((filters[k].type == FILTER_BRIGHTNESS) ||
+                (filters[k].type == FILTER_CONTRAST))) {
+          _filter_compose_lut(lut, &filters[k]);
+          ++k;
+        }
+        job.lut = lut;
+        _filter_run_pixel_job(_filter_lut_rows, &job);
+        break;
+      }
+      case FILTER_GRAYSCALE: {
+        int32_t m[9];
+        _filter_grayscale_matrix(m, filters[k].amount);
+        job.matrix = m;
+        _filter_run_pixel_job(_filter_matrix_rows, &job);
+        ++k;
+        break;
+      }
+      case FILTER_DROP_SHADOW:
+        res = _filter_drop_shadow(pm, &filters[k]);
+        ++k;
+        break;
+      default:
+        assert(!"Invalid filter type");
+        ++k;
+        break;
+    }
+
+    if (res == false) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Extent of the area around a drawing that the filters can reach
+double
+filter_get_margin(
+  const filter_t *filters,
+  int32_t nb_filters)
+{
+  assert((filters != NULL) || (nb_filters == 0));
+
+  double margin = 0.0;
+  for (int32_t k = 0; k < nb_filters; ++k) {
+    if (filters[k].type == FILTER_BLUR) {
+      margin += 3.0 * max(filters[k].amount, 0.0);
+    } else if (filters[k].type == FILTER_DROP_SHADOW) {
+      margin += 1.5 * max(filters[k].amount, 0.0) +
+        max(fabs(filters[k].offset_x), fabs(filters[k].offset_y));
+    }
+  }
+  return margin;
+}
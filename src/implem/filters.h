@@ -11,11 +11,51 @@
 #ifndef __FILTERS_H
 #define __FILTERS_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "color.h"
 #include "pixmap.h"
 
+typedef enum filter_type_t {
+  FILTER_BLUR        = 0,
+  FILTER_BRIGHTNESS  = 1,
+  FILTER_CONTRAST    = 2,
+  FILTER_GRAYSCALE   = 3,
+  FILTER_DROP_SHADOW = 4
+} filter_type_t;
+
+// A CSS-like filter function
+typedef struct filter_t {
+  filter_type_t type;
+  double amount;   // blur standard deviation, brightness, contrast
+                   // or grayscale amount, or drop shadow blur
+  double offset_x; // drop shadow only
+  double offset_y;
+  color_t_ color;
+} filter_t;
+
 pixmap_t
 filter_gaussian_blur_alpha(
   pixmap_t *src,
   double s);
 
+bool
+filter_gaussian_blur_a8(
+  uint8_t *data,
+  int32_t width,
+  int32_t height,
+  double s);
+
+bool
+filter_apply(
+  pixmap_t *pm,
+  const filter_t *filters,
+  int32_t nb_filters);
+
+double
+filter_get_margin(
+  const filter_t *filters,
+  int32_t nb_filters);
+
 #endif /* __FILTERS_H */
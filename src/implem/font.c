@@ -49,11 +49,8 @@ font_create(
     return NULL;
   }
 
-  f->font_desc = font_desc_copy(fd);
-  if (f->font_desc == NULL) {
-    font_destroy(f);
-    return NULL;
-  }
+  // Font descriptions are never modified once shared
+  f->font_desc = font_desc_retain(fd);
 
   return f;
 }
@@ -65,7 +62,7 @@ font_destroy(
   assert(f != NULL);
 
   if (f->font_desc != NULL) {
-    font_desc_destroy(f->font_desc);
+    font_desc_release(f->font_desc);
     f->font_desc = NULL;
   }
 
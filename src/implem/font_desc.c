@@ -20,22 +20,25 @@
 
 #define MAX_FAMILY_SIZE 256
 
+IMPLEMENT_OBJECT_METHODS(font_desc_t, font_desc, _font_desc_destroy)
+
 font_desc_t *
 font_desc_create(
   void)
 {
-  font_desc_t *fd = (font_desc_t *)calloc(1, sizeof(font_desc_t));
+  font_desc_t *fd = font_desc_alloc();
   if (fd == NULL) {
     return NULL;
   }
 
+  fd->family = NULL;
   font_desc_reset(fd);
 
   return fd;
 }
 
-void
-font_desc_destroy(
+static void
+_font_desc_destroy(
   font_desc_t *fd)
 {
   assert(fd != NULL);
@@ -70,7 +73,7 @@ font_desc_copy(
 {
   assert(fd != NULL);
 
-  font_desc_t *fdc = (font_desc_t *)calloc(1, sizeof(font_desc_t));
+  font_desc_t *fdc = font_desc_alloc();
   if (fdc == NULL) {
     return NULL;
   }
@@ -78,7 +81,7 @@ font_desc_copy(
   if (fd->family != NULL) {
     fdc->family = strndup(fd->family, MAX_FAMILY_SIZE);
     if (fdc->family == NULL) {
-      font_desc_destroy(fdc);
+      free(fdc);
       return NULL;
     }
   } else {
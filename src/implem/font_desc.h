@@ -14,6 +14,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "object.h"
+
 typedef struct font_desc_t font_desc_t;
 
 typedef enum font_slant_t {
@@ -22,13 +24,11 @@ typedef enum font_slant_t {
   SLANT_OBLIQUE = 2
 } font_slant_t;
 
+DECLARE_OBJECT_METHODS(font_desc_t, font_desc)
+
 font_desc_t *
 font_desc_create();
 
-void
-font_desc_destroy(
-  font_desc_t *fd);
-
 void
 font_desc_reset(
   font_desc_t *fd);
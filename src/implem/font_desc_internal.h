@@ -13,9 +13,11 @@
 
 #include <stdint.h>
 
+#include "object.h"
 #include "font_desc.h"
 
 typedef struct font_desc_t {
+  INHERITS_OBJECT;
   const char *family;
   double size;
   font_slant_t slant;
@@ -116,6 +116,7 @@ gdi_sw_context_create(
   context->base.base.width = width;
   context->base.base.height = height;
   context->base.data = data;
+  context->base.capacity = (size_t)width * height;
   context->bmp = bmp;
   context->hdc = hdc;
   context->hwnd = target->hwnd;
@@ -168,9 +169,12 @@ gdi_sw_context_resize(
 
   DeleteObject(context->bmp);
 
+  // The bitmap memory belongs to the system, which does
+  // not let it outgrow the bitmap, so it is always replaced
   context->base.base.width = width;
   context->base.base.height = height;
   context->base.data = data;
+  context->base.capacity = (size_t)width * height;
   context->bmp = bmp;
 
   return true;
@@ -24,10 +24,10 @@
 #include "polygon.h"
 #include "transform.h"
 #include "draw_style.h"
-#include "list.h"
 #include "state.h" // for shadow_t
 
 #include "draw_instr.h"
+#include "clip_path.h"
 #include "poly_render.h"
 #include "impexp.h"
 
@@ -225,25 +225,17 @@ _hw_context_clip_fill_instr(
 bool
 hw_context_clip(
   hw_context_t *c,
-  list_t *clip_path,
+  const clip_path_t *clip_path,
   const transform_t *transform)
 {
   assert(c != NULL);
   assert(clip_path != NULL);
   assert(transform != NULL);
 
-  list_iterator_t *it = list_get_iterator(clip_path);
-  if (it == NULL) {
-    return false;
-  }
-
-  path_fill_instr_t *instr = NULL;
-  while ((instr = (path_fill_instr_t *)list_iterator_next(it)) != NULL) {
-    _hw_context_clip_fill_instr(c, instr, transform);
+  for (const clip_path_t *cp = clip_path; cp != NULL; cp = cp->next) {
+    _hw_context_clip_fill_instr(c, cp->instr, transform);
   }
 
-  list_free_iterator(it);
-
   return true;
 }
 
@@ -275,6 +267,155 @@ hw_context_render_polygon(
 
 }
 
+void
+hw_context_render_hairline(
+  hw_context_t *c,
+  const polygon_t *p,
+  draw_style_t draw_style,
+  double global_alpha,
+  double width,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(p != NULL);
+  assert(transform != NULL);
+
+}
+
+void
+hw_context_render_batch(
+  hw_context_t *c,
+  const picture_instr_t *instrs,
+  int32_t nb_instrs)
+{
+  assert(c != NULL);
+  assert(instrs != NULL);
+  assert(nb_instrs >= 0);
+
+  for (int32_t i = 0; i < nb_instrs; ++i) {
+    const picture_instr_t *pi = &instrs[i];
+    if (pi->type == PICTURE_INSTR_HAIRLINE) {
+      hw_context_render_hairline(c, pi->poly, pi->style, pi->global_alpha,
+                                 pi->line_width, pi->compose_op,
+                                 &pi->transform);
+    } else {
+      hw_context_render_polygon(c, pi->poly, &pi->bbox, pi->style,
+                                pi->global_alpha, &pi->shadow,
+                                pi->compose_op, pi->non_zero,
+                                &pi->transform);
+    }
+  }
+}
+
+void
+hw_context_render_mask(
+  hw_context_t *c,
+  const mask_t *mask,
+  int32_t x,
+  int32_t y,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(mask != NULL);
+  assert(transform != NULL);
+
+}
+
+void
+hw_context_render_rects(
+  hw_context_t *c,
+  const double *rects,
+  int32_t nb_rects,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(rects != NULL);
+  assert(nb_rects >= 0);
+  assert(transform != NULL);
+
+}
+
+void
+hw_context_render_circles(
+  hw_context_t *c,
+  const double *circles,
+  int32_t nb_circles,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(circles != NULL);
+  assert(nb_circles >= 0);
+  assert(transform != NULL);
+
+}
+
+void
+hw_context_render_rect(
+  hw_context_t *c,
+  double x1,
+  double y1,
+  double x2,
+  double y2,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(transform != NULL);
+
+}
+
+void
+hw_context_render_ellipse(
+  hw_context_t *c,
+  double cx,
+  double cy,
+  double rx,
+  double ry,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(transform != NULL);
+
+}
+
+bool
+hw_context_push_layer(
+  hw_context_t *c)
+{
+  assert(c != NULL);
+
+  return false;
+}
+
+void
+hw_context_pop_layer(
+  hw_context_t *c,
+  const filter_t *filters,
+  int32_t nb_filters,
+  double global_alpha,
+  composite_operation_t compose_op)
+{
+  assert(c != NULL);
+
+}
+
 void
 hw_context_blit(
   hw_context_t *dc,
@@ -289,6 +430,7 @@ hw_context_blit(
   double global_alpha,
   const shadow_t *shadow,
   composite_operation_t compose_op,
+  image_smoothing_t smoothing,
   const transform_t *transform)
 {
   assert(dc != NULL);
@@ -298,6 +440,53 @@ hw_context_blit(
 
 }
 
+void
+hw_context_draw_image(
+  hw_context_t *dc,
+  double dx,
+  double dy,
+  double dw,
+  double dh,
+  const hw_context_t *sc,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform)
+{
+  assert(dc != NULL);
+  assert(sc != NULL);
+  assert(shadow != NULL);
+  assert(transform != NULL);
+
+}
+
+void
+hw_context_draw_sprites(
+  hw_context_t *dc,
+  const hw_context_t *sc,
+  const pixmap_t *sp,
+  const double *sprites,
+  int32_t nb_sprites,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform)
+{
+  assert(dc != NULL);
+  assert((sc != NULL) || (sp != NULL));
+  assert(sprites != NULL);
+  assert(nb_sprites >= 0);
+  assert(shadow != NULL);
+  assert(transform != NULL);
+
+}
+
 color_t_
 hw_context_get_pixel(
   const hw_context_t *c,
@@ -322,6 +511,33 @@ hw_context_put_pixel(
 
 }
 
+pixmap_t
+hw_context_get_raw_pixmap(
+  hw_context_t *c)
+{
+  assert(c != NULL);
+
+  return pixmap_null();
+}
+
+bool
+hw_context_can_detach_pixels(
+  const hw_context_t *c)
+{
+  assert(c != NULL);
+
+  return false;
+}
+
+color_t_ *
+hw_context_detach_pixels(
+  hw_context_t *c)
+{
+  assert(c != NULL);
+
+  return NULL;
+}
+
 pixmap_t
 hw_context_get_pixmap(
   const hw_context_t *c,
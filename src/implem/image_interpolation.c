@@ -12,8 +12,36 @@
 #include <stdbool.h>
 #include <assert.h>
 
+#include "util.h"
 #include "color.h"
 #include "pixmap.h"
+#include "image_interpolation.h"
+
+// Restricts a coordinate to [0; size[, so that it converts to a valid
+// index; callers keep coordinates within the image, but NaN goes
+// through their comparisons
+static inline double
+_interpolation_clamp(
+  double v,
+  int32_t size)
+{
+  return (v >= 0.0) ? ((v < (double)size) ? v : (double)(size - 1)) : 0.0;
+}
+
+color_t_
+interpolation_nearest(
+  const pixmap_t *sp,
+  double uvx,
+  double uvy)
+{
+  assert(sp != NULL);
+  assert(pixmap_valid(*sp) == true);
+
+  int32_t pt_x = (int32_t)_interpolation_clamp(uvx, sp->width);
+  int32_t pt_y = (int32_t)_interpolation_clamp(uvy, sp->height);
+
+  return pixmap_at(*sp, pt_y, pt_x);
+}
 
 color_t_
 interpolation_bilinear(
@@ -27,6 +55,9 @@ interpolation_bilinear(
   int width = sp->width;
   int height = sp->height;
 
+  uvx = _interpolation_clamp(uvx, width);
+  uvy = _interpolation_clamp(uvy, height);
+
   int32_t pt_x = (int32_t)uvx;
   int32_t pt_y = (int32_t)uvy;
 
@@ -89,6 +120,37 @@ _interpolation_cubic_h(
   }
 }
 
+// Bicubic weights of the 4 taps around a sample, for each
+// subpixel phase, in fixed point; the last phase is the
+// first one of the next pixel, which saves a test
+#define CUBIC_PHASES 64
+#define CUBIC_BITS 10
+#define CUBIC_ONE (1 << CUBIC_BITS)
+
+static int32_t _cubic_weights[CUBIC_PHASES + 1][4] = { { 0 } };
+
+void
+interpolation_init(
+  void)
+{
+  for (int p = 0; p <= CUBIC_PHASES; ++p) {
+    double f = (double)p / (double)CUBIC_PHASES;
+    int32_t sum = 0;
+    for (int k = 0; k < 4; ++k) {
+      double w = _interpolation_cubic_h((double)(k - 1) - f, -0.75);
+      _cubic_weights[p][k] = fastround(w * (double)CUBIC_ONE);
+      sum += _cubic_weights[p][k];
+    }
+    // Make sure the weights add up exactly to one,
+    // so that flat areas are reproduced exactly
+    _cubic_weights[p][1 + (p >= CUBIC_PHASES / 2)] += CUBIC_ONE - sum;
+  }
+}
+
+// Separable bicubic interpolation: each of the 4 rows is first
+// reduced horizontally, then the 4 results are combined vertically;
+// channels are accumulated side by side so that the compiler can
+// process them as a single vector
 color_t_
 interpolation_cubic(
   const pixmap_t *image,
@@ -98,41 +160,79 @@ interpolation_cubic(
   assert(image != NULL);
   assert(pixmap_valid(*image) == true);
 
-  int floor_x = (int)(uvx);
-  int floor_y = (int)(uvy);
-
-  double x_vals[4] = {
-    (double)(floor_x - 1) - uvx, (double)(floor_x) - uvx,
-    (double)(floor_x + 1) - uvx, (double)(floor_x + 2) - uvx};
-
-  double y_vals[4] = {
-    (double)(floor_y - 1) - uvy, (double)(floor_y) - uvy,
-    (double)(floor_y + 1) - uvy, (double)(floor_y + 2) - uvy};
+  // The fractional parts index the weights, so must be in [0; 1[
+  uvx = _interpolation_clamp(uvx, image->width);
+  uvy = _interpolation_clamp(uvy, image->height);
+
+  int32_t floor_x = (int32_t)uvx;
+  int32_t floor_y = (int32_t)uvy;
+
+  const int32_t *wx =
+    _cubic_weights[(int32_t)((uvx - (double)floor_x) * CUBIC_PHASES + 0.5)];
+  const int32_t *wy =
+    _cubic_weights[(int32_t)((uvy - (double)floor_y) * CUBIC_PHASES + 0.5)];
+
+  // Tap coordinates, clamped only near the edges
+  int32_t xs[4], ys[4];
+  if ((floor_x >= 1) && (floor_x + 2 < image->width) &&
+      (floor_y >= 1) && (floor_y + 2 < image->height)) {
+    for (int k = 0; k < 4; ++k) {
+      xs[k] = floor_x + k - 1;
+      ys[k] = floor_y + k - 1;
+    }
+  } else {
+    for (int k = 0; k < 4; ++k) {
+      xs[k] = max(0, min(image->width - 1, floor_x + k - 1));
+      ys[k] = max(0, min(image->height - 1, floor_y + k - 1));
+    }
+  }
 
-  double r = 0.0, g = 0.0, b = 0.0, a = 0.0;
+  int32_t acc[4] = { 0 };
 
-  for (int i = 0; i < 4; ++i) {
-    for (int j = 0; j < 4; ++j) {
+  for (int j = 0; j < 4; ++j) {
 
-      double x_coeff = _interpolation_cubic_h(x_vals[i], -0.75);
-      double y_coeff = _interpolation_cubic_h(y_vals[j], -0.75);
+    const color_t_ *row = image->data + ys[j] * image->width;
+    int32_t racc[4] = { 0 };
 
-      color_t_ sample =
-        pixmap_at(*image,
-                  max(0, min(image->height - 1, (int)(uvy + y_vals[j]))),
-                  max(0, min(image->width - 1, (int)(uvx + x_vals[i]))));
+    for (int i = 0; i < 4; ++i) {
+      color_t_ sample = row[xs[i]];
+      const int32_t ch[4] = { sample.b, sample.g, sample.r, sample.a };
+      for (int k = 0; k < 4; ++k) {
+        racc[k] += wx[i] * ch[k];
+      }
+    }
 
-      r += (x_coeff * y_coeff * (double)sample.r);
-      g += (x_coeff * y_coeff * (double)sample.g);
-      b += (x_coeff * y_coeff * (double)sample.b);
-      a += (x_coeff * y_coeff * (double)sample.a);
+    for (int k = 0; k < 4; ++k) {
+      acc[k] += wy[j] * racc[k];
     }
   }
 
-  r = min(max(r, 0.0), 255.0);
-  g = min(max(g, 0.0), 255.0);
-  b = min(max(b, 0.0), 255.0);
-  a = min(max(a, 0.0), 255.0);
+  uint8_t ch[4];
+  for (int k = 0; k < 4; ++k) {
+    int32_t v = (acc[k] + (1 << (2 * CUBIC_BITS - 1))) >> (2 * CUBIC_BITS);
+    ch[k] = (uint8_t)max(0, min(255, v));
+  }
 
-  return color((uint8_t)a, (uint8_t)r, (uint8_t)g, (uint8_t)b);
+  return color(ch[3], ch[2], ch[1], ch[0]);
+}
+
+color_t_
+interpolation_sample(
+  const pixmap_t *image,
+  double uvx,
+  double uvy,
+  image_smoothing_t smoothing)
+{
+  assert(image != NULL);
+
+  switch (smoothing) {
+    case IMAGE_SMOOTHING_OFF:
+      return interpolation_nearest(image, uvx, uvy);
+    case IMAGE_SMOOTHING_LOW:
+      return interpolation_bilinear(image, uvx, uvy);
+    case IMAGE_SMOOTHING_MEDIUM:
+    case IMAGE_SMOOTHING_HIGH:
+    default:
+      return interpolation_cubic(image, uvx, uvy);
+  }
 }
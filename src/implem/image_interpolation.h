@@ -14,6 +14,23 @@
 #include "color.h"
 #include "pixmap.h"
 
+typedef enum image_smoothing_t {
+  IMAGE_SMOOTHING_OFF    = 0, // nearest neighbor
+  IMAGE_SMOOTHING_LOW    = 1, // bilinear
+  IMAGE_SMOOTHING_MEDIUM = 2, // bicubic
+  IMAGE_SMOOTHING_HIGH   = 3  // bicubic
+} image_smoothing_t;
+
+void
+interpolation_init(
+  void);
+
+color_t_
+interpolation_nearest(
+  const pixmap_t *image,
+  double uvx,
+  double uvy);
+
 color_t_
 interpolation_bilinear(
   const pixmap_t *image,
@@ -26,4 +43,11 @@ interpolation_cubic(
   double uvx,
   double uvy);
 
+color_t_
+interpolation_sample(
+  const pixmap_t *image,
+  double uvx,
+  double uvy,
+  image_smoothing_t smoothing);
+
 #endif /* __IMAGE_INTERPOLATION_H */
@@ -0,0 +1,295 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#include "hashtable.h"
+#include "mask_cache.h"
+
+#define MASK_CACHE_BUCKETS 251
+
+typedef struct mask_cache_entry_t mask_cache_entry_t;
+
+typedef struct mask_cache_entry_t {
+  mask_key_t key;
+  mask_t mask;
+  size_t size;
+  mask_cache_entry_t *prev; // more recently used
+  mask_cache_entry_t *next; // less recently used
+} mask_cache_entry_t;
+
+typedef struct mask_cache_t {
+  hashtable_t *entries;
+  mask_cache_entry_t *first; // most recently used
+  mask_cache_entry_t *last;  // least recently used
+  size_t budget;
+  mask_cache_stats_t stats;
+} mask_cache_t;
+
+static hash_t
+_mask_key_hash(
+  const mask_key_t *key)
+{
+  assert(key != NULL);
+
+  uint64_t h = key->stamp * 0x9E3779B97F4A7C15;
+  const double lin[6] = { key->a, key->b, key->c, key->d,
+                           key->tolerance, key->blur };
+  for (int i = 0; i < 6; ++i) {
+    uint64_t bits = 0;
+    memcpy(&bits, &lin[i], sizeof(double));
+    h = (h ^ bits) * 0x100000001B3;
+  }
+  h ^= (uint64_t)key->non_zero;
+  h ^= (uint64_t)(key->phase_x * MASK_SUBPIXEL_PHASES + key->phase_y) << 1;
+  return (hash_t)(h ^ (h >> 32));
+}
+
+static bool
+_mask_key_equal(
+  const mask_key_t *key1,
+  const mask_key_t *key2)
+{
+  assert(key1 != NULL);
+  assert(key2 != NULL);
+
+  return (key1->stamp == key2->stamp) &&
+    (key1->a == key2->a) && (key1->b == key2->b) &&
+    (key1->c == key2->c) && (key1->d == key2->d) &&
+    (key1->non_zero == key2->non_zero) &&
+    (key1->phase_x == key2->phase_x) &&
+    (key1->phase_y == key2->phase_y) &&
+    (key1->tolerance == key2->tolerance) &&
+    (key1->blur == key2->blur);
+}
+
+mask_cache_t *
+mask_cache_create(
+  size_t budget)
+{
+  mask_cache_t *mc = (mask_cache_t *)calloc(1, sizeof(mask_cache_t));
+  if (mc == NULL) {
+    return NULL;
+  }
+
+  mc->entries = ht_new((key_hash_fun_t *)_mask_key_hash,
+                       (key_equal_fun_t *)_mask_key_equal,
+                       MASK_CACHE_BUCKETS);
+  if (mc->entries == NULL) {
+    free(mc);
+    return NULL;
+  }
+
+  mc->first = NULL;
+  mc->last = NULL;
+  mc->budget = budget;
+
+  return mc;
+}
+
+void
+mask_cache_destroy(
+  mask_cache_t *mc)
+{
+  assert(mc != NULL);
+  assert(mc->entries != NULL);
+
+  mask_cache_clear(mc);
+  ht_delete(mc->entries);
+  free(mc);
+}
+
+static void
+_mask_cache_unlink(
+  mask_cache_t *mc,
+  mask_cache_entry_t *e)
+{
+  assert(mc != NULL);
+  assert(e != NULL);
+
+  if (e->prev != NULL) {
+    e->prev->next = e->next;
+  } else {
+    mc->first = e->next;
+  }
+  if (e->next != NULL) {
+    e->next->prev = e->prev;
+  } else {
+    mc->last = e->prev;
+  }
+  e->prev = NULL;
+  e->next = NULL;
+}
+
+static void
+_mask_cache_push_front(
+  mask_cache_t *mc,
+  mask_cache_entry_t *e)
+{
+  assert(mc != NULL);
+  assert(e != NULL);
+
+  e->prev = NULL;
+  e->next = mc->first;
+  if (mc->first != NULL) {
+    mc->first->prev = e;
+  } else {
+    mc->last = e;
+  }
+  mc->first = e;
+}
+
+static void
+_mask_cache_remove(
+  mask_cache_t *mc,
+  mask_cache_entry_t *e)
+{
+  assert(mc != NULL);
+  assert(e != NULL);
+
+  ht_remove(mc->entries, &e->key);
+  _mask_cache_unlink(mc, e);
+  mc->stats.entries--;
+  mc->stats.bytes -= e->size;
+  free(e->mask.data);
+  free(e);
+}
+
+// Drops the least recently used masks until the given
+// amount of memory is available within the budget
+static void
+_mask_cache_evict(
+  mask_cache_t *mc,
+  size_t needed)
+{
+  assert(mc != NULL);
+
+  while ((mc->last != NULL) && (mc->stats.bytes + needed > mc->budget)) {
+    _mask_cache_remove(mc, mc->last);
+    mc->stats.evictions++;
+  }
+}
+
+void
+mask_cache_clear(
+  mask_cache_t *mc)
+{
+  assert(mc != NULL);
+
+  while (mc->last != NULL) {
+    _mask_cache_remove(mc, mc->last);
+  }
+}
+
+size_t
+mask_cache_get_budget(
+  const mask_cache_t *mc)
+{
+  assert(mc != NULL);
+
+  return mc->budget;
+}
+
+void
+mask_cache_set_budget(
+  mask_cache_t *mc,
+  size_t budget)
+{
+  assert(mc != NULL);
+
+  mc->budget = budget;
+  _mask_cache_evict(mc, 0);
+}
+
+void
+mask_cache_get_stats(
+  const mask_cache_t *mc,
+  mask_cache_stats_t *stats)
+{
+  assert(mc != NULL);
+  assert(stats != NULL);
+
+  *stats = mc->stats;
+}
+
+// Looks up a mask, and marks it as the most recently used
+const mask_t *
+mask_cache_find(
+  mask_cache_t *mc,
+  const mask_key_t *key)
+{
+  assert(mc != NULL);
+  assert(key != NULL);
+
+  mask_cache_entry_t *e =
+    (mask_cache_entry_t *)ht_find(mc->entries, key);
+  if (e == NULL) {
+    mc->stats.misses++;
+    return NULL;
+  }
+
+  mc->stats.hits++;
+  if (e != mc->first) {
+    _mask_cache_unlink(mc, e);
+    _mask_cache_push_front(mc, e);
+  }
+
+  return &e->mask;
+}
+
+// Stores a mask, taking ownership of its data; returns NULL,
+// leaving the mask to the caller, if it does not fit in the budget
+const mask_t *
+mask_cache_add(
+  mask_cache_t *mc,
+  const mask_key_t *key,
+  mask_t mask)
+{
+  assert(mc != NULL);
+  assert(key != NULL);
+  assert(mask.data != NULL);
+
+  size_t size =
+    (size_t)mask.width * (size_t)mask.height + sizeof(mask_cache_entry_t);
+  if (size > mc->budget) {
+    return NULL;
+  }
+
+  mask_cache_entry_t *e =
+    (mask_cache_entry_t *)ht_find(mc->entries, key);
+  if (e != NULL) {
+    _mask_cache_remove(mc, e);
+  }
+
+  _mask_cache_evict(mc, size);
+
+  e = (mask_cache_entry_t *)calloc(1, sizeof(mask_cache_entry_t));
+  if (e == NULL) {
+    return NULL;
+  }
+
+  e->key = *key;
+  e->mask = mask;
+  e->size = size;
+
+  if (ht_add(mc->entries, &e->key, e) == false) {
+    free(e);
+    return NULL;
+  }
+  _mask_cache_push_front(mc, e);
+  mc->stats.entries++;
+  mc->stats.bytes += size;
+
+  return &e->mask;
+}
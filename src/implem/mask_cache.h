@@ -0,0 +1,100 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef __MASK_CACHE_H
+#define __MASK_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of cached subpixel positions along each axis
+#define MASK_SUBPIXEL_PHASES 4
+
+// Larger masks are rendered directly rather than cached
+#define MASK_MAX_SIZE 512
+
+#define MASK_CACHE_DEFAULT_BUDGET (4 * 1024 * 1024)
+
+// A8 coverage mask, whose top-left pixel lies at (x, y)
+// relative to the integer position the mask is drawn at
+typedef struct mask_t {
+  uint8_t *data;
+  int32_t width;
+  int32_t height;
+  int32_t x;
+  int32_t y;
+} mask_t;
+
+// A mask depends on the path contents, the linear part of
+// the transform, the fill rule, the subpixel phase and the
+// path tolerance; shadow masks are blurred coverage masks,
+// and also depend on the blur
+typedef struct mask_key_t {
+  uint64_t stamp;
+  double a;
+  double b;
+  double c;
+  double d;
+  bool non_zero;
+  int32_t phase_x;
+  int32_t phase_y;
+  double tolerance;
+  double blur; // 0.0 for coverage masks
+} mask_key_t;
+
+typedef struct mask_cache_stats_t {
+  int64_t hits;
+  int64_t misses;
+  int64_t evictions;
+  int32_t entries;
+  size_t bytes;
+} mask_cache_stats_t;
+
+typedef struct mask_cache_t mask_cache_t;
+
+mask_cache_t *
+mask_cache_create(
+  size_t budget);
+
+void
+mask_cache_destroy(
+  mask_cache_t *mc);
+
+void
+mask_cache_clear(
+  mask_cache_t *mc);
+
+size_t
+mask_cache_get_budget(
+  const mask_cache_t *mc);
+
+void
+mask_cache_set_budget(
+  mask_cache_t *mc,
+  size_t budget);
+
+void
+mask_cache_get_stats(
+  const mask_cache_t *mc,
+  mask_cache_stats_t *stats);
+
+const mask_t *
+mask_cache_find(
+  mask_cache_t *mc,
+  const mask_key_t *key);
+
+const mask_t *
+mask_cache_add(
+  mask_cache_t *mc,
+  const mask_key_t *key,
+  mask_t mask);
+
+#endif /* __MASK_CACHE_H */
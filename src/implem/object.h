@@ -26,6 +26,11 @@ typedef struct object_t {
 #define INHERITS_OBJECT                                                       \
   object_t base_object_t
 
+// True if more than one reference to the object is held,
+// in which case it must be copied before being modified
+#define object_is_shared(o)                                                   \
+  (((const object_t *)(o))->count > 1)
+
 #define DECLARE_OBJECT_METHODS(type,prefix)                                   \
 type * prefix##_retain(type *o);                                              \
 void prefix##_release(type *o);                                               \
@@ -14,6 +14,7 @@
 #include <assert.h>
 
 #include "util.h"
+#include "rect.h"
 #include "path.h"
 #include "path_internal.h"
 
@@ -279,6 +280,30 @@ path_get_nb_prims(
   return path->nb_prims;
 }
 
+// Computes the bounding box of the path control points,
+// which encloses the flattened path as well
+bool
+path_get_bounds(
+  const path_t *path,
+  rect_t *bbox) // out
+{
+  assert(path != NULL);
+  assert(path->points != NULL);
+  assert(bbox != NULL);
+
+  if (path->nb_points <= 0) {
+    *bbox = rect(point(0.0, 0.0), point(0.0, 0.0));
+    return false;
+  }
+
+  *bbox = rect(path->points[0], path->points[0]);
+  for (int32_t i = 1; i < path->nb_points; ++i) {
+    rect_expand(bbox, path->points[i]);
+  }
+
+  return true;
+}
+
 path_iterator_t *
 path_get_iterator(
   path_t *path)
@@ -15,6 +15,7 @@
 #include <stdbool.h>
 
 #include "point.h"
+#include "rect.h"
 
 typedef struct path_t path_t;
 typedef struct path_iterator_t path_iterator_t;
@@ -82,6 +83,11 @@ int32_t
 path_get_nb_prims(
   const path_t *path);
 
+bool
+path_get_bounds(
+  const path_t *path,
+  rect_t *bbox);
+
 path_iterator_t *
 path_get_iterator(
   path_t *path);
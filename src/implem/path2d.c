@@ -8,11 +8,17 @@
 /*                                                                        */
 /**************************************************************************/
 
+#include <stdlib.h>
 #include <stdbool.h>
+#include <math.h> // Note: on Win32, add #define _USE_MATH_DEFINES for M_PI
 #include <assert.h>
 
 #include "object.h"
+#include "rect.h"
 #include "path.h"
+#include "polygon.h"
+#include "polygon_internal.h"
+#include "polygonize.h"
 #include "transform.h"
 #include "arc.h"
 #include "path2d.h"
@@ -20,6 +26,58 @@
 
 IMPLEMENT_OBJECT_METHODS(path2d_t, path2d, _path2d_destroy)
 
+static uint64_t _path2d_next_stamp = 1;
+
+// Any change to the path makes the cached polygons stale
+static void
+_path2d_invalidate(
+  path2d_t *path2d)
+{
+  assert(path2d != NULL);
+
+  path2d->flat_valid = false;
+  path2d->outline_valid = false;
+  path2d->shape.type = PATH2D_SHAPE_NONE;
+  path2d->stamp = _path2d_next_stamp++;
+}
+
+// Remembers that the path consists of a single simple shape
+static void
+_path2d_set_shape(
+  path2d_t *path2d,
+  path2d_shape_type_t type,
+  double x,
+  double y,
+  double w,
+  double h,
+  const transform_t *t)
+{
+  assert(path2d != NULL);
+
+  path2d->shape.type = type;
+  path2d->shape.x = x;
+  path2d->shape.y = y;
+  path2d->shape.w = w;
+  path2d->shape.h = h;
+  if (t != NULL) {
+    path2d->shape.transform = *t;
+  } else {
+    path2d->shape.transform =
+      (transform_t){ .a = 1.0, .b = 0.0, .c = 0.0,
+                     .d = 1.0, .e = 0.0, .f = 0.0 };
+  }
+}
+
+// True if an arc from di to df covers the whole ellipse
+static bool
+_path2d_full_arc(
+  double di,
+  double df,
+  bool ccw)
+{
+  return (ccw == false) ? (df - di >= 2.0 * M_PI) : (di - df >= 2.0 * M_PI);
+}
+
 path2d_t *
 path2d_create(
   void)
@@ -31,10 +89,22 @@ path2d_create(
 
   path2d->path = path_create(12, 18);
   if (path2d->path == NULL) {
-    path_destroy(path2d->path);
+    free(path2d);
     return NULL;
   }
 
+  path2d->stamp = _path2d_next_stamp++;
+  path2d->shape.type = PATH2D_SHAPE_NONE;
+
+  path2d->flat = NULL;
+  path2d->flat_valid = false;
+
+  path2d->outline = NULL;
+  path2d->outline_valid = false;
+  path2d->outline_key = NULL;
+  path2d->outline_dash = NULL;
+  path2d->outline_dash_len = 0;
+
   return path2d;
 }
 
@@ -45,6 +115,8 @@ path2d_reset(
   assert(path2d != NULL);
   assert(path2d->path != NULL);
 
+  _path2d_invalidate(path2d);
+
   path_reset(path2d->path);
 }
 
@@ -79,6 +151,11 @@ path2d_close(
   assert(path2d != NULL);
   assert(path2d->path != NULL);
 
+  // Closing does not change the shape of the path
+  path2d_shape_t shape = path2d->shape;
+  _path2d_invalidate(path2d);
+  path2d->shape = shape;
+
   // Add a move to the first point before the close
   // This makes handling of primitives after close easier
   // TODO: this seems clumsy : if a transform is set before the close,
@@ -104,6 +181,8 @@ path2d_move_to(
   assert(path2d != NULL);
   assert(path2d->path != NULL);
 
+  _path2d_invalidate(path2d);
+
   point_t p = point(x, y);
   if (t != NULL) {
     transform_apply(t, &p);
@@ -124,6 +203,8 @@ path2d_line_to(
   assert(path2d != NULL);
   assert(path2d->path != NULL);
 
+  _path2d_invalidate(path2d);
+
   point_t p = point(x, y);
   if (t != NULL) {
     transform_apply(t, &p);
@@ -146,6 +227,8 @@ path2d_quadratic_curve_to(
   assert(path2d != NULL);
   assert(path2d->path != NULL);
 
+  _path2d_invalidate(path2d);
+
   point_t cp = point(cpx, cpy);
   point_t p = point(x, y);
 
@@ -173,6 +256,8 @@ path2d_bezier_curve_to(
   assert(path2d != NULL);
   assert(path2d->path != NULL);
 
+  _path2d_invalidate(path2d);
+
   point_t cp1 = point(cp1x, cp1y);
   point_t cp2 = point(cp2x, cp2y);
   point_t p = point(x, y);
@@ -201,11 +286,17 @@ path2d_rect(
   assert(path2d != NULL);
   assert(path2d->path != NULL);
 
+  bool was_empty = path_empty(path2d->path);
+
   path2d_move_to(path2d, x, y, t);
   path2d_line_to(path2d, x + width, y, t);
   path2d_line_to(path2d, x + width, y + height, t);
   path2d_line_to(path2d, x, y + height, t);
   path2d_close(path2d);
+
+  if (was_empty == true) {
+    _path2d_set_shape(path2d, PATH2D_SHAPE_RECT, x, y, width, height, t);
+  }
 }
 
 static void
@@ -244,9 +335,15 @@ path2d_arc(
   assert(path2d != NULL);
   assert(path2d->path != NULL);
 
+  bool was_empty = path_empty(path2d->path);
+
   double values[26];
   int nb_bezier = arc_to_bezier(values, x, y, r, r, di, df, ccw);
   _path2d_bezier_list(path2d, values, nb_bezier, t);
+
+  if ((was_empty == true) && (_path2d_full_arc(di, df, ccw) == true)) {
+    _path2d_set_shape(path2d, PATH2D_SHAPE_ELLIPSE, x, y, r, r, t);
+  }
 }
 
 void
@@ -310,10 +407,17 @@ path2d_ellipse(
   assert(path2d != NULL);
   assert(path2d->path != NULL);
 
+  bool was_empty = path_empty(path2d->path);
+
   double values[26];
   int nb_bezier = arc_to_bezier(values, x, y, rx, ry, di, df, ccw);
   _rotate_list(1 + nb_bezier * 3, values, -r);
   _path2d_bezier_list(path2d, values, nb_bezier, t);
+
+  if ((was_empty == true) && (r == 0.0) &&
+      (_path2d_full_arc(di, df, ccw) == true)) {
+    _path2d_set_shape(path2d, PATH2D_SHAPE_ELLIPSE, x, y, rx, ry, t);
+  }
 }
 
 bool
@@ -384,6 +488,228 @@ path2d_add(
   return true;
 }
 
+// Appends a copy of polygon src, translated by (tx, ty), to polygon dst
+static bool
+_path2d_append_polygon(
+  polygon_t *dst,
+  const polygon_t *src,
+  double tx,
+  double ty)
+{
+  assert(dst != NULL);
+  assert(src != NULL);
+
+  for (int32_t i = 0; i < src->nb_subpolys; ++i) {
+    int32_t j = (i == 0) ? 0 : src->subpolys[i - 1] + 1;
+    for (; j <= src->subpolys[i]; ++j) {
+      point_t pt = point(src->points[j].x + tx, src->points[j].y + ty);
+      if (polygon_add_point(dst, pt) == false) {
+        return false;
+      }
+    }
+    if (polygon_end_subpoly(dst, src->subpoly_closed[i]) == false) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Same as polygonize, but the flattened polygon is cached
+// until the path is modified
+bool
+path2d_polygonize(
+  path2d_t *path2d,
+  polygon_t *p, // out
+  rect_t *bbox) // out
+{
+  assert(path2d != NULL);
+  assert(path2d->path != NULL);
+  assert(p != NULL);
+  assert(bbox != NULL);
+
+  if (path2d->flat_valid == false) {
+    if (path2d->flat == NULL) {
+      path2d->flat = polygon_create(1024, 16);
+      if (path2d->flat == NULL) {
+        return false;
+      }
+    }
+    polygon_reset(path2d->flat);
+    if (polygonize(path2d->path, path2d->flat,
+                   &path2d->flat_bbox) == false) {
+      return false;
+    }
+    path2d->flat_valid = true;
+  }
+
+  *bbox = path2d->flat_bbox;
+
+  return _path2d_append_polygon(p, path2d->flat, 0.0, 0.0);
+}
+
+static bool
+_path2d_outline_key_match(
+  const path2d_t *path2d,
+  double w,
+  join_type_t join_type,
+  cap_type_t cap_type,
+  double miter_limit,
+  const transform_t *transform,
+  const double *dash,
+  int32_t dash_array_size,
+  double dash_offset,
+  double tolerance)
+{
+  assert(path2d != NULL);
+  assert(transform != NULL);
+
+  if ((path2d->outline_valid == false) ||
+      (path2d->outline_width != w) ||
+      (path2d->outline_join != join_type) ||
+      (path2d->outline_cap != cap_type) ||
+      (path2d->outline_miter_limit != miter_limit) ||
+      (path2d->outline_dash_len != dash_array_size) ||
+      (path2d->outline_dash_offset != dash_offset) ||
+      (path2d->outline_tolerance != tolerance)) {
+    return false;
+  }
+
+  double a1, b1, c1, d1, a2, b2, c2, d2;
+  transform_extract_ft(path2d->outline_key, &a1, &b1, &c1, &d1);
+  transform_extract_ft(transform, &a2, &b2, &c2, &d2);
+  if ((a1 != a2) || (b1 != b2) || (c1 != c2) || (d1 != d2)) {
+    return false;
+  }
+
+  for (int32_t i = 0; i < dash_array_size; ++i) {
+    if (path2d->outline_dash[i] != dash[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Same as polygonize_outline (with points transformed on the fly);
+// the outline is computed with the linear part of the transform only,
+// and cached until the path or any of the stroke parameters changes,
+// as the translation can be applied when copying it out
+bool
+path2d_polygonize_outline(
+  path2d_t *path2d,
+  double w,
+  polygon_t *p, // out
+  rect_t *bbox, // out
+  join_type_t join_type,
+  cap_type_t cap_type,
+  double miter_limit,
+  const transform_t *transform,
+  const double *dash,
+  int32_t dash_array_size,
+  double dash_offset,
+  double tolerance)
+{
+  assert(path2d != NULL);
+  assert(path2d->path != NULL);
+  assert(w > 0.0);
+  assert(p != NULL);
+  assert(bbox != NULL);
+  assert(transform != NULL);
+  assert(dash_array_size == 0 || dash != NULL);
+
+  if (_path2d_outline_key_match(path2d, w, join_type, cap_type, miter_limit,
+                                transform, dash, dash_array_size,
+                                dash_offset, tolerance) == false) {
+
+    path2d->outline_valid = false;
+
+    if (path2d->outline == NULL) {
+      path2d->outline = polygon_create(1024, 16);
+      if (path2d->outline == NULL) {
+        return false;
+      }
+    }
+    polygon_reset(path2d->outline);
+
+    if (path2d->outline_dash_len != dash_array_size) {
+      double *outline_dash = NULL;
+      if (dash_array_size > 0) {
+        outline_dash = (double *)calloc(dash_array_size, sizeof(double));
+        if (outline_dash == NULL) {
+          return false;
+        }
+      }
+      if (path2d->outline_dash != NULL) {
+        free(path2d->outline_dash);
+      }
+      path2d->outline_dash = outline_dash;
+      path2d->outline_dash_len = dash_array_size;
+    }
+    for (int32_t i = 0; i < dash_array_size; ++i) {
+      path2d->outline_dash[i] = dash[i];
+    }
+
+    if (path2d->outline_key != NULL) {
+      transform_destroy(path2d->outline_key);
+    }
+    path2d->outline_key = transform_extract_linear(transform);
+    if (path2d->outline_key == NULL) {
+      return false;
+    }
+
+    if (polygonize_outline(path2d->path, w, path2d->outline,
+                           &path2d->outline_bbox, join_type, cap_type,
+                           miter_limit, path2d->outline_key, false,
+                           dash, dash_array_size, dash_offset,
+                           tolerance) == false) {
+      return false;
+    }
+
+    path2d->outline_width = w;
+    path2d->outline_join = join_type;
+    path2d->outline_cap = cap_type;
+    path2d->outline_miter_limit = miter_limit;
+    path2d->outline_dash_offset = dash_offset;
+    path2d->outline_tolerance = tolerance;
+    path2d->outline_valid = true;
+  }
+
+  double tx, ty;
+  transform_extract_translation(transform, &tx, &ty);
+
+  *bbox = rect(point(path2d->outline_bbox.p1.x + tx,
+                     path2d->outline_bbox.p1.y + ty),
+               point(path2d->outline_bbox.p2.x + tx,
+                     path2d->outline_bbox.p2.y + ty));
+
+  return _path2d_append_polygon(p, path2d->outline, tx, ty);
+}
+
+// Identifies the current contents of the path, for caching purposes
+uint64_t
+path2d_get_stamp(
+  const path2d_t *path2d)
+{
+  assert(path2d != NULL);
+
+  return path2d->stamp;
+}
+
+// Tells whether the path consists of a single simple shape
+bool
+path2d_get_shape(
+  const path2d_t *path2d,
+  path2d_shape_t *shape) // out
+{
+  assert(path2d != NULL);
+  assert(shape != NULL);
+
+  *shape = path2d->shape;
+
+  return path2d->shape.type != PATH2D_SHAPE_NONE;
+}
+
 path_t *
 path2d_get_path(
   path2d_t *path2d)
@@ -416,6 +742,18 @@ _path2d_destroy(
   if (path2d->path != NULL) {
     path_destroy(path2d->path);
   }
+  if (path2d->flat != NULL) {
+    polygon_destroy(path2d->flat);
+  }
+  if (path2d->outline != NULL) {
+    polygon_destroy(path2d->outline);
+  }
+  if (path2d->outline_key != NULL) {
+    transform_destroy(path2d->outline_key);
+  }
+  if (path2d->outline_dash != NULL) {
+    free(path2d->outline_dash);
+  }
 
   free(path2d);
 }
@@ -11,12 +11,37 @@
 #ifndef __PATH2D_H
 #define __PATH2D_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "object.h"
+#include "rect.h"
 #include "path.h"
+#include "polygon.h"
+#include "polygonize.h"
 #include "transform.h"
 
 typedef struct path2d_t path2d_t;
 
+typedef enum path2d_shape_type_t {
+  PATH2D_SHAPE_NONE    = 0,
+  PATH2D_SHAPE_RECT    = 1,
+  PATH2D_SHAPE_ELLIPSE = 2
+} path2d_shape_type_t;
+
+// A path made of a single simple primitive; for a rectangle,
+// (x, y) is a corner and (w, h) its size, for an ellipse,
+// (x, y) is the center and (w, h) the radii; the transform
+// is the one that was used when the primitive was added
+typedef struct path2d_shape_t {
+  path2d_shape_type_t type;
+  double x;
+  double y;
+  double w;
+  double h;
+  transform_t transform;
+} path2d_shape_t;
+
 DECLARE_OBJECT_METHODS(path2d_t, path2d)
 
 path2d_t *
@@ -114,6 +139,36 @@ path2d_add(
   const path2d_t *spath2d,
   const transform_t *t);
 
+bool
+path2d_polygonize(
+  path2d_t *path2d,
+  polygon_t *p,
+  rect_t *bbox);
+
+bool
+path2d_polygonize_outline(
+  path2d_t *path2d,
+  double w,
+  polygon_t *p,
+  rect_t *bbox,
+  join_type_t join_type,
+  cap_type_t cap_type,
+  double miter_limit,
+  const transform_t *transform,
+  const double *dash,
+  int32_t dash_array_size,
+  double dash_offset,
+  double tolerance);
+
+uint64_t
+path2d_get_stamp(
+  const path2d_t *path2d);
+
+bool
+path2d_get_shape(
+  const path2d_t *path2d,
+  path2d_shape_t *shape);
+
 path_t *
 path2d_get_path(
   path2d_t *path2d);
@@ -11,8 +11,15 @@
 #ifndef __PATH2D_INTERNAL_H
 #define __PATH2D_INTERNAL_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "object.h"
+#include "rect.h"
 #include "path.h"
+#include "polygon.h"
+#include "polygonize.h"
+#include "path2d.h"
 
 typedef struct path2d_t {
   INHERITS_OBJECT;
@@ -23,6 +30,29 @@ typedef struct path2d_t {
   double first_y;  /* First untransformed point */
   double last_x;   /* Last untransformed point */
   double last_y;   /* Last untransformed point */
+  uint64_t stamp;  /* Unique for each path contents */
+
+  /* Set when the path is a single rectangle or full ellipse */
+  path2d_shape_t shape;
+
+  /* Flattened path, untransformed */
+  polygon_t *flat;
+  rect_t flat_bbox;
+  bool flat_valid;
+
+  /* Outline, transformed by the linear part of outline_key */
+  polygon_t *outline;
+  rect_t outline_bbox;
+  bool outline_valid;
+  transform_t *outline_key;
+  double outline_width;
+  join_type_t outline_join;
+  cap_type_t outline_cap;
+  double outline_miter_limit;
+  double *outline_dash;
+  int32_t outline_dash_len;
+  double outline_dash_offset;
+  double outline_tolerance;
 } path2d_t;
 
 #endif /* __PATH2D_INTERNAL_H */
@@ -10,6 +10,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <math.h>
 #include <assert.h>
 
 #include "object.h"
@@ -33,6 +34,8 @@ pattern_create(
   }
 
   p->repeat = repeat;
+  p->mips = NULL;
+  p->nb_mips = 0;
   p->image = pixmap_copy(*image);
   if (pixmap_valid(p->image) == false) {
     free(p);
@@ -42,41 +45,119 @@ pattern_create(
   return p;
 }
 
+// Builds the mipmap chain up to the given level if needed,
+// and returns the highest level available below it
+static int32_t
+_pattern_ensure_level(
+  pattern_t *pattern,
+  int32_t level)
+{
+  assert(pattern != NULL);
+
+  if (level <= pattern->nb_mips) {
+    return level;
+  }
+
+  // The chain is complete once it reaches a single texel
+  const pixmap_t *top = (pattern->nb_mips == 0) ?
+    &pattern->image : &pattern->mips[pattern->nb_mips - 1];
+  if ((top->width == 1) && (top->height == 1)) {
+    return pattern->nb_mips;
+  }
+
+  pixmap_t *mips =
+    (pixmap_t *)realloc(pattern->mips, level * sizeof(pixmap_t));
+  if (mips == NULL) {
+    return pattern->nb_mips;
+  }
+  pattern->mips = mips;
+
+  while (pattern->nb_mips < level) {
+    const pixmap_t *prev = (pattern->nb_mips == 0) ?
+      &pattern->image : &pattern->mips[pattern->nb_mips - 1];
+    if ((prev->width == 1) && (prev->height == 1)) {
+      break;
+    }
+    pixmap_t next = pixmap_halve(prev);
+    if (pixmap_valid(next) == false) {
+      break;
+    }
+    pattern->mips[pattern->nb_mips++] = next;
+  }
+
+  return pattern->nb_mips;
+}
+
+// Selects the mipmap level whose texels are about the size of a
+// pixel, as sampling a larger image at single points would alias
+int32_t
+pattern_select_level(
+  pattern_t *pattern,
+  const transform_t *inverse)
+{
+  assert(pattern != NULL);
+  assert(inverse != NULL);
+
+  double s = transform_get_max_scale(inverse);
+  if ((s < 2.0) || (isfinite(s) == false)) {
+    return 0;
+  }
+
+  return _pattern_ensure_level(pattern, min((int32_t)log2(s), 30));
+}
+
 color_t_
 pattern_evaluate_pos(
   const pattern_t *pattern,
   double pos_x,
   double pos_y,
-  const transform_t *inverse)
+  const transform_t *inverse,
+  image_smoothing_t smoothing,
+  int32_t level)
 {
   assert(pattern != NULL);
   assert(inverse != NULL);
+  assert((level >= 0) && (level <= pattern->nb_mips));
+
+  const pixmap_t *image =
+    (level == 0) ? &pattern->image : &pattern->mips[level - 1];
+
+  // Wrap or clamp in level 0 texel space: mips are rounded up to
+  // whole texels, so wrapping on them would change the period of
+  // patterns whose size is not a power of two
+  int32_t width = pattern->image.width;
+  int32_t height = pattern->image.height;
 
   point_t p = point(pos_x, pos_y);
   transform_apply(inverse, &p);
 
   switch (pattern->repeat) {
     case PATTERN_NO_REPEAT:
-      p.x = min(max(p.x, 0), pattern->image.width - 1);
-      p.y = min(max(p.y, 0), pattern->image.height - 1);
+      p.x = min(max(p.x, 0), width - 1);
+      p.y = min(max(p.y, 0), height - 1);
       break;
     case PATTERN_REPEAT_X:
-      p.x -= pattern->image.width * floor(p.x / pattern->image.width);
-      p.y = min(max(p.y, 0), pattern->image.height - 1);
+      p.x -= width * floor(p.x / width);
+      p.y = min(max(p.y, 0), height - 1);
       break;
     case PATTERN_REPEAT_Y:
-      p.x = min(max(p.x, 0), pattern->image.width - 1);
-      p.y -= pattern->image.height * floor(p.y / pattern->image.height);
+      p.x = min(max(p.x, 0), width - 1);
+      p.y -= height * floor(p.y / height);
       break;
     case PATTERN_REPEAT_XY:
-      p.x -= pattern->image.width * floor(p.x / pattern->image.width);
-      p.y -= pattern->image.height * floor(p.y / pattern->image.height);
+      p.x -= width * floor(p.x / width);
+      p.y -= height * floor(p.y / height);
       break;
     default:
       break;
   }
 
-  return interpolation_cubic(&pattern->image, p.x, p.y);
+  if (level > 0) {
+    p.x = ldexp(p.x, -level);
+    p.y = ldexp(p.y, -level);
+  }
+
+  return interpolation_sample(image, p.x, p.y, smoothing);
 }
 
 static void (*_pattern_destroy_callback)(pattern_t *) = NULL;
@@ -98,6 +179,12 @@ _pattern_destroy(
     _pattern_destroy_callback(pattern);
   }
 
+  for (int32_t i = 0; i < pattern->nb_mips; ++i) {
+    pixmap_destroy(pattern->mips[i]);
+  }
+  if (pattern->mips != NULL) {
+    free(pattern->mips);
+  }
   pixmap_destroy(pattern->image);
 
   free(pattern);
@@ -14,6 +14,7 @@
 #include "object.h"
 #include "pixmap.h"
 #include "transform.h"
+#include "image_interpolation.h"
 
 typedef struct pattern_t pattern_t;
 
@@ -36,6 +37,13 @@ pattern_evaluate_pos(
   const pattern_t *pattern,
   double pos_x,
   double pos_y,
+  const transform_t *inverse,
+  image_smoothing_t smoothing,
+  int32_t level);
+
+int32_t
+pattern_select_level(
+  pattern_t *pattern,
   const transform_t *inverse);
 
 void
@@ -19,6 +19,8 @@ typedef struct pattern_t {
   INHERITS_OBJECT;
   pattern_repeat_t repeat;
   pixmap_t image;
+  pixmap_t *mips; // successive halvings of image, built on demand
+  int32_t nb_mips;
 } pattern_t;
 
 #endif /* __PATTERN_INTERNAL_H */
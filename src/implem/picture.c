@@ -0,0 +1,125 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "util.h"
+#include "object.h"
+#include "polygon.h"
+#include "draw_style.h"
+#include "clip_path.h"
+#include "picture.h"
+
+IMPLEMENT_OBJECT_METHODS(picture_t, picture, _picture_destroy)
+
+picture_t *
+picture_create(
+  void)
+{
+  picture_t *pic = picture_alloc();
+  if (pic == NULL) {
+    return NULL;
+  }
+
+  pic->instrs = NULL;
+  pic->nb_instrs = 0;
+  pic->max_instrs = 0;
+
+  return pic;
+}
+
+// Appends a copy of the instruction to the picture; the polygon
+// is copied, and the draw style and clip path are retained
+bool
+picture_add(
+  picture_t *pic,
+  const picture_instr_t *instr)
+{
+  assert(pic != NULL);
+  assert(instr != NULL);
+  assert(instr->poly != NULL);
+
+  if (pic->nb_instrs >= pic->max_instrs) {
+    int32_t max_instrs = max(16, pic->max_instrs + pic->max_instrs / 2);
+    picture_instr_t *instrs =
+      (picture_instr_t *)realloc(pic->instrs,
+                                 max_instrs * sizeof(picture_instr_t));
+    if (instrs == NULL) {
+      return false;
+    }
+    pic->instrs = instrs;
+    pic->max_instrs = max_instrs;
+  }
+
+  polygon_t *poly = polygon_copy(instr->poly);
+  if (poly == NULL) {
+    return false;
+  }
+
+  picture_instr_t *pi = &pic->instrs[pic->nb_instrs++];
+  *pi = *instr;
+  pi->poly = poly;
+  pi->style = draw_style_copy(&instr->style);
+  if (instr->clip_path != NULL) {
+    pi->clip_path = clip_path_retain(instr->clip_path);
+  }
+
+  return true;
+}
+
+// Releases the instructions of the picture, keeping their storage
+void
+picture_reset(
+  picture_t *pic)
+{
+  assert(pic != NULL);
+
+  for (int32_t i = 0; i < pic->nb_instrs; ++i) {
+    picture_instr_t *pi = &pic->instrs[i];
+    polygon_destroy(pi->poly);
+    draw_style_destroy(&pi->style);
+    if (pi->clip_path != NULL) {
+      clip_path_release(pi->clip_path);
+    }
+  }
+
+  pic->nb_instrs = 0;
+}
+
+static void (*_picture_destroy_callback)(picture_t *) = NULL;
+
+void
+picture_set_destroy_callback(
+  void (*callback_function)(picture_t *))
+{
+  _picture_destroy_callback = callback_function;
+}
+
+static void
+_picture_destroy(
+  picture_t *pic)
+{
+  assert(pic != NULL);
+
+  if (_picture_destroy_callback != NULL) {
+    _picture_destroy_callback(pic);
+  }
+
+  picture_reset(pic);
+
+  if (pic->instrs != NULL) {
+    free(pic->instrs);
+  }
+
+  free(pic);
+}
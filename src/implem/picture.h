@@ -0,0 +1,76 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef __PICTURE_H
+#define __PICTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "object.h"
+#include "rect.h"
+#include "transform.h"
+#include "polygon.h"
+#include "draw_style.h"
+#include "color_composition.h"
+#include "clip_path.h"
+#include "state.h"
+
+typedef enum picture_instr_type_t {
+  PICTURE_INSTR_POLYGON  = 0,
+  PICTURE_INSTR_HAIRLINE = 1
+} picture_instr_type_t;
+
+// A recorded drawing operation: the polygon is flattened and in
+// device space, and the draw style, its transform and the clip
+// path are those that were current when it was recorded
+typedef struct picture_instr_t {
+  picture_instr_type_t type;
+  polygon_t *poly;
+  rect_t bbox; // device space bounds of the polygon (polygons only)
+  draw_style_t style;
+  transform_t transform; // maps the draw style to device space
+  double global_alpha;
+  shadow_t shadow; // polygons only
+  composite_operation_t compose_op;
+  bool non_zero; // polygons only
+  double line_width; // device space width (hairlines only)
+  clip_path_t *clip_path; // NULL if not clipped
+} picture_instr_t;
+
+// A picture is a display list of recorded drawing operations,
+// that can be replayed onto any canvas
+typedef struct picture_t {
+  INHERITS_OBJECT;
+  picture_instr_t *instrs;
+  int32_t nb_instrs;
+  int32_t max_instrs;
+} picture_t;
+
+DECLARE_OBJECT_METHODS(picture_t, picture)
+
+picture_t *
+picture_create(
+  void);
+
+bool
+picture_add(
+  picture_t *pic,
+  const picture_instr_t *instr);
+
+void
+picture_reset(
+  picture_t *pic);
+
+void
+picture_set_destroy_callback(
+  void (*callback_function)(picture_t *));
+
+#endif /* __PICTURE_H */
@@ -9,6 +9,7 @@
 /**************************************************************************/
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <assert.h>
 
@@ -46,3 +47,384 @@ pixmap_blit(
     }
   }
 }
+
+// Copies an area of a pixmap to a new pixmap; the parts
+// of the area that lie outside the source are transparent
+pixmap_t
+pixmap_extract(
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t width,
+  int32_t height)
+{
+  assert(sp != NULL);
+  assert(pixmap_valid(*sp));
+  assert(width > 0);
+  assert(height > 0);
+
+  pixmap_t dp = pixmap_null();
+  if ((sx >= 0) && (sy >= 0) &&
+      (width <= sp->width - sx) && (height <= sp->height - sy)) {
+    dp = pixmap_uninit(width, height);
+  } else {
+    dp = pixmap(width, height, NULL);
+  }
+
+  if (pixmap_valid(dp) == true) {
+    pixmap_blit(&dp, 0, 0, sp, sx, sy, width, height);
+  }
+
+  return dp;
+}
+
+// Spreads the 4 channels of a pixel over 16-bit lanes,
+// so that they can be summed in a single operation
+static inline uint64_t
+_pixmap_expand(
+  color_t_ c)
+{
+  return
+    ((uint64_t)c.b) |
+    ((uint64_t)c.g << 16) |
+    ((uint64_t)c.r << 32) |
+    ((uint64_t)c.a << 48);
+}
+
+static inline color_t_
+_pixmap_pack(
+  uint64_t v)
+{
+  return color((v >> 48) & 0xFF, (v >> 32) & 0xFF,
+               (v >> 16) & 0xFF, v & 0xFF);
+}
+
+// Downscales a pixmap by a factor of two, averaging blocks of
+// 2x2 pixels (the last row or column is repeated for odd sizes)
+pixmap_t
+pixmap_halve(
+  const pixmap_t *sp)
+{
+  assert(sp != NULL);
+  assert(pixmap_valid(*sp));
+
+  int32_t width = (sp->width + 1) / 2;
+  int32_t height = (sp->height + 1) / 2;
+
+  pixmap_t dp = pixmap_uninit(width, height);
+  if (pixmap_valid(dp) == false) {
+    return dp;
+  }
+
+  for (int32_t i = 0; i < height; ++i) {
+    const color_t_ *r1 = &pixmap_at(*sp, 2 * i, 0);
+    const color_t_ *r2 = &pixmap_at(*sp, min(2 * i + 1, sp->height - 1), 0);
+    color_t_ *d = &pixmap_at(dp, i, 0);
+    for (int32_t j = 0; j < width; ++j) {
+      int32_t j1 = 2 * j;
+      int32_t j2 = min(2 * j + 1, sp->width - 1);
+      uint64_t sum =
+        _pixmap_expand(r1[j1]) + _pixmap_expand(r1[j2]) +
+        _pixmap_expand(r2[j1]) + _pixmap_expand(r2[j2]) +
+        0x0002000200020002;
+      d[j] = _pixmap_pack(sum >> 2);
+    }
+  }
+
+  return dp;
+}
+
+// Maps the destination columns [x0; x1[ of a scaled row to
+// source columns, sampling at pixel centers
+static void
+_pixmap_scale_nearest_row(
+  color_t_ *d,
+  const color_t_ *s,
+  const int32_t *map,
+  int32_t n)
+{
+  assert(d != NULL);
+  assert(s != NULL);
+  assert(map != NULL);
+
+  for (int32_t k = 0; k < n; ++k) {
+    d[k] = s[map[k]];
+  }
+}
+
+// Bilinear interpolation of a source row at the given positions,
+// with 8 bits of fraction; the result is kept in 16-bit lanes
+static void
+_pixmap_scale_bilinear_row(
+  uint64_t *d,
+  const color_t_ *s,
+  const int32_t *map,
+  const int32_t *frac,
+  int32_t sw,
+  int32_t n)
+{
+  assert(d != NULL);
+  assert(s != NULL);
+  assert(map != NULL);
+  assert(frac != NULL);
+
+  for (int32_t k = 0; k < n; ++k) {
+    int32_t i = map[k];
+    uint64_t f = (uint64_t)frac[k];
+    d[k] = _pixmap_expand(s[i]) * (256 - f) +
+           _pixmap_expand(s[min(i + 1, sw - 1)]) * f;
+  }
+}
+
+static pixmap_t
+_pixmap_scale_nearest(
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  int32_t dw,
+  int32_t dh,
+  int32_t x0,
+  int32_t y0,
+  int32_t x1,
+  int32_t y1)
+{
+  int32_t w = x1 - x0;
+  int32_t h = y1 - y0;
+
+  pixmap_t dp = pixmap_uninit(w, h);
+  int32_t *map = (int32_t *)calloc(w, sizeof(int32_t));
+  if ((pixmap_valid(dp) == false) || (map == NULL)) {
+    pixmap_destroy(dp);
+    free(map);
+    return pixmap_null();
+  }
+
+  for (int32_t x = x0; x < x1; ++x) {
+    map[x - x0] = sx + (int32_t)(((2 * (int64_t)x + 1) * sw) / (2 * dw));
+  }
+
+  // Consecutive rows that map to the same source row are
+  // duplicated, which makes integer upscaling a plain copy
+  int32_t prev = -1;
+  for (int32_t y = y0; y < y1; ++y) {
+    int32_t j = sy + (int32_t)(((2 * (int64_t)y + 1) * sh) / (2 * dh));
+    color_t_ *d = &pixmap_at(dp, y - y0, 0);
+    if (j == prev) {
+      memcpy(d, d - w, w * COLOR_SIZE);
+    } else {
+      _pixmap_scale_nearest_row(d, &pixmap_at(*sp, j, 0), map, w);
+    }
+    prev = j;
+  }
+
+  free(map);
+
+  return dp;
+}
+
+static pixmap_t
+_pixmap_scale_bilinear(
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  int32_t dw,
+  int32_t dh,
+  int32_t x0,
+  int32_t y0,
+  int32_t x1,
+  int32_t y1)
+{
+  int32_t w = x1 - x0;
+  int32_t h = y1 - y0;
+
+  pixmap_t dp = pixmap_uninit(w, h);
+  int32_t *map = (int32_t *)calloc(w, sizeof(int32_t));
+  int32_t *frac = (int32_t *)calloc(w, sizeof(int32_t));
+  uint64_t *rows = (uint64_t *)calloc(2 * w, sizeof(uint64_t));
+  if ((pixmap_valid(dp) == false) ||
+      (map == NULL) || (frac == NULL) || (rows == NULL)) {
+    pixmap_destroy(dp);
+    free(map);
+    free(frac);
+    free(rows);
+    return pixmap_null();
+  }
+
+  // Source positions of destination pixel centers, in 1/256th
+  // of a pixel, clamped to the edges of the source rectangle
+  for (int32_t x = x0; x < x1; ++x) {
+    int64_t u = (((2 * (int64_t)x + 1) * sw - dw) * 128) / dw;
+    u = max(0, min(u, ((int64_t)sw - 1) * 256));
+    map[x - x0] = (int32_t)(u >> 8);
+    frac[x - x0] = (int32_t)(u & 0xFF);
+  }
+
+  // The two horizontally interpolated source rows are kept
+  // from one destination row to the next when possible
+  uint64_t *r1 = rows;
+  uint64_t *r2 = rows + w;
+  int32_t j1 = -1;
+  int32_t j2 = -1;
+
+  for (int32_t y = y0; y < y1; ++y) {
+    int64_t v = (((2 * (int64_t)y + 1) * sh - dh) * 128) / dh;
+    v = max(0, min(v, ((int64_t)sh - 1) * 256));
+    int32_t j = (int32_t)(v >> 8);
+    uint64_t g = (uint64_t)(v & 0xFF);
+
+    if (j != j1) {
+      if (j == j2) {
+        uint64_t *t = r1; r1 = r2; r2 = t;
+      } else {
+        _pixmap_scale_bilinear_row(r1, &pixmap_at(*sp, sy + j, sx),
+                                   map, frac, sw, w);
+      }
+      j1 = j;
+      j2 = min(j + 1, sh - 1);
+      if (j2 != j1) {
+        _pixmap_scale_bilinear_row(r2, &pixmap_at(*sp, sy + j2, sx),
+                                   map, frac, sw, w);
+      } else {
+        memcpy(r2, r1, w * sizeof(uint64_t));
+      }
+    }
+
+    // Lanes are split in pairs so that the vertical
+    // weights do not overflow into the next channel
+    color_t_ *d = &pixmap_at(dp, y - y0, 0);
+    const uint64_t m = 0x0000FFFF0000FFFF;
+    for (int32_t k = 0; k < w; ++k) {
+      uint64_t lo =
+        ((r1[k] & m) * (256 - g) + (r2[k] & m) * g + 0x0000800000008000);
+      uint64_t hi =
+        (((r1[k] >> 16) & m) * (256 - g) + ((r2[k] >> 16) & m) * g +
+         0x0000800000008000);
+      d[k] = color((hi >> 48) & 0xFF, (lo >> 48) & 0xFF,
+                   (hi >> 16) & 0xFF, (lo >> 16) & 0xFF);
+    }
+  }
+
+  free(map);
+  free(frac);
+  free(rows);
+
+  return dp;
+}
+
+static pixmap_t
+_pixmap_scale_area(
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  int32_t dw,
+  int32_t dh,
+  int32_t x0,
+  int32_t y0,
+  int32_t x1,
+  int32_t y1)
+{
+  int32_t w = x1 - x0;
+  int32_t h = y1 - y0;
+
+  pixmap_t dp = pixmap_uninit(w, h);
+  uint32_t *hacc = (uint32_t *)calloc(4 * w, sizeof(uint32_t));
+  uint64_t *vacc = (uint64_t *)calloc(4 * w, sizeof(uint64_t));
+  if ((pixmap_valid(dp) == false) || (hacc == NULL) || (vacc == NULL)) {
+    pixmap_destroy(dp);
+    free(hacc);
+    free(vacc);
+    return pixmap_null();
+  }
+
+  // Destination pixel x covers [x * sw; (x + 1) * sw[ and source
+  // pixel i covers [i * dw; (i + 1) * dw[, in units of 1/dw of a
+  // source pixel, so that overlaps are exact integer weights
+  uint64_t total = (uint64_t)sw * (uint64_t)sh;
+
+  for (int32_t y = y0; y < y1; ++y) {
+
+    memset(vacc, 0, 4 * w * sizeof(uint64_t));
+
+    int64_t ty1 = (int64_t)y * sh;
+    int64_t ty2 = ty1 + sh;
+    for (int32_t j = (int32_t)(ty1 / dh); (int64_t)j * dh < ty2; ++j) {
+      uint64_t wy = (uint64_t)(min(((int64_t)j + 1) * dh, ty2) -
+                               max((int64_t)j * dh, ty1));
+      const color_t_ *s = &pixmap_at(*sp, sy + j, sx);
+
+      for (int32_t x = x0; x < x1; ++x) {
+        int64_t tx1 = (int64_t)x * sw;
+        int64_t tx2 = tx1 + sw;
+        uint32_t b = 0, g = 0, r = 0, a = 0;
+        for (int32_t i = (int32_t)(tx1 / dw); (int64_t)i * dw < tx2; ++i) {
+          uint32_t wx = (uint32_t)(min(((int64_t)i + 1) * dw, tx2) -
+                                   max((int64_t)i * dw, tx1));
+          b += wx * s[i].b;
+          g += wx * s[i].g;
+          r += wx * s[i].r;
+          a += wx * s[i].a;
+        }
+        uint32_t *ha = &hacc[4 * (x - x0)];
+        ha[0] = b; ha[1] = g; ha[2] = r; ha[3] = a;
+      }
+
+      for (int32_t k = 0; k < 4 * w; ++k) {
+        vacc[k] += wy * hacc[k];
+      }
+    }
+
+    color_t_ *d = &pixmap_at(dp, y - y0, 0);
+    for (int32_t k = 0; k < w; ++k) {
+      const uint64_t *va = &vacc[4 * k];
+      d[k] = color((va[3] + total / 2) / total, (va[2] + total / 2) / total,
+                   (va[1] + total / 2) / total, (va[0] + total / 2) / total);
+    }
+  }
+
+  free(hacc);
+  free(vacc);
+
+  return dp;
+}
+
+// Scales the source rectangle (sx, sy, sw, sh) to a dw x dh image,
+// and returns the part of it that lies in [x0; x1[ x [y0; y1[;
+// smooth scaling uses bilinear interpolation when magnifying
+// and area averaging when minifying in both directions
+pixmap_t
+pixmap_scale(
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  int32_t dw,
+  int32_t dh,
+  int32_t x0,
+  int32_t y0,
+  int32_t x1,
+  int32_t y1,
+  bool smooth)
+{
+  assert(sp != NULL);
+  assert(pixmap_valid(*sp));
+  assert((sx >= 0) && (sw > 0) && (sx + sw <= sp->width));
+  assert((sy >= 0) && (sh > 0) && (sy + sh <= sp->height));
+  assert((dw > 0) && (dh > 0));
+  assert((0 <= x0) && (x0 < x1) && (x1 <= dw));
+  assert((0 <= y0) && (y0 < y1) && (y1 <= dh));
+
+  if (smooth == false) {
+    return _pixmap_scale_nearest(sp, sx, sy, sw, sh, dw, dh, x0, y0, x1, y1);
+  } else if ((dw <= sw) && (dh <= sh)) {
+    return _pixmap_scale_area(sp, sx, sy, sw, sh, dw, dh, x0, y0, x1, y1);
+  } else {
+    return _pixmap_scale_bilinear(sp, sx, sy, sw, sh, dw, dh, x0, y0, x1, y1);
+  }
+}
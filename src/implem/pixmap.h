@@ -13,10 +13,12 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 
 #include "util.h"
 #include "color.h"
+#include "buffer_pool.h"
 
 typedef struct pixmap_t {
   color_t_ *data;
@@ -27,15 +29,25 @@ typedef struct pixmap_t {
 #define pixmap_null() \
   ((pixmap_t){ .data = NULL, .width = 0, .height = 0 })
 
+#define pixmap_size(w,h) \
+  ((size_t)(w) * (size_t)(h) * COLOR_SIZE)
+
 #define pixmap(w,h,d) \
   ((pixmap_t){ .data = ((d) != NULL) ? (d) : \
-                        (color_t_ *)calloc((w) * (h), COLOR_SIZE), \
+                        (color_t_ *)buffer_pool_acquire(pixmap_size(w,h), \
+                                                        true), \
+               .width = (w), .height = (h) })
+
+// For pixmaps whose every pixel is written right away
+#define pixmap_uninit(w,h) \
+  ((pixmap_t){ .data = (color_t_ *)buffer_pool_acquire(pixmap_size(w,h), \
+                                                       false), \
                .width = (w), .height = (h) })
 
 #define pixmap_copy(p) \
   ((pixmap_t){ .data = ((p).data == NULL) ? NULL : \
-                        (color_t_ *)memdup((p).data, (p).width * \
-                                           (p).height * COLOR_SIZE), \
+                        (color_t_ *)buffer_pool_dup((p).data, \
+                                        pixmap_size((p).width, (p).height)), \
                .width = (p).width, .height = (p).height })
 
 #define pixmap_clear(p) \
@@ -44,7 +56,7 @@ typedef struct pixmap_t {
 #define pixmap_destroy(p) \
   do { \
     if ((p).data != NULL) { \
-      free((p).data); \
+      buffer_pool_release((p).data, pixmap_size((p).width, (p).height)); \
       (p).data = NULL; \
     } \
     (p).width = 0; \
@@ -68,4 +80,31 @@ pixmap_blit(
   int32_t width,
   int32_t height);
 
+pixmap_t
+pixmap_extract(
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t width,
+  int32_t height);
+
+pixmap_t
+pixmap_halve(
+  const pixmap_t *sp);
+
+pixmap_t
+pixmap_scale(
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  int32_t dw,
+  int32_t dh,
+  int32_t x0,
+  int32_t y0,
+  int32_t x1,
+  int32_t y1,
+  bool smooth);
+
 #endif /* __PIXMAP_H */
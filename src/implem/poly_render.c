@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 
@@ -28,7 +29,9 @@
 #include "polygon.h"
 #include "polygon_internal.h"
 #include "pixmap.h"
+#include "buffer_pool.h"
 #include "filters.h"
+#include "mask_cache.h"
 #include "state.h" // just shadow
 
 // Mask array
@@ -244,6 +247,24 @@ _calculate_coverage_even_odd(
 }
 
 
+// Accumulates packed 8-bit winding counters into 32-bit ones,
+// and resets the packed counters
+static void
+_flush_winding(
+  uint64_t lcnt[8],
+  int32_t winding[64])
+{
+  assert(lcnt != NULL);
+  assert(winding != NULL);
+
+  for (int l = 0; l < 8; ++l) {
+    for (int k = 0; k < 8; ++k) {
+      winding[l * 8 + k] += (int32_t)((lcnt[l] >> (k * 8)) & 0xFF) - 0x80;
+    }
+    lcnt[l] = 0x8080808080808080;
+  }
+}
+
 static int
 _calculate_coverage_non_zero(
   float y,
@@ -254,11 +275,6 @@ _calculate_coverage_non_zero(
   assert(x >= 0.0f);
   assert(y >= 0.0f);
 
-  // When too many points, fall back to even_odd
-  if (p->nb_points >= 128) {
-    return _calculate_coverage_even_odd(y, x, p);
-  }
-
   // 8-bit winding counters packed as 64-bit integers
   uint64_t lcnt[8] = {
     0x8080808080808080, 0x8080808080808080,
@@ -267,6 +283,12 @@ _calculate_coverage_non_zero(
     0x8080808080808080, 0x8080808080808080,
   };
 
+  // When there are too many edges, the packed counters could
+  // overflow, so they are periodically flushed to wider ones
+  int32_t winding[64] = { 0 };
+  bool flushed = false;
+  int32_t nb_edges = 0;
+
   int i = 0;
   for (int ip = 0; ip < p->nb_subpolys; ++ip) {
 
@@ -304,12 +326,26 @@ _calculate_coverage_non_zero(
         lcnt[6] -= map[(m & 0x00FF000000000000) >> 0x30];
         lcnt[7] -= map[(m & 0xFF00000000000000) >> 0x38];
       };
+
+      if (++nb_edges == 127) {
+        _flush_winding(lcnt, winding);
+        flushed = true;
+        nb_edges = 0;
+      }
     }
 
   }
 
   int bits = 0;
 
+  if (flushed == true) {
+    _flush_winding(lcnt, winding);
+    for (int l = 0; l < 64; ++l) {
+      bits += (winding[l] != 0);
+    }
+    return bits * 255 / 64;
+  }
+
   for (int l = 0; l < 8; ++l) {
     bits += (lcnt[l] & 0x00000000000000FF) != 0x0000000000000080;
     bits += (lcnt[l] & 0x000000000000FF00) != 0x0000000000008000;
@@ -385,14 +421,16 @@ _determine_base_color(
       color = gradient_evaluate_pos(draw_style->content.gradient, x, y, inv);
       break;
     case DRAW_STYLE_PATTERN:
-      color = pattern_evaluate_pos(draw_style->content.pattern, x, y, inv);
+      color = pattern_evaluate_pos(draw_style->content.pattern, x, y, inv,
+                                   draw_style->smoothing, draw_style->level);
       break;
     case DRAW_STYLE_PIXMAP: {
         point_t p = point(x, y);
         transform_apply(inv, &p);
         p.x = max(0, min(draw_style->content.pixmap->width - 1, p.x));
         p.y = max(0, min(draw_style->content.pixmap->height - 1, p.y));
-        color = interpolation_cubic(draw_style->content.pixmap, p.x, p.y);
+        color = interpolation_sample(draw_style->content.pixmap, p.x, p.y,
+                                     draw_style->smoothing);
         break;
       }
     default:
@@ -403,11 +441,133 @@ _determine_base_color(
   return color;
 }
 
+// When pixels map exactly onto texels, interpolation is useless;
+// the pattern level is otherwise left as selected by the caller
+static void
+_poly_render_select_smoothing(
+  draw_style_t *draw_style,
+  const transform_t *inv)
+{
+  assert(draw_style != NULL);
+  assert(inv != NULL);
+
+  if (transform_is_integer_translation(inv) == true) {
+    draw_style->smoothing = IMAGE_SMOOTHING_OFF;
+    draw_style->level = 0;
+  }
+}
+
+// Composes transparent black onto the pixels [k1; k2[ of the
+// destination (in row-major order), taking the clip region into
+// account; constant results are written in bulk
+static void
+_poly_render_compose_zero_span(
+  pixmap_t *pm,
+  int32_t k1,
+  int32_t k2,
+  comp_zero_action_t action,
+  color_t_ fill,
+  composite_operation_t composite_operation,
+  const pixmap_t *clip_region)
+{
+  assert(pm != NULL);
+  assert(pixmap_valid(*pm) == true);
+
+  if ((k1 >= k2) || (action == COMP_ZERO_KEEP)) {
+    return;
+  }
+
+  color_t_ *d = pm->data + k1;
+  int32_t n = k2 - k1;
+
+  if ((clip_region != NULL) && (pixmap_valid(*clip_region) == true)) {
+    assert(clip_region->width == pm->width);
+    assert(clip_region->height == pm->height);
+    const color_t_ *c = clip_region->data + k1;
+    for (int32_t k = 0; k < n; ++k) {
+      color_t_ res = (action == COMP_ZERO_FILL) ? fill :
+        comp_compose(color_transparent_black, d[k], 0, composite_operation);
+      d[k] = alpha_blend(255 - c[k].a, d[k], res);
+    }
+  } else if (action == COMP_ZERO_FILL) {
+    if (color_to_int(fill) == 0) {
+      memset(d, 0, n * COLOR_SIZE);
+    } else {
+      for (int32_t k = 0; k < n; ++k) {
+        d[k] = fill;
+      }
+    }
+  } else {
+    for (int32_t k = 0; k < n; ++k) {
+      d[k] = comp_compose(color_transparent_black, d[k],
+                          0, composite_operation);
+    }
+  }
+}
+
+// Applies a full screen composite operation to the part of the
+// destination that lies outside of the rectangle [x1; x2[ x [y1; y2[,
+// where the source is known to be transparent black
+static void
+_poly_render_compose_outside(
+  pixmap_t *pm,
+  int32_t x1,
+  int32_t y1,
+  int32_t x2,
+  int32_t y2,
+  composite_operation_t composite_operation,
+  const pixmap_t *clip_region)
+{
+  assert(pm != NULL);
+  assert(pixmap_valid(*pm) == true);
+
+  color_t_ fill = color_transparent_black;
+  comp_zero_action_t action =
+    comp_zero_source_action(composite_operation, &fill);
+  if (action == COMP_ZERO_KEEP) {
+    return;
+  }
+
+  int32_t w = pm->width;
+  int32_t h = pm->height;
+
+  x1 = min(max(x1, 0), w); x2 = min(max(x2, 0), w);
+  y1 = min(max(y1, 0), h); y2 = min(max(y2, 0), h);
+
+  // Empty rectangle (or entirely off the pixmap): everything is outside
+  if ((x1 >= x2) || (y1 >= y2)) {
+    _poly_render_compose_zero_span(pm, 0, h * w, action, fill,
+                                   composite_operation, clip_region);
+    return;
+  }
+
+  // Rows above and below the rectangle are contiguous
+  _poly_render_compose_zero_span(pm, 0, y1 * w, action, fill,
+                                 composite_operation, clip_region);
+  _poly_render_compose_zero_span(pm, y2 * w, h * w, action, fill,
+                                 composite_operation, clip_region);
+
+  // The right part of a row and the left part of the next one as well
+  if ((x1 == 0) && (x2 == w)) {
+    return;
+  }
+  _poly_render_compose_zero_span(pm, y1 * w, y1 * w + x1, action, fill,
+                                 composite_operation, clip_region);
+  for (int32_t i = y1; i < y2 - 1; ++i) {
+    _poly_render_compose_zero_span(pm, i * w + x2, (i + 1) * w + x1,
+                                   action, fill, composite_operation,
+                                   clip_region);
+  }
+  _poly_render_compose_zero_span(pm, (y2 - 1) * w + x2, y2 * w,
+                                 action, fill, composite_operation,
+                                 clip_region);
+}
+
 static pixmap_t
 _poly_render_pixmap(
   const polygon_t *p,
   const rect_t *bbox,
-  const draw_style_t draw_style,
+  draw_style_t draw_style,
   const transform_t *transform,
   bool non_zero)
 {
@@ -428,6 +588,7 @@ _poly_render_pixmap(
 
   transform_t *inverse = transform_copy(transform);
   transform_inverse(inverse);
+  _poly_render_select_smoothing(&draw_style, inverse);
 
   int32_t w = (int32_t)(bbox->p2.x - bbox->p1.x) + 1;
   int32_t h = (int32_t)(bbox->p2.y - bbox->p1.y) + 1;
@@ -486,6 +647,104 @@ _poly_render_pixmap(
   return pm;
 }
 
+// A blurred A8 copy of the shape alpha, in the shadow color,
+// whose top-left pixel lies at (x, y)
+typedef struct shadow_layer_t {
+  const uint8_t *data;
+  int32_t width;
+  int32_t height;
+  int32_t x;
+  int32_t y;
+  color_t_ color;
+} shadow_layer_t;
+
+// Composes the shadow layer, then the rendered shape (whose top-left
+// pixel lies at (bx, by)), in a single pass over the union of their
+// rectangles; either layer can be NULL
+static void
+_poly_render_compose_layers(
+  pixmap_t *pm,
+  const shadow_layer_t *sl,
+  const pixmap_t *rendered,
+  int32_t bx,
+  int32_t by,
+  composite_operation_t composite_operation,
+  double global_alpha,
+  const pixmap_t *clip_region)
+{
+  assert(pm != NULL);
+  assert(pixmap_valid(*pm) == true);
+  assert((sl == NULL) || (sl->data != NULL));
+  assert((rendered == NULL) || (pixmap_valid(*rendered) == true));
+
+  int32_t x1 = INT32_MAX, y1 = INT32_MAX, x2 = INT32_MIN, y2 = INT32_MIN;
+  if (sl != NULL) {
+    x1 = min(x1, sl->x); x2 = max(x2, sl->x + sl->width);
+    y1 = min(y1, sl->y); y2 = max(y2, sl->y + sl->height);
+  }
+  if (rendered != NULL) {
+    x1 = min(x1, bx); x2 = max(x2, bx + rendered->width);
+    y1 = min(y1, by); y2 = max(y2, by + rendered->height);
+  }
+  x1 = max(x1, 0); x2 = min(x2, pm->width);
+  y1 = max(y1, 0); y2 = min(y2, pm->height);
+
+  bool full_screen = comp_is_full_screen(composite_operation);
+  if (full_screen == true) {
+    _poly_render_compose_outside(pm, x1, y1, x2, y2,
+                                 composite_operation, clip_region);
+  }
+
+  bool clipped = (clip_region != NULL) && (pixmap_valid(*clip_region) == true);
+
+  for (int32_t i = y1; i < y2; ++i) {
+
+    bool shadow_row = (sl != NULL) && (i >= sl->y) && (i < sl->y + sl->height);
+    bool shape_row = (rendered != NULL) &&
+      (i >= by) && (i < by + rendered->height);
+    if ((shadow_row == false) && (shape_row == false)) {
+      continue;
+    }
+
+    color_t_ *d = pm->data + i * pm->width;
+    const color_t_ *c = clipped ? clip_region->data + i * pm->width : NULL;
+
+    for (int32_t j = x1; j < x2; ++j) {
+
+      if ((shadow_row == true) && (j >= sl->x) && (j < sl->x + sl->width)) {
+        int a = sl->data[(i - sl->y) * sl->width + (j - sl->x)];
+        if ((a != 0) || (full_screen == true)) {
+          color_t_ fill_color = sl->color;
+          fill_color.a = (uint8_t)a;
+          double draw_alpha = a;
+          if (c != NULL) {
+            draw_alpha *= 255 - c[j].a;
+            draw_alpha /= 255;
+          }
+          d[j] = comp_compose(fill_color, d[j],
+                              (int)(draw_alpha * sl->color.a *
+                                    global_alpha / 255),
+                              composite_operation);
+        }
+      }
+
+      if ((shape_row == true) && (j >= bx) && (j < bx + rendered->width)) {
+        color_t_ fill_color = pixmap_at(*rendered, i - by, j - bx);
+        if ((fill_color.a != 0) || (full_screen == true)) {
+          double draw_alpha = fill_color.a;
+          if (c != NULL) {
+            draw_alpha *= 255 - c[j].a;
+            draw_alpha /= 255;
+          }
+          d[j] = comp_compose(fill_color, d[j],
+                              (int)(draw_alpha * global_alpha),
+                              composite_operation);
+        }
+      }
+    }
+  }
+}
+
 static void
 _poly_render_layered(
   pixmap_t *pm,
@@ -512,130 +771,61 @@ _poly_render_layered(
 
   pixmap_t rendered_poly =
     _poly_render_pixmap(p, bbox, draw_style, transform, non_zero);
+  if (pixmap_valid(rendered_poly) == false) {
+    return;
+  }
 
-  // Compose shadows if any
-  if ((shadow->blur > 0.0 ||
-       shadow->offset_x != 0.0 || shadow->offset_y != 0.0) &&
-      composite_operation != COPY && shadow->color.a != 0) {
-
-    int shadow_size_offset =
-      (int)(sqrt(3.0 * shadow->blur * shadow->blur));
-
-    pixmap_t shadow_poly =
-      pixmap(rendered_poly.width + shadow_size_offset * 2,
-             rendered_poly.height + shadow_size_offset * 2, NULL);
-    for (int32_t i = 0; i < rendered_poly.width; i++) {
-      for (int32_t j = 0; j < rendered_poly.height; j++) {
-        pixmap_at(shadow_poly,
-                  j + shadow_size_offset,
-                  i + shadow_size_offset).a =
-          pixmap_at(rendered_poly, j, i).a;
-      }
-    }
-
-    pixmap_t blurred_shadow_poly;
-    if (shadow->blur == 0.0) {
-      blurred_shadow_poly = shadow_poly;
-    } else {
-      blurred_shadow_poly =
-        filter_gaussian_blur_alpha(&shadow_poly, shadow->blur / 2.0);
-      pixmap_destroy(shadow_poly);
-    }
-
-    rect_t sbbox =
-      rect(point(bbox->p1.x - shadow_size_offset + shadow->offset_x,
-                 bbox->p1.y - shadow_size_offset + shadow->offset_y),
-           point(bbox->p2.x + shadow_size_offset + shadow->offset_x,
-                 bbox->p2.y + shadow_size_offset + shadow->offset_y));
-
-    int32_t lower_bound_i = 0, upper_bound_i = pm->height;
-    int32_t lower_bound_j = 0, upper_bound_j = pm->width;
+  // Rendered mesh covers [bbox.p1; bbox.p1 + size[
+  int32_t bx = (int32_t)bbox->p1.x;
+  int32_t by = (int32_t)bbox->p1.y;
+
+  // The shadow is a blurred copy of the shape alpha, with
+  // enough room around it for the blur to spread
+  int32_t o = (int32_t)(sqrt(3.0 * shadow->blur * shadow->blur));
+  int32_t sw = rendered_poly.width + o * 2;
+  int32_t sh = rendered_poly.height + o * 2;
+  uint8_t *shadow_data =
+    (uint8_t *)buffer_pool_acquire((size_t)sw * (size_t)sh, true);
+  if (shadow_data == NULL) {
+    pixmap_destroy(rendered_poly);
+    return;
+  }
 
-    if (comp_is_full_screen(composite_operation) == false) {
-      lower_bound_i = max((int32_t)sbbox.p1.y, 0);
-      upper_bound_i = min((int32_t)(sbbox.p2.y + 1.0), pm->height);
-      lower_bound_j = max((int32_t)sbbox.p1.x, 0);
-      upper_bound_j = min((int32_t)(sbbox.p2.x + 1.0), pm->width);
+  for (int32_t i = 0; i < rendered_poly.height; ++i) {
+    const color_t_ *s = rendered_poly.data + i * rendered_poly.width;
+    uint8_t *d = shadow_data + (i + o) * sw + o;
+    for (int32_t j = 0; j < rendered_poly.width; ++j) {
+      d[j] = s[j].a;
     }
-
-    for (int32_t i = lower_bound_i; i < upper_bound_i; ++i) {
-      for (int32_t j = lower_bound_j; j < upper_bound_j; ++j) {
-
-        if (j < sbbox.p1.x || j > sbbox.p2.x ||
-            i < sbbox.p1.y || i > sbbox.p2.y) {
-          pixmap_at(*pm, i, j) =
-            comp_compose(color_transparent_black,
-                         pixmap_at(*pm, i, j), 0, composite_operation);
-          continue;
-        }
-
-        color_t_ fill_color =
-          pixmap_at(blurred_shadow_poly,
-                    i - (int32_t)sbbox.p1.y,
-                    j - (int32_t)sbbox.p1.x);
-
-        fill_color.r = shadow->color.r;
-        fill_color.g = shadow->color.g;
-        fill_color.b = shadow->color.b;
-
-        double draw_alpha = fill_color.a;
-
-        if ((clip_region != NULL) && (pixmap_valid(*clip_region) == true)) {
-          draw_alpha *= 255 - pixmap_at(*clip_region, i, j).a;
-          draw_alpha /= 255;
-        }
-
-        pixmap_at(*pm, i, j) =
-          comp_compose(fill_color, pixmap_at(*pm, i, j),
-                       (int)(draw_alpha * shadow->color.a *
-                             global_alpha / 255), composite_operation);
-      }
-    }
-
-    pixmap_destroy(blurred_shadow_poly);
   }
 
-  // Compose rendered mesh
-  int32_t lower_bound_i = 0, upper_bound_i = pm->height;
-  int32_t lower_bound_j = 0, upper_bound_j = pm->width;
-
-  if (comp_is_full_screen(composite_operation) == false) {
-    lower_bound_i = max((int32_t)bbox->p1.y, 0);
-    upper_bound_i = min((int32_t)(bbox->p2.y + 1.0), pm->height);
-    lower_bound_j = max((int32_t)bbox->p1.x, 0);
-    upper_bound_j = min((int32_t)(bbox->p2.x + 1.0), pm->width);
+  if (shadow->blur > 0.0) {
+    filter_gaussian_blur_a8(shadow_data, sw, sh, shadow->blur / 2.0);
   }
 
-  for (int32_t i = lower_bound_i; i < upper_bound_i; ++i) {
-    for (int32_t j = lower_bound_j; j < upper_bound_j; ++j) {
-
-      if (j < bbox->p1.x || j > bbox->p2.x ||
-          i < bbox->p1.y || i > bbox->p2.y) {
-        pixmap_at(*pm, i, j) =
-          comp_compose(color_transparent_black,
-                       pixmap_at(*pm, i, j), 0, composite_operation);
-        continue;
-      }
-
-      color_t_ fill_color =
-        pixmap_at(rendered_poly,
-                  i - (int32_t)bbox->p1.y,
-                  j - (int32_t)bbox->p1.x);
-
-      double draw_alpha = fill_color.a;
-
-      if ((clip_region != NULL) && (pixmap_valid(*clip_region) == true)) {
-        draw_alpha *= 255 - pixmap_at(*clip_region, i, j).a;
-        draw_alpha /= 255;
-      }
+  shadow_layer_t sl = {
+    .data = shadow_data, .width = sw, .height = sh,
+    .x = (int32_t)(bbox->p1.x - o + shadow->offset_x),
+    .y = (int32_t)(bbox->p1.y - o + shadow->offset_y),
+    .color = shadow->color
+  };
 
-      pixmap_at(*pm, i, j) =
-        comp_compose(fill_color, pixmap_at(*pm, i, j),
-                     (int)(draw_alpha * global_alpha),
-                     composite_operation);
-    }
+  // Operations that affect the whole canvas clear what lies outside
+  // each layer, so the layers have to be composed one after the other
+  if (comp_is_full_screen(composite_operation) == true) {
+    _poly_render_compose_layers(pm, &sl, NULL, 0, 0,
+                                composite_operation, global_alpha,
+                                clip_region);
+    _poly_render_compose_layers(pm, NULL, &rendered_poly, bx, by,
+                                composite_operation, global_alpha,
+                                clip_region);
+  } else {
+    _poly_render_compose_layers(pm, &sl, &rendered_poly, bx, by,
+                                composite_operation, global_alpha,
+                                clip_region);
   }
 
+  buffer_pool_release(shadow_data, (size_t)sw * (size_t)sh);
   pixmap_destroy(rendered_poly);
 }
 
@@ -669,29 +859,23 @@ _poly_render_direct(
 
   transform_t *inverse = transform_copy(transform);
   transform_inverse(inverse);
-
-  int32_t lower_bound_i = 0, upper_bound_i = pm->height;
-  int32_t lower_bound_j = 0, upper_bound_j = pm->width;
-
-  if (comp_is_full_screen(composite_operation) == false) {
-    lower_bound_i = max((int32_t)bbox->p1.y, 0);
-    upper_bound_i = min((int32_t)(bbox->p2.y + 1.0), pm->height);
-    lower_bound_j = max((int32_t)bbox->p1.x, 0);
-    upper_bound_j = min((int32_t)(bbox->p2.x + 1.0), pm->width);
+  _poly_render_select_smoothing(&draw_style, inverse);
+
+  // Pixels partially covered by the bounding box are inside
+  int32_t lower_bound_i = max((int32_t)floor(bbox->p1.y), 0);
+  int32_t upper_bound_i = min((int32_t)floor(bbox->p2.y) + 1, pm->height);
+  int32_t lower_bound_j = max((int32_t)floor(bbox->p1.x), 0);
+  int32_t upper_bound_j = min((int32_t)floor(bbox->p2.x) + 1, pm->width);
+
+  // Outside of the bounding box, the source is transparent black
+  if (comp_is_full_screen(composite_operation) == true) {
+    _poly_render_compose_outside(pm, lower_bound_j, lower_bound_i,
+                                 upper_bound_j, upper_bound_i,
+                                 composite_operation, clip_region);
   }
 
   for (int32_t i = lower_bound_i; i < upper_bound_i; ++i) {
 
-    // If not in the bounding box, take src color as transparent black
-    if (i < bbox->p1.y || i > bbox->p2.y) {
-      for (int32_t j = 0; j < pm->width; ++j) {
-        pixmap_at(*pm, i, j) = comp_compose(color_transparent_black,
-                                            pixmap_at(*pm, i, j), 0,
-                                            composite_operation);
-      }
-      continue;
-    }
-
     _clip_horizontal((float)i, -1.0, p, tmp_poly, 0.0, 0.0);
     _clip_horizontal((float)(i + 1), 1.0, tmp_poly, line_poly, 0.0, 0.0);
 
@@ -701,14 +885,6 @@ _poly_render_direct(
     // Calculate scanline, bounded by the bounding box
     for (int32_t j = lower_bound_j; j < upper_bound_j; ++j) {
 
-      // If not in the bounding box, take src color as transparent black
-      if (j < bbox->p1.x || j > bbox->p2.x) {
-        pixmap_at(*pm, i, j) = comp_compose(color_transparent_black,
-                                            pixmap_at(*pm, i, j), 0,
-                                            composite_operation);
-        continue;
-      }
-
       bool is_complex = complex[j];
 
       // If the current cell is complex, we need to calculate it.
@@ -760,6 +936,592 @@ _poly_render_direct(
 }
 
 
+// Computes the A8 coverage mask of the polygon over the pixels
+// partially covered by its bounding box
+bool
+poly_render_coverage(
+  const polygon_t *p,
+  const rect_t *bbox,
+  bool non_zero,
+  mask_t *mask) // out
+{
+  assert(p != NULL);
+  assert(bbox != NULL);
+  assert(mask != NULL);
+
+  int32_t x = (int32_t)floor(bbox->p1.x);
+  int32_t y = (int32_t)floor(bbox->p1.y);
+  int32_t w = (int32_t)floor(bbox->p2.x) + 1 - x;
+  int32_t h = (int32_t)floor(bbox->p2.y) + 1 - y;
+
+  uint8_t *data = (uint8_t *)calloc(w * h, sizeof(uint8_t));
+  polygon_t *line_poly = polygon_create(1024, 16);
+  polygon_t *pixel_poly = polygon_create(1024, 16);
+  polygon_t *tmp_poly = polygon_create(1024, 16);
+  if ((data == NULL) || (line_poly == NULL) ||
+      (pixel_poly == NULL) || (tmp_poly == NULL)) {
+    goto error;
+  }
+
+  int alpha = 0;
+
+  for (int32_t i = 0; i < h; ++i) {
+
+    _clip_horizontal((float)i, -1.0, p, tmp_poly, -x, -y);
+    _clip_horizontal((float)(i + 1), 1.0, tmp_poly, line_poly, 0.0, 0.0);
+
+    bool *complex = _build_complex(w, line_poly);
+    bool calculate = true;
+
+    for (int32_t j = 0; j < w; ++j) {
+
+      bool is_complex = complex[j];
+
+      calculate |= is_complex;
+
+      if (calculate) {
+        _clip_vertical((float)j, -1.0, line_poly, tmp_poly, 0.0, 0.0);
+        _clip_vertical((float)(j + 1), 1.0, tmp_poly, pixel_poly, 0.0, 0.0);
+
+        swap(polygon_t *, line_poly, tmp_poly);
+
+        alpha =
+          non_zero ?
+          _calculate_coverage_non_zero((float)i, (float)j, pixel_poly) :
+          _calculate_coverage_even_odd((float)i, (float)j, pixel_poly);
+
+        calculate = is_complex;
+      }
+
+      data[i * w + j] = (uint8_t)alpha;
+    }
+
+    free(complex);
+  }
+
+  polygon_destroy(tmp_poly);
+  polygon_destroy(pixel_poly);
+  polygon_destroy(line_poly);
+
+  mask->data = data;
+  mask->width = w;
+  mask->height = h;
+  mask->x = x;
+  mask->y = y;
+
+  return true;
+
+error:
+  if (tmp_poly != NULL) {
+    polygon_destroy(tmp_poly);
+  }
+  if (pixel_poly != NULL) {
+    polygon_destroy(pixel_poly);
+  }
+  if (line_poly != NULL) {
+    polygon_destroy(line_poly);
+  }
+  if (data != NULL) {
+    free(data);
+  }
+  return false;
+}
+
+// Composes the draw style through a coverage mask
+// whose origin is placed at pixel (x, y)
+void
+poly_render_mask(
+  pixmap_t *pm,
+  const mask_t *mask,
+  int32_t x,
+  int32_t y,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region,
+  const transform_t *transform)
+{
+  assert(pm != NULL);
+  assert(pixmap_valid(*pm) == true);
+  assert(mask != NULL);
+  assert(mask->data != NULL);
+  assert(transform != NULL);
+
+  int64_t mx = (int64_t)x + mask->x;
+  int64_t my = (int64_t)y + mask->y;
+  int32_t lower_bound_i = (int32_t)max(my, 0);
+  int32_t upper_bound_i = (int32_t)min(my + mask->height, pm->height);
+  int32_t lower_bound_j = (int32_t)max(mx, 0);
+  int32_t upper_bound_j = (int32_t)min(mx + mask->width, pm->width);
+
+  bool full_screen = comp_is_full_screen(compose_op);
+  if (full_screen == true) {
+    _poly_render_compose_outside(pm, lower_bound_j, lower_bound_i,
+                                 upper_bound_j, upper_bound_i,
+                                 compose_op, clip_region);
+  }
+
+  transform_t *inverse = transform_copy(transform);
+  transform_inverse(inverse);
+  _poly_render_select_smoothing(&draw_style, inverse);
+
+  int ga = fastround(global_alpha * 256.0);
+
+  for (int32_t i = lower_bound_i; i < upper_bound_i; ++i) {
+    const uint8_t *m = mask->data + (i - my) * mask->width - mx;
+    for (int32_t j = lower_bound_j; j < upper_bound_j; ++j) {
+
+      // Uncovered pixels only matter to full screen operations
+      int alpha = m[j];
+      if ((alpha == 0) && (full_screen == false)) {
+        continue;
+      }
+
+      color_t_ color =
+        _determine_base_color(&draw_style, (float)j, (float)i, inverse);
+
+      int draw_alpha = (alpha * ga * color.a) / (256 * 255);
+      if ((clip_region != NULL) && (pixmap_valid(*clip_region) == true)) {
+        draw_alpha *= 255 - pixmap_at(*clip_region, i, j).a;
+        draw_alpha /= 255;
+      }
+
+      pixmap_at(*pm, i, j) =
+        comp_compose(color, pixmap_at(*pm, i, j),
+                     draw_alpha, compose_op);
+    }
+  }
+
+  transform_destroy(inverse);
+}
+
+
+// State shared by the analytic renderers below
+typedef struct analytic_t {
+  pixmap_t *pm;
+  draw_style_t draw_style;
+  composite_operation_t compose_op;
+  const pixmap_t *clip_region;
+  transform_t *inverse; // only for gradients and patterns
+  int global_alpha; // 0 - 256
+  bool full_screen;
+  bool opaque_fill; // covered pixels are simply replaced
+} analytic_t;
+
+static bool
+_poly_render_analytic_init(
+  analytic_t *a,
+  pixmap_t *pm,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region,
+  const transform_t *transform)
+{
+  assert(a != NULL);
+  assert(pm != NULL);
+  assert(pixmap_valid(*pm) == true);
+  assert(transform != NULL);
+
+  a->pm = pm;
+  a->draw_style = draw_style;
+  a->compose_op = compose_op;
+  a->clip_region =
+    ((clip_region != NULL) && (pixmap_valid(*clip_region) == true)) ?
+    clip_region : NULL;
+  a->inverse = NULL;
+  a->global_alpha = fastround(global_alpha * 256.0);
+  a->full_screen = comp_is_full_screen(compose_op);
+  a->opaque_fill =
+    (draw_style.type == DRAW_STYLE_COLOR) &&
+    (draw_style.content.color.a == 255) && (a->global_alpha >= 256) &&
+    (a->clip_region == NULL) &&
+    ((compose_op == SOURCE_OVER) || (compose_op == COPY));
+
+  if (draw_style.type != DRAW_STYLE_COLOR) {
+    a->inverse = transform_copy(transform);
+    if (a->inverse == NULL) {
+      return false;
+    }
+    transform_inverse(a->inverse);
+    _poly_render_select_smoothing(&a->draw_style, a->inverse);
+  }
+
+  return true;
+}
+
+static void
+_poly_render_analytic_release(
+  analytic_t *a)
+{
+  assert(a != NULL);
+
+  if (a->inverse != NULL) {
+    transform_destroy(a->inverse);
+  }
+}
+
+// Composes the draw style on pixel (j, i) with the given coverage
+static inline void
+_poly_render_analytic_plot(
+  const analytic_t *a,
+  int32_t i,
+  int32_t j,
+  int coverage) // 0 - 255
+{
+  color_t_ color = (a->draw_style.type == DRAW_STYLE_COLOR) ?
+    a->draw_style.content.color :
+    _determine_base_color(&a->draw_style, (float)j, (float)i, a->inverse);
+
+  int draw_alpha = (coverage * a->global_alpha * color.a) / (256 * 255);
+  if (a->clip_region != NULL) {
+    draw_alpha *= 255 - pixmap_at(*a->clip_region, i, j).a;
+    draw_alpha /= 255;
+  }
+
+  pixmap_at(*a->pm, i, j) =
+    comp_compose(color, pixmap_at(*a->pm, i, j), draw_alpha, a->compose_op);
+}
+
+// Composes the draw style on the fully covered pixels [j1; j2[ of row i
+static void
+_poly_render_analytic_span(
+  const analytic_t *a,
+  int32_t i,
+  int32_t j1,
+  int32_t j2)
+{
+  if (a->opaque_fill == true) {
+    color_t_ *d = &pixmap_at(*a->pm, i, 0);
+    color_t_ color = a->draw_style.content.color;
+    for (int32_t j = j1; j < j2; ++j) {
+      d[j] = color;
+    }
+  } else {
+    for (int32_t j = j1; j < j2; ++j) {
+      _poly_render_analytic_plot(a, i, j, 255);
+    }
+  }
+}
+
+// Renders the device space rectangle [x1; x2] x [y1; y2], computing
+// the exact area coverage of edge pixels instead of rasterizing
+// a polygon; interior spans are filled directly
+void
+poly_render_rect(
+  pixmap_t *pm,
+  double x1,
+  double y1,
+  double x2,
+  double y2,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region,
+  const transform_t *transform)
+{
+  assert(pm != NULL);
+  assert(pixmap_valid(*pm) == true);
+  assert(transform != NULL);
+
+  if (x1 > x2) { swap(double, x1, x2); }
+  if (y1 > y2) { swap(double, y1, y2); }
+
+  x1 = max(x1, 0.0); x2 = min(x2, (double)pm->width);
+  y1 = max(y1, 0.0); y2 = min(y2, (double)pm->height);
+
+  int32_t lower_bound_i = 0, upper_bound_i = 0;
+  int32_t lower_bound_j = 0, upper_bound_j = 0;
+  if ((x1 < x2) && (y1 < y2)) {
+    lower_bound_i = (int32_t)floor(y1);
+    upper_bound_i = (int32_t)ceil(y2);
+    lower_bound_j = (int32_t)floor(x1);
+    upper_bound_j = (int32_t)ceil(x2);
+  }
+
+  analytic_t a;
+  if (_poly_render_analytic_init(&a, pm, draw_style, global_alpha,
+                                 compose_op, clip_region,
+                                 transform) == false) {
+    return;
+  }
+
+  if (a.full_screen == true) {
+    _poly_render_compose_outside(pm, lower_bound_j, lower_bound_i,
+                                 upper_bound_j, upper_bound_i,
+                                 compose_op, clip_region);
+  }
+
+  // Pixels of the interior are those fully covered in both directions
+  int32_t inner_j1 = (int32_t)ceil(x1);
+  int32_t inner_j2 = max((int32_t)floor(x2), inner_j1);
+
+  for (int32_t i = lower_bound_i; i < upper_bound_i; ++i) {
+
+    double cov_y = min(i + 1.0, y2) - max((double)i, y1);
+
+    for (int32_t j = lower_bound_j; j < upper_bound_j; ++j) {
+
+      if ((cov_y >= 1.0) && (j == inner_j1) && (inner_j1 < inner_j2)) {
+        _poly_render_analytic_span(&a, i, inner_j1, inner_j2);
+        j = inner_j2 - 1;
+        continue;
+      }
+
+      double cov_x = min(j + 1.0, x2) - max((double)j, x1);
+      int coverage = fastround(cov_x * cov_y * 255.0);
+      if ((coverage > 0) || (a.full_screen == true)) {
+        _poly_render_analytic_plot(&a, i, j, coverage);
+      }
+    }
+  }
+
+  _poly_render_analytic_release(&a);
+}
+
+// Renders the device space axis-aligned ellipse of center (cx, cy)
+// and radii (rx, ry); the coverage of edge pixels is derived from
+// the approximate distance of their center to the outline, small
+// ellipses are supersampled instead
+void
+poly_render_ellipse(
+  pixmap_t *pm,
+  double cx,
+  double cy,
+  double rx,
+  double ry,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region,
+  const transform_t *transform)
+{
+  assert(pm != NULL);
+  assert(pixmap_valid(*pm) == true);
+  assert(transform != NULL);
+
+  rx = fabs(rx);
+  ry = fabs(ry);
+
+  int32_t lower_bound_i = 0, upper_bound_i = 0;
+  int32_t lower_bound_j = 0, upper_bound_j = 0;
+  if ((rx > 0.0) && (ry > 0.0) &&
+      (cx + rx > 0.0) && (cx - rx < (double)pm->width) &&
+      (cy + ry > 0.0) && (cy - ry < (double)pm->height)) {
+    lower_bound_i = (int32_t)max(floor(cy - ry), 0.0);
+    upper_bound_i = (int32_t)min(ceil(cy + ry), (double)pm->height);
+    lower_bound_j = (int32_t)max(floor(cx - rx), 0.0);
+    upper_bound_j = (int32_t)min(ceil(cx + rx), (double)pm->width);
+  }
+
+  analytic_t a;
+  if (_poly_render_analytic_init(&a, pm, draw_style, global_alpha,
+                                 compose_op, clip_region,
+                                 transform) == false) {
+    return;
+  }
+
+  if (a.full_screen == true) {
+    _poly_render_compose_outside(pm, lower_bound_j, lower_bound_i,
+                                 upper_bound_j, upper_bound_i,
+                                 compose_op, clip_region);
+  }
+
+  bool small = (min(rx, ry) < 2.0);
+  double irx2 = 1.0 / (rx * rx);
+  double iry2 = 1.0 / (ry * ry);
+
+  for (int32_t i = lower_bound_i; i < upper_bound_i; ++i) {
+
+    double dy = i + 0.5 - cy;
+
+    // Pixels whose center lies within the ellipse shrunk by
+    // one and a half pixel are certainly fully covered
+    int32_t inner_j1 = upper_bound_j;
+    int32_t inner_j2 = upper_bound_j;
+    if ((small == false) && (fabs(dy) < ry - 1.5)) {
+      double t = dy / (ry - 1.5);
+      double hw = (rx - 1.5) * sqrt(1.0 - t * t);
+      inner_j1 = max((int32_t)ceil(cx - hw - 0.5), lower_bound_j);
+      inner_j2 = min((int32_t)floor(cx + hw - 0.5) + 1, upper_bound_j);
+      if (inner_j1 >= inner_j2) {
+        inner_j1 = inner_j2 = upper_bound_j;
+      }
+    }
+
+    for (int32_t j = lower_bound_j; j < upper_bound_j; ++j) {
+
+      if (j == inner_j1) {
+        _poly_render_analytic_span(&a, i, inner_j1, inner_j2);
+        j = inner_j2 - 1;
+        continue;
+      }
+
+      int coverage = 0;
+
+      if (small == true) {
+        // 4 x 4 samples per pixel
+        for (int32_t k = 0; k < 16; ++k) {
+          double sx = j + 0.125 + 0.25 * (k & 3) - cx;
+          double sy = i + 0.125 + 0.25 * (k >> 2) - cy;
+          coverage += (sx * sx * irx2 + sy * sy * iry2 <= 1.0);
+        }
+        coverage = (coverage * 255 + 8) / 16;
+      } else {
+        // Distance to the outline, from the implicit equation
+        // f = x^2 / rx^2 + y^2 / ry^2 - 1 and its gradient
+        double dx = j + 0.5 - cx;
+        double f = dx * dx * irx2 + dy * dy * iry2 - 1.0;
+        double gx = 2.0 * dx * irx2;
+        double gy = 2.0 * dy * iry2;
+        double g = sqrt(gx * gx + gy * gy);
+        double d = (g > 0.0) ? f / g : -min(rx, ry);
+        coverage = fastround(max(0.0, min(0.5 - d, 1.0)) * 255.0);
+      }
+
+      if ((coverage > 0) || (a.full_screen == true)) {
+        _poly_render_analytic_plot(&a, i, j, coverage);
+      }
+    }
+  }
+
+  _poly_render_analytic_release(&a);
+}
+
+typedef struct hairline_t {
+  pixmap_t *pm;
+  const draw_style_t *draw_style;
+  composite_operation_t composite_operation;
+  const pixmap_t *clip_region;
+  const transform_t *inverse;
+  int global_alpha; // 0 - 256
+  double intensity; // 0 - 255
+  int32_t x_min, y_min, x_max, y_max; // pixels that may be drawn
+  bool steep;
+} hairline_t;
+
+typedef enum hairline_end_t {
+  HAIRLINE_END_FREE = 0, // partially covered, depending on its position
+  HAIRLINE_END_OWNED = 1, // shared with the next segment, fully covered
+  HAIRLINE_END_SKIPPED = 2 // shared with the previous segment, not drawn
+} hairline_end_t;
+
+// Composes the draw style on a pixel given in (major, minor) axis
+// order; coordinates are integral but may lie far outside the area
+static void
+_poly_render_hairline_plot(
+  const hairline_t *h,
+  double major,
+  double minor,
+  double coverage)
+{
+  assert(h != NULL);
+
+  double x = h->steep ? minor : major;
+  double y = h->steep ? major : minor;
+  if ((x < (double)h->x_min) || (x >= (double)h->x_max) ||
+      (y < (double)h->y_min) || (y >= (double)h->y_max)) {
+    return;
+  }
+
+  int alpha = (int)(coverage * h->intensity);
+  if (alpha <= 0) {
+    return;
+  }
+
+  int32_t j = (int32_t)x;
+  int32_t i = (int32_t)y;
+
+  color_t_ color =
+    _determine_base_color(h->draw_style, (float)j, (float)i, h->inverse);
+
+  int draw_alpha = (alpha * h->global_alpha * color.a) / (256 * 255);
+  if ((h->clip_region != NULL) && (pixmap_valid(*h->clip_region) == true)) {
+    draw_alpha *= 255 - pixmap_at(*h->clip_region, i, j).a;
+    draw_alpha /= 255;
+  }
+
+  pixmap_at(*h->pm, i, j) =
+    comp_compose(color, pixmap_at(*h->pm, i, j),
+                 draw_alpha, h->composite_operation);
+}
+
+// Xiaolin Wu's antialiased line, with pixel centers at half integers;
+// shared vertices are drawn by a single segment, so that the pixels
+// around them are composed only once
+static void
+_poly_render_hairline_segment(
+  hairline_t *h,
+  point_t p1,
+  point_t p2,
+  double width,
+  hairline_end_t e1,
+  hairline_end_t e2)
+{
+  assert(h != NULL);
+
+  double x1 = p1.x - 0.5, y1 = p1.y - 0.5;
+  double x2 = p2.x - 0.5, y2 = p2.y - 0.5;
+
+  h->steep = fabs(y2 - y1) > fabs(x2 - x1);
+  if (h->steep) {
+    swap(double, x1, y1);
+    swap(double, x2, y2);
+  }
+  if (x1 > x2) {
+    swap(double, x1, x2);
+    swap(double, y1, y2);
+    swap(hairline_end_t, e1, e2);
+  }
+
+  double major_min = h->steep ? h->y_min : h->x_min;
+  double major_max = h->steep ? h->y_max : h->x_max;
+  double minor_min = h->steep ? h->x_min : h->y_min;
+  double minor_max = h->steep ? h->x_max : h->y_max;
+  // End points are extrapolated by up to half a pixel along the major
+  // axis, hence by up to half a pixel along the minor axis as well
+  if ((x2 < major_min - 1.0) || (x1 > major_max) ||
+      (max(y1, y2) < minor_min - 1.5) || (min(y1, y2) > minor_max + 0.5)) {
+    return;
+  }
+
+  double dx = x2 - x1;
+  double gradient = (dx == 0.0) ? 1.0 : (y2 - y1) / dx;
+
+  // The minor axis extent of the line grows with its slope
+  h->intensity = 255.0 * min(1.0, width * sqrt(1.0 + gradient * gradient));
+
+  // End points, partially covered along the major axis
+  double xe1 = floor(x1 + 0.5);
+  double ye1 = y1 + gradient * (xe1 - x1);
+  double gap1 = (e1 == HAIRLINE_END_OWNED) ? 1.0 :
+                (e1 == HAIRLINE_END_SKIPPED) ? 0.0 : 1.0 - (x1 + 0.5 - xe1);
+  double f1 = ye1 - floor(ye1);
+  _poly_render_hairline_plot(h, xe1, floor(ye1), (1.0 - f1) * gap1);
+  _poly_render_hairline_plot(h, xe1, floor(ye1) + 1.0, f1 * gap1);
+
+  double xe2 = floor(x2 + 0.5);
+  double ye2 = y2 + gradient * (xe2 - x2);
+  double gap2 = (e2 == HAIRLINE_END_OWNED) ? 1.0 :
+                (e2 == HAIRLINE_END_SKIPPED) ? 0.0 : x2 + 0.5 - xe2;
+  double f2 = ye2 - floor(ye2);
+  _poly_render_hairline_plot(h, xe2, floor(ye2), (1.0 - f2) * gap2);
+  _poly_render_hairline_plot(h, xe2, floor(ye2) + 1.0, f2 * gap2);
+
+  // Inner points, restricted to the area along the major axis; the
+  // intersections are not accumulated, so that they do not depend
+  // on where the area starts
+  int32_t lower = (int32_t)max(xe1 + 1.0, major_min);
+  int32_t upper = (int32_t)min(xe2, major_max);
+  for (int32_t x = lower; x < upper; ++x) {
+    double intery = y1 + gradient * ((double)x - x1);
+    double fy = floor(intery);
+    double f = intery - fy;
+    _poly_render_hairline_plot(h, (double)x, fy, 1.0 - f);
+    _poly_render_hairline_plot(h, (double)x, fy + 1.0, f);
+  }
+}
+
 void
 poly_render(
   pixmap_t *s,
@@ -784,3 +1546,74 @@ poly_render(
                         global_alpha, clip_region, non_zero, transform);
   }
 }
+
+// Draws the polygon edges as antialiased lines of the given
+// device-space width (at most one pixel); only suitable
+// for operations that leave uncovered pixels untouched;
+// if given, area restricts drawing to pixels [p1; p2[
+void
+poly_render_hairline(
+  pixmap_t *pm,
+  const polygon_t *p,
+  draw_style_t draw_style,
+  double global_alpha,
+  double width,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region,
+  const rect_t *area,
+  const transform_t *transform)
+{
+  assert(pm != NULL);
+  assert(pixmap_valid(*pm) == true);
+  assert(p != NULL);
+  assert(width > 0.0);
+  assert(comp_is_full_screen(compose_op) == false);
+  assert(transform != NULL);
+
+  transform_t *inverse = transform_copy(transform);
+  if (inverse == NULL) {
+    return;
+  }
+  transform_inverse(inverse);
+  _poly_render_select_smoothing(&draw_style, inverse);
+
+  hairline_t h = {
+    .pm = pm,
+    .draw_style = &draw_style,
+    .composite_operation = compose_op,
+    .clip_region = clip_region,
+    .inverse = inverse,
+    .global_alpha = fastround(global_alpha * 256.0),
+    .intensity = 255.0,
+    .x_min = 0, .y_min = 0,
+    .x_max = pm->width, .y_max = pm->height,
+    .steep = false,
+  };
+
+  if (area != NULL) {
+    h.x_min = max(h.x_min, (int32_t)area->p1.x);
+    h.y_min = max(h.y_min, (int32_t)area->p1.y);
+    h.x_max = min(h.x_max, (int32_t)area->p2.x);
+    h.y_max = min(h.y_max, (int32_t)area->p2.y);
+  }
+
+  // Closed subpolygons end on their first point, which is then
+  // shared by their last and first segments
+  int i = 0;
+  for (int ip = 0; ip < p->nb_subpolys; ++ip) {
+    int first = i;
+    int last = p->subpolys[ip];
+    bool closed = (p->subpoly_closed[ip] == true) && (last - first > 1);
+    for (; i < last; ++i) {
+      _poly_render_hairline_segment(&h, p->points[i], p->points[i + 1],
+                                    min(width, 1.0),
+                                    ((i > first) || (closed == true)) ?
+                                      HAIRLINE_END_SKIPPED : HAIRLINE_END_FREE,
+                                    ((i + 1 < last) || (closed == true)) ?
+                                      HAIRLINE_END_OWNED : HAIRLINE_END_FREE);
+    }
+    i = last + 1;
+  }
+
+  transform_destroy(inverse);
+}
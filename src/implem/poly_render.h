@@ -11,6 +11,7 @@
 #ifndef __POLY_RENDER_H
 #define __POLY_RENDER_H
 
+#include <stdint.h>
 #include <stdbool.h>
 
 #include "rect.h"
@@ -20,6 +21,7 @@
 #include "color_composition.h"
 #include "state.h" // just shadow
 #include "polygon.h"
+#include "mask_cache.h"
 
 void
 poly_render_init(
@@ -38,4 +40,61 @@ poly_render(
   bool non_zero,
   const transform_t *transform);
 
+bool
+poly_render_coverage(
+  const polygon_t *p,
+  const rect_t *bbox,
+  bool non_zero,
+  mask_t *mask);
+
+void
+poly_render_mask(
+  pixmap_t *pm,
+  const mask_t *mask,
+  int32_t x,
+  int32_t y,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region,
+  const transform_t *transform);
+
+void
+poly_render_rect(
+  pixmap_t *pm,
+  double x1,
+  double y1,
+  double x2,
+  double y2,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region,
+  const transform_t *transform);
+
+void
+poly_render_ellipse(
+  pixmap_t *pm,
+  double cx,
+  double cy,
+  double rx,
+  double ry,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region,
+  const transform_t *transform);
+
+void
+poly_render_hairline(
+  pixmap_t *pm,
+  const polygon_t *p,
+  draw_style_t draw_style,
+  double global_alpha,
+  double width,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region,
+  const rect_t *area,
+  const transform_t *transform);
+
 #endif /* __POLY_RENDER_H */
@@ -15,6 +15,7 @@
 
 #include "util.h"
 #include "point.h"
+#include "rect.h"
 #include "polygon.h"
 #include "polygon_internal.h"
 
@@ -226,3 +227,27 @@ polygon_copy(
 
   return output;
 }
+
+// Bounding box of all the points of the polygon;
+// returns false (with an empty box) if it has no point
+bool
+polygon_bbox(
+  const polygon_t *p,
+  rect_t *bbox) // out
+{
+  assert(p != NULL);
+  assert(p->points != NULL);
+  assert(bbox != NULL);
+
+  if (p->nb_points <= 0) {
+    *bbox = rect(point(0.0, 0.0), point(0.0, 0.0));
+    return false;
+  }
+
+  *bbox = rect(p->points[0], p->points[0]);
+  for (int32_t i = 1; i < p->nb_points; ++i) {
+    rect_expand(bbox, p->points[i]);
+  }
+
+  return true;
+}
@@ -15,6 +15,7 @@
 #include <stdbool.h>
 
 #include "point.h"
+#include "rect.h"
 
 typedef struct polygon_t polygon_t;
 
@@ -53,4 +54,9 @@ polygon_t *
 polygon_copy(
   const polygon_t *p);
 
+bool
+polygon_bbox(
+  const polygon_t *p,
+  rect_t *bbox);
+
 #endif /* __POLYGON_H */
@@ -8,6 +8,7 @@
 /*                                                                        */
 /**************************************************************************/
 
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <math.h> // Note: on Win32, add #define _USE_MATH_DEFINES for M_PI
@@ -98,123 +99,227 @@ bezier_to_poly(
   }
 }
 
-// Assuming the points are on opposite major sides of an ellipse
-// (image of a circle by the transform), fill the semi ellipse
-static void
-_arc_to_poly_transform(
-  point_t p1,
-  point_t p2,
-  polygon_t *p,
-  int precision,
-  const transform_t *linear,
-  const transform_t *inv_linear)
+// Maximum distance (in device pixels) between a round join
+// or cap and its polygonal approximation
+#define ROUND_TOLERANCE 0.125
+
+// Angle between two consecutive vertices of a round join or cap,
+// so that a circle of radius r (in device space) is approximated
+// within ROUND_TOLERANCE
+static double
+_round_step(
+  double r)
 {
-  assert(p != NULL);
-  assert(linear != NULL);
-  assert(inv_linear != NULL);
-
-  point_t dp = point((p1.x - p2.x) / 2.0, (p1.y - p2.y) / 2.0);
-  point_t center = point((p1.x + p2.x) / 2.0, (p1.y + p2.y) / 2.0);
-  transform_apply(inv_linear, &dp);
-
-  for (int i = 1; i < precision; i++) {
-    double cs = cos(((double)(-i)) * M_PI / precision);
-    double ss = sin(((double)(-i)) * M_PI / precision);
-    point_t newPt = point((cs * dp.x + ss * dp.y), (-ss * dp.x + cs * dp.y));
-    transform_apply(linear, &newPt);
-    point_t output = point(newPt.x + center.x, newPt.y + center.y);
-    polygon_add_point(p, output);
+  if (r <= ROUND_TOLERANCE * 2.0) {
+    return M_PI / 2.0;
   }
+  return min(M_PI / 2.0, 2.0 * acos(1.0 - ROUND_TOLERANCE / r));
+}
+
+// Point at offset o along user space vector v from device space point c
+static point_t
+_stroke_point(
+  point_t c,
+  point_t v,
+  double o,
+  const transform_t *lin)
+{
+  assert(lin != NULL);
+
+  transform_apply(lin, &v);
+  return point(c.x + v.x * o, c.y + v.y * o);
 }
 
-// Same as previous, but now we don't assume the points are on opposite ends
+// Adds the intermediate vertices of an arc of center c, starting
+// at user space unit vector u and spanning the given signed angle;
+// the extremities of the arc are left to the caller
 static void
-_arc_to_poly_transform_center(
-  point_t center,
-  point_t p1,
-  point_t p2,
-  polygon_t *p,
-  int precision,
-  const transform_t *linear,
-  const transform_t *inv_linear)
+_stroke_arc(
+  polygon_t *np,
+  point_t c,
+  point_t u,
+  double angle,
+  double o,
+  double step,
+  const transform_t *lin)
 {
-  assert(p != NULL);
-  assert(linear != NULL);
-  assert(inv_linear != NULL);
-
-  point_t dp1 = point((p1.x - center.x), (p1.y - center.y));
-  point_t dp2 = point((p2.x - center.x), (p2.y - center.y));
-  transform_apply(inv_linear, &dp1);
-  transform_apply(inv_linear, &dp2);
-
-  double angle = atan2((dp2.y), (dp2.x)) - atan2((dp1.y), dp1.x);
-  angle = angle - 2.0 * M_PI * floor(angle / (2.0 * M_PI));
-
-  for (int i = 0; i <= precision; i++) {
-    double cs = cos(((double)(-1)) * i * angle / precision);
-    double ss = sin(((double)(-1)) * i * angle / precision);
-    double x = dp1.x;
-    double y = dp1.y;
-    point_t new_pt = point((cs * x + ss * y), (-ss * x + cs * y));
-    transform_apply(linear, &new_pt);
-    point_t output = point(new_pt.x + center.x, new_pt.y + center.y);
-    polygon_add_point(p, output);
+  assert(np != NULL);
+  assert(lin != NULL);
+  assert(step > 0.0);
+
+  int32_t n = (int32_t)ceil(fabs(angle) / step);
+  if (n <= 1) {
+    return;
+  }
+
+  // Rotate incrementally rather than computing cos/sin for each vertex
+  double cs = cos(angle / n);
+  double sn = sin(angle / n);
+  for (int32_t i = 1; i < n; ++i) {
+    u = point(u.x * cs - u.y * sn, u.x * sn + u.y * cs);
+    polygon_add_point(np, _stroke_point(c, u, o, lin));
   }
 }
 
+// Adds a join at c between two segments of user space unit tangents
+// t_in and t_out, on the left side of the traversal, going from
+// c + left(t_in) to c + left(t_out)
 static void
-_miter_to_poly(
-  point_t p11,
-  point_t p12,
-  point_t p21,
-  point_t p22,
-  polygon_t *p,
+_stroke_join(
+  polygon_t *np,
+  point_t c,
+  point_t t_in,
+  point_t t_out,
+  join_type_t join_type,
   double miter_limit,
-  point_t po,
-  double line_width,
-  const transform_t *inverse_linear)
+  double o,
+  double step,
+  const transform_t *lin)
 {
-  assert(p != NULL);
-  assert(inverse_linear != NULL);
-
-  // Compute intersection and add point
-  double a11 = p12.x - p11.x;
-  double a21 = p12.y - p11.y;
-  double a12 = p21.x - p22.x;
-  double a22 = p21.y - p22.y;
-  double det = a11 * a22 - a21 * a12;
-  double c1 = p21.x - p11.x;
-  double c2 = p21.y - p11.y;
-  double topdet = c1 * a22 - c2 * a12;
-  double ans = topdet / det;
-  point_t intersection =
-    point(p11.x + ans * (p12.x - p11.x), p11.y + ans * (p12.y - p11.y));
-  point_t dp = point(intersection.x - po.x, intersection.y - po.y);
-  transform_apply(inverse_linear, &dp);
-  double dist_to_intersection = point_dist_2(dp, point(0.0, 0.0));
-  double miter_cut = (line_width * miter_limit / 2.0);
-  if (dist_to_intersection < miter_cut * miter_cut) {
-    polygon_add_point(p, intersection);
+  assert(np != NULL);
+  assert(lin != NULL);
+
+  point_t n_in = point(-t_in.y, t_in.x);
+  point_t n_out = point(-t_out.y, t_out.x);
+  double cross = t_in.x * t_out.y - t_in.y * t_out.x;
+  double dot = t_in.x * t_out.x + t_in.y * t_out.y;
+
+  polygon_add_point(np, _stroke_point(c, n_in, o, lin));
+
+  // Inner side: going through the center keeps the winding
+  // consistent even when the segments are shorter than the width
+  if (cross > 0.0) {
+    polygon_add_point(np, c);
+  } else if ((cross < 0.0) || (dot < 0.0)) {
+    switch (join_type) {
+      case JOIN_ROUND:
+        _stroke_arc(np, c, n_in, (cross < 0.0) ? atan2(cross, dot) : -M_PI,
+                    o, step, lin);
+        break;
+      case JOIN_MITER:
+        // Miter length ratio is 1 / cos(angle / 2) = sqrt(2 / (1 + dot))
+        if ((1.0 + dot > DBL_EPSILON) &&
+            (2.0 <= miter_limit * miter_limit * (1.0 + dot))) {
+          point_t m = point((n_in.x + n_out.x) / (1.0 + dot),
+                            (n_in.y + n_out.y) / (1.0 + dot));
+          polygon_add_point(np, _stroke_point(c, m, o, lin));
+        }
+        break;
+      case JOIN_BEVEL:
+        break;
+    }
   }
+
+  polygon_add_point(np, _stroke_point(c, n_out, o, lin));
 }
 
+// Adds a cap at c, end of a segment of user space unit tangent t,
+// going from c + left(t) to c - left(t)
 static void
-_line_offset(
-  point_t p1,
-  point_t p2,
+_stroke_cap(
+  polygon_t *np,
+  point_t c,
+  point_t t,
+  cap_type_t cap_type,
   double o,
-  point_t *out_p1,
-  point_t *out_p2,
-  const transform_t *lin,
-  const transform_t *inv_lin)
+  double step,
+  const transform_t *lin)
 {
-  assert(out_p1 != NULL);
-  assert(out_p2 != NULL);
+  assert(np != NULL);
   assert(lin != NULL);
-  assert(inv_lin != NULL);
 
-  *out_p1 = point_offset_ortho_transform(p1, p2, o, lin, inv_lin);
-  *out_p2 = point_offset_ortho_transform(p2, p1, -o, lin, inv_lin);
+  point_t n = point(-t.y, t.x);
+
+  polygon_add_point(np, _stroke_point(c, n, o, lin));
+
+  switch (cap_type) {
+    case CAP_BUTT:
+      break;
+    case CAP_SQUARE:
+      polygon_add_point(np, _stroke_point(c, point(t.x + n.x, t.y + n.y),
+                                          o, lin));
+      polygon_add_point(np, _stroke_point(c, point(t.x - n.x, t.y - n.y),
+                                          o, lin));
+      break;
+    case CAP_ROUND:
+      _stroke_arc(np, c, n, -M_PI, o, step, lin);
+      break;
+  }
+
+  polygon_add_point(np, _stroke_point(c, point(-n.x, -n.y), o, lin));
+}
+
+static polygon_t *
+_polygon_dash(
+  const polygon_t *p,
+  const double *dash,
+  int32_t dash_array_size,
+  double dash_offset)
+{
+  assert(p != NULL);
+  assert(dash != NULL);
+  assert(dash_array_size > 0);
+
+  polygon_t *dashed_poly =
+    polygon_create(p->max_points * 2, p->max_subpolys * 2);
+  if (dashed_poly == NULL) {
+    return NULL;
+  }
+
+  double dash_length = 0.0;
+  for (int32_t i = 0; i < dash_array_size; ++i) {
+    dash_length += dash[i];
+  }
+
+  int32_t init_indx = 0;
+  dash_offset -= dash_length * floor(dash_offset / dash_length);
+  while (dash_offset >= dash[init_indx]) {
+    dash_offset -= dash[init_indx];
+    init_indx++;
+  }
+
+  for (int32_t i = 0; i < p->nb_subpolys; ++i) {
+    int32_t indx = init_indx;
+    double l = dash_offset;
+    int32_t fst = (i == 0) ? 0 : p->subpolys[i - 1] + 1;
+    if (init_indx % 2 == 0) {
+      polygon_add_point(dashed_poly, p->points[fst]);
+    }
+
+    for (int j = fst; j < p->subpolys[i]; ++j) {
+
+      point_t current_point = p->points[j];
+      point_t final_point = p->points[j + 1];
+      double dst = point_dist(current_point, final_point);
+      double line_x = (final_point.x - current_point.x) / dst;
+      double line_y = (final_point.y - current_point.y) / dst;
+
+      while (l + dst >= dash[indx]) {
+        double dst_to_cut = dash[indx] - l;
+        point_t cut_point = point(current_point.x + dst_to_cut * line_x,
+                                  current_point.y + dst_to_cut * line_y);
+        polygon_add_point(dashed_poly, cut_point);
+        if (indx % 2 == 0) {
+          polygon_end_subpoly(dashed_poly, false);
+        }
+        dst -= dash[indx] - l;
+        indx++;
+        indx %= dash_array_size;
+        l = 0;
+        current_point = cut_point;
+      }
+
+      if (l + dst < dash[indx]) {
+        l = l + dst;
+        if (indx % 2 == 0) {
+          polygon_add_point(dashed_poly, final_point);
+        }
+      }
+    }
+    polygon_end_subpoly(dashed_poly, false);
+  }
+
+  return dashed_poly;
 }
 
 void
@@ -246,281 +351,188 @@ polygon_offset(
   // Make dashed
   polygon_t *dashed_poly = NULL;
   if (dash_array_size > 0) {
-    dashed_poly = polygon_create(p->max_points * 2, p->max_subpolys * 2);
-
-    double dash_length = 0.0;
-    for (int32_t i = 0; i < dash_array_size; ++i) {
-      dash_length += dash[i];
-    }
-
-    int32_t init_indx = 0;
-    dash_offset -= dash_length * floor(dash_offset / dash_length);
-    while (dash_offset >= dash[init_indx]) {
-      dash_offset -= dash[init_indx];
-      init_indx++;
-    }
-
-    for (int32_t i = 0; i < p->nb_subpolys; ++i) {
-      int32_t indx = init_indx;
-      double l = dash_offset;
-      int32_t fst = (i == 0) ? 0 : p->subpolys[i - 1];
-      if (init_indx % 2 == 0) {
-        polygon_add_point(dashed_poly, p->points[fst]);
-      }
-
-      for (int j = fst; j < p->subpolys[i]; ++j) {
-        if (j == p->subpolys[i] && !p->subpoly_closed[i]) {
-          break;
-        }
-
-        point_t current_point = p->points[j];
-        point_t final_point = p->points[j == p->subpolys[i] ? fst : j + 1];
-        double dst = point_dist(current_point, final_point);
-        double line_x = (p->points[j+1].x - p->points[j].x) / dst;
-        double line_y = (p->points[j+1].y - p->points[j].y) / dst;
-
-        while (l + dst >= dash[indx]) {
-          double dst_to_cut = dash[indx] - l;
-          point_t cut_point = point(current_point.x + dst_to_cut * line_x,
-                                    current_point.y + dst_to_cut * line_y);
-          polygon_add_point(dashed_poly, cut_point);
-          if (indx % 2 == 0) {
-            polygon_end_subpoly(dashed_poly, false);
-          }
-          dst -= dash[indx] - l;
-          indx++;
-          indx %= dash_array_size;
-          l = 0;
-          current_point = cut_point;
-        }
-
-        if (l + dst < dash[indx]) {
-          l = l + dst;
-          if (indx % 2 == 0) {
-            polygon_add_point(dashed_poly, final_point);
-          }
-        }
-      }
-      polygon_end_subpoly(dashed_poly, false);
+    dashed_poly = _polygon_dash(p, dash, dash_array_size, dash_offset);
+    if (dashed_poly == NULL) {
+      return;
     }
-
     p = dashed_poly;
   }
 
   transform_t *lin = transform_extract_linear(transform);
   transform_t *inv_lin = transform_copy(lin);
+  point_t *vtx = (point_t *)calloc(max(1, p->nb_points), sizeof(point_t));
+  point_t *tan = (point_t *)calloc(max(1, p->nb_points), sizeof(point_t));
+  if ((lin == NULL) || (inv_lin == NULL) || (vtx == NULL) || (tan == NULL)) {
+    goto error;
+  }
   transform_inverse(inv_lin);
 
-  point_t p1o, p2o, p1n, p2n;
   double o = w / 2.0;
-  int iter = 5;
+  double step = _round_step(o * transform_get_max_scale(lin));
 
   for (int ip = 0; ip < p->nb_subpolys; ++ip) {
 
     int ifp = (ip == 0) ? 0 : p->subpolys[ip - 1] + 1;
+    bool closed = p->subpoly_closed[ip];
+
+    // Collect vertices (in device space) and segment tangents
+    // (in user space), dropping degenerate segments
+    int32_t m = 0;
+    vtx[0] = p->points[ifp];
+    for (int i = ifp + 1; i <= p->subpolys[ip]; ++i) {
+      point_t t = point(p->points[i].x - vtx[m].x,
+                        p->points[i].y - vtx[m].y);
+      transform_apply(inv_lin, &t);
+      double len = sqrt(t.x * t.x + t.y * t.y);
+      if (len > 0.0) {
+        tan[m] = point(t.x / len, t.y / len);
+        vtx[++m] = p->points[i];
+      }
+    }
 
     // Skip polygons with a single point
-    if (ifp == p->subpolys[ip]) {
+    if (m == 0) {
       continue;
     }
 
-    // Draw the "left" part
-
-    _line_offset(p->points[ifp], p->points[ifp + 1],
-                 -o, &p1o, &p2o, lin, inv_lin);
-    polygon_add_point(np, p1o);
-    polygon_add_point(np, p2o);
-
-    for (int i = ifp + 1; i < p->subpolys[ip]; ++i) {
-      _line_offset(p->points[i], p->points[i + 1],
-                   -o, &p1n, &p2n, lin, inv_lin);
-
-      // Add join if turning "right"
-      // TODO: don't bother if distance too small
-      if (point_position(p->points[i-1], p->points[i + 1], p->points[i]) > 0) {
-        switch (join_type) {
-          case JOIN_ROUND:
-            _arc_to_poly_transform_center(p->points[i], p2o, p1n, np,
-                                          iter, lin, inv_lin);
-            break;
-          case JOIN_MITER:
-            _miter_to_poly(p1o, p2o, p1n, p2n, np, miter_limit,
-                           p->points[i], w, inv_lin);
-            break;
-          case JOIN_BEVEL:
-            break;
-        }
-      }
-
-      polygon_add_point(np, p1n);
-      polygon_add_point(np, p2n);
+    // The outline is a single closed polygon: the left side
+    // forward, then the right side backward, joined by caps
+    // if the sub-path is open, or by a zero-width bridge
+    // between the two rings if it is closed
 
-      p1o = p1n;
-      p2o = p2n;
+    point_t t = tan[0];
+    polygon_add_point(np, _stroke_point(vtx[0], point(-t.y, t.x), o, lin));
+    for (int32_t i = 1; i < m; ++i) {
+      _stroke_join(np, vtx[i], tan[i - 1], tan[i], join_type,
+                   miter_limit, o, step, lin);
     }
 
-    // If closed, add a join
-    if (p->subpoly_closed[ip]) {
-      // Add join if turning "right"
-      // TODO: don't bother if distance too small
-      // Assume end and start point are equal
-      assert(point_equal(p->points[p->subpolys[ip]], p->points[ifp]));
-      _line_offset(p->points[ifp], p->points[ifp + 1],
-                   -o, &p1n, &p2n, lin, inv_lin);
-      if (point_position(p->points[p->subpolys[ip] - 1],
-                         p->points[ifp+1],
-                         p->points[ifp]) > 0) {
-        switch (join_type) {
-          case JOIN_ROUND:
-            _arc_to_poly_transform_center(p->points[ifp], p2o, p1n, np,
-                                          iter, lin, inv_lin);
-            break;
-          case JOIN_MITER:
-            _miter_to_poly(p1o, p2o, p1n, p2n, np, miter_limit,
-                           p->points[ifp], w, inv_lin);
-            break;
-          case JOIN_BEVEL:
-            break;
-        }
-      } else {
-        polygon_add_point(np, p1n);
-      }
-
-      polygon_end_subpoly(np, true);
-
-    // If not closed, add a line cap
+    if (closed) {
+      _stroke_join(np, vtx[0], tan[m - 1], tan[0], join_type,
+                   miter_limit, o, step, lin);
+      t = tan[m - 1];
+      polygon_add_point(np, _stroke_point(vtx[m], point(t.y, -t.x), o, lin));
     } else {
-      switch (cap_type) {
-        case CAP_BUTT:
-          break;
-        case CAP_SQUARE: {
-          double dist = point_dist(p->points[p->subpolys[ip] - 1],
-                                   p->points[p->subpolys[ip]]);
-          point_t new_p1 =
-            point(p2o.x + (p2o.x - p1o.x) / dist * o,
-                  p2o.y + (p2o.y - p1o.y) / dist * o);
-          p1o = p->points[p->subpolys[ip] - 1];
-          p2o = p->points[p->subpolys[ip]];
-          _line_offset(p1o, p2o, o, &p1n, &p2n, lin, inv_lin);
-          point_t new_p2 =
-            point(p2n.x + ((p2n.x - p1n.x) / dist) * o,
-                  p2n.y + ((p2n.y - p1n.y) / dist) * o);
-          polygon_add_point(np, new_p1);
-          polygon_add_point(np, new_p2);
-          break;
-        }
-        case CAP_ROUND: {
-          point_t new_p1 = point(p2o.x, p2o.y);
-          p1o = p->points[p->subpolys[ip] - 1];
-          p2o = p->points[p->subpolys[ip]];
-          _line_offset(p1o, p2o, o, &p1n, &p2n, lin, inv_lin);
-          _arc_to_poly_transform(new_p1, p2n, np, iter, lin, inv_lin);
-          break;
-        }
-      }
+      _stroke_cap(np, vtx[m], tan[m - 1], cap_type, o, step, lin);
     }
 
-    // Draw the "right" part
-
-    _line_offset(p->points[p->subpolys[ip]], p->points[p->subpolys[ip] - 1],
-                 -o, &p1o, &p2o, lin, inv_lin);
-    polygon_add_point(np, p1o);
-    polygon_add_point(np, p2o);
-
-    for (int i = p->subpolys[ip] - 1; i > ifp; --i) {
-      _line_offset(p->points[i], p->points[i - 1],
-                   -o, &p1n, &p2n, lin, inv_lin);
-
-      // Add round join if turning "right"
-      // TODO: don't bother if distance too small
-      if (point_position(p->points[i+1], p->points[i - 1], p->points[i]) > 0) {
-        switch(join_type) {
-          case JOIN_ROUND:
-            _arc_to_poly_transform_center(p->points[i], p2o, p1n, np,
-                                          iter, lin, inv_lin);
-            break;
-          case JOIN_MITER:
-            _miter_to_poly(p1o, p2o, p1n, p2n, np, miter_limit,
-                           p->points[i], w, inv_lin);
-            break;
-          case JOIN_BEVEL:
-            break;
-        }
-      }
-      polygon_add_point(np, p1n);
-      polygon_add_point(np, p2n);
-
-      p1o = p1n;
-      p2o = p2n;
+    for (int32_t i = m - 1; i > 0; --i) {
+      _stroke_join(np, vtx[i], point(-tan[i].x, -tan[i].y),
+                   point(-tan[i - 1].x, -tan[i - 1].y), join_type,
+                   miter_limit, o, step, lin);
     }
 
-    // If closed, add a join
-    if (p->subpoly_closed[ip]) {
-      // Add join if turning "right"
-      // TODO: don't bother if distance too small
-      // Assume end and start point are equal
-      assert(point_equal(p->points[p->subpolys[ip]], p->points[ifp]));
-      _line_offset(p->points[p->subpolys[ip]], p->points[p->subpolys[ip] - 1],
-                   -o, &p1n, &p2n, lin, inv_lin);
-      if (point_position(p->points[ifp+1],
-                         p->points[p->subpolys[ip]-1],
-                         p->points[ifp]) > 0) {
-        switch (join_type) {
-          case JOIN_ROUND:
-            _arc_to_poly_transform_center(p->points[ifp], p2o, p1n, np,
-                                          iter, lin, inv_lin);
-            break;
-          case JOIN_MITER:
-            _miter_to_poly(p1o, p2o, p1n, p2n, np, miter_limit,
-                           p->points[ifp], w, inv_lin);
-            break;
-          case JOIN_BEVEL:
-            break;
-        }
-      } else {
-        polygon_add_point(np, p1n);
-      }
-
-    // If not closed, add a line cap
+    t = tan[0];
+    if (closed) {
+      _stroke_join(np, vtx[0], point(-t.x, -t.y),
+                   point(-tan[m - 1].x, -tan[m - 1].y), join_type,
+                   miter_limit, o, step, lin);
     } else {
-      switch (cap_type) {
-        case CAP_BUTT:
-          break;
-        case CAP_SQUARE: {
-          double dist = point_dist(p1o,p2o);
-          point_t new_p1 =
-            point(p2o.x + (p2o.x - p1o.x) / dist * o,
-                  p2o.y + (p2o.y - p1o.y) / dist * o);
-          p1o = p->points[ifp + 1];
-          p2o = p->points[ifp];
-          _line_offset(p1o, p2o, o, &p1n, &p2n, lin, inv_lin);
-          point_t new_p2 =
-            point(p2n.x + (p2n.x - p1n.x) / dist * o,
-                  p2n.y + (p2n.y - p1n.y) / dist * o);
-          polygon_add_point(np,new_p1);
-          polygon_add_point(np,new_p2);
-          break;
-        }
-        case CAP_ROUND: {
-          point_t new_p1 = point(p2o.x, p2o.y);
-          p1o = p->points[ifp + 1];
-          p2o = p->points[ifp];
-          _line_offset(p1o, p2o, o, &p1n, &p2n, lin, inv_lin);
-          _arc_to_poly_transform(new_p1, p2n, np, iter, lin, inv_lin);
-          break;
-        }
-      }
+      _stroke_cap(np, vtx[0], point(-t.x, -t.y), cap_type, o, step, lin);
     }
 
     polygon_end_subpoly(np, true);
   }
 
+error:
+
+  if (tan != NULL) {
+    free(tan);
+  }
+
+  if (vtx != NULL) {
+    free(vtx);
+  }
+
+  if (inv_lin != NULL) {
+    transform_destroy(inv_lin);
+  }
+
+  if (lin != NULL) {
+    transform_destroy(lin);
+  }
+
   if (dashed_poly != NULL) {
     polygon_destroy(dashed_poly);
   }
+}
 
-  transform_destroy(lin);
-  transform_destroy(inv_lin);
+// Appends point k of p at index w, unless it repeats the previous one
+static void
+_decimate_emit(
+  polygon_t *p,
+  int32_t first,
+  int32_t *w,
+  int32_t k)
+{
+  assert(p != NULL);
+  assert(w != NULL);
+  assert(*w <= k);
+
+  if ((*w > first) && point_equal(p->points[*w - 1], p->points[k])) {
+    return;
+  }
+  p->points[(*w)++] = p->points[k];
+}
+
+// Collapses the runs of consecutive points falling in the same
+// device space column of width tolerance, keeping for each run its
+// first and last points, and those with the minimum and maximum
+// ordinate, so that the envelope of the path is preserved
+void
+polygon_decimate(
+  polygon_t *p,
+  double tolerance)
+{
+  assert(p != NULL);
+  assert(tolerance >= 0.0);
+
+  if (tolerance <= 0.0) {
+    return;
+  }
+
+  int32_t w = 0;
+  int32_t k = 0;
+
+  for (int32_t ip = 0; ip < p->nb_subpolys; ++ip) {
+
+    int32_t first = w;
+    int32_t last = p->subpolys[ip];
+
+    while (k <= last) {
+
+      // Find the run starting at k
+      double column = floor(p->points[k].x / tolerance);
+      int32_t kmin = k, kmax = k, e = k;
+      while ((e < last) &&
+             (floor(p->points[e + 1].x / tolerance) == column)) {
+        ++e;
+        if (p->points[e].y < p->points[kmin].y) { kmin = e; }
+        if (p->points[e].y > p->points[kmax].y) { kmax = e; }
+      }
+
+      // Emit its extreme points in path order
+      if (kmin > kmax) {
+        swap(int32_t, kmin, kmax);
+      }
+      _decimate_emit(p, first, &w, k);
+      if (kmin != k) {
+        _decimate_emit(p, first, &w, kmin);
+      }
+      if ((kmax != kmin) && (kmax != k)) {
+        _decimate_emit(p, first, &w, kmax);
+      }
+      if ((e != kmax) && (e != k)) {
+        _decimate_emit(p, first, &w, e);
+      }
+
+      k = e + 1;
+    }
+
+    p->subpolys[ip] = w - 1;
+  }
+
+  p->nb_points = w;
 }
 
 bool
@@ -606,7 +618,8 @@ polygonize_outline(
   bool only_linear,
   const double *dash,
   int32_t dash_array_size,
-  double dash_offset)
+  double dash_offset,
+  double tolerance)
 {
   assert(path != NULL);
   assert(w > 0.0);
@@ -627,32 +640,25 @@ polygonize_outline(
     return false;
   }
 
+  // Decimation happens in device space; dashed paths are
+  // left intact so as not to alter the dash pattern
+  if (!only_linear) {
+    for (int i = 0; i < tp->nb_points; i++) {
+      transform_apply(transform, &(tp->points[i]));
+    }
+  }
+  if (dash_array_size == 0) {
+    polygon_decimate(tp, tolerance);
+  }
+
   polygon_offset(tp, p, w, join_type, cap_type, miter_limit, transform,
-                 only_linear, dash, dash_array_size, dash_offset);
+                 true, dash, dash_array_size, dash_offset);
 
   polygon_destroy(tp);
 
-  if (!only_linear) {
-    point_t pt1 = transform_apply_new(transform, &bbox->p1);
-    point_t pt2 = transform_apply_new(transform, &bbox->p2);
-    point_t bp3 = point(bbox->p2.x, bbox->p1.y);
-    point_t bp4 = point(bbox->p1.x, bbox->p2.y);
-    point_t pt3 = transform_apply_new(transform, &bp3);
-    point_t pt4 = transform_apply_new(transform, &bp4);
-    double xmin = min(pt1.x, min(pt2.x, min(pt3.x, pt4.x)));
-    double ymin = min(pt1.y, min(pt2.y, min(pt3.y, pt4.y)));
-    double xmax = max(pt1.x, max(pt2.x, max(pt3.x, pt4.x)));
-    double ymax = max(pt1.y, max(pt2.y, max(pt3.y, pt4.y)));
-    bbox->p1 = point(xmin, ymin);
-    bbox->p2 = point(xmax, ymax);
-  }
-
-  double a, b, c, d;
-  transform_extract_ft(transform, &a, &b, &c, &d);
-  //TODO : Improve this (probably) not optimal coefficient
-  double inf_norm = fabs(a) + fabs(b) + fabs(c) + fabs(d);
-  bbox->p1.x -= inf_norm * w; bbox->p1.y -= inf_norm * w;
-  bbox->p2.x += inf_norm * w; bbox->p2.y += inf_norm * w;
+  // The outline is in device space: its exact bounds account
+  // for the transform, the joins and the caps at once
+  polygon_bbox(p, bbox);
 
   return true;
 }
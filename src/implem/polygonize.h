@@ -50,6 +50,11 @@ bezier_to_poly(
   polygon_t *p,
   int n);
 
+void
+polygon_decimate(
+  polygon_t *p,
+  double tolerance);
+
 bool
 polygonize(
   path_t *path,
@@ -69,7 +74,8 @@ polygonize_outline(
   bool only_linear,
   const double *dash,
   int32_t dash_array_size,
-  double dash_offset);
+  double dash_offset,
+  double tolerance);
 
 void
 polygon_offset(
@@ -71,36 +71,28 @@ typedef struct qtz_sw_context_t {
 
 @end
 
+// The bitmap context only describes the buffer, which remains ours
 static CGContextRef
 _qtz_sw_context_create_bitmap_context(
   int32_t width,
   int32_t height,
-  color_t_ **data)
+  color_t_ *data)
 {
   assert(width > 0);
   assert(height > 0);
   assert(data != NULL);
 
-  *data = (color_t_ *)calloc(width * height, sizeof(color_t_));
-  if (*data == NULL) {
-    return NULL;
-  }
-
   CGColorSpaceRef cs = CGColorSpaceCreateWithName(kCGColorSpaceGenericRGB);
   if (cs == NULL) {
-    free(*data);
-    *data = NULL;
     return NULL;
   }
 
   CGContextRef ctxt =
-    CGBitmapContextCreate((void *)*data, width, height, 8, width * 4, cs,
+    CGBitmapContextCreate((void *)data, width, height, 8, width * 4, cs,
                           kCGImageAlphaPremultipliedFirst |
                           kCGBitmapByteOrder32Little);
   if (ctxt == NULL) {
     CGColorSpaceRelease(cs);
-    free(*data);
-    *data = NULL;
     return NULL;
   }
 
@@ -126,15 +118,19 @@ qtz_sw_context_create(
     return NULL;
   }
 
-  color_t_ *data = NULL;
+  color_t_ *data = (color_t_ *)calloc(width * height, sizeof(color_t_));
+  if (data == NULL) {
+    free(context);
+    return NULL;
+  }
+
   CGContextRef ctxt =
-    _qtz_sw_context_create_bitmap_context(width, height, &data);
+    _qtz_sw_context_create_bitmap_context(width, height, data);
   if (ctxt == NULL) {
-    assert(data == NULL);
+    free(data);
     free(context);
     return NULL;
   }
-  assert(data != NULL);
 
   ALLOC_POOL; // don't know if necessary here
 
@@ -149,6 +145,7 @@ qtz_sw_context_create(
   context->base.base.width = width;
   context->base.base.height = height;
   context->base.data = data;
+  context->base.capacity = (size_t)width * height;
   context->ctxt = ctxt;
   context->nsview = nsview;
 
@@ -187,22 +184,36 @@ qtz_sw_context_resize(
   assert(width > 0);
   assert(height > 0);
 
-  color_t_ *data = NULL;
+  // Within the capacity of the buffer, only the context is recreated
+  size_t capacity = _sw_context_capacity(&context->base, width, height);
+  color_t_ *data = context->base.data;
+  if (capacity != context->base.capacity) {
+    data = (color_t_ *)malloc(capacity * sizeof(color_t_));
+    if (data == NULL) {
+      return false;
+    }
+  }
+
   CGContextRef ctxt =
-    _qtz_sw_context_create_bitmap_context(width, height, &data);
+    _qtz_sw_context_create_bitmap_context(width, height, data);
   if (ctxt == NULL) {
-    assert(data == NULL);
+    if (data != context->base.data) {
+      free(data);
+    }
     return false;
   }
-  assert(data != NULL);
 
   _sw_context_copy_to_buffer(&context->base, data, width, height);
 
   CGContextRelease(context->ctxt);
+  if (data != context->base.data) {
+    free(context->base.data);
+  }
 
   context->base.base.width = width;
   context->base.base.height = height;
   context->base.data = data;
+  context->base.capacity = capacity;
   context->ctxt = ctxt;
 
   return true;
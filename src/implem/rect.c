@@ -9,8 +9,10 @@
 /**************************************************************************/
 
 #include <stddef.h>
+#include <stdbool.h>
 #include <assert.h>
 
+#include "util.h"
 #include "point.h"
 #include "rect.h"
 
@@ -34,3 +36,27 @@ rect_expand(
     r->p2.y = p.y;
   }
 }
+
+void
+rect_intersect(
+  rect_t *r,
+  const rect_t *o)
+{
+  assert(r != NULL);
+  assert(o != NULL);
+
+  r->p1.x = max(r->p1.x, o->p1.x);
+  r->p1.y = max(r->p1.y, o->p1.y);
+  r->p2.x = min(r->p2.x, o->p2.x);
+  r->p2.y = min(r->p2.y, o->p2.y);
+}
+
+// Note: a rectangle with NaN coordinates is not considered empty
+bool
+rect_empty(
+  const rect_t *r)
+{
+  assert(r != NULL);
+
+  return (r->p1.x >= r->p2.x) || (r->p1.y >= r->p2.y);
+}
@@ -11,6 +11,8 @@
 #ifndef __RECT_H
 #define __RECT_H
 
+#include <stdbool.h>
+
 #include "point.h"
 
 typedef struct rect_t {
@@ -26,4 +28,13 @@ rect_expand(
   rect_t *r,
   point_t p);
 
+void
+rect_intersect(
+  rect_t *r,
+  const rect_t *o);
+
+bool
+rect_empty(
+  const rect_t *r);
+
 #endif /* __RECT_H */
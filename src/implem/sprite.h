@@ -0,0 +1,31 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef __SPRITE_H
+#define __SPRITE_H
+
+// Layout of a sprite in a batch of sprites, stored as
+// consecutive doubles: the source rectangle in the atlas,
+// the destination position, a scaling factor, a rotation
+// angle (around the center of the sprite) and an opacity
+typedef enum sprite_field_t {
+  SPRITE_SX       = 0,
+  SPRITE_SY       = 1,
+  SPRITE_SW       = 2,
+  SPRITE_SH       = 3,
+  SPRITE_DX       = 4,
+  SPRITE_DY       = 5,
+  SPRITE_SCALE    = 6,
+  SPRITE_ROTATION = 7,
+  SPRITE_ALPHA    = 8,
+  SPRITE_SIZE     = 9
+} sprite_field_t;
+
+#endif /* __SPRITE_H */
@@ -12,21 +12,25 @@
 #include <assert.h>
 
 #include "util.h"
-#include "list.h"
+#include "object.h"
+#include "rect.h"
 #include "color.h"
 #include "transform.h"
 #include "font_desc.h"
 #include "draw_style.h"
 #include "polygonize.h"
 #include "color_composition.h"
-#include "draw_instr.h"
+#include "clip_path.h"
+#include "filters.h"
 #include "state.h"
 
+IMPLEMENT_OBJECT_METHODS(state_t, state, _state_destroy)
+
 state_t *
 state_create(
   void)
 {
-  state_t *s = (state_t *)calloc(1, sizeof(state_t));
+  state_t *s = state_alloc();
   if (s == NULL) {
     return NULL;
   }
@@ -44,15 +48,9 @@ state_create(
     return NULL;
   }
 
-  s->clip_path = list_new((free_val_fun_t *)path_fill_instr_destroy);
-  if (s->clip_path == NULL) {
-    transform_destroy(s->transform);
-    font_desc_destroy(s->font_desc);
-    free(s);
-    return NULL;
-  }
-
+  s->clip_path = NULL;
   s->line_dash = NULL;
+  s->filters = NULL;
 
   s->fill_style.type = DRAW_STYLE_COLOR;
   s->stroke_style.type = DRAW_STYLE_COLOR;
@@ -62,39 +60,59 @@ state_create(
   return s;
 }
 
-void
-state_destroy(
+static void
+_state_destroy(
   state_t *s)
 {
   assert(s != NULL);
   assert(s->transform != NULL);
   assert(s->font_desc != NULL);
-  assert(s->clip_path != NULL);
 
   draw_style_destroy(&s->fill_style);
   draw_style_destroy(&s->stroke_style);
-  list_delete(s->clip_path);
+  if (s->clip_path != NULL) {
+    clip_path_release(s->clip_path);
+  }
   if (s->line_dash != NULL) {
     free(s->line_dash);
   }
-  font_desc_destroy(s->font_desc);
+  if (s->filters != NULL) {
+    free(s->filters);
+  }
+  font_desc_release(s->font_desc);
   transform_destroy(s->transform);
 
   free(s);
 }
 
-void
+// Only valid on a state that is not shared
+bool
 state_reset(
   state_t *s)
 {
   assert(s != NULL);
   assert(s->transform != NULL);
   assert(s->font_desc != NULL);
-  assert(s->clip_path != NULL);
+  assert(object_is_shared(s) == false);
 
   transform_reset(s->transform);
-  font_desc_reset(s->font_desc);
-  list_reset(s->clip_path);
+
+  if (object_is_shared(s->font_desc) == true) {
+    font_desc_t *fd = font_desc_create();
+    if (fd == NULL) {
+      return false;
+    }
+    font_desc_release(s->font_desc);
+    s->font_desc = fd;
+  } else {
+    font_desc_reset(s->font_desc);
+  }
+
+  if (s->clip_path != NULL) {
+    clip_path_release(s->clip_path);
+  }
+
+  s->clip_path = NULL;
 
   if (s->line_dash != NULL) {
     free(s->line_dash);
@@ -114,10 +132,12 @@ state_reset(
   draw_style_destroy(&s->fill_style);
   s->fill_style.type = DRAW_STYLE_COLOR;
   s->fill_style.content.color = color_white;
+  s->fill_style.smoothing = IMAGE_SMOOTHING_MEDIUM;
 
   draw_style_destroy(&s->stroke_style);
   s->stroke_style.type = DRAW_STYLE_COLOR;
   s->stroke_style.content.color = color_black;
+  s->stroke_style.smoothing = IMAGE_SMOOTHING_MEDIUM;
 
   s->shadow.offset_x = 0;
   s->shadow.offset_y = 0;
@@ -125,8 +145,18 @@ state_reset(
   s->shadow.color = color_transparent_black;
 
   s->global_composite_operation = SOURCE_OVER;
+
+  if (s->filters != NULL) {
+    free(s->filters);
+  }
+
+  s->filters = NULL;
+  s->nb_filters = 0;
+
+  return true;
 }
 
+// The copy shares the clip path and font description of s
 state_t *
 state_copy(
   const state_t *s)
@@ -134,9 +164,8 @@ state_copy(
   assert(s != NULL);
   assert(s->transform != NULL);
   assert(s->font_desc != NULL);
-  assert(s->clip_path != NULL);
 
-  state_t *sc = (state_t *)calloc(1, sizeof(state_t));
+  state_t *sc = state_alloc();
   if (sc == NULL) {
     return NULL;
   }
@@ -147,51 +176,37 @@ state_copy(
     return NULL;
   }
 
-  sc->font_desc = font_desc_copy(s->font_desc);
-  if (sc->font_desc == NULL) {
-    transform_destroy(sc->transform);
-    free(sc);
-    return NULL;
-  }
-
-  sc->clip_path = list_new((free_val_fun_t*)path_fill_instr_destroy);
-  if (sc->clip_path == NULL) {
-    transform_destroy(sc->transform);
-    font_desc_destroy(sc->font_desc);
-    free(sc);
-    return NULL;
-  }
-
-  if (s->line_dash) {
+  sc->line_dash = NULL;
+  if (s->line_dash != NULL) {
     sc->line_dash =
-      (double *)memdup(sc->line_dash, s->line_dash_len * sizeof(double));
+      (double *)memdup(s->line_dash, s->line_dash_len * sizeof(double));
     if (sc->line_dash == NULL) {
       transform_destroy(sc->transform);
-      font_desc_destroy(sc->font_desc);
-      list_delete(s->clip_path);
       free(sc);
+      return NULL;
     }
   }
 
-  list_iterator_t *it = list_get_iterator(s->clip_path);
-  if (it == NULL) {
-    transform_destroy(sc->transform);
-    font_desc_destroy(sc->font_desc);
-    list_delete(s->clip_path);
-    if (sc->line_dash != NULL) {
-      free(sc->line_dash);
+  sc->filters = NULL;
+  if (s->filters != NULL) {
+    sc->filters =
+      (filter_t *)memdup(s->filters, s->nb_filters * sizeof(filter_t));
+    if (sc->filters == NULL) {
+      if (sc->line_dash != NULL) {
+        free(sc->line_dash);
+      }
+      transform_destroy(sc->transform);
+      free(sc);
+      return NULL;
     }
-    free(sc);
-    return NULL;
   }
+  sc->nb_filters = s->nb_filters;
 
-  path_fill_instr_t *instr = NULL;
-  while ((instr = (path_fill_instr_t *)list_iterator_next(it)) != NULL) {
-    path_fill_instr_t *copy =
-      path_fill_instr_create(instr->poly, instr->non_zero);
-    list_push(sc->clip_path, copy);
+  sc->font_desc = font_desc_retain(s->font_desc);
+  sc->clip_path = NULL;
+  if (s->clip_path != NULL) {
+    sc->clip_path = clip_path_retain(s->clip_path);
   }
-  list_free_iterator(it);
 
   sc->line_dash_len = s->line_dash_len;
   sc->line_dash_offset = s->line_dash_offset;
@@ -13,14 +13,17 @@
 
 #include <stdint.h>
 
-#include "list.h"
+#include "object.h"
+#include "rect.h"
 #include "color.h"
 #include "transform.h"
 #include "font_desc.h"
 #include "draw_style.h"
 #include "polygonize.h"
 #include "path2d.h"
+#include "clip_path.h"
 #include "color_composition.h"
+#include "filters.h"
 
 typedef struct shadow_t {
   double offset_x;
@@ -29,11 +32,16 @@ typedef struct shadow_t {
   color_t_ color;
 } shadow_t;
 
+// States are shared between the canvas and its save stack until
+// either side modifies them; the clip path and font description
+// are shared between states as well, and are never modified once
+// shared
 typedef struct state_t {
+  INHERITS_OBJECT;
   transform_t *transform;
 
   /* Polygonizer state */
-  list_t *clip_path;
+  clip_path_t *clip_path; // NULL if not clipped
   font_desc_t *font_desc; // font, textAlign, textBaseline, direction
   join_type_t join_type; // lineJoin
   cap_type_t cap_type; // lineCap
@@ -49,18 +57,18 @@ typedef struct state_t {
   draw_style_t stroke_style;
   shadow_t shadow;
   composite_operation_t global_composite_operation;
+  int32_t nb_filters;
+  filter_t *filters; // filter, applied through a layer
 
 } state_t;
 
+DECLARE_OBJECT_METHODS(state_t, state)
+
 state_t *
 state_create(
   void);
 
-void
-state_destroy(
-  state_t *s);
-
-void
+bool
 state_reset(
   state_t *s);
 
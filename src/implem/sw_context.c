@@ -11,6 +11,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <math.h>
 #include <assert.h>
 
 #include "config.h"
@@ -22,12 +24,18 @@
 #include "polygon.h"
 #include "transform.h"
 #include "draw_style.h"
-#include "list.h"
 #include "state.h" // for shadow_t
+#include "filters.h"
 
 #include "draw_instr.h"
+#include "clip_path.h"
+#include "pattern.h"
+#include "picture.h"
 #include "poly_render.h"
+#include "worker_pool.h"
+#include "buffer_pool.h"
 #include "impexp.h"
+#include "sprite.h"
 
 #ifdef HAS_GDI
 #include "gdi/gdi_sw_context.h"
@@ -53,14 +61,15 @@ sw_context_create(
   assert(width > 0);
   assert(height > 0);
 
-  color_t_ *data = (color_t_ *)calloc(width * height, sizeof(color_t_));
+  color_t_ *data = (color_t_ *)
+    buffer_pool_acquire(pixmap_size(width, height), true);
   if (data == NULL) {
     return NULL;
   }
 
   sw_context_t *c = (sw_context_t *)calloc(1, sizeof(sw_context_t));
   if (c == NULL) {
-    free(data);
+    buffer_pool_release(data, pixmap_size(width, height));
     return NULL;
   }
 
@@ -68,6 +77,7 @@ sw_context_create(
   c->base.width = width;
   c->base.height = height;
   c->data = data;
+  c->capacity = (size_t)width * height;
   c->clip_region = pixmap_null();
 
   return c;
@@ -89,6 +99,7 @@ sw_context_create_from_pixmap(
   c->base.width = pixmap->width;
   c->base.height = pixmap->height;
   c->data = pixmap->data;
+  c->capacity = (size_t)pixmap->width * pixmap->height;
   c->clip_region = pixmap_null();
 
   pixmap->data = NULL;
@@ -134,6 +145,148 @@ sw_context_create_onscreen(
   return c;
 }
 
+// Drops the topmost layer and restores the surface below it
+static color_t_ *
+_sw_context_remove_layer(
+  sw_context_t *c)
+{
+  assert(c != NULL);
+  assert(c->layer != NULL);
+
+  sw_layer_t *layer = c->layer;
+  color_t_ *data = c->data;
+
+  if (pixmap_valid(c->clip_region) == true) {
+    pixmap_destroy(c->clip_region);
+  }
+
+  c->data = layer->data;
+  c->clip_region = layer->clip_region;
+  c->layer = layer->below;
+
+  free(layer);
+
+  return data;
+}
+
+static bool
+_sw_context_draw_shadows(
+  const shadow_t *shadow,
+  composite_operation_t compose_op)
+{
+  assert(shadow != NULL);
+
+  return
+    (shadow->blur > 0.0 ||
+     shadow->offset_x != 0.0 || shadow->offset_y != 0.0) &&
+    compose_op != COPY && shadow->color.a != 0;
+}
+
+// Layers are not cleared when pushed: an area is only made
+// transparent the first time it is drawn to or read from; the
+// cleared area grows to the bounding box of the areas requested
+static void
+_sw_context_clear_layer(
+  sw_context_t *c,
+  int32_t x1,
+  int32_t y1,
+  int32_t x2,
+  int32_t y2)
+{
+  assert(c != NULL);
+
+  sw_layer_t *l = c->layer;
+  if ((l == NULL) || (x1 >= x2) || (y1 >= y2)) {
+    return;
+  }
+
+  // Bounding box of the cleared area and the requested one
+  int32_t bx1 = x1, by1 = y1, bx2 = x2, by2 = y2;
+  if (l->cx1 < l->cx2) {
+    bx1 = min(bx1, l->cx1); by1 = min(by1, l->cy1);
+    bx2 = max(bx2, l->cx2); by2 = max(by2, l->cy2);
+  } else {
+    l->cx1 = l->cx2 = bx1;
+    l->cy1 = l->cy2 = by1;
+  }
+
+  // Only clear what lies outside of the area already cleared
+  for (int32_t y = by1; y < by2; ++y) {
+    color_t_ *row = &c->data[(size_t)y * c->base.width];
+    if ((y < l->cy1) || (y >= l->cy2)) {
+      memset(&row[bx1], 0, (size_t)(bx2 - bx1) * COLOR_SIZE);
+    } else {
+      memset(&row[bx1], 0, (size_t)(l->cx1 - bx1) * COLOR_SIZE);
+      memset(&row[l->cx2], 0, (size_t)(bx2 - l->cx2) * COLOR_SIZE);
+    }
+  }
+
+  l->cx1 = bx1; l->cy1 = by1;
+  l->cx2 = bx2; l->cy2 = by2;
+}
+
+// Marks the whole topmost layer as drawn to
+static void
+_sw_context_damage_all(
+  sw_context_t *c)
+{
+  assert(c != NULL);
+
+  if (c->layer != NULL) {
+    _sw_context_clear_layer(c, 0, 0, c->base.width, c->base.height);
+    c->layer->x1 = 0;
+    c->layer->y1 = 0;
+    c->layer->x2 = c->base.width;
+    c->layer->y2 = c->base.height;
+  }
+}
+
+// Marks a device space area of the topmost layer as drawn to, with
+// a margin for antialiasing; operations that affect the whole surface
+// or cast a shadow mark the whole layer
+static void
+_sw_context_damage(
+  sw_context_t *c,
+  rect_t area,
+  const shadow_t *shadow,
+  composite_operation_t compose_op)
+{
+  assert(c != NULL);
+
+  sw_layer_t *l = c->layer;
+  if (l == NULL) {
+    return;
+  }
+
+  if ((comp_is_full_screen(compose_op) == true) ||
+      ((shadow != NULL) &&
+       (_sw_context_draw_shadows(shadow, compose_op) == true))) {
+    _sw_context_damage_all(c);
+    return;
+  }
+
+  double x1 = max(floor(min(area.p1.x, area.p2.x)) - 1.0, 0.0);
+  double y1 = max(floor(min(area.p1.y, area.p2.y)) - 1.0, 0.0);
+  double x2 = min(ceil(max(area.p1.x, area.p2.x)) + 1.0,
+                  (double)c->base.width);
+  double y2 = min(ceil(max(area.p1.y, area.p2.y)) + 1.0,
+                  (double)c->base.height);
+  if (!(x1 < x2) || !(y1 < y2)) {
+    return;
+  }
+
+  _sw_context_clear_layer(c, (int32_t)x1, (int32_t)y1,
+                          (int32_t)x2, (int32_t)y2);
+
+  if (l->x1 >= l->x2) {
+    l->x1 = (int32_t)x1; l->y1 = (int32_t)y1;
+    l->x2 = (int32_t)x2; l->y2 = (int32_t)y2;
+  } else {
+    l->x1 = min(l->x1, (int32_t)x1); l->y1 = min(l->y1, (int32_t)y1);
+    l->x2 = max(l->x2, (int32_t)x2); l->y2 = max(l->y2, (int32_t)y2);
+  }
+}
+
 void
 sw_context_destroy(
   sw_context_t *c)
@@ -141,12 +294,17 @@ sw_context_destroy(
   assert(c != NULL);
   assert(c->data != NULL);
 
+  while (c->layer != NULL) {
+    buffer_pool_release(_sw_context_remove_layer(c),
+                        pixmap_size(c->base.width, c->base.height));
+  }
+
   if (pixmap_valid(c->clip_region) == true) {
     pixmap_destroy(c->clip_region);
   }
 
   if (c->base.offscreen == true) {
-    free(c->data);
+    buffer_pool_release(c->data, c->capacity * COLOR_SIZE);
     free(c);
   } else {
     switch_IMPL() {
@@ -159,6 +317,9 @@ sw_context_destroy(
   }
 }
 
+// Copies the contents of the context to a buffer laid out for a new
+// size, which may be the current buffer if it is large enough; the
+// pixels the current contents do not cover are cleared
 void
 _sw_context_copy_to_buffer(
   sw_context_t *c,
@@ -174,13 +335,54 @@ _sw_context_copy_to_buffer(
   assert(width > 0);
   assert(height > 0);
 
-  uint32_t min_width = width < c->base.width ? width : c->base.width;
-  uint32_t min_height = height < c->base.height ? height : c->base.height;
-  for (size_t i = 0; i < min_height; ++i) {
-    for (size_t j = 0; j < min_width; ++j) {
-      data[i * width + j] = c->data[i * c->base.width + j];
+  int32_t min_width = min(width, c->base.width);
+  int32_t min_height = min(height, c->base.height);
+
+  // Rows move towards the end of the buffer when widening, and
+  // towards its start otherwise, so when copying within the same
+  // buffer they are moved in an order that never overwrites a
+  // row not moved yet
+  if (width > c->base.width) {
+    for (int32_t i = min_height - 1; i >= 0; --i) {
+      memmove(&data[(size_t)i * width],
+              &c->data[(size_t)i * c->base.width],
+              min_width * COLOR_SIZE);
+      memset(&data[(size_t)i * width + min_width], 0,
+             (width - min_width) * COLOR_SIZE);
     }
+  } else {
+    for (int32_t i = 0; i < min_height; ++i) {
+      memmove(&data[(size_t)i * width],
+              &c->data[(size_t)i * c->base.width],
+              min_width * COLOR_SIZE);
+    }
+  }
+
+  if (height > min_height) {
+    memset(&data[(size_t)min_height * width], 0,
+           pixmap_size(width, height - min_height));
+  }
+}
+
+// Number of pixels to allocate for the surface when resizing it:
+// the current buffer is kept if large enough, unless it would become
+// mostly unused, and grown geometrically otherwise, so that
+// interactive resizes seldom have to reallocate
+size_t
+_sw_context_capacity(
+  const sw_context_t *c,
+  int32_t width,
+  int32_t height)
+{
+  assert(c != NULL);
+  assert(width > 0);
+  assert(height > 0);
+
+  size_t needed = (size_t)width * height;
+  if (needed <= c->capacity) {
+    return (needed >= c->capacity / 4) ? c->capacity : needed;
   }
+  return max(needed, c->capacity + c->capacity / 2);
 }
 
 bool
@@ -193,6 +395,7 @@ sw_context_resize(
   assert(c->base.width > 0);
   assert(c->base.height > 0);
   assert(c->data != NULL);
+  assert(c->layer == NULL);
 
   if ((width <= 0) || (height <= 0)) {
     return false;
@@ -210,18 +413,25 @@ sw_context_resize(
 
   if (c->base.offscreen == true) {
 
-    color_t_ *data = (color_t_ *)calloc(width * height, sizeof(color_t_));
-    if (data == NULL) {
-      return false;
+    size_t capacity = _sw_context_capacity(c, width, height);
+    color_t_ *data = c->data;
+    if (capacity != c->capacity) {
+      data = (color_t_ *)buffer_pool_acquire(capacity * COLOR_SIZE, false);
+      if (data == NULL) {
+        return false;
+      }
     }
 
     _sw_context_copy_to_buffer(c, data, width, height);
 
-    free(c->data);
+    if (data != c->data) {
+      buffer_pool_release(c->data, c->capacity * COLOR_SIZE);
+    }
 
     c->base.width = width;
     c->base.height = height;
     c->data = data;
+    c->capacity = capacity;
 
     return true;
 
@@ -276,6 +486,19 @@ _sw_context_get_raw_pixmap(
   return pixmap(c->base.width, c->base.height, c->data);
 }
 
+// Direct access to the context pixels, for reading them all:
+// the topmost layer is entirely cleared first
+static pixmap_t
+_sw_context_get_cleared_pixmap(
+  sw_context_t *c)
+{
+  assert(c != NULL);
+
+  _sw_context_clear_layer(c, 0, 0, c->base.width, c->base.height);
+
+  return _sw_context_get_raw_pixmap(c);
+}
+
 static void
 _sw_context_clip_fill_instr(
   sw_context_t *c,
@@ -306,7 +529,7 @@ _sw_context_clip_fill_instr(
 bool
 sw_context_clip(
   sw_context_t *c,
-  list_t *clip_path,
+  const clip_path_t *clip_path,
   const transform_t *transform)
 {
   assert(c != NULL);
@@ -328,18 +551,10 @@ sw_context_clip(
 
   pixmap_clear(c->clip_region);
 
-  list_iterator_t *it = list_get_iterator(clip_path);
-  if (it == NULL) {
-    return false;
-  }
-
-  path_fill_instr_t *instr = NULL;
-  while ((instr = (path_fill_instr_t *)list_iterator_next(it)) != NULL) {
-    _sw_context_clip_fill_instr(c, instr, transform);
+  for (const clip_path_t *cp = clip_path; cp != NULL; cp = cp->next) {
+    _sw_context_clip_fill_instr(c, cp->instr, transform);
   }
 
-  list_free_iterator(it);
-
   return true;
 }
 
@@ -354,6 +569,31 @@ sw_context_clear_clip(
   }
 }
 
+// Selects the mipmap level of patterns, which are built on demand:
+// renderers use the level as is, so that they only read patterns
+static void
+_sw_context_select_level(
+  draw_style_t *draw_style,
+  const transform_t *transform)
+{
+  assert(draw_style != NULL);
+  assert(transform != NULL);
+
+  draw_style->level = 0;
+  if ((draw_style->type != DRAW_STYLE_PATTERN) ||
+      (draw_style->smoothing == IMAGE_SMOOTHING_OFF)) {
+    return;
+  }
+
+  transform_t *inverse = transform_copy(transform);
+  if (inverse != NULL) {
+    transform_inverse(inverse);
+    draw_style->level =
+      pattern_select_level(draw_style->content.pattern, inverse);
+    transform_destroy(inverse);
+  }
+}
+
 void
 sw_context_render_polygon(
   sw_context_t *c,
@@ -372,11 +612,686 @@ sw_context_render_polygon(
   assert(shadow != NULL);
   assert(transform != NULL);
 
+  _sw_context_select_level(&draw_style, transform);
+
+  _sw_context_damage(c, *bbox, shadow, compose_op);
+
   pixmap_t pm = pixmap(c->base.width, c->base.height, c->data);
   poly_render(&pm, p, bbox, draw_style, global_alpha, shadow, compose_op,
               &(c->clip_region), non_zero, transform);
 }
 
+void
+sw_context_render_hairline(
+  sw_context_t *c,
+  const polygon_t *p,
+  draw_style_t draw_style,
+  double global_alpha,
+  double width,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(p != NULL);
+  assert(transform != NULL);
+
+  _sw_context_select_level(&draw_style, transform);
+
+  if (c->layer != NULL) {
+    rect_t bbox = { 0 };
+    polygon_bbox(p, &bbox);
+    _sw_context_damage(c, bbox, NULL, compose_op);
+  }
+
+  pixmap_t pm = pixmap(c->base.width, c->base.height, c->data);
+  poly_render_hairline(&pm, p, draw_style, global_alpha, width, compose_op,
+                       &(c->clip_region), NULL, transform);
+}
+
+#define SW_BAND_HEIGHT 32
+
+typedef struct sw_band_job_t {
+  pixmap_t pm;
+  const pixmap_t *clip_region;
+  const picture_instr_t *instrs;
+  const int32_t *levels; // pattern mipmap level of each instruction
+  const int32_t *band_start; // first entry of each band in band_instrs
+  const int32_t *band_instrs; // instruction indices, in order for each band
+} sw_band_job_t;
+
+// Computes the range of bands touched by an instruction
+static bool
+_sw_context_instr_bands(
+  const sw_context_t *c,
+  const picture_instr_t *pi,
+  int32_t *b1, // out
+  int32_t *b2) // out
+{
+  assert(c != NULL);
+  assert(pi != NULL);
+  assert(b1 != NULL);
+  assert(b2 != NULL);
+
+  // Antialiased lines may spill over the pixels around their bounding box
+  double m = (pi->type == PICTURE_INSTR_HAIRLINE) ? 1.0 : 0.0;
+  double x1 = max(floor(pi->bbox.p1.x - m), 0.0);
+  double y1 = max(floor(pi->bbox.p1.y - m), 0.0);
+  double x2 = min(floor(pi->bbox.p2.x + m), (double)c->base.width - 1.0);
+  double y2 = min(floor(pi->bbox.p2.y + m), (double)c->base.height - 1.0);
+  if (!(x1 <= x2) || !(y1 <= y2)) {
+    return false;
+  }
+
+  *b1 = (int32_t)y1 / SW_BAND_HEIGHT;
+  *b2 = (int32_t)y2 / SW_BAND_HEIGHT;
+
+  return true;
+}
+
+// Renders the instructions binned to bands [first; last[,
+// restricting each of them to the rows of the band; each row
+// of a polygon is clipped once for the whole width of the band
+static void
+_sw_context_render_bands(
+  void *data,
+  int32_t first,
+  int32_t last)
+{
+  sw_band_job_t *job = (sw_band_job_t *)data;
+
+  for (int32_t b = first; b < last; ++b) {
+
+    double by = (double)(b * SW_BAND_HEIGHT);
+    rect_t area = rect(point(0.0, by),
+                       point((double)job->pm.width, by + SW_BAND_HEIGHT));
+
+    for (int32_t k = job->band_start[b]; k < job->band_start[b + 1]; ++k) {
+
+      int32_t i = job->band_instrs[k];
+      const picture_instr_t *pi = &job->instrs[i];
+
+      // Mipmaps are built on demand, so the level is selected beforehand
+      draw_style_t style = pi->style;
+      style.level = job->levels[i];
+
+      if (pi->type == PICTURE_INSTR_HAIRLINE) {
+        poly_render_hairline(&job->pm, pi->poly, style, pi->global_alpha,
+                             pi->line_width, pi->compose_op,
+                             job->clip_region, &area, &pi->transform);
+        continue;
+      }
+
+      // The renderer covers the pixels from floor(p1) to floor(p2)
+      rect_t bbox = rect(point(pi->bbox.p1.x, max(pi->bbox.p1.y, by)),
+                         point(pi->bbox.p2.x,
+                               min(pi->bbox.p2.y, area.p2.y - 0.5)));
+      poly_render(&job->pm, pi->poly, &bbox, style, pi->global_alpha,
+                  &pi->shadow, pi->compose_op, job->clip_region,
+                  pi->non_zero, &pi->transform);
+    }
+  }
+}
+
+// Renders instructions one after the other
+static void
+_sw_context_render_instrs(
+  sw_context_t *c,
+  const picture_instr_t *instrs,
+  int32_t nb_instrs)
+{
+  assert(c != NULL);
+  assert(instrs != NULL);
+
+  for (int32_t i = 0; i < nb_instrs; ++i) {
+    const picture_instr_t *pi = &instrs[i];
+    if (pi->type == PICTURE_INSTR_HAIRLINE) {
+      sw_context_render_hairline(c, pi->poly, pi->style, pi->global_alpha,
+                                 pi->line_width, pi->compose_op,
+                                 &pi->transform);
+    } else {
+      sw_context_render_polygon(c, pi->poly, &pi->bbox, pi->style,
+                                pi->global_alpha, &pi->shadow,
+                                pi->compose_op, pi->non_zero,
+                                &pi->transform);
+    }
+  }
+}
+
+// Renders instructions in bulk: they are binned to the horizontal
+// screen bands their bounding box touches, and the bands are rendered
+// concurrently, each processing its instructions in order; this is
+// only valid because none of them casts a shadow or affects the
+// whole surface
+void
+sw_context_render_batch(
+  sw_context_t *c,
+  const picture_instr_t *instrs,
+  int32_t nb_instrs)
+{
+  assert(c != NULL);
+  assert(c->data != NULL);
+  assert(instrs != NULL);
+  assert(nb_instrs >= 0);
+
+  int32_t nb_bands = (c->base.height + SW_BAND_HEIGHT - 1) / SW_BAND_HEIGHT;
+
+  int32_t *levels = (int32_t *)calloc(max(nb_instrs, 1), sizeof(int32_t));
+  int32_t *band_start = (int32_t *)calloc(nb_bands + 1, sizeof(int32_t));
+  int32_t *band_next = (int32_t *)calloc(nb_bands, sizeof(int32_t));
+  int32_t *band_instrs = NULL;
+
+  // Counting sort of the instructions by band, keeping their order
+  if ((levels != NULL) && (band_start != NULL) && (band_next != NULL)) {
+    for (int32_t i = 0; i < nb_instrs; ++i) {
+      int32_t b1, b2;
+      if (_sw_context_instr_bands(c, &instrs[i], &b1, &b2) == true) {
+        for (int32_t b = b1; b <= b2; ++b) {
+          band_start[b + 1]++;
+        }
+      }
+    }
+    for (int32_t b = 0; b < nb_bands; ++b) {
+      band_start[b + 1] += band_start[b];
+      band_next[b] = band_start[b];
+    }
+    band_instrs =
+      (int32_t *)malloc(max(band_start[nb_bands], 1) * sizeof(int32_t));
+  }
+
+  if (band_instrs == NULL) {
+    _sw_context_render_instrs(c, instrs, nb_instrs);
+    free(band_next);
+    free(band_start);
+    free(levels);
+    return;
+  }
+
+  for (int32_t i = 0; i < nb_instrs; ++i) {
+    const picture_instr_t *pi = &instrs[i];
+    assert(comp_is_full_screen(pi->compose_op) == false);
+    _sw_context_damage(c, pi->bbox, NULL, pi->compose_op);
+    draw_style_t style = pi->style;
+    _sw_context_select_level(&style, &pi->transform);
+    levels[i] = style.level;
+    int32_t b1, b2;
+    if (_sw_context_instr_bands(c, pi, &b1, &b2) == true) {
+      for (int32_t b = b1; b <= b2; ++b) {
+        band_instrs[band_next[b]++] = i;
+      }
+    }
+  }
+
+  sw_band_job_t job = {
+    .pm = pixmap(c->base.width, c->base.height, c->data),
+    .clip_region = &c->clip_region,
+    .instrs = instrs,
+    .levels = levels,
+    .band_start = band_start,
+    .band_instrs = band_instrs,
+  };
+  worker_pool_run(_sw_context_render_bands, &job, nb_bands, 1);
+
+  free(band_instrs);
+  free(band_next);
+  free(band_start);
+  free(levels);
+}
+
+void
+sw_context_render_mask(
+  sw_context_t *c,
+  const mask_t *mask,
+  int32_t x,
+  int32_t y,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(mask != NULL);
+  assert(transform != NULL);
+
+  _sw_context_select_level(&draw_style, transform);
+
+  _sw_context_damage(c, rect(point((double)x + mask->x, (double)y + mask->y),
+                             point((double)x + mask->x + mask->width,
+                                   (double)y + mask->y + mask->height)),
+                     NULL, compose_op);
+
+  pixmap_t pm = pixmap(c->base.width, c->base.height, c->data);
+  poly_render_mask(&pm, mask, x, y, draw_style, global_alpha, compose_op,
+                   &(c->clip_region), transform);
+}
+
+// Draws a batch of (x, y, width, height) rectangles, given in user
+// space, with the transform known to be axis-aligned; colors, when
+// provided, replace the draw style of each rectangle
+void
+sw_context_render_rects(
+  sw_context_t *c,
+  const double *rects,
+  int32_t nb_rects,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(rects != NULL);
+  assert(nb_rects >= 0);
+  assert(transform != NULL);
+  assert(transform_is_axis_aligned(transform) == true);
+
+  _sw_context_select_level(&draw_style, transform);
+
+  pixmap_t pm = pixmap(c->base.width, c->base.height, c->data);
+
+  for (int32_t i = 0; i < nb_rects; ++i) {
+    const double *r = rects + 4 * i;
+    point_t p1 = point(r[0], r[1]);
+    point_t p2 = point(r[0] + r[2], r[1] + r[3]);
+    transform_apply(transform, &p1);
+    transform_apply(transform, &p2);
+    _sw_context_damage(c, rect(p1, p2), NULL, compose_op);
+    if (colors != NULL) {
+      draw_style = (draw_style_t){ .type = DRAW_STYLE_COLOR,
+                                   .content.color =
+                                     color_of_int((uint32_t)colors[i]) };
+    }
+    poly_render_rect(&pm, p1.x, p1.y, p2.x, p2.y, draw_style,
+                     global_alpha, compose_op, &(c->clip_region), transform);
+  }
+}
+
+// Draws a batch of (x, y, radius) circles, given in user space,
+// with the transform known to be axis-aligned
+void
+sw_context_render_circles(
+  sw_context_t *c,
+  const double *circles,
+  int32_t nb_circles,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(circles != NULL);
+  assert(nb_circles >= 0);
+  assert(transform != NULL);
+  assert(transform_is_axis_aligned(transform) == true);
+
+  _sw_context_select_level(&draw_style, transform);
+
+  pixmap_t pm = pixmap(c->base.width, c->base.height, c->data);
+
+  for (int32_t i = 0; i < nb_circles; ++i) {
+    const double *e = circles + 3 * i;
+    point_t p = point(e[0], e[1]);
+    transform_apply(transform, &p);
+    double rx = fabs(e[2] * transform->a), ry = fabs(e[2] * transform->d);
+    _sw_context_damage(c, rect(point(p.x - rx, p.y - ry),
+                               point(p.x + rx, p.y + ry)),
+                       NULL, compose_op);
+    if (colors != NULL) {
+      draw_style = (draw_style_t){ .type = DRAW_STYLE_COLOR,
+                                   .content.color =
+                                     color_of_int((uint32_t)colors[i]) };
+    }
+    poly_render_ellipse(&pm, p.x, p.y,
+                        e[2] * transform->a, e[2] * transform->d,
+                        draw_style, global_alpha, compose_op,
+                        &(c->clip_region), transform);
+  }
+}
+
+// Draws a rectangle given by two opposite corners in device space;
+// the transform is only used to map the draw style
+void
+sw_context_render_rect(
+  sw_context_t *c,
+  double x1,
+  double y1,
+  double x2,
+  double y2,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(transform != NULL);
+
+  _sw_context_select_level(&draw_style, transform);
+
+  _sw_context_damage(c, rect(point(x1, y1), point(x2, y2)), NULL, compose_op);
+
+  pixmap_t pm = pixmap(c->base.width, c->base.height, c->data);
+  poly_render_rect(&pm, x1, y1, x2, y2, draw_style, global_alpha,
+                   compose_op, &(c->clip_region), transform);
+}
+
+// Draws an axis-aligned ellipse given in device space;
+// the transform is only used to map the draw style
+void
+sw_context_render_ellipse(
+  sw_context_t *c,
+  double cx,
+  double cy,
+  double rx,
+  double ry,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform)
+{
+  assert(c != NULL);
+  assert(transform != NULL);
+
+  _sw_context_select_level(&draw_style, transform);
+
+  _sw_context_damage(c, rect(point(cx - fabs(rx), cy - fabs(ry)),
+                             point(cx + fabs(rx), cy + fabs(ry))),
+                     NULL, compose_op);
+
+  pixmap_t pm = pixmap(c->base.width, c->base.height, c->data);
+  poly_render_ellipse(&pm, cx, cy, rx, ry, draw_style, global_alpha,
+                      compose_op, &(c->clip_region), transform);
+}
+
+// Returns the smallest alpha value of a row of pixels
+static uint8_t
+_sw_context_min_alpha(
+  const color_t_ *s,
+  int32_t n)
+{
+  assert(s != NULL);
+
+  uint8_t a = 255;
+  for (int32_t k = 0; (k < n) && (a > 0); ++k) {
+    a = min(a, s[k].a);
+  }
+  return a;
+}
+
+// Composes a row of source pixels onto a row of destination pixels,
+// with the composite operation resolved once for the whole row;
+// alpha (from 0 to 255) scales the opacity of the source
+static void
+_sw_context_blit_row(
+  color_t_ *d,
+  const color_t_ *s,
+  const color_t_ *c,
+  int32_t n,
+  int alpha,
+  composite_operation_t compose_op)
+{
+  assert(d != NULL);
+  assert(s != NULL);
+  assert((alpha >= 0) && (alpha <= 255));
+
+  if (c != NULL) {
+    for (int32_t k = 0; k < n; ++k) {
+      int draw_alpha = s[k].a * (255 - c[k].a) / 255 * alpha / 255;
+      d[k] = comp_compose(s[k], d[k], draw_alpha, compose_op);
+    }
+    return;
+  }
+
+  if (alpha < 255) {
+    for (int32_t k = 0; k < n; ++k) {
+      d[k] = comp_compose(s[k], d[k], s[k].a * alpha / 255, compose_op);
+    }
+    return;
+  }
+
+  switch (compose_op) {
+    case COPY:
+      if (_sw_context_min_alpha(s, n) > 0) {
+        memmove(d, s, n * COLOR_SIZE);
+      } else {
+        for (int32_t k = 0; k < n; ++k) {
+          d[k] = (s[k].a == 0) ? color_transparent_black : s[k];
+        }
+      }
+      break;
+    case SOURCE_OVER:
+      if (_sw_context_min_alpha(s, n) == 255) {
+        memmove(d, s, n * COLOR_SIZE);
+      } else {
+        for (int32_t k = 0; k < n; ++k) {
+          if (s[k].a == 255) {
+            d[k] = s[k];
+          } else if (s[k].a != 0) {
+            d[k] = comp_source_over(s[k], d[k], s[k].a);
+          }
+        }
+      }
+      break;
+    default:
+      for (int32_t k = 0; k < n; ++k) {
+        d[k] = comp_compose(s[k], d[k], s[k].a, compose_op);
+      }
+      break;
+  }
+}
+
+// Blits a source rectangle at an integer offset, one row at a time;
+// the rectangles are clipped against both surfaces beforehand
+static void
+_sw_context_blit_translate(
+  pixmap_t *dp,
+  int32_t dx,
+  int32_t dy,
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t width,
+  int32_t height,
+  int alpha,
+  composite_operation_t compose_op,
+  const pixmap_t *clip_region)
+{
+  assert(dp != NULL);
+  assert(sp != NULL);
+  assert(clip_region != NULL);
+
+  adjust_blit_info(dp->width, dp->height, dx, dy,
+                   sp->width, sp->height, sx, sy,
+                   width, height);
+
+  if ((width <= 0) || (height <= 0)) {
+    return;
+  }
+
+  // When blitting a surface onto itself, rows are processed
+  // bottom-up if the destination lies below the source, and
+  // source rows are saved first so that overlapping spans
+  // are composed from the original pixels
+  color_t_ *row = NULL;
+  bool same = (dp->data == sp->data);
+  bool bottom_up = same && (dy > sy);
+  if (same) {
+    row = (color_t_ *)calloc(width, sizeof(color_t_));
+    if (row == NULL) {
+      return;
+    }
+  }
+
+  bool clip = pixmap_valid(*clip_region);
+
+  for (int32_t i = 0; i < height; ++i) {
+    int32_t j = bottom_up ? height - 1 - i : i;
+    const color_t_ *s = &pixmap_at(*sp, sy + j, sx);
+    if (row != NULL) {
+      memcpy(row, s, width * COLOR_SIZE);
+      s = row;
+    }
+    _sw_context_blit_row(&pixmap_at(*dp, dy + j, dx), s,
+                         clip ? &pixmap_at(*clip_region, dy + j, dx) : NULL,
+                         width, alpha, compose_op);
+  }
+
+  if (row != NULL) {
+    free(row);
+  }
+}
+
+// Returns the number of times the source rectangle should be halved
+// so that its pixels are about the size of a destination pixel,
+// and stores the corresponding downscaled copy in mip
+static int32_t
+_sw_context_blit_level(
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t width,
+  int32_t height,
+  image_smoothing_t smoothing,
+  const transform_t *transform,
+  pixmap_t *mip) // out
+{
+  assert(sp != NULL);
+  assert(transform != NULL);
+  assert(mip != NULL);
+
+  if ((smoothing == IMAGE_SMOOTHING_OFF) ||
+      (sx < 0) || (sy < 0) ||
+      (width > sp->width - sx) || (height > sp->height - sy)) {
+    return 0;
+  }
+
+  transform_t *inverse = transform_copy(transform);
+  if (inverse == NULL) {
+    return 0;
+  }
+  transform_inverse(inverse);
+  double s = transform_get_max_scale(inverse);
+  transform_destroy(inverse);
+
+  if ((s < 2.0) || (isfinite(s) == false)) {
+    return 0;
+  }
+
+  int32_t target = (int32_t)log2(s);
+  int32_t level = 0;
+
+  pixmap_t cur = pixmap_extract(sp, sx, sy, width, height);
+  if (pixmap_valid(cur) == false) {
+    return 0;
+  }
+
+  while ((level < target) && ((cur.width > 1) || (cur.height > 1))) {
+    pixmap_t next = pixmap_halve(&cur);
+    if (pixmap_valid(next) == false) {
+      break;
+    }
+    pixmap_destroy(cur);
+    cur = next;
+    level++;
+  }
+
+  if (level == 0) {
+    pixmap_destroy(cur);
+    return 0;
+  }
+
+  *mip = cur;
+  return level;
+}
+
+// Draws the source rectangle (sx, sy, sw, sh) into the destination
+// rectangle (dx, dy, dw, dh), both expressed in user space, using
+// the general polygon renderer
+static void
+_sw_context_draw_transformed(
+  sw_context_t *dc,
+  double dx,
+  double dy,
+  double dw,
+  double dh,
+  const pixmap_t *sp,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform)
+{
+  assert(dc != NULL);
+  assert(sp != NULL);
+  assert(shadow != NULL);
+  assert(transform != NULL);
+
+  // Maps the source rectangle to the device
+  transform_t *temp_transform = transform_copy(transform);
+  if (temp_transform == NULL) {
+    return;
+  }
+  transform_translate(temp_transform, dx, dy);
+  transform_scale(temp_transform, dw / (double)sw, dh / (double)sh);
+
+  // When the source is minified, draw a box-filtered
+  // downscaled copy of the source rectangle instead
+  pixmap_t mip = pixmap_null();
+  int32_t level = _sw_context_blit_level(sp, sx, sy, sw, sh,
+                                         smoothing, temp_transform, &mip);
+  if (level > 0) {
+    transform_scale(temp_transform, ldexp(1.0, level), ldexp(1.0, level));
+  } else {
+    transform_translate(temp_transform, -sx, -sy);
+  }
+
+  draw_style_t draw_style =
+    (draw_style_t){ .type = DRAW_STYLE_PIXMAP,
+                    .content.pixmap = (level > 0) ? &mip : (pixmap_t *)sp,
+                    .smoothing = smoothing };
+
+  polygon_t *p = polygon_create(8, 1);
+  if (p == NULL) {
+    transform_destroy(temp_transform);
+    pixmap_destroy(mip);
+    return;
+  }
+
+  point_t p1 = point(dx, dy);
+  point_t p2 = point(dx + dw, dy);
+  point_t p3 = point(dx + dw, dy + dh);
+  point_t p4 = point(dx, dy + dh);
+
+  transform_apply(transform, &p1);
+  transform_apply(transform, &p2);
+  transform_apply(transform, &p3);
+  transform_apply(transform, &p4);
+
+  polygon_add_point(p, p1);
+  polygon_add_point(p, p2);
+  polygon_add_point(p, p3);
+  polygon_add_point(p, p4);
+  polygon_end_subpoly(p, true);
+
+  rect_t bbox = rect(point(min4(p1.x, p2.x, p3.x, p4.x),
+                           min4(p1.y, p2.y, p3.y, p4.y)),
+                     point(max4(p1.x, p2.x, p3.x, p4.x),
+                           max4(p1.y, p2.y, p3.y, p4.y)));
+
+  pixmap_t pm = _sw_context_get_raw_pixmap(dc);
+  poly_render(&pm, p, &bbox, draw_style, global_alpha, shadow, compose_op,
+              &(dc->clip_region), false, temp_transform);
+
+  transform_destroy(temp_transform);
+
+  pixmap_destroy(mip);
+
+  polygon_destroy(p);
+}
+
 void
 sw_context_blit(
   sw_context_t *dc,
@@ -391,6 +1306,7 @@ sw_context_blit(
   double global_alpha,
   const shadow_t *shadow,
   composite_operation_t compose_op,
+  image_smoothing_t smoothing,
   const transform_t *transform)
 {
   assert(dc != NULL);
@@ -398,91 +1314,364 @@ sw_context_blit(
   assert(shadow != NULL);
   assert(transform != NULL);
 
-  bool draw_shadows =
-    (shadow->blur > 0.0 ||
-     shadow->offset_x != 0.0 || shadow->offset_y != 0.0) &&
-    compose_op != COPY && shadow->color.a != 0;
-
-  const pixmap_t sp = _sw_context_get_raw_pixmap((sw_context_t *)sc);
+  const pixmap_t sp = _sw_context_get_cleared_pixmap((sw_context_t *)sc);
   pixmap_t dp = _sw_context_get_raw_pixmap(dc);
 
-// TODO: global_alpha ?
   if ((transform_is_pure_translation(transform) == true) &&
-      (draw_shadows == false)) {
+      (_sw_context_draw_shadows(shadow, compose_op) == false)) {
 
     double tx = 0.0, ty = 0.0;
     transform_extract_translation(transform, &tx, &ty);
 
-    int32_t lo_x = max(dx + (int32_t)tx, 0);
-    int32_t hi_x = min(dx + (int32_t)tx + width, dc->base.width); // canvas wd
-    int32_t lo_y = max(dy + (int32_t)ty, 0);
-    int32_t hi_y = min(dy + (int32_t)ty + height, dc->base.height); //canvas ht
+    _sw_context_damage(dc, rect(point(dx + tx, dy + ty),
+                                point(dx + tx + width, dy + ty + height)),
+                       NULL, compose_op);
 
-    for (int32_t i = lo_x; i < hi_x; i++) {
-      for (int32_t j = lo_y; j < hi_y; j++) {
+    int alpha = (int)(max(0.0, min(global_alpha, 1.0)) * 255.0 + 0.5);
+    _sw_context_blit_translate(&dp, dx + (int32_t)tx, dy + (int32_t)ty,
+                               &sp, sx, sy, width, height,
+                               alpha, compose_op, &(dc->clip_region));
 
-        int32_t uvx = i + sx - dx - (int32_t)tx;
-        int32_t uvy = j + sy - dy - (int32_t)ty;
-        if (uvx < 0 || uvx >= sc->base.width || // canvas wd
-            uvy < 0 || uvy >= sc->base.height) { // canvas ht
-          continue;
-        }
+  } else {
 
-        color_t_ fill_color = pixmap_at(sp, uvy, uvx);
-        int draw_alpha = fill_color.a;
-        if (pixmap_valid(dc->clip_region) == true) {
-          draw_alpha *= 255 - pixmap_at(dc->clip_region, j, i).a;
-          draw_alpha /= 255;
-        }
+    _sw_context_damage_all(dc);
 
-        pixmap_at(dp, j, i) =
-          comp_compose(fill_color, pixmap_at(dp, j, i),
-                       draw_alpha, compose_op);
-      }
+    _sw_context_draw_transformed(dc, dx, dy, width, height,
+                                 &sp, sx, sy, width, height,
+                                 global_alpha, shadow, compose_op,
+                                 smoothing, transform);
+
+  }
+}
+
+// Draws the source rectangle (sx, sy, sw, sh) of a pixmap into
+// the destination rectangle (dx, dy, dw, dh), given in user space
+static void
+_sw_context_draw_pixmap(
+  sw_context_t *dc,
+  double dx,
+  double dy,
+  double dw,
+  double dh,
+  const pixmap_t *src,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform)
+{
+  assert(dc != NULL);
+  assert(src != NULL);
+  assert(shadow != NULL);
+  assert(transform != NULL);
+
+  const pixmap_t sp = *src;
+  pixmap_t dp = _sw_context_get_raw_pixmap(dc);
+
+  // Restrict the source rectangle to the source surface,
+  // shrinking the destination rectangle accordingly
+  double kx = dw / (double)sw;
+  double ky = dh / (double)sh;
+  if (sx < 0) { dx -= sx * kx; sw += sx; sx = 0; }
+  if (sy < 0) { dy -= sy * ky; sh += sy; sy = 0; }
+  if (sw > sp.width - sx) { sw = sp.width - sx; }
+  if (sh > sp.height - sy) { sh = sp.height - sy; }
+  if ((sw <= 0) || (sh <= 0)) {
+    return;
+  }
+  dw = sw * kx;
+  dh = sh * ky;
+
+  if (dc->layer != NULL) {
+    point_t p[4] = { point(dx, dy), point(dx + dw, dy),
+                     point(dx + dw, dy + dh), point(dx, dy + dh) };
+    for (int32_t i = 0; i < 4; ++i) {
+      transform_apply(transform, &p[i]);
     }
+    rect_t area = rect(p[0], p[0]);
+    for (int32_t i = 1; i < 4; ++i) {
+      rect_expand(&area, p[i]);
+    }
+    _sw_context_damage(dc, area, shadow, compose_op);
+  }
 
-  } else {
+  double tx = 0.0, ty = 0.0;
+  transform_extract_translation(transform, &tx, &ty);
+  double x1 = dx + tx, y1 = dy + ty;
+  double x2 = x1 + dw, y2 = y1 + dh;
+
+  // Pixel-aligned destinations drawn without transformation
+  // or shadows are scaled with dedicated kernels
+  if ((transform_is_pure_translation(transform) == false) ||
+      (_sw_context_draw_shadows(shadow, compose_op) == true) ||
+      (x1 != floor(x1)) || (y1 != floor(y1)) ||
+      (x2 != floor(x2)) || (y2 != floor(y2)) ||
+      (fabs(x1) > (double)INT32_MAX / 2) ||
+      (fabs(y1) > (double)INT32_MAX / 2) ||
+      (x2 - x1 > (double)INT32_MAX / 2) ||
+      (y2 - y1 > (double)INT32_MAX / 2)) {
+    _sw_context_draw_transformed(dc, dx, dy, dw, dh,
+                                 &sp, sx, sy, sw, sh,
+                                 global_alpha, shadow, compose_op,
+                                 smoothing, transform);
+    return;
+  }
 
-    draw_style_t draw_style =
-      (draw_style_t){ .type = DRAW_STYLE_PIXMAP, .content.pixmap = &sp };
+  int32_t ix = (int32_t)x1;
+  int32_t iy = (int32_t)y1;
+  int32_t iw = (int32_t)(x2 - x1);
+  int32_t ih = (int32_t)(y2 - y1);
+  if ((iw <= 0) || (ih <= 0)) {
+    return;
+  }
 
-    polygon_t *p = polygon_create(8, 1);
-    if (p == NULL) {
-      return;
+  int alpha = (int)(max(0.0, min(global_alpha, 1.0)) * 255.0 + 0.5);
+
+  if ((iw == sw) && (ih == sh)) {
+    _sw_context_blit_translate(&dp, ix, iy, &sp, sx, sy, sw, sh,
+                               alpha, compose_op, &(dc->clip_region));
+    return;
+  }
+
+  // Only scale the part that ends up on the destination
+  int32_t wx0 = max(0, -ix);
+  int32_t wy0 = max(0, -iy);
+  int32_t wx1 = min(iw, dp.width - ix);
+  int32_t wy1 = min(ih, dp.height - iy);
+  if ((wx0 >= wx1) || (wy0 >= wy1)) {
+    return;
+  }
+
+  pixmap_t scaled = pixmap_scale(&sp, sx, sy, sw, sh, iw, ih,
+                                 wx0, wy0, wx1, wy1,
+                                 smoothing != IMAGE_SMOOTHING_OFF);
+  if (pixmap_valid(scaled) == false) {
+    return;
+  }
+
+  _sw_context_blit_translate(&dp, ix + wx0, iy + wy0,
+                             &scaled, 0, 0, scaled.width, scaled.height,
+                             alpha, compose_op, &(dc->clip_region));
+
+  pixmap_destroy(scaled);
+}
+
+void
+sw_context_draw_image(
+  sw_context_t *dc,
+  double dx,
+  double dy,
+  double dw,
+  double dh,
+  const sw_context_t *sc,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform)
+{
+  assert(dc != NULL);
+  assert(sc != NULL);
+  assert(shadow != NULL);
+  assert(transform != NULL);
+
+  const pixmap_t sp = _sw_context_get_cleared_pixmap((sw_context_t *)sc);
+  _sw_context_draw_pixmap(dc, dx, dy, dw, dh, &sp, sx, sy, sw, sh,
+                          global_alpha, shadow, compose_op,
+                          smoothing, transform);
+}
+
+void
+sw_context_draw_sprites(
+  sw_context_t *dc,
+  const sw_context_t *sc,
+  const pixmap_t *sp,
+  const double *sprites,
+  int32_t nb_sprites,
+
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform)
+{
+  assert(dc != NULL);
+  assert((sc != NULL) || (sp != NULL));
+  assert(sprites != NULL);
+  assert(nb_sprites >= 0);
+  assert(shadow != NULL);
+  assert(transform != NULL);
+
+  const pixmap_t src =
+    (sc != NULL) ? _sw_context_get_cleared_pixmap((sw_context_t *)sc) : *sp;
+  if (pixmap_valid(src) == false) {
+    return;
+  }
+
+  for (int32_t i = 0; i < nb_sprites; ++i) {
+
+    const double *sprite = sprites + i * SPRITE_SIZE;
+    double sx = trunc(sprite[SPRITE_SX]);
+    double sy = trunc(sprite[SPRITE_SY]);
+    double sw = trunc(sprite[SPRITE_SW]);
+    double sh = trunc(sprite[SPRITE_SH]);
+    double scale = sprite[SPRITE_SCALE];
+    double rotation = sprite[SPRITE_ROTATION];
+    double alpha = sprite[SPRITE_ALPHA] * global_alpha;
+    double dx = sprite[SPRITE_DX];
+    double dy = sprite[SPRITE_DY];
+    double dw = sw * scale;
+    double dh = sh * scale;
+
+    // The destination must be finite for the renderer to convert
+    // its bounds to integers
+    if ((isfinite(sx) == false) || (isfinite(sy) == false) ||
+        (isfinite(dx) == false) || (isfinite(dy) == false) ||
+        (isfinite(dw) == false) || (isfinite(dh) == false) ||
+        (isfinite(rotation) == false) ||
+        !(sw > 0.0) || !(sh > 0.0) || !(dw > 0.0) || !(dh > 0.0) ||
+        !(alpha > 0.0)) {
+      continue;
     }
 
-    point_t p1 = point((double)dx, (double)dy);
-    point_t p2 = point((double)(dx + width), (double)dy);
-    point_t p3 = point((double)(dx + width), (double)(dy + height));
-    point_t p4 = point((double)dx, (double)(dy + height));
+    // Restrict the source rectangle to the source surface before
+    // converting it to integers, as sprite fields are arbitrary
+    // doubles; the destination is offset and shrunk accordingly
+    double sx1 = max(sx, 0.0);
+    double sy1 = max(sy, 0.0);
+    double sx2 = min(sx + sw, (double)src.width);
+    double sy2 = min(sy + sh, (double)src.height);
+    if ((sx1 >= sx2) || (sy1 >= sy2)) {
+      continue;
+    }
+    double ox = (sx1 - sx) * scale;
+    double oy = (sy1 - sy) * scale;
+    double cw = (sx2 - sx1) * scale;
+    double ch = (sy2 - sy1) * scale;
+
+    if (rotation == 0.0) {
+      _sw_context_draw_pixmap(dc, dx + ox, dy + oy, cw, ch, &src,
+                              (int32_t)sx1, (int32_t)sy1,
+                              (int32_t)(sx2 - sx1), (int32_t)(sy2 - sy1),
+                              alpha, shadow, compose_op,
+                              smoothing, transform);
+    } else {
+      // Rotate around the center of the sprite
+      transform_t rotated = *transform;
+      transform_translate(&rotated, dx + dw / 2.0, dy + dh / 2.0);
+      transform_rotate(&rotated, rotation);
+      _sw_context_draw_pixmap(dc, -dw / 2.0 + ox, -dh / 2.0 + oy,
+                              cw, ch, &src,
+                              (int32_t)sx1, (int32_t)sy1,
+                              (int32_t)(sx2 - sx1), (int32_t)(sy2 - sy1),
+                              alpha, shadow, compose_op,
+                              smoothing, &rotated);
+    }
+  }
+}
 
-    transform_apply(transform, &p1);
-    transform_apply(transform, &p2);
-    transform_apply(transform, &p3);
-    transform_apply(transform, &p4);
+// Redirects subsequent drawing to a new transparent layer, which
+// is only cleared where drawn to; the clip region is set aside,
+// and only applied when the layer is composed back
+bool
+sw_context_push_layer(
+  sw_context_t *c)
+{
+  assert(c != NULL);
+  assert(c->data != NULL);
 
-    polygon_add_point(p, p1);
-    polygon_add_point(p, p2);
-    polygon_add_point(p, p3);
-    polygon_add_point(p, p4);
-    polygon_end_subpoly(p, true);
+  sw_layer_t *layer = (sw_layer_t *)calloc(1, sizeof(sw_layer_t));
+  if (layer == NULL) {
+    return false;
+  }
 
-    rect_t bbox = rect(point(min4(p1.x, p2.x, p3.x, p4.x),
-                             min4(p1.y, p2.y, p3.y, p4.y)),
-                       point(max4(p1.x, p2.x, p3.x, p4.x),
-                             max4(p1.y, p2.y, p3.y, p4.y)));
+  color_t_ *data = (color_t_ *)
+    buffer_pool_acquire(pixmap_size(c->base.width, c->base.height), false);
+  if (data == NULL) {
+    free(layer);
+    return false;
+  }
 
-    transform_t *temp_transform = transform_copy(transform);
-    transform_translate(temp_transform, dx - sx, dy - sy);
+  layer->data = c->data;
+  layer->clip_region = c->clip_region;
+  layer->below = c->layer;
 
-    pixmap_t pm = _sw_context_get_raw_pixmap(dc);
-    poly_render(&pm, p, &bbox, draw_style, global_alpha, shadow, compose_op,
-                &(dc->clip_region), false, temp_transform);
+  c->data = data;
+  c->clip_region = pixmap_null();
+  c->layer = layer;
 
-    transform_destroy(temp_transform);
+  return true;
+}
+
+// Applies the filters to the topmost layer, then composes it
+// onto the surface below with the saved clip region
+void
+sw_context_pop_layer(
+  sw_context_t *c,
+  const filter_t *filters,
+  int32_t nb_filters,
+  double global_alpha,
+  composite_operation_t compose_op)
+{
+  assert(c != NULL);
+  assert(c->layer != NULL);
+
+  int32_t x1 = c->layer->x1, y1 = c->layer->y1;
+  int32_t x2 = c->layer->x2, y2 = c->layer->y2;
+
+  // Outside of the area drawn to, the layer is transparent black,
+  // which only matters to operations that affect the whole surface;
+  // filters may spread the area by their margin
+  if (comp_is_full_screen(compose_op) == true) {
+    x1 = 0; y1 = 0; x2 = c->base.width; y2 = c->base.height;
+  } else if ((nb_filters > 0) && (x1 < x2)) {
+    int32_t m = (int32_t)ceil(filter_get_margin(filters, nb_filters)) + 1;
+    x1 = max(x1 - m, 0); y1 = max(y1 - m, 0);
+    x2 = min(x2 + m, c->base.width); y2 = min(y2 + m, c->base.height);
+  }
+  _sw_context_clear_layer(c, x1, y1, x2, y2);
+
+  color_t_ *data = _sw_context_remove_layer(c);
+  pixmap_t sp = pixmap(c->base.width, c->base.height, data);
+  pixmap_t dp = _sw_context_get_raw_pixmap(c);
+
+  if ((x1 >= x2) || (y1 >= y2)) {
+    pixmap_destroy(sp);
+    return;
+  }
+
+  // Only the area is filtered, in a buffer of its own
+  pixmap_t fp = sp;
+  int32_t fx = x1, fy = y1;
+  if ((nb_filters > 0) &&
+      ((x2 - x1 < sp.width) || (y2 - y1 < sp.height))) {
+    pixmap_t ap = pixmap_uninit(x2 - x1, y2 - y1);
+    if (pixmap_valid(ap) == true) {
+      pixmap_blit(&ap, 0, 0, &sp, x1, y1, x2 - x1, y2 - y1);
+      fp = ap;
+      fx = fy = 0;
+    }
+  }
+  filter_apply(&fp, filters, nb_filters);
+
+  int alpha = (int)(max(0.0, min(global_alpha, 1.0)) * 255.0 + 0.5);
+  _sw_context_blit_translate(&dp, x1, y1, &fp, fx, fy, x2 - x1, y2 - y1,
+                             alpha, compose_op, &c->clip_region);
 
-    polygon_destroy(p);
+  if (fp.data != sp.data) {
+    pixmap_destroy(fp);
   }
+  pixmap_destroy(sp);
 }
 
 color_t_
@@ -495,7 +1684,7 @@ sw_context_get_pixel(
 
   color_t_ color = color_black;
 
-  const pixmap_t pm = _sw_context_get_raw_pixmap((sw_context_t *)c);
+  const pixmap_t pm = _sw_context_get_cleared_pixmap((sw_context_t *)c);
   if (pixmap_valid(pm) == true) {
     if ((x >= 0) && (x < pm.width) && (y >= 0) && (y < pm.height)) {
       color = pixmap_at(pm, y, x);
@@ -517,11 +1706,65 @@ sw_context_put_pixel(
   pixmap_t pm = _sw_context_get_raw_pixmap((sw_context_t *)c);
   if (pixmap_valid(pm) == true) {
     if ((x >= 0) && (x < pm.width) && (y >= 0) && (y < pm.height)) {
+      _sw_context_damage(c, rect(point(x, y), point(x + 1, y + 1)),
+                         NULL, SOURCE_OVER);
       pixmap_at(pm, y, x) = color;
     }
   }
 }
 
+// Shares the pixels of the surface drawn to; as they may be
+// written to, the whole topmost layer counts as drawn to
+pixmap_t
+sw_context_get_raw_pixmap(
+  sw_context_t *c)
+{
+  assert(c != NULL);
+
+  _sw_context_damage_all(c);
+
+  return _sw_context_get_raw_pixmap(c);
+}
+
+// Surfaces of onscreen contexts belong to the window system,
+// only the other ones may be handed over
+bool
+sw_context_can_detach_pixels(
+  const sw_context_t *c)
+{
+  assert(c != NULL);
+
+  return (c->layer != NULL) || (c->base.offscreen == true);
+}
+
+// Hands the pixels of the surface drawn to over to the caller, who
+// must free them, and draws to a copy of them from now on; returns
+// NULL if the surface cannot be handed over
+color_t_ *
+sw_context_detach_pixels(
+  sw_context_t *c)
+{
+  assert(c != NULL);
+  assert(c->data != NULL);
+
+  if (sw_context_can_detach_pixels(c) == false) {
+    return NULL;
+  }
+
+  size_t size = (c->layer != NULL) ?
+    pixmap_size(c->base.width, c->base.height) : c->capacity * COLOR_SIZE;
+  color_t_ *data = (color_t_ *)buffer_pool_acquire(size, false);
+  if (data == NULL) {
+    return NULL;
+  }
+  memcpy(data, c->data, pixmap_size(c->base.width, c->base.height));
+
+  color_t_ *detached = c->data;
+  c->data = data;
+
+  return detached;
+}
+
 pixmap_t
 sw_context_get_pixmap(
   const sw_context_t *c,
@@ -533,12 +1776,9 @@ sw_context_get_pixmap(
   assert(c != NULL);
 
   pixmap_t dp = pixmap_null();
-  const pixmap_t sp = _sw_context_get_raw_pixmap((sw_context_t *)c);
+  const pixmap_t sp = _sw_context_get_cleared_pixmap((sw_context_t *)c);
   if (pixmap_valid(sp) == true) {
-    dp = pixmap(width, height, NULL);
-    if (pixmap_valid(dp) == true) {
-      pixmap_blit(&dp, 0, 0, &sp, sx, sy, width, height);
-    }
+    dp = pixmap_extract(&sp, sx, sy, width, height);
   }
   return dp;
 }
@@ -560,6 +1800,8 @@ sw_context_put_pixmap(
 
   pixmap_t dp = _sw_context_get_raw_pixmap(c);
   if (pixmap_valid(dp) == true) {
+    _sw_context_damage(c, rect(point(dx, dy), point(dx + width, dy + height)),
+                       NULL, SOURCE_OVER);
     pixmap_blit(&dp, dx, dy, sp, sx, sy, width, height);
   }
 }
@@ -572,7 +1814,7 @@ sw_context_export_png(
   assert(c != NULL);
   assert(filename != NULL);
 
-  const pixmap_t pm = _sw_context_get_raw_pixmap((sw_context_t *)c);
+  const pixmap_t pm = _sw_context_get_cleared_pixmap((sw_context_t *)c);
   if (pixmap_valid(pm) == false) {
     return false;
   }
@@ -593,5 +1835,6 @@ sw_context_import_png(
   if (pixmap_valid(pm) == false) {
     return false;
   }
+  _sw_context_damage_all(c);
   return impexp_import_png(&pm, x, y, filename);
 }
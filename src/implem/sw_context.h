@@ -19,10 +19,13 @@
 
 #include "rect.h"
 #include "polygon.h"
+#include "mask_cache.h"
 #include "transform.h"
 #include "draw_style.h"
-#include "list.h"
+#include "clip_path.h"
 #include "state.h" // for shadow_t
+#include "picture.h"
+#include "filters.h"
 
 typedef struct sw_context_t sw_context_t;
 
@@ -62,7 +65,7 @@ sw_context_present(
 bool
 sw_context_clip(
   sw_context_t *c,
-  list_t *clip_path,
+  const clip_path_t *clip_path,
   const transform_t *transform);
 
 void
@@ -81,6 +84,91 @@ sw_context_render_polygon(
   bool non_zero,
   const transform_t *transform);
 
+void
+sw_context_render_hairline(
+  sw_context_t *c,
+  const polygon_t *p,
+  draw_style_t draw_style,
+  double global_alpha,
+  double width,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+sw_context_render_batch(
+  sw_context_t *c,
+  const picture_instr_t *instrs,
+  int32_t nb_instrs);
+
+void
+sw_context_render_mask(
+  sw_context_t *c,
+  const mask_t *mask,
+  int32_t x,
+  int32_t y,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+sw_context_render_rects(
+  sw_context_t *c,
+  const double *rects,
+  int32_t nb_rects,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+sw_context_render_circles(
+  sw_context_t *c,
+  const double *circles,
+  int32_t nb_circles,
+  const int32_t *colors,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+sw_context_render_rect(
+  sw_context_t *c,
+  double x1,
+  double y1,
+  double x2,
+  double y2,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+void
+sw_context_render_ellipse(
+  sw_context_t *c,
+  double cx,
+  double cy,
+  double rx,
+  double ry,
+  draw_style_t draw_style,
+  double global_alpha,
+  composite_operation_t compose_op,
+  const transform_t *transform);
+
+bool
+sw_context_push_layer(
+  sw_context_t *c);
+
+void
+sw_context_pop_layer(
+  sw_context_t *c,
+  const filter_t *filters,
+  int32_t nb_filters,
+  double global_alpha,
+  composite_operation_t compose_op);
+
 void
 sw_context_blit(
   sw_context_t *dc,
@@ -94,6 +182,38 @@ sw_context_blit(
   double global_alpha,
   const shadow_t *shadow,
   composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform);
+
+void
+sw_context_draw_image(
+  sw_context_t *dc,
+  double dx,
+  double dy,
+  double dw,
+  double dh,
+  const sw_context_t *sc,
+  int32_t sx,
+  int32_t sy,
+  int32_t sw,
+  int32_t sh,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
+  const transform_t *transform);
+
+void
+sw_context_draw_sprites(
+  sw_context_t *dc,
+  const sw_context_t *sc,
+  const pixmap_t *sp,
+  const double *sprites,
+  int32_t nb_sprites,
+  double global_alpha,
+  const shadow_t *shadow,
+  composite_operation_t compose_op,
+  image_smoothing_t smoothing,
   const transform_t *transform);
 
 color_t_
@@ -109,6 +229,18 @@ sw_context_put_pixel(
   int32_t y,
   color_t_ color);
 
+pixmap_t
+sw_context_get_raw_pixmap(
+  sw_context_t *c);
+
+bool
+sw_context_can_detach_pixels(
+  const sw_context_t *c);
+
+color_t_ *
+sw_context_detach_pixels(
+  sw_context_t *c);
+
 pixmap_t
 sw_context_get_pixmap(
   const sw_context_t *c,
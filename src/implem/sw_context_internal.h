@@ -11,18 +11,36 @@
 #ifndef __SW_CONTEXT_INTERNAL_H
 #define __SW_CONTEXT_INTERNAL_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "color.h"
 #include "pixmap.h"
 #include "context_internal.h"
 
+// Surface set aside while drawing to a layer
+typedef struct sw_layer_t {
+  color_t_ *data;
+  pixmap_t clip_region;
+  int32_t x1, y1, x2, y2; // area drawn to in the layer, empty if x1 >= x2
+  int32_t cx1, cy1, cx2, cy2; // area cleared so far, empty if cx1 >= cx2
+  struct sw_layer_t *below;
+} sw_layer_t;
+
 typedef struct sw_context_t {
   context_t base;
-  color_t_ *data;
+  color_t_ *data; // surface drawn to, the topmost layer if any
+  size_t capacity; // number of pixels the bottom surface can hold
   pixmap_t clip_region; // temporary
+  sw_layer_t *layer; // NULL if not drawing to a layer
 } sw_context_t;
 
+size_t
+_sw_context_capacity(
+  const sw_context_t *c,
+  int32_t width,
+  int32_t height);
+
 void
 _sw_context_copy_to_buffer(
   sw_context_t *c,
@@ -299,6 +299,24 @@ transform_is_pure_translation(
     between(t->c, -_epsilon, _epsilon);
 }
 
+// Exact test, as it is used to select pixel exact sampling
+bool
+transform_is_integer_translation(
+  const transform_t *t)
+{
+  return
+    (t->a == 1.0) && (t->b == 0.0) && (t->c == 0.0) && (t->d == 1.0) &&
+    (t->e == floor(t->e)) && (t->f == floor(t->f));
+}
+
+// True if axis-aligned rectangles remain axis-aligned
+bool
+transform_is_axis_aligned(
+  const transform_t *t)
+{
+  return (t->b == 0.0) && (t->c == 0.0);
+}
+
 void
 transform_extract_ft(
   const transform_t *t,
@@ -347,6 +365,20 @@ transform_extract_scale(
   *sy = det / r;
 }
 
+// Largest scale factor applied by the linear part of the transform,
+// i.e. its largest singular value
+double
+transform_get_max_scale(
+  const transform_t *t)
+{
+  assert(t != NULL);
+
+  double s = (t->a * t->a + t->b * t->b + t->c * t->c + t->d * t->d) / 2.0;
+  double det = t->a * t->d - t->b * t->c;
+
+  return sqrt(s + sqrt(max(0.0, s * s - det * det)));
+}
+
 transform_t *
 transform_extract_linear(
   const transform_t *t
@@ -114,6 +114,14 @@ bool
 transform_is_pure_translation(
   const transform_t *t);
 
+bool
+transform_is_integer_translation(
+  const transform_t *t);
+
+bool
+transform_is_axis_aligned(
+  const transform_t *t);
+
 void
 transform_extract_ft(
   const transform_t *t,
@@ -134,6 +142,10 @@ transform_extract_scale(
   double *sx,
   double *sy);
 
+double
+transform_get_max_scale(
+  const transform_t *t);
+
 transform_t *
 transform_extract_linear(
   const transform_t *t);
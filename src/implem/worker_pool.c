@@ -0,0 +1,189 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#ifdef HAS_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "util.h"
+#include "worker_pool.h"
+
+#define WORKER_POOL_MAX_THREADS 16
+
+#ifdef HAS_PTHREAD
+
+// A single job runs at a time; the calling thread takes part in
+// it, and jobs submitted while another one runs (e.g. from within
+// a worker) are simply run by the submitting thread
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  pthread_t threads[WORKER_POOL_MAX_THREADS];
+  int32_t nb_threads;
+  bool initialized;
+  bool busy;
+  uint64_t generation;
+  worker_fun_t *fun;
+  void *data;
+  int32_t nb_items;
+  int32_t grain;
+  int32_t next;      // first item not handed out yet
+  int32_t remaining; // items not processed yet
+} _pool = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .work_cond = PTHREAD_COND_INITIALIZER,
+  .done_cond = PTHREAD_COND_INITIALIZER,
+};
+
+// Processes chunks of the current job until none is left;
+// called and returns with the mutex held
+static void
+_worker_pool_process(
+  void)
+{
+  while (_pool.next < _pool.nb_items) {
+    int32_t first = _pool.next;
+    int32_t last = min(first + _pool.grain, _pool.nb_items);
+    _pool.next = last;
+    worker_fun_t *fun = _pool.fun;
+    void *data = _pool.data;
+    pthread_mutex_unlock(&_pool.mutex);
+    fun(data, first, last);
+    pthread_mutex_lock(&_pool.mutex);
+    _pool.remaining -= last - first;
+    if (_pool.remaining == 0) {
+      pthread_cond_signal(&_pool.done_cond);
+    }
+  }
+}
+
+static void *
+_worker_pool_thread(
+  void *arg)
+{
+  (void)arg;
+
+  pthread_mutex_lock(&_pool.mutex);
+  uint64_t seen = _pool.generation;
+  for (;;) {
+    while (_pool.generation == seen) {
+      pthread_cond_wait(&_pool.work_cond, &_pool.mutex);
+    }
+    seen = _pool.generation;
+    _worker_pool_process();
+  }
+  pthread_mutex_unlock(&_pool.mutex);
+
+  return NULL;
+}
+
+// Starts one thread per additional processor; called with the mutex held
+static void
+_worker_pool_init(
+  void)
+{
+  _pool.initialized = true;
+
+  int32_t nb_cpus = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+  nb_cpus = (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  int32_t nb_threads = min(max(nb_cpus - 1, 0), WORKER_POOL_MAX_THREADS);
+
+  for (int32_t i = 0; i < nb_threads; ++i) {
+    if (pthread_create(&_pool.threads[_pool.nb_threads], NULL,
+                       _worker_pool_thread, NULL) != 0) {
+      break;
+    }
+    pthread_detach(_pool.threads[_pool.nb_threads]);
+    _pool.nb_threads++;
+  }
+}
+
+#endif /* HAS_PTHREAD */
+
+// Number of threads that take part in a job, including the caller
+int32_t
+worker_pool_get_nb_workers(
+  void)
+{
+#ifdef HAS_PTHREAD
+  pthread_mutex_lock(&_pool.mutex);
+  if (_pool.initialized == false) {
+    _worker_pool_init();
+  }
+  int32_t nb_threads = _pool.nb_threads;
+  pthread_mutex_unlock(&_pool.mutex);
+  return nb_threads + 1;
+#else
+  return 1;
+#endif
+}
+
+// Calls fun on chunks of at most grain items covering [0; nb_items[,
+// spread over the worker threads, and waits until all are processed;
+// the chunks may be processed in any order, and concurrently
+void
+worker_pool_run(
+  worker_fun_t *fun,
+  void *data,
+  int32_t nb_items,
+  int32_t grain)
+{
+  assert(fun != NULL);
+  assert(nb_items >= 0);
+  assert(grain > 0);
+
+  if (nb_items == 0) {
+    return;
+  }
+
+#ifdef HAS_PTHREAD
+  if (nb_items > grain) {
+
+    pthread_mutex_lock(&_pool.mutex);
+    if (_pool.initialized == false) {
+      _worker_pool_init();
+    }
+
+    if ((_pool.busy == false) && (_pool.nb_threads > 0)) {
+
+      _pool.busy = true;
+      _pool.fun = fun;
+      _pool.data = data;
+      _pool.nb_items = nb_items;
+      _pool.grain = grain;
+      _pool.next = 0;
+      _pool.remaining = nb_items;
+      _pool.generation++;
+      pthread_cond_broadcast(&_pool.work_cond);
+
+      _worker_pool_process();
+      while (_pool.remaining > 0) {
+        pthread_cond_wait(&_pool.done_cond, &_pool.mutex);
+      }
+
+      _pool.busy = false;
+      pthread_mutex_unlock(&_pool.mutex);
+      return;
+    }
+
+    pthread_mutex_unlock(&_pool.mutex);
+  }
+#endif
+
+  fun(data, 0, nb_items);
+}
@@ -0,0 +1,30 @@
+/**************************************************************************/
+/*                                                                        */
+/*    Copyright 2022 OCamlPro                                             */
+/*                                                                        */
+/*  All rights reserved. This file is distributed under the terms of the  */
+/*  GNU Lesser General Public License version 2.1, with the special       */
+/*  exception on linking described in the file LICENSE.                   */
+/*                                                                        */
+/**************************************************************************/
+
+#ifndef __WORKER_POOL_H
+#define __WORKER_POOL_H
+
+#include <stdint.h>
+
+// Processes items [first; last[ of a job
+typedef void (worker_fun_t)(void *data, int32_t first, int32_t last);
+
+int32_t
+worker_pool_get_nb_workers(
+  void);
+
+void
+worker_pool_run(
+  worker_fun_t *fun,
+  void *data,
+  int32_t nb_items,
+  int32_t grain);
+
+#endif /* __WORKER_POOL_H */
@@ -33,36 +33,23 @@ typedef struct x11_sw_context_t {
   xcb_gcontext_t cid;
 } x11_sw_context_t;
 
+// The image only describes the buffer, which remains ours
 static xcb_image_t *
 _x11_sw_context_create_image(
   xcb_connection_t *c,
   uint8_t depth,
   int32_t width,
   int32_t height,
-  color_t_ **data)
+  color_t_ *data)
 {
   assert(c != NULL);
   assert(width > 0);
   assert(height  > 0);
   assert(data != NULL);
-  assert(*data == NULL);
 
-  *data = (color_t_ *)calloc(width * height, sizeof(color_t_));
-  if (*data == NULL) {
-    return NULL;
-  }
-
-  xcb_image_t *img =
-    xcb_image_create_native(c, width, height,
-                            XCB_IMAGE_FORMAT_Z_PIXMAP, depth,
-                            NULL, 0, (uint8_t *)*data);
-  if (img == NULL) {
-    free(*data);
-    *data = NULL;
-    return NULL;
-  }
-
-  return img;
+  return xcb_image_create_native(c, width, height,
+                                 XCB_IMAGE_FORMAT_Z_PIXMAP, depth,
+                                 NULL, 0, (uint8_t *)data);
 }
 
 x11_sw_context_t *
@@ -83,16 +70,20 @@ x11_sw_context_create(
   }
 
   // TODO: allow xcb / SHM
-  color_t_ *data = NULL;
+  color_t_ *data = (color_t_ *)calloc(width * height, sizeof(color_t_));
+  if (data == NULL) {
+    free(context);
+    return NULL;
+  }
+
   xcb_image_t *img =
     _x11_sw_context_create_image(x11_back->c, x11_back->screen->root_depth,
-                              width, height, &data);
+                                 width, height, data);
   if (img == NULL) {
-    assert(data == NULL);
+    free(data);
     free(context);
     return NULL;
   }
-  assert(data != NULL);
 
   xcb_gcontext_t cid = xcb_generate_id(x11_back->c);
   xcb_create_gc(x11_back->c, cid, target->wid,
@@ -101,6 +92,7 @@ x11_sw_context_create(
   context->base.base.width = width;
   context->base.base.height = height;
   context->base.data = data;
+  context->base.capacity = (size_t)width * height;
   context->img = img;
   context->wid = target->wid;
   context->cid = cid;
@@ -140,23 +132,37 @@ x11_sw_context_resize(
   assert(width > 0);
   assert(height > 0);
 
-  color_t_ *data = NULL;
+  // Within the capacity of the buffer, only the image is recreated
+  size_t capacity = _sw_context_capacity(&context->base, width, height);
+  color_t_ *data = context->base.data;
+  if (capacity != context->base.capacity) {
+    data = (color_t_ *)malloc(capacity * sizeof(color_t_));
+    if (data == NULL) {
+      return false;
+    }
+  }
+
   xcb_image_t *img =
     _x11_sw_context_create_image(x11_back->c, x11_back->screen->root_depth,
-                                 width, height, &data);
+                                 width, height, data);
   if (img == NULL) {
-    assert(data == NULL);
+    if (data != context->base.data) {
+      free(data);
+    }
     return false;
   }
-  assert(data != NULL);
 
   _sw_context_copy_to_buffer(&context->base, data, width, height);
 
   xcb_image_destroy(context->img);
+  if (data != context->base.data) {
+    free(context->base.data);
+  }
 
   context->base.base.width = width;
   context->base.base.height = height;
   context->base.data = data;
+  context->base.capacity = capacity;
   context->img = img;
 
   return true;
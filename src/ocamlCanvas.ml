@@ -312,6 +312,17 @@ module V1 = struct
 
   end
 
+  module Filter = struct
+
+    type t =
+      | Blur of float
+      | Brightness of float
+      | Contrast of float
+      | Grayscale of float
+      | DropShadow of Vector.t * float * Color.t
+
+  end
+
   module ImageData = struct
 
     type t = image_data
@@ -366,6 +377,9 @@ module V1 = struct
     external exportPNG : t -> string -> unit
       = "ml_canvas_image_data_export_png"
 
+    external applyFilter : t -> Filter.t list -> unit
+      = "ml_canvas_image_data_apply_filter"
+
     type t_repr = image_data
 
     let of_bigarray (ba : t_repr) =
@@ -462,6 +476,12 @@ module V1 = struct
 
   end
 
+  module Picture = struct
+
+    type t
+
+  end
+
   module Join = struct
 
     type t =
@@ -480,6 +500,16 @@ module V1 = struct
 
   end
 
+  module Smoothing = struct
+
+    type t =
+      | Off
+      | Low
+      | Medium
+      | High
+
+  end
+
   module Style = struct
 
     type t =
@@ -525,6 +555,14 @@ module V1 = struct
 
     type t = canvas
 
+    type mask_cache_stats = {
+      hits : int;
+      misses : int;
+      evictions : int;
+      entries : int;
+      bytes : int;
+    }
+
     (* Comparison and hash functions *)
 
     let () =
@@ -593,6 +631,21 @@ module V1 = struct
     external setPosition : t -> (int * int) -> unit
       = "ml_canvas_set_position"
 
+    external getPathTolerance : t -> float
+      = "ml_canvas_get_path_tolerance"
+
+    external setPathTolerance : t -> float -> unit
+      = "ml_canvas_set_path_tolerance"
+
+    external getMaskCacheBudget : t -> int
+      = "ml_canvas_get_mask_cache_budget"
+
+    external setMaskCacheBudget : t -> int -> unit
+      = "ml_canvas_set_mask_cache_budget"
+
+    external getMaskCacheStats : t -> mask_cache_stats
+      = "ml_canvas_get_mask_cache_stats"
+
     (* State *)
 
     external save : t -> unit
@@ -706,6 +759,12 @@ module V1 = struct
     external setGlobalCompositeOperation : t -> CompositeOp.t -> unit
       = "ml_canvas_set_global_composite_operation"
 
+    external getImageSmoothing : t -> Smoothing.t
+      = "ml_canvas_get_image_smoothing"
+
+    external setImageSmoothing : t -> Smoothing.t -> unit
+      = "ml_canvas_set_image_smoothing"
+
     external getShadowColor : t -> Color.t
       = "ml_canvas_get_shadow_color"
 
@@ -724,6 +783,12 @@ module V1 = struct
     external setShadowOffset : t -> Vector.t -> unit
       = "ml_canvas_set_shadow_offset"
 
+    external getFilter : t -> Filter.t list
+      = "ml_canvas_get_filter"
+
+    external setFilter : t -> Filter.t list -> unit
+      = "ml_canvas_set_filter"
+
     external setFont :
       t -> string -> size:Font.size -> slant:Font.slant ->
       weight:Font.weight -> unit
@@ -792,6 +857,25 @@ module V1 = struct
     external strokeRect : t -> pos:Point.t -> size:Vector.t -> unit
       = "ml_canvas_stroke_rect"
 
+    external fillRects :
+      t ->
+      ?colors:(int32, Bigarray.int32_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+      = "ml_canvas_fill_rects"
+
+    external fillCircles :
+      t ->
+      ?colors:(int32, Bigarray.int32_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+      = "ml_canvas_fill_circles"
+
+    external strokePolyline :
+      t -> (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+      = "ml_canvas_stroke_polyline"
+
     external fillText : t -> string -> Point.t -> unit
       = "ml_canvas_fill_text"
 
@@ -803,6 +887,50 @@ module V1 = struct
       src:t -> spos:(int * int) -> size:(int * int) -> unit
       = "ml_canvas_blit"
 
+    external drawImage :
+      dst:t -> dpos:Point.t -> dsize:Vector.t ->
+      src:t -> spos:(int * int) -> ssize:(int * int) -> unit
+      = "ml_canvas_draw_image" "ml_canvas_draw_image_n"
+
+    external drawSprites :
+      t -> src:t ->
+      (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+      = "ml_canvas_draw_sprites"
+
+    external drawSpritesFromImageData :
+      t -> src:ImageData.t ->
+      (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+      = "ml_canvas_draw_sprites_from_image_data"
+
+    (* Layers *)
+
+    external beginLayer : ?alpha:float -> ?op:CompositeOp.t -> t -> unit
+      = "ml_canvas_begin_layer"
+
+    external endLayer : t -> unit
+      = "ml_canvas_end_layer"
+
+    (* Pictures *)
+
+    external beginRecording : t -> unit
+      = "ml_canvas_begin_recording"
+
+    external endRecording : t -> Picture.t
+      = "ml_canvas_end_recording"
+
+    external drawPicture : t -> Picture.t -> Transform.t -> unit
+      = "ml_canvas_draw_picture"
+
+    (* Deferred rendering *)
+
+    external setDeferred : t -> bool -> unit
+      = "ml_canvas_set_deferred"
+
+    external getDeferred : t -> bool
+      = "ml_canvas_get_deferred"
+
     (* Direct pixel access *)
 
     external getPixel : t -> (int * int) -> Color.t
@@ -820,6 +948,18 @@ module V1 = struct
       spos:(int * int) -> size:(int * int) -> unit
       = "ml_canvas_put_image_data"
 
+    external lockPixels : t -> ImageData.t
+      = "ml_canvas_lock_pixels"
+
+    external unlockPixels : t -> unit
+      = "ml_canvas_unlock_pixels"
+
+    let withPixels c f =
+      let data = lockPixels c in
+      match f data with
+      | r -> unlockPixels c; r
+      | exception e -> unlockPixels c; raise e
+
     external importPNG_internal :
       t -> pos:(int * int) -> string -> (t -> unit) -> unit
       = "ml_canvas_import_png"
@@ -1169,6 +1309,14 @@ module V1 = struct
 
   module Backend = struct
 
+    type buffer_pool_stats = {
+      hits : int;
+      misses : int;
+      evictions : int;
+      entries : int;
+      bytes : int;
+    }
+
     external init : unit -> unit
       = "ml_canvas_init"
 
@@ -1185,6 +1333,18 @@ module V1 = struct
     external getCanvas : int -> Canvas.t
       = "ml_canvas_get_canvas"
 
+    external getBufferPoolBudget : unit -> int
+      = "ml_canvas_get_buffer_pool_budget"
+
+    external setBufferPoolBudget : int -> unit
+      = "ml_canvas_set_buffer_pool_budget"
+
+    external trimBufferPool : unit -> unit
+      = "ml_canvas_trim_buffer_pool"
+
+    external getBufferPoolStats : unit -> buffer_pool_stats
+      = "ml_canvas_get_buffer_pool_stats"
+
     let run k =
       let open InternalEvent in
       let open Event in
@@ -461,6 +461,26 @@ module V1 : sig
 
   end
 
+  module Filter : sig
+  (** Image filters *)
+
+    type t =
+      | Blur of float
+      | Brightness of float
+      | Contrast of float
+      | Grayscale of float
+      | DropShadow of Vector.t * float * Color.t (** *)
+    (** Filter functions, as in CSS. [Blur s] blurs with a standard
+        deviation of [s] pixels. [Brightness f] and [Contrast f]
+        scale the brightness and the contrast by [f], with [1.0]
+        leaving colors unchanged. [Grayscale a] converts to
+        grayscale by an amount [a] between [0.0] and [1.0].
+        [DropShadow (o, b, c)] draws a shadow of color [c] below
+        the image, offset by [o] and blurred by [b], where [b]
+        has the same meaning as in {!Canvas.setShadowBlur}. *)
+
+  end
+
   module ImageData : sig
   (** Image data manipulation functions *)
 
@@ -543,6 +563,10 @@ module V1 : sig
         {- {!Exception.Not_initialized} if {!Backend.init} was not called}
         {- {!Exception.Write_png_failed} if the PNG file could not be written}} *)
 
+    val applyFilter : t -> Filter.t list -> unit
+    (** [applyFilter id f] applies the filters [f] in order
+        to image data [id], in place *)
+
     type t_repr =
       (int, Bigarray.int8_unsigned_elt, Bigarray.c_layout) Bigarray.Array3.t
     (** Image data's internal representation is a big array of dimension 3
@@ -675,6 +699,16 @@ module V1 : sig
 
   end
 
+  module Picture : sig
+  (** Recorded drawing operations *)
+
+    type t
+    (** An abstract type representing a picture, i.e. a sequence
+        of drawing operations recorded with {!Canvas.beginRecording},
+        that can be replayed onto any canvas *)
+
+  end
+
   module Join : sig
 
     type t =
@@ -695,6 +729,19 @@ module V1 : sig
 
   end
 
+  module Smoothing : sig
+
+    type t =
+      | Off
+      | Low
+      | Medium
+      | High (** *)
+    (** The different image smoothing qualities: [Off] samples the
+        nearest pixel, [Low] uses bilinear interpolation,
+        [Medium] and [High] use bicubic interpolation *)
+
+  end
+
   module Style : sig
 
     type t =
@@ -744,6 +791,15 @@ module V1 : sig
     type t
     (** An abstract type representing a canvas *)
 
+    type mask_cache_stats = {
+      hits : int;      (** Fills served from a cached mask *)
+      misses : int;    (** Fills that had to compute their mask *)
+      evictions : int; (** Masks dropped to stay within the budget *)
+      entries : int;   (** Masks currently cached *)
+      bytes : int;     (** Memory currently used by the cache *)
+    }
+    (** Statistics of the coverage mask cache of a canvas *)
+
 
     (** {1 Comparison and hash functions} *)
 
@@ -869,6 +925,38 @@ module V1 : sig
     (** [setPosition c pos] sets the position of canvas [c].
         Does nothing on offscreen canvases. *)
 
+    val getPathTolerance : t -> float
+    (** [getPathTolerance c] returns the path decimation
+        tolerance of canvas [c] *)
+
+    val setPathTolerance : t -> float -> unit
+    (** [setPathTolerance c tol] sets the path decimation tolerance of
+        canvas [c] to [tol] device pixels. Runs of consecutive vertices
+        of filled or stroked paths that fall within the same [tol] wide
+        column are reduced to their first, last, lowest and highest
+        points, which preserves the envelope of dense paths such as long
+        time series. A tolerance of [0.0] (the default) keeps every
+        vertex. Dashed strokes are never decimated. Negative values
+        are ignored. *)
+
+    val getMaskCacheBudget : t -> int
+    (** [getMaskCacheBudget c] returns the memory budget, in bytes,
+        of the coverage mask cache of canvas [c] *)
+
+    val setMaskCacheBudget : t -> int -> unit
+    (** [setMaskCacheBudget c size] sets the memory budget of the
+        coverage mask cache of canvas [c] to [size] bytes, evicting the
+        least recently used masks if needed. When a {!Path.t} is filled
+        under a transform that only differs by its translation from a
+        previous fill of the same path, the cached coverage mask is
+        reused. Translations are rounded to a quarter of a pixel.
+        A budget of [0] disables the cache. Negative values
+        are ignored. *)
+
+    val getMaskCacheStats : t -> mask_cache_stats
+    (** [getMaskCacheStats c] returns statistics about
+        the coverage mask cache of canvas [c] *)
+
 
     (** {1 State} *)
 
@@ -1006,6 +1094,16 @@ module V1 : sig
     (** [setGlobalCompositeOperation c o] sets the global
         composite or blending operation of canvas[c] to [o] *)
 
+    val getImageSmoothing : t -> Smoothing.t
+    (** [getImageSmoothing c] returns the image smoothing
+        quality of canvas [c] *)
+
+    val setImageSmoothing : t -> Smoothing.t -> unit
+    (** [setImageSmoothing c s] sets the quality used by canvas [c]
+        to sample images and patterns that are transformed to [s].
+        The default is [Medium]. Images that are only translated
+        by whole pixels are always copied without interpolation. *)
+
     val getShadowColor : t -> Color.t
     (** [setShadowColor c] returns the canvas [c]'s shadow color *)
 
@@ -1025,6 +1123,20 @@ module V1 : sig
     (** [setShadowOffset c o] sets the offset
         of the shadows drawn in [c] to [o] *)
 
+    val getFilter : t -> Filter.t list
+    (** [getFilter c] returns the filter applied to the
+        drawing operations of canvas [c] *)
+
+    val setFilter : t -> Filter.t list -> unit
+    (** [setFilter c f] sets the filter applied to the drawing
+        operations of canvas [c] to [f]. Each drawing operation is
+        then rendered to a transparent layer, to which the filters
+        in [f] are applied in order, before the layer is composed
+        onto the canvas with the global alpha, the global composite
+        operation and the clip path. Clearing and direct pixel
+        access are not filtered. The default is [[]], which
+        disables filtering. *)
+
     val setFont :
       t -> string -> size:Font.size ->
       slant:Font.slant -> weight:Font.weight -> unit
@@ -1131,6 +1243,54 @@ module V1 : sig
         the rectangle specified by [pos] and [size] to the canvas
         [c] using the current stroke color and line width *)
 
+    val fillRects :
+      t ->
+      ?colors:(int32, Bigarray.int32_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+    (** [fillRects c ?colors rects] immediatly fills the rectangles
+        whose successive [(x, y, width, height)] quadruples are stored
+        in [rects] to the canvas [c]. If [colors] is given, rectangle
+        [i] is filled with the color {!Color.of_int32} [colors.{i}],
+        otherwise with the current fill style. When the transform
+        only scales and translates and no shadow is cast, no polygon
+        is built and edge pixels get their exact coverage.
+
+        {b Exceptions:}
+        {ul
+        {- {!Invalid_argument} if the number of elements of [rects] is
+           not a multiple of 4, or if [colors] has fewer elements than
+           there are rectangles}} *)
+
+    val fillCircles :
+      t ->
+      ?colors:(int32, Bigarray.int32_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+    (** [fillCircles c ?colors circles] immediatly fills the circles
+        whose successive [(x, y, radius)] triples are stored in
+        [circles] to the canvas [c], like {!fillRects}.
+
+        {b Exceptions:}
+        {ul
+        {- {!Invalid_argument} if the number of elements of [circles] is
+           not a multiple of 3, or if [colors] has fewer elements than
+           there are circles}} *)
+
+    val strokePolyline :
+      t -> (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+    (** [strokePolyline c coords] immediatly draws the open polyline
+        whose successive vertices are the [(x, y)] pairs stored in
+        [coords] to the canvas [c] using the current stroke style and
+        line width. The current path is left untouched. Lines that are
+        at most one pixel wide and that do not use miter joins are drawn
+        with a dedicated fast path.
+
+        {b Exceptions:}
+        {ul
+        {- {!Invalid_argument} if [coords] has an odd number of elements}} *)
+
     val fillText : t -> string -> Point.t -> unit
     (** [fillText c text pos] immediatly draws the text [text] at
         position [pos] on the canvas [c] using the current fill color *)
@@ -1152,6 +1312,124 @@ module V1 : sig
         {ul
         {- {!Invalid_argument} if either component of [size] is outside the range 1-32767}} *)
 
+    val drawImage :
+      dst:t -> dpos:Point.t -> dsize:Vector.t ->
+      src:t -> spos:(int * int) -> ssize:(int * int) -> unit
+    (** [drawImage ~dst ~dpos ~dsize ~src ~spos ~ssize] draws the area
+        specified by [spos] and [ssize] from canvas [src] into the
+        rectangle specified by [dpos] and [dsize] on canvas [dst],
+        scaling it as needed. The drawing is subject to the current
+        transform, global alpha, shadow, composite operation and image
+        smoothing setting of [dst]. Parts of the source area that lie
+        outside [src] are ignored.
+
+        {b Exceptions:}
+        {ul
+        {- {!Invalid_argument} if either component of [ssize] is outside the range 1-32767}} *)
+
+    val drawSprites :
+      t -> src:t ->
+      (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+    (** [drawSprites c ~src sprites] draws a batch of sprites taken
+        from the atlas canvas [src] to the canvas [c], in a single call.
+        Each sprite is described by 9 consecutive floats in [sprites]:
+        the position and size [(sx, sy, sw, sh)] of the sprite in [src],
+        the position [(dx, dy)] of its top-left corner in [c], a scaling
+        factor, a rotation angle (in radians, around the center of the
+        sprite) and an opacity. Sprites are drawn in order, and are
+        subject to the current state of [c] like {!drawImage}. Sprites
+        that are neither scaled, rotated nor transformed take a fast path.
+
+        {b Exceptions:}
+        {ul
+        {- {!Invalid_argument} if the number of elements of [sprites] is
+           not a multiple of 9}} *)
+
+    val drawSpritesFromImageData :
+      t -> src:ImageData.t ->
+      (float, Bigarray.float64_elt, Bigarray.c_layout) Bigarray.Array1.t ->
+      unit
+    (** [drawSpritesFromImageData c ~src sprites] is the same as
+        {!drawSprites}, but takes the sprites from the image data [src]
+
+        {b Exceptions:}
+        {ul
+        {- {!Invalid_argument} if the number of elements of [sprites] is
+           not a multiple of 9}} *)
+
+
+    (** {1 Layers} *)
+
+    val beginLayer : ?alpha:float -> ?op:CompositeOp.t -> t -> unit
+    (** [beginLayer ?alpha ?op c] saves the state of canvas [c] and
+        redirects subsequent drawing to a transparent layer. When the
+        layer ends, it is composed back as a whole with global alpha
+        [alpha] and composite operation [op], which default to the
+        current ones, within the current clip path and through the
+        current filter. Within the layer, the global alpha, composite
+        operation and filter are reset. Only the area actually drawn
+        to is filtered and composed back. Within a layer, {!restore}
+        does not restore states saved before the layer began, and
+        states saved but not restored are discarded when it ends.
+
+        {b Exceptions:}
+        {ul
+        {- {!Failure} if the layer could not be created}
+        {- {!Failure} if [c] is recording a picture}} *)
+
+    val endLayer : t -> unit
+    (** [endLayer c] composes the innermost layer of canvas [c] back,
+        and restores the state saved by the matching {!beginLayer}.
+        Does nothing if no layer was begun. *)
+
+
+    (** {1 Pictures} *)
+
+    val beginRecording : t -> unit
+    (** [beginRecording c] starts recording the drawing operations
+        performed on canvas [c] into a new picture, discarding any
+        recording in progress. Until {!endRecording} is called, paths,
+        rectangles, circles and text are flattened and recorded, along
+        with the style, global alpha, shadow, composite operation and
+        clip path they are drawn with, instead of being drawn. Filters
+        are not recorded, and image operations still draw directly.
+
+        {b Exceptions:}
+        {ul
+        {- {!Failure} if the picture could not be created}} *)
+
+    val endRecording : t -> Picture.t
+    (** [endRecording c] stops recording on canvas [c] and returns
+        the recorded picture, which is empty if [c] was not recording *)
+
+    val drawPicture : t -> Picture.t -> Transform.t -> unit
+    (** [drawPicture c p t] replays the picture [p] onto the canvas [c],
+        mapped by [t] then by the current transform of [c], within the
+        current clip path and with the current global alpha. Replaying
+        with an identity transform reuses the recorded polygons as is. *)
+
+
+    (** {1 Deferred rendering} *)
+
+    val setDeferred : t -> bool -> unit
+    (** [setDeferred c d] sets whether drawing operations on canvas [c]
+        are deferred. Deferred paths, rectangles, circles and text are
+        recorded instead of drawn, and rendered only when the canvas
+        contents are needed: on {!commit}, on direct pixel access, or
+        when an image is drawn onto or from [c]. They are then rendered
+        by screen bands, spread over the available processors, with the
+        same result as if drawn immediately. Disabling deferred
+        rendering renders the pending operations.
+
+        {b Exceptions:}
+        {ul
+        {- {!Failure} if the operation list could not be created}} *)
+
+    val getDeferred : t -> bool
+    (** [getDeferred c] returns whether drawing operations on
+        canvas [c] are deferred *)
+
 
     (** {1 Direct pixel access} *)
 
@@ -1193,6 +1471,34 @@ module V1 : sig
         {ul
         {- {!Invalid_argument} if either component of [size] is outside the range 1-32767}} *)
 
+    val lockPixels : t -> ImageData.t
+    (** [lockPixels c] returns the pixels of canvas [c] as image data
+        that shares the canvas memory, so that they can be read and
+        written in place without copying; changes become visible
+        on the next commit. Pending deferred drawing operations are
+        rendered first, and drawing is not deferred while the pixels
+        are locked. The image data remains valid until {!unlockPixels}
+        is called, or the canvas is locked again, resized or destroyed,
+        or begins or ends a layer; it then becomes empty, and any
+        further access fails. Sub-arrays of the image data are not
+        invalidated: they keep the pixels as they were when unlocking,
+        but no longer share them with the canvas. The pixels of an
+        onscreen canvas outside of a layer belong to the window system,
+        so the image data is then a copy that is written back when
+        unlocking, as always with the javascript backend.
+
+        {b Exceptions:}
+        {ul
+        {- {!Failure} if the canvas pixels cannot be accessed directly}} *)
+
+    val unlockPixels : t -> unit
+    (** [unlockPixels c] invalidates the image data returned by the
+        last call to {!lockPixels} on canvas [c], if still valid *)
+
+    val withPixels : t -> (ImageData.t -> 'a) -> 'a
+    (** [withPixels c f] calls [f] on the locked pixels of canvas [c],
+        and unlocks them when [f] returns or raises an exception *)
+
     val importPNG :
       t -> pos:(int * int) -> string -> t React.event
     (** [importPNG c ~pos filename] loads the file [filename]
@@ -1509,6 +1815,15 @@ module V1 : sig
   module Backend : sig
   (** Initialization and event loop control *)
 
+    type buffer_pool_stats = {
+      hits : int;      (** Buffers recycled from the pool *)
+      misses : int;    (** Buffers that had to be allocated *)
+      evictions : int; (** Buffers freed to stay within the budget *)
+      entries : int;   (** Buffers currently held by the pool *)
+      bytes : int;     (** Memory currently held by the pool *)
+    }
+    (** Statistics of the pool of pixel buffers *)
+
     val init : unit -> unit
     (** [init ()] initializes the backend
 
@@ -1558,6 +1873,27 @@ module V1 : sig
         {ul
         {- {!Exception.Not_initialized} if {!Backend.init} was not called}} *)
 
+    val getBufferPoolBudget : unit -> int
+    (** [getBufferPoolBudget ()] returns the memory budget, in bytes,
+        of the pool of pixel buffers *)
+
+    val setBufferPoolBudget : int -> unit
+    (** [setBufferPoolBudget size] sets the memory budget of the pool
+        of pixel buffers to [size] bytes, freeing the least recently
+        released buffers if needed. Large pixel buffers, such as those
+        of offscreen canvases, image data, layers and shadows, are handed
+        back to this pool when no longer needed, and recycled for later
+        buffers of a similar size. A budget of [0] disables the pool.
+        Negative values are ignored. *)
+
+    val trimBufferPool : unit -> unit
+    (** [trimBufferPool ()] frees all the buffers held by
+        the pool of pixel buffers *)
+
+    val getBufferPoolStats : unit -> buffer_pool_stats
+    (** [getBufferPoolStats ()] returns statistics about
+        the pool of pixel buffers *)
+
   end
 
 end
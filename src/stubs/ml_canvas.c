@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 
 #define CAML_NAME_SPACE
@@ -29,11 +30,15 @@
 #include "../implem/transform.h"
 #include "../implem/path.h"
 #include "../implem/path2d.h"
+#include "../implem/picture.h"
 #include "../implem/pixmap.h"
+#include "../implem/filters.h"
 #include "../implem/impexp.h"
 #include "../implem/event.h"
 #include "../implem/canvas.h"
+#include "../implem/sprite.h"
 #include "../implem/backend.h"
+#include "../implem/buffer_pool.h"
 
 #include "ml_tags.h"
 #include "ml_convert.h"
@@ -132,6 +137,22 @@ ml_canvas_image_data_fill(
   CAMLreturn(Val_unit);
 }
 
+CAMLprim value
+ml_canvas_image_data_apply_filter(
+  value mlPixmap,
+  value mlFilters)
+{
+  CAMLparam2(mlPixmap, mlFilters);
+  pixmap_t pixmap = Pixmap_val(mlPixmap);
+  int32_t nb_filters = 0;
+  filter_t *filters = Filter_list_val(mlFilters, &nb_filters);
+  if (filters != NULL) {
+    filter_apply(&pixmap, filters, nb_filters);
+    free(filters);
+  }
+  CAMLreturn(Val_unit);
+}
+
 CAMLprim value
 ml_canvas_image_data_sub(
   value mlPixmap,
@@ -147,11 +168,10 @@ ml_canvas_image_data_sub(
   int32_t sx = Int31_val_clip(Field(mlPos, 0));
   int32_t sy = Int31_val_clip(Field(mlPos, 1));
   pixmap_t src_pixmap = Pixmap_val(mlPixmap);
-  pixmap_t dst_pixmap = pixmap(width, height, NULL);
+  pixmap_t dst_pixmap = pixmap_extract(&src_pixmap, sx, sy, width, height);
   if (pixmap_valid(dst_pixmap) == false) {
     caml_failwith("ImageData.sub: unable to extract sub image data");
   }
-  pixmap_blit(&dst_pixmap, 0, 0, &src_pixmap, sx, sy, width, height);
   CAMLreturn(Val_pixmap(&dst_pixmap));
 }
 
@@ -888,6 +908,64 @@ ml_canvas_set_position(
   CAMLreturn(Val_unit);
 }
 
+CAMLprim value
+ml_canvas_get_path_tolerance(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  CAMLreturn(caml_copy_double(
+    canvas_get_path_tolerance(Canvas_val(mlCanvas))));
+}
+
+CAMLprim value
+ml_canvas_set_path_tolerance(
+  value mlCanvas,
+  value mlTolerance)
+{
+  CAMLparam2(mlCanvas, mlTolerance);
+  canvas_set_path_tolerance(Canvas_val(mlCanvas),
+                            Double_val(mlTolerance));
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_get_mask_cache_budget(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  CAMLreturn(Val_long(canvas_get_mask_cache_budget(Canvas_val(mlCanvas))));
+}
+
+CAMLprim value
+ml_canvas_set_mask_cache_budget(
+  value mlCanvas,
+  value mlBudget)
+{
+  CAMLparam2(mlCanvas, mlBudget);
+  if (Long_val(mlBudget) >= 0) {
+    canvas_set_mask_cache_budget(Canvas_val(mlCanvas),
+                                 (size_t)Long_val(mlBudget));
+  }
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_get_mask_cache_stats(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  CAMLlocal1(mlStats);
+  mask_cache_stats_t stats = { 0 };
+  canvas_get_mask_cache_stats(Canvas_val(mlCanvas), &stats);
+  mlStats = caml_alloc_tuple(5);
+  Store_field(mlStats, 0, Val_long(stats.hits));
+  Store_field(mlStats, 1, Val_long(stats.misses));
+  Store_field(mlStats, 2, Val_long(stats.evictions));
+  Store_field(mlStats, 3, Val_long(stats.entries));
+  Store_field(mlStats, 4, Val_long(stats.bytes));
+  CAMLreturn(mlStats);
+}
+
 
 
 /* Transform */
@@ -1299,6 +1377,25 @@ ml_canvas_set_global_composite_operation(
   CAMLreturn(Val_unit);
 }
 
+CAMLprim value
+ml_canvas_get_image_smoothing(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  CAMLreturn(Val_smoothing(canvas_get_image_smoothing(Canvas_val(mlCanvas))));
+}
+
+CAMLprim value
+ml_canvas_set_image_smoothing(
+  value mlCanvas,
+  value mlSmoothing)
+{
+  CAMLparam2(mlCanvas, mlSmoothing);
+  canvas_set_image_smoothing(Canvas_val(mlCanvas),
+                             Smoothing_val(mlSmoothing));
+  CAMLreturn(Val_unit);
+}
+
 CAMLprim value
 ml_canvas_get_shadow_color(
   value mlCanvas)
@@ -1363,6 +1460,31 @@ ml_canvas_set_shadow_offset(
   CAMLreturn(Val_unit);
 }
 
+CAMLprim value
+ml_canvas_get_filter(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  canvas_t *canvas = Canvas_val(mlCanvas);
+  CAMLreturn(Val_filter_list(canvas_get_filter(canvas),
+                             canvas_get_filter_length(canvas)));
+}
+
+CAMLprim value
+ml_canvas_set_filter(
+  value mlCanvas,
+  value mlFilters)
+{
+  CAMLparam2(mlCanvas, mlFilters);
+  int32_t nb_filters = 0;
+  filter_t *filters = Filter_list_val(mlFilters, &nb_filters);
+  canvas_set_filter(Canvas_val(mlCanvas), filters, nb_filters);
+  if (filters != NULL) {
+    free(filters);
+  }
+  CAMLreturn(Val_unit);
+}
+
 CAMLprim value
 ml_canvas_set_font(
   value mlCanvas,
@@ -1645,6 +1767,79 @@ ml_canvas_stroke_rect(
   CAMLreturn(Val_unit);
 }
 
+// Returns the number of instances in a batch of primitives described
+// by size consecutive floats, checking the optional per-instance colors
+static int32_t
+_ml_canvas_batch_size(
+  value mlColors,
+  value mlCoords,
+  intnat size,
+  const char *fun)
+{
+  intnat len = Caml_ba_array_val(mlCoords)->dim[0];
+  if ((len % size != 0) || (len / size > INT32_MAX) ||
+      (Is_some(mlColors) &&
+       (Caml_ba_array_val(Some_val(mlColors))->dim[0] < len / size))) {
+    caml_invalid_argument(fun);
+  }
+  return (int32_t)(len / size);
+}
+
+CAMLprim value
+ml_canvas_fill_rects(
+  value mlCanvas,
+  value mlColors,
+  value mlRects)
+{
+  CAMLparam3(mlCanvas, mlColors, mlRects);
+  int32_t nb_rects =
+    _ml_canvas_batch_size(mlColors, mlRects, 4,
+                          "Canvas.fillRects: invalid number of elements");
+  canvas_fill_rects(Canvas_val(mlCanvas),
+                    (const double *)Caml_ba_data_val(mlRects),
+                    nb_rects,
+                    Is_some(mlColors) ?
+                    (const int32_t *)Caml_ba_data_val(Some_val(mlColors)) :
+                    NULL);
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_fill_circles(
+  value mlCanvas,
+  value mlColors,
+  value mlCircles)
+{
+  CAMLparam3(mlCanvas, mlColors, mlCircles);
+  int32_t nb_circles =
+    _ml_canvas_batch_size(mlColors, mlCircles, 3,
+                          "Canvas.fillCircles: invalid number of elements");
+  canvas_fill_circles(Canvas_val(mlCanvas),
+                      (const double *)Caml_ba_data_val(mlCircles),
+                      nb_circles,
+                      Is_some(mlColors) ?
+                      (const int32_t *)Caml_ba_data_val(Some_val(mlColors)) :
+                      NULL);
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_stroke_polyline(
+  value mlCanvas,
+  value mlCoords)
+{
+  CAMLparam2(mlCanvas, mlCoords);
+  intnat len = Caml_ba_array_val(mlCoords)->dim[0];
+  if ((len % 2 != 0) || (len / 2 > INT32_MAX)) {
+    caml_invalid_argument("Canvas.strokePolyline: "
+                          "invalid number of coordinates");
+  }
+  canvas_stroke_polyline(Canvas_val(mlCanvas),
+                         (const double *)Caml_ba_data_val(mlCoords),
+                         (int32_t)(len / 2));
+  CAMLreturn(Val_unit);
+}
+
 CAMLprim value
 ml_canvas_fill_text(
   value mlCanvas,
@@ -1700,6 +1895,199 @@ ml_canvas_blit(
   CAMLreturn(Val_unit);
 }
 
+CAMLprim value
+ml_canvas_draw_image_n(
+  value mlDstCanvas,
+  value mlDPos,
+  value mlDSize,
+  value mlSrcCanvas,
+  value mlSPos,
+  value mlSSize)
+{
+  CAMLparam5(mlDstCanvas, mlDPos, mlDSize, mlSrcCanvas, mlSPos);
+  CAMLxparam1(mlSSize);
+  int32_t width = Int31_val_clip(Field(mlSSize, 0));
+  int32_t height = Int31_val_clip(Field(mlSSize, 1));
+  if (!_ml_canvas_valid_canvas_size(width, height)) {
+    caml_invalid_argument("Canvas.drawImage: invalid dimensions");
+  }
+  canvas_draw_image(Canvas_val(mlDstCanvas),
+                    Double_val(Field(mlDPos, 0)),
+                    Double_val(Field(mlDPos, 1)),
+                    Double_val(Field(mlDSize, 0)),
+                    Double_val(Field(mlDSize, 1)),
+                    Canvas_val(mlSrcCanvas),
+                    Int31_val_clip(Field(mlSPos, 0)),
+                    Int31_val_clip(Field(mlSPos, 1)),
+                    width,
+                    height);
+  CAMLreturn(Val_unit);
+}
+
+BYTECODE_STUB_6(ml_canvas_draw_image)
+
+static int32_t
+_ml_canvas_nb_sprites(
+  value mlSprites,
+  const char *fun)
+{
+  intnat len = Caml_ba_array_val(mlSprites)->dim[0];
+  if ((len % SPRITE_SIZE != 0) || (len / SPRITE_SIZE > INT32_MAX)) {
+    caml_invalid_argument(fun);
+  }
+  return (int32_t)(len / SPRITE_SIZE);
+}
+
+CAMLprim value
+ml_canvas_draw_sprites(
+  value mlDstCanvas,
+  value mlSrcCanvas,
+  value mlSprites)
+{
+  CAMLparam3(mlDstCanvas, mlSrcCanvas, mlSprites);
+  int32_t nb_sprites =
+    _ml_canvas_nb_sprites(mlSprites, "Canvas.drawSprites: "
+                                     "invalid number of elements");
+  canvas_draw_sprites(Canvas_val(mlDstCanvas),
+                      Canvas_val(mlSrcCanvas),
+                      (const double *)Caml_ba_data_val(mlSprites),
+                      nb_sprites);
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_draw_sprites_from_image_data(
+  value mlCanvas,
+  value mlPixmap,
+  value mlSprites)
+{
+  CAMLparam3(mlCanvas, mlPixmap, mlSprites);
+  int32_t nb_sprites =
+    _ml_canvas_nb_sprites(mlSprites, "Canvas.drawSpritesFromImageData: "
+                                     "invalid number of elements");
+  pixmap_t pixmap = Pixmap_val(mlPixmap);
+  canvas_draw_sprites_from_pixmap(Canvas_val(mlCanvas), &pixmap,
+                                  (const double *)Caml_ba_data_val(mlSprites),
+                                  nb_sprites);
+  CAMLreturn(Val_unit);
+}
+
+
+
+/* Layers */
+
+CAMLprim value
+ml_canvas_begin_layer(
+  value mlAlpha,
+  value mlOp,
+  value mlCanvas)
+{
+  CAMLparam3(mlAlpha, mlOp, mlCanvas);
+  canvas_t *canvas = Canvas_val(mlCanvas);
+  double alpha = Is_some(mlAlpha) ?
+    Double_val(Some_val(mlAlpha)) : canvas_get_global_alpha(canvas);
+  composite_operation_t op = Is_some(mlOp) ?
+    Compop_val(Some_val(mlOp)) : canvas_get_comp_operation(canvas);
+  if (canvas_begin_layer(canvas, alpha, op) == false) {
+    caml_failwith("Canvas.beginLayer: unable to create the layer, "
+                  "or the canvas is recording");
+  }
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_end_layer(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  canvas_end_layer(Canvas_val(mlCanvas));
+  CAMLreturn(Val_unit);
+}
+
+/* Pictures */
+
+static void
+_ml_canvas_picture_destroy_callback(
+  picture_t *picture)
+{
+  CAMLparam0();
+  value *mlWeakPointer_ptr = (value *)picture_get_data(picture);
+  if (mlWeakPointer_ptr != NULL) {
+    picture_set_data(picture, NULL);
+    caml_remove_generational_global_root(mlWeakPointer_ptr);
+    free(mlWeakPointer_ptr);
+  }
+  CAMLreturn0;
+}
+
+CAMLprim value
+ml_canvas_begin_recording(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  if (canvas_begin_recording(Canvas_val(mlCanvas)) == false) {
+    caml_failwith("Canvas.beginRecording: unable to create the picture");
+  }
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_end_recording(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  CAMLlocal1(mlPicture);
+  picture_t *picture = canvas_end_recording(Canvas_val(mlCanvas));
+  if (picture == NULL) {
+    // Not recording: return an empty picture
+    picture = picture_create();
+    if (picture == NULL) {
+      caml_failwith("Canvas.endRecording: unable to create the picture");
+    }
+  }
+  mlPicture = Val_picture(picture);
+  picture_release(picture); /* Because Val_picture retains it */
+  CAMLreturn(mlPicture);
+}
+
+CAMLprim value
+ml_canvas_draw_picture(
+  value mlCanvas,
+  value mlPicture,
+  value mlTransform)
+{
+  CAMLparam3(mlCanvas, mlPicture, mlTransform);
+  transform_t transform = Transform_val(mlTransform);
+  canvas_draw_picture(Canvas_val(mlCanvas), Picture_val(mlPicture),
+                      &transform);
+  CAMLreturn(Val_unit);
+}
+
+
+
+/* Deferred rendering */
+
+CAMLprim value
+ml_canvas_set_deferred(
+  value mlCanvas,
+  value mlDeferred)
+{
+  CAMLparam2(mlCanvas, mlDeferred);
+  if (canvas_set_deferred(Canvas_val(mlCanvas),
+                          Bool_val(mlDeferred)) == false) {
+    caml_failwith("Canvas.setDeferred: unable to create the operation list");
+  }
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_get_deferred(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  CAMLreturn(Val_bool(canvas_get_deferred(Canvas_val(mlCanvas))));
+}
+
 
 
 /* Direct pixel access */
@@ -1782,6 +2170,114 @@ ml_canvas_put_image_data(
   CAMLreturn(Val_unit);
 }
 
+// Image data returned by Canvas.lockPixels; views of it share its
+// proxy, so that the pixels can be handed over to them if they
+// outlive the lock
+typedef struct ml_canvas_lock_t {
+  value image_data; // generational global root, unit until created
+  color_t_ *pixels; // locked canvas pixels
+  bool copied; // the image data holds a copy, written back on unlock
+} ml_canvas_lock_t;
+
+static void
+_ml_canvas_canvas_unlock_callback(
+  canvas_t *canvas,
+  void *lock_data)
+{
+  CAMLparam0();
+  ml_canvas_lock_t *lock = (ml_canvas_lock_t *)lock_data;
+  if (lock == NULL) {
+    CAMLreturn0;
+  }
+  if (lock->image_data != Val_unit) {
+    struct caml_ba_array *ba = Caml_ba_array_val(lock->image_data);
+    if (lock->copied == true) {
+      memcpy(lock->pixels, ba->data,
+             (size_t)ba->dim[0] * (size_t)ba->dim[1] * COLOR_SIZE);
+    } else if (ba->proxy->refcount > 1) {
+      // Views of the image data outlive the lock:
+      // they take the pixels over, and free them
+      ba->proxy->data = canvas_detach_pixels(canvas);
+    }
+    // Make the image data empty, so that any further access
+    // is out of bounds
+    ba->data = NULL;
+    ba->dim[0] = 0;
+    ba->dim[1] = 0;
+  }
+  caml_remove_generational_global_root(&lock->image_data);
+  free(lock);
+  CAMLreturn0;
+}
+
+CAMLprim value
+ml_canvas_lock_pixels(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  CAMLlocal1(mlImageData);
+  canvas_t *canvas = Canvas_val(mlCanvas);
+  ml_canvas_lock_t *lock =
+    (ml_canvas_lock_t *)calloc(1, sizeof(ml_canvas_lock_t));
+  struct caml_ba_proxy *proxy =
+    (struct caml_ba_proxy *)calloc(1, sizeof(struct caml_ba_proxy));
+  if ((lock == NULL) || (proxy == NULL)) {
+    free(proxy);
+    free(lock);
+    caml_failwith("Canvas.lockPixels: unable to lock the canvas pixels");
+  }
+  lock->image_data = Val_unit;
+  caml_register_generational_global_root(&lock->image_data);
+  pixmap_t pixmap = canvas_lock_pixels(canvas, lock);
+  if (pixmap_valid(pixmap) == false) {
+    caml_remove_generational_global_root(&lock->image_data);
+    free(lock);
+    free(proxy);
+    caml_failwith("Canvas.lockPixels: unable to lock the canvas pixels");
+  }
+  lock->pixels = pixmap.data;
+
+  // Pixels that cannot be handed over to the image data are copied
+  size_t size = pixmap_size(pixmap.width, pixmap.height);
+  void *data = pixmap.data;
+  if (canvas_can_detach_pixels(canvas) == false) {
+    data = malloc(size);
+    if (data == NULL) {
+      canvas_unlock_pixels(canvas);
+      free(proxy);
+      caml_failwith("Canvas.lockPixels: unable to lock the canvas pixels");
+    }
+    memcpy(data, pixmap.data, size);
+    proxy->data = data;
+    lock->copied = true;
+  }
+  proxy->refcount = 1;
+  proxy->size = size;
+
+  // The proxy only owns the pixels once handed over or copied; the
+  // image data is allocated as external so as not to count them
+  intnat dims[CAML_BA_MAX_NUM_DIMS] = { (intnat)pixmap.height,
+                                        (intnat)pixmap.width,
+                                        COLOR_SIZE };
+  mlImageData =
+    caml_ba_alloc(CAML_BA_UINT8 | CAML_BA_C_LAYOUT | CAML_BA_EXTERNAL,
+                  3, data, dims);
+  struct caml_ba_array *ba = Caml_ba_array_val(mlImageData);
+  ba->flags = (ba->flags & ~CAML_BA_MANAGED_MASK) | CAML_BA_MANAGED;
+  ba->proxy = proxy;
+  caml_modify_generational_global_root(&lock->image_data, mlImageData);
+  CAMLreturn(mlImageData);
+}
+
+CAMLprim value
+ml_canvas_unlock_pixels(
+  value mlCanvas)
+{
+  CAMLparam1(mlCanvas);
+  canvas_unlock_pixels(Canvas_val(mlCanvas));
+  CAMLreturn(Val_unit);
+}
+
 CAMLprim value
 ml_canvas_import_png(
   value mlCanvas,
@@ -1870,9 +2366,11 @@ ml_canvas_init()
   }
 
   canvas_set_destroy_callback(_ml_canvas_canvas_destroy_callback);
+  canvas_set_unlock_callback(_ml_canvas_canvas_unlock_callback);
   gradient_set_destroy_callback(_ml_canvas_gradient_destroy_callback);
   pattern_set_destroy_callback(_ml_canvas_pattern_destroy_callback);
   path2d_set_destroy_callback(_ml_canvas_path_destroy_callback);
+  picture_set_destroy_callback(_ml_canvas_picture_destroy_callback);
 
   CAMLreturn(Val_unit);
 }
@@ -1987,3 +2485,48 @@ ml_canvas_get_current_timestamp(
   _ml_canvas_ensure_initialized();
   CAMLreturn(caml_copy_int64(backend_get_time()));
 }
+
+CAMLprim value
+ml_canvas_get_buffer_pool_budget(
+  value mlUnit)
+{
+  CAMLparam1(mlUnit);
+  CAMLreturn(Val_long(buffer_pool_get_budget()));
+}
+
+CAMLprim value
+ml_canvas_set_buffer_pool_budget(
+  value mlBudget)
+{
+  CAMLparam1(mlBudget);
+  if (Long_val(mlBudget) >= 0) {
+    buffer_pool_set_budget((size_t)Long_val(mlBudget));
+  }
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_trim_buffer_pool(
+  value mlUnit)
+{
+  CAMLparam1(mlUnit);
+  buffer_pool_trim();
+  CAMLreturn(Val_unit);
+}
+
+CAMLprim value
+ml_canvas_get_buffer_pool_stats(
+  value mlUnit)
+{
+  CAMLparam1(mlUnit);
+  CAMLlocal1(mlStats);
+  buffer_pool_stats_t stats = { 0 };
+  buffer_pool_get_stats(&stats);
+  mlStats = caml_alloc_tuple(5);
+  Store_field(mlStats, 0, Val_long(stats.hits));
+  Store_field(mlStats, 1, Val_long(stats.misses));
+  Store_field(mlStats, 2, Val_long(stats.evictions));
+  Store_field(mlStats, 3, Val_long(stats.entries));
+  Store_field(mlStats, 4, Val_long(stats.bytes));
+  CAMLreturn(mlStats);
+}
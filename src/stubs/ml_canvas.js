@@ -315,6 +315,28 @@ function ml_canvas_image_data_fill(data, color) {
   return 0;
 }
 
+//Provides: ml_canvas_image_data_apply_filter
+//Requires: _ml_canvas_surface_of_ba, Filter_list_val, caml_ba_to_typed_array
+function ml_canvas_image_data_apply_filter(data, filters) {
+  var src = _ml_canvas_surface_of_ba(data);
+  var dst = document.createElement("canvas");
+  dst.width = src.width;
+  dst.height = src.height;
+  var ctxt = dst.getContext("2d");
+  ctxt.filter = Filter_list_val(filters);
+  ctxt.drawImage(src, 0, 0);
+  var sta = ctxt.getImageData(0, 0, dst.width, dst.height).data;
+  var dta = caml_ba_to_typed_array(data);
+  // Convert from RGBA to BGRA
+  for (var i = 0; i < sta.length; i += 4) {
+    dta[i+0] = sta[i+2];
+    dta[i+1] = sta[i+1];
+    dta[i+2] = sta[i+0];
+    dta[i+3] = sta[i+3];
+  }
+  return 0;
+}
+
 //Provides: _ml_canvas_adjust_blit_info
 function _ml_canvas_adjust_blit_info(dwidth, dheight, dx, dy,
                                      swidth, sheight, sx, sy, width, height) {
@@ -932,13 +954,14 @@ function ml_canvas_get_size(canvas) {
 
 // Provides: ml_canvas_set_size
 // Requires: _ml_canvas_valid_canvas_size, _ml_canvas_decorate
-// Requires: caml_invalid_argument
+// Requires: ml_canvas_unlock_pixels, caml_invalid_argument
 function ml_canvas_set_size(canvas, size) {
   var width = size[1];
   var height = size[2];
   if (!_ml_canvas_valid_canvas_size(width, height)) {
     caml_invalid_argument("Canvas.setSize: invalid dimensions");
   }
+  ml_canvas_unlock_pixels(canvas);
   var img = canvas.ctxt.getImageData(0, 0, canvas.width, canvas.height);
   if (canvas.header !== null) {
       canvas.header.width = width;
@@ -974,6 +997,42 @@ function ml_canvas_set_position(canvas, pos) {
   return 0;
 }
 
+// Provides: ml_canvas_get_path_tolerance
+function ml_canvas_get_path_tolerance(canvas) {
+  return (canvas.pathTolerance === undefined) ? 0.0 : canvas.pathTolerance;
+}
+
+// Provides: ml_canvas_set_path_tolerance
+function ml_canvas_set_path_tolerance(canvas, tolerance) {
+  // The browser rasterizer has no decimation stage,
+  // the value is only recorded
+  if (tolerance >= 0.0) {
+    canvas.pathTolerance = tolerance;
+  }
+  return 0;
+}
+
+// Provides: ml_canvas_get_mask_cache_budget
+function ml_canvas_get_mask_cache_budget(canvas) {
+  return (canvas.maskCacheBudget === undefined) ?
+    4 * 1024 * 1024 : canvas.maskCacheBudget;
+}
+
+// Provides: ml_canvas_set_mask_cache_budget
+function ml_canvas_set_mask_cache_budget(canvas, budget) {
+  // The browser handles its own rasterization caches,
+  // the value is only recorded
+  if (budget >= 0) {
+    canvas.maskCacheBudget = budget;
+  }
+  return 0;
+}
+
+// Provides: ml_canvas_get_mask_cache_stats
+function ml_canvas_get_mask_cache_stats(canvas) {
+  return [0, 0, 0, 0, 0, 0];
+}
+
 
 
 /* Transform */
@@ -1242,6 +1301,23 @@ function ml_canvas_set_global_composite_operation(canvas, op) {
   return 0;
 }
 
+//Provides: ml_canvas_get_image_smoothing
+//Requires: Val_smoothing
+function ml_canvas_get_image_smoothing(canvas) {
+  return Val_smoothing(canvas.ctxt.imageSmoothingEnabled,
+                       canvas.ctxt.imageSmoothingQuality);
+}
+
+//Provides: ml_canvas_set_image_smoothing
+//Requires: SMOOTHING_TAG, Smoothing_quality_val
+function ml_canvas_set_image_smoothing(canvas, smoothing) {
+  canvas.ctxt.imageSmoothingEnabled = (smoothing != SMOOTHING_TAG.OFF);
+  if (smoothing != SMOOTHING_TAG.OFF) {
+    canvas.ctxt.imageSmoothingQuality = Smoothing_quality_val(smoothing);
+  }
+  return 0;
+}
+
 //Provides: ml_canvas_get_shadow_color
 //Requires: _int_of_color
 function ml_canvas_get_shadow_color(canvas) {
@@ -1278,6 +1354,26 @@ function ml_canvas_set_shadow_offset(canvas, offset) {
   return 0;
 }
 
+//Provides: ml_canvas_get_filter
+function ml_canvas_get_filter(canvas) {
+  // The context only knows the CSS filter string, so the
+  // lists it was built from are remembered by string
+  var filters = canvas.filters && canvas.filters.get(canvas.ctxt.filter);
+  return (filters === undefined) ? 0 : filters;
+}
+
+//Provides: ml_canvas_set_filter
+//Requires: Filter_list_val
+function ml_canvas_set_filter(canvas, filters) {
+  var f = Filter_list_val(filters);
+  if (canvas.filters === undefined) {
+    canvas.filters = new Map();
+  }
+  canvas.filters.set(f, filters);
+  canvas.ctxt.filter = f;
+  return 0;
+}
+
 //Provides: ml_canvas_set_font
 //Requires: Slant_val, caml_jsstring_of_string
 function ml_canvas_set_font(canvas, family, size, slant, weight) {
@@ -1424,6 +1520,72 @@ function ml_canvas_stroke_rect(canvas, pos, size) {
 }
 
 
+//Provides: _ml_canvas_fill_batch
+//Requires: caml_ba_to_typed_array, caml_invalid_argument, _color_of_int
+//Requires: Optional_val
+function _ml_canvas_fill_batch(canvas, colors, coords, size, fun, fill) {
+  var ta = caml_ba_to_typed_array(coords);
+  var ca = Optional_val(colors, null);
+  if (ca !== null) {
+    ca = caml_ba_to_typed_array(ca);
+  }
+  if ((ta.length % size != 0) ||
+      ((ca !== null) && (ca.length < ta.length / size))) {
+    caml_invalid_argument(fun + ": invalid number of elements");
+  }
+  var ctxt = canvas.ctxt;
+  var style = ctxt.fillStyle;
+  for (var i = 0; i < ta.length / size; ++i) {
+    if (ca !== null) {
+      ctxt.fillStyle = _color_of_int(ca[i]);
+    }
+    fill(ctxt, ta, i * size);
+  }
+  ctxt.fillStyle = style;
+  return 0;
+}
+
+//Provides: ml_canvas_fill_rects
+//Requires: _ml_canvas_fill_batch
+function ml_canvas_fill_rects(canvas, colors, rects) {
+  return _ml_canvas_fill_batch(canvas, colors, rects, 4, "Canvas.fillRects",
+    function (ctxt, ta, k) {
+      ctxt.fillRect(ta[k], ta[k+1], ta[k+2], ta[k+3]);
+    });
+}
+
+//Provides: ml_canvas_fill_circles
+//Requires: _ml_canvas_fill_batch
+function ml_canvas_fill_circles(canvas, colors, circles) {
+  return _ml_canvas_fill_batch(canvas, colors, circles, 3,
+                               "Canvas.fillCircles",
+    function (ctxt, ta, k) {
+      var path = new window.Path2D();
+      path.arc(ta[k], ta[k+1], ta[k+2], 0.0, 2.0 * Math.PI, false);
+      ctxt.fill(path);
+    });
+}
+
+//Provides: ml_canvas_stroke_polyline
+//Requires: caml_ba_to_typed_array, caml_invalid_argument
+function ml_canvas_stroke_polyline(canvas, coords) {
+  var ta = caml_ba_to_typed_array(coords);
+  if (ta.length % 2 != 0) {
+    caml_invalid_argument("Canvas.strokePolyline: " +
+                          "invalid number of coordinates");
+  }
+  if (ta.length < 4) {
+    return 0;
+  }
+  var path = new window.Path2D();
+  path.moveTo(ta[0], ta[1]);
+  for (var i = 2; i < ta.length; i += 2) {
+    path.lineTo(ta[i], ta[i + 1]);
+  }
+  canvas.ctxt.stroke(path);
+  return 0;
+}
+
 //Provides: ml_canvas_fill_text
 //Requires: caml_jsstring_of_string
 function ml_canvas_fill_text(canvas, text, pos) {
@@ -1453,6 +1615,208 @@ function ml_canvas_blit(dst_canvas, dpos, src_canvas, spos, size) {
   return 0;
 }
 
+//Provides: ml_canvas_draw_image
+//Requires: _ml_canvas_valid_canvas_size
+//Requires: caml_invalid_argument
+function ml_canvas_draw_image(dst_canvas, dpos, dsize,
+                              src_canvas, spos, ssize) {
+  var width = ssize[1];
+  var height = ssize[2];
+  if (!_ml_canvas_valid_canvas_size(width, height)) {
+    caml_invalid_argument("Canvas.drawImage: invalid dimensions");
+  }
+  dst_canvas.ctxt.drawImage(src_canvas.surface,
+                            spos[1], spos[2], width, height,
+                            dpos[1], dpos[2], dsize[1], dsize[2]);
+  return 0;
+}
+
+//Provides: _ml_canvas_draw_sprites
+//Requires: caml_ba_to_typed_array, caml_invalid_argument
+function _ml_canvas_draw_sprites(canvas, surface, sprites, fun) {
+  var ta = caml_ba_to_typed_array(sprites);
+  if (ta.length % 9 != 0) {
+    caml_invalid_argument(fun + ": invalid number of elements");
+  }
+  var ctxt = canvas.ctxt;
+  var alpha = ctxt.globalAlpha;
+  for (var i = 0; i < ta.length; i += 9) {
+    var sw = ta[i+2], sh = ta[i+3];
+    var dw = sw * ta[i+6], dh = sh * ta[i+6];
+    ctxt.globalAlpha = alpha * ta[i+8];
+    if (ta[i+7] == 0.0) {
+      ctxt.drawImage(surface, ta[i+0], ta[i+1], sw, sh,
+                     ta[i+4], ta[i+5], dw, dh);
+    } else {
+      ctxt.save();
+      ctxt.translate(ta[i+4] + dw / 2.0, ta[i+5] + dh / 2.0);
+      ctxt.rotate(ta[i+7]);
+      ctxt.drawImage(surface, ta[i+0], ta[i+1], sw, sh,
+                     -dw / 2.0, -dh / 2.0, dw, dh);
+      ctxt.restore();
+    }
+  }
+  ctxt.globalAlpha = alpha;
+  return 0;
+}
+
+//Provides: ml_canvas_draw_sprites
+//Requires: _ml_canvas_draw_sprites
+function ml_canvas_draw_sprites(dst_canvas, src_canvas, sprites) {
+  return _ml_canvas_draw_sprites(dst_canvas, src_canvas.surface, sprites,
+                                 "Canvas.drawSprites");
+}
+
+//Provides: ml_canvas_draw_sprites_from_image_data
+//Requires: _ml_canvas_draw_sprites
+//Requires: ml_canvas_create_offscreen_from_image_data
+function ml_canvas_draw_sprites_from_image_data(canvas, data, sprites) {
+  var atlas = ml_canvas_create_offscreen_from_image_data(data);
+  if (atlas === null) {
+    return 0;
+  }
+  return _ml_canvas_draw_sprites(canvas, atlas.surface, sprites,
+                                 "Canvas.drawSpritesFromImageData");
+}
+
+
+/* Layers */
+
+// A layer draws into a transparent surface the size of the canvas,
+// drawn back as an image by the context the layer began on, whose
+// state, clip and filter are left untouched meanwhile
+
+//Provides: ml_canvas_begin_layer
+//Requires: _ml_canvas_copy_context_state, Compop_val, caml_failwith
+function ml_canvas_begin_layer(alpha, op, canvas) {
+  if (canvas.recording !== undefined) {
+    caml_failwith("Canvas.beginLayer: the canvas is recording");
+  }
+  var ctxt = canvas.ctxt;
+  var surface = document.createElement("canvas");
+  surface.width = canvas.width;
+  surface.height = canvas.height;
+  var layer_ctxt = surface.getContext("2d");
+  _ml_canvas_copy_context_state(layer_ctxt, ctxt);
+  layer_ctxt.globalAlpha = 1.0;
+  layer_ctxt.globalCompositeOperation = "source-over";
+  layer_ctxt.filter = "none";
+  if (canvas.layers === undefined) {
+    canvas.layers = [];
+  }
+  canvas.layers.push({
+    ctxt: ctxt,
+    alpha: (alpha === 0) ? ctxt.globalAlpha : alpha[1],
+    op: (op === 0) ? ctxt.globalCompositeOperation : Compop_val(op[1])
+  });
+  canvas.ctxt = layer_ctxt;
+  return 0;
+}
+
+//Provides: ml_canvas_end_layer
+function ml_canvas_end_layer(canvas) {
+  if ((canvas.layers === undefined) || (canvas.layers.length === 0)) {
+    return 0;
+  }
+  var layer = canvas.layers.pop();
+  var ctxt = layer.ctxt;
+  ctxt.save();
+  ctxt.setTransform(1, 0, 0, 1, 0, 0);
+  ctxt.globalAlpha = layer.alpha;
+  ctxt.globalCompositeOperation = layer.op;
+  ctxt.shadowColor = "transparent";
+  ctxt.drawImage(canvas.ctxt.canvas, 0, 0);
+  ctxt.restore();
+  canvas.ctxt = ctxt;
+  return 0;
+}
+
+/* Pictures */
+
+// Browsers have no display lists, so a picture records into a
+// transparent surface the size of the canvas, which is drawn as
+// an image on replay
+
+//Provides: _ml_canvas_copy_context_state
+function _ml_canvas_copy_context_state(dst, src) {
+  dst.setTransform(src.getTransform());
+  dst.fillStyle = src.fillStyle;
+  dst.strokeStyle = src.strokeStyle;
+  dst.lineWidth = src.lineWidth;
+  dst.lineCap = src.lineCap;
+  dst.lineJoin = src.lineJoin;
+  dst.miterLimit = src.miterLimit;
+  dst.setLineDash(src.getLineDash());
+  dst.lineDashOffset = src.lineDashOffset;
+  dst.globalAlpha = src.globalAlpha;
+  dst.globalCompositeOperation = src.globalCompositeOperation;
+  dst.shadowColor = src.shadowColor;
+  dst.shadowBlur = src.shadowBlur;
+  dst.shadowOffsetX = src.shadowOffsetX;
+  dst.shadowOffsetY = src.shadowOffsetY;
+  dst.font = src.font;
+  dst.imageSmoothingEnabled = src.imageSmoothingEnabled;
+  dst.imageSmoothingQuality = src.imageSmoothingQuality;
+}
+
+//Provides: ml_canvas_begin_recording
+//Requires: _ml_canvas_copy_context_state
+function ml_canvas_begin_recording(canvas) {
+  if (canvas.recording !== undefined) {
+    canvas.ctxt = canvas.recording;
+  }
+  var surface = document.createElement("canvas");
+  surface.width = canvas.width;
+  surface.height = canvas.height;
+  var ctxt = surface.getContext("2d");
+  _ml_canvas_copy_context_state(ctxt, canvas.ctxt);
+  canvas.recording = canvas.ctxt;
+  canvas.ctxt = ctxt;
+  return 0;
+}
+
+//Provides: ml_canvas_end_recording
+//Requires: _ml_canvas_copy_context_state
+function ml_canvas_end_recording(canvas) {
+  if (canvas.recording === undefined) {
+    var empty = document.createElement("canvas");
+    empty.width = 1;
+    empty.height = 1;
+    return { surface: empty };
+  }
+  var picture = { surface: canvas.ctxt.canvas };
+  _ml_canvas_copy_context_state(canvas.recording, canvas.ctxt);
+  canvas.ctxt = canvas.recording;
+  canvas.recording = undefined;
+  return picture;
+}
+
+//Provides: ml_canvas_draw_picture
+function ml_canvas_draw_picture(canvas, picture, t) {
+  canvas.ctxt.save();
+  canvas.ctxt.transform(t[1], t[2], t[3], t[4], t[5], t[6]);
+  canvas.ctxt.globalCompositeOperation = "source-over";
+  canvas.ctxt.shadowColor = "transparent";
+  canvas.ctxt.drawImage(picture.surface, 0, 0);
+  canvas.ctxt.restore();
+  return 0;
+}
+
+
+/* Deferred rendering */
+
+// The browser already defers and batches rendering
+//Provides: ml_canvas_set_deferred
+function ml_canvas_set_deferred(canvas, deferred) {
+  canvas.deferred = deferred;
+  return 0;
+}
+
+//Provides: ml_canvas_get_deferred
+function ml_canvas_get_deferred(canvas) {
+  return (canvas.deferred === undefined) ? 0 : canvas.deferred;
+}
+
 
 /* Direct pixel access */
 
@@ -1530,6 +1894,34 @@ function ml_canvas_put_image_data(canvas, dpos, data, spos, size) {
   return 0;
 }
 
+//Provides: ml_canvas_lock_pixels
+//Requires: ml_canvas_get_image_data, ml_canvas_unlock_pixels
+function ml_canvas_lock_pixels(canvas) {
+  // Browser canvases do not expose their pixels, so the
+  // locked pixels are a copy, written back when unlocking
+  ml_canvas_unlock_pixels(canvas);
+  canvas.lockedPixels =
+    ml_canvas_get_image_data(canvas, [0, 0, 0],
+                             [0, canvas.width, canvas.height]);
+  return canvas.lockedPixels;
+}
+
+//Provides: ml_canvas_unlock_pixels
+//Requires: ml_canvas_put_image_data, caml_ba_dim
+function ml_canvas_unlock_pixels(canvas) {
+  var data = canvas.lockedPixels;
+  if (data === undefined || data === null) {
+    return 0;
+  }
+  canvas.lockedPixels = null;
+  ml_canvas_put_image_data(canvas, [0, 0, 0], data, [0, 0, 0],
+                           [0, caml_ba_dim(data, 1), caml_ba_dim(data, 0)]);
+  data.dims[0] = 0;
+  data.dims[1] = 0;
+  data.data = new window.Uint8Array(0);
+  return 0;
+}
+
 //Provides: ml_canvas_import_png
 //Requires: _ml_canvas_image_of_png_file
 //Requires: caml_raise_with_string, caml_named_value
@@ -1680,3 +2072,33 @@ function ml_canvas_get_current_timestamp() {
   var e = new window.Event("dummy");
   return caml_int64_of_float(e.timeStamp * 1000.0);
 }
+
+//Provides: _ml_canvas_buffer_pool_budget
+var _ml_canvas_buffer_pool_budget = 32 * 1024 * 1024;
+
+//Provides: ml_canvas_get_buffer_pool_budget
+//Requires: _ml_canvas_buffer_pool_budget
+function ml_canvas_get_buffer_pool_budget() {
+  return _ml_canvas_buffer_pool_budget;
+}
+
+//Provides: ml_canvas_set_buffer_pool_budget
+//Requires: _ml_canvas_buffer_pool_budget
+function ml_canvas_set_buffer_pool_budget(budget) {
+  // Pixel buffers are managed by the browser,
+  // the value is only recorded
+  if (budget >= 0) {
+    _ml_canvas_buffer_pool_budget = budget;
+  }
+  return 0;
+}
+
+//Provides: ml_canvas_trim_buffer_pool
+function ml_canvas_trim_buffer_pool() {
+  return 0;
+}
+
+//Provides: ml_canvas_get_buffer_pool_stats
+function ml_canvas_get_buffer_pool_stats() {
+  return [0, 0, 0, 0, 0, 0];
+}
@@ -28,9 +28,12 @@
 #include "../implem/font_desc.h"
 #include "../implem/transform.h"
 #include "../implem/path2d.h"
+#include "../implem/picture.h"
 #include "../implem/polygonize.h"
 #include "../implem/color_composition.h"
+#include "../implem/image_interpolation.h"
 #include "../implem/pixmap.h"
+#include "../implem/filters.h"
 #include "../implem/event.h"
 #include "../implem/window.h"
 #include "../implem/canvas.h"
@@ -1079,6 +1082,94 @@ Pattern_val(
   CAMLreturnT(pattern_t *, pattern);
 }
 
+static void
+_ml_canvas_picture_finalize(
+  value mlPicture)
+{
+  picture_t *picture = *((picture_t **)Data_custom_val(mlPicture));
+  if (picture != NULL) {
+    picture_release(picture);
+  }
+}
+
+int
+_ml_canvas_picture_compare(
+  value mlPicture1,
+  value mlPicture2)
+{
+  picture_t *p1 = *((picture_t **)Data_custom_val(mlPicture1));
+  if (p1 == NULL) {
+    caml_failwith("invalid picture object");
+  }
+  picture_t *p2 = *((picture_t **)Data_custom_val(mlPicture2));
+  if (p2 == NULL) {
+    caml_failwith("invalid picture object");
+  }
+  if (p1 < p2) {
+    return -1;
+  }
+  else if (p1 > p2) {
+    return 1;
+  }
+  else {
+    return 0;
+  }
+}
+
+static struct custom_operations _ml_picture_ops = {
+  "com.ocamlpro.ocaml-canvas.picture",
+  _ml_canvas_picture_finalize,
+  _ml_canvas_picture_compare,
+  custom_hash_default,
+  custom_serialize_default,
+  custom_deserialize_default,
+  custom_compare_ext_default,
+#if OCAML_VERSION >= 40800
+  custom_fixed_length_default
+#endif
+};
+
+value
+Val_picture(
+  picture_t *picture)
+{
+  CAMLparam0();
+  CAMLlocal2(mlPicture, mlWeakPointer);
+
+  value *mlWeakPointer_ptr = (value *)picture_get_data(picture);
+
+  if (mlWeakPointer_ptr != NULL) {
+    mlWeakPointer = *mlWeakPointer_ptr;
+  } else {
+    mlWeakPointer = caml_weak_array_create(1);
+    mlWeakPointer_ptr = (value *)calloc(1, sizeof(value));
+    *mlWeakPointer_ptr = mlWeakPointer;
+    caml_register_generational_global_root(mlWeakPointer_ptr);
+    picture_set_data(picture, (void *)mlWeakPointer_ptr);
+  }
+
+  if (caml_weak_array_get(mlWeakPointer, 0, &mlPicture) == 0) {
+    mlPicture =
+      caml_alloc_custom(&_ml_picture_ops, sizeof(picture_t *), 0, 1);
+    *((picture_t **)Data_custom_val(mlPicture)) = picture_retain(picture);
+    caml_weak_array_set(mlWeakPointer, 0, mlPicture);
+  }
+
+  CAMLreturn(mlPicture);
+}
+
+picture_t *
+Picture_val(
+  value mlPicture)
+{
+  CAMLparam1(mlPicture);
+  picture_t *picture = *((picture_t **)Data_custom_val(mlPicture));
+  if (picture == NULL) {
+    caml_failwith("invalid picture object");
+  }
+  CAMLreturnT(picture_t *, picture);
+}
+
 value
 Val_repeat(
   pattern_repeat_t repeat)
@@ -1161,6 +1252,107 @@ Style_val(
   CAMLreturnT(draw_style_t, style);
 }
 
+value
+Val_filter(
+  const filter_t *filter)
+{
+  CAMLparam0();
+  CAMLlocal2(mlFilter, mlOffset);
+  static const filter_tag_t map[5] = {
+    [FILTER_BLUR]        = TAG_FILTER_BLUR,
+    [FILTER_BRIGHTNESS]  = TAG_FILTER_BRIGHTNESS,
+    [FILTER_CONTRAST]    = TAG_FILTER_CONTRAST,
+    [FILTER_GRAYSCALE]   = TAG_FILTER_GRAYSCALE,
+    [FILTER_DROP_SHADOW] = TAG_FILTER_DROP_SHADOW
+  };
+  if (filter->type == FILTER_DROP_SHADOW) {
+    mlOffset = caml_alloc_tuple(2);
+    Store_field(mlOffset, 0, caml_copy_double(filter->offset_x));
+    Store_field(mlOffset, 1, caml_copy_double(filter->offset_y));
+    mlFilter = caml_alloc(3, map[filter->type]);
+    Store_field(mlFilter, 0, mlOffset);
+    Store_field(mlFilter, 1, caml_copy_double(filter->amount));
+    Store_field(mlFilter, 2, caml_copy_int32(color_to_int(filter->color)));
+  } else {
+    mlFilter = caml_alloc(1, map[filter->type]);
+    Store_field(mlFilter, 0, caml_copy_double(filter->amount));
+  }
+  CAMLreturn(mlFilter);
+}
+
+filter_t
+Filter_val(
+  value mlFilter)
+{
+  CAMLparam1(mlFilter);
+  static const filter_type_t map[5] = {
+    [TAG_FILTER_BLUR]        = FILTER_BLUR,
+    [TAG_FILTER_BRIGHTNESS]  = FILTER_BRIGHTNESS,
+    [TAG_FILTER_CONTRAST]    = FILTER_CONTRAST,
+    [TAG_FILTER_GRAYSCALE]   = FILTER_GRAYSCALE,
+    [TAG_FILTER_DROP_SHADOW] = FILTER_DROP_SHADOW
+  };
+  filter_t filter = { 0 };
+  filter.type = map[Tag_val(mlFilter)];
+  if (filter.type == FILTER_DROP_SHADOW) {
+    filter.offset_x = Double_val(Field(Field(mlFilter, 0), 0));
+    filter.offset_y = Double_val(Field(Field(mlFilter, 0), 1));
+    filter.amount = Double_val(Field(mlFilter, 1));
+    filter.color = color_of_int(Int32_val(Field(mlFilter, 2)));
+  } else {
+    filter.amount = Double_val(Field(mlFilter, 0));
+  }
+  CAMLreturnT(filter_t, filter);
+}
+
+value
+Val_filter_list(
+  const filter_t *filters,
+  int32_t nb_filters)
+{
+  CAMLparam0();
+  CAMLlocal3(mlList, mlCell, mlFilter);
+  mlList = Val_emptylist;
+  for (int32_t i = nb_filters - 1; i >= 0; --i) {
+    mlFilter = Val_filter(&filters[i]);
+    mlCell = caml_alloc(2, 0);
+    Store_field(mlCell, 0, mlFilter);
+    Store_field(mlCell, 1, mlList);
+    mlList = mlCell;
+  }
+  CAMLreturn(mlList);
+}
+
+// Returns a newly allocated array, or NULL if
+// the list is empty or the allocation failed
+filter_t *
+Filter_list_val(
+  value mlList,
+  int32_t *nb_filters) // out
+{
+  CAMLparam1(mlList);
+  CAMLlocal1(mlCell);
+  assert(nb_filters != NULL);
+  *nb_filters = 0;
+  int32_t n = 0;
+  for (mlCell = mlList; mlCell != Val_emptylist; mlCell = Field(mlCell, 1)) {
+    ++n;
+  }
+  if (n == 0) {
+    CAMLreturnT(filter_t *, NULL);
+  }
+  filter_t *filters = (filter_t *)calloc(n, sizeof(filter_t));
+  if (filters == NULL) {
+    CAMLreturnT(filter_t *, NULL);
+  }
+  n = 0;
+  for (mlCell = mlList; mlCell != Val_emptylist; mlCell = Field(mlCell, 1)) {
+    filters[n++] = Filter_val(Field(mlCell, 0));
+  }
+  *nb_filters = n;
+  CAMLreturnT(filter_t *, filters);
+}
+
 transform_t
 Transform_val(
   value mlTransform)
@@ -1242,6 +1434,34 @@ Cap_type_val(
   CAMLreturnT(cap_type_t, map[Int_val(mlLineCap)]);
 }
 
+value
+Val_smoothing(
+  image_smoothing_t smoothing)
+{
+  CAMLparam0();
+  static intnat map[4] = {
+    [IMAGE_SMOOTHING_OFF]    = TAG_SMOOTHING_OFF,
+    [IMAGE_SMOOTHING_LOW]    = TAG_SMOOTHING_LOW,
+    [IMAGE_SMOOTHING_MEDIUM] = TAG_SMOOTHING_MEDIUM,
+    [IMAGE_SMOOTHING_HIGH]   = TAG_SMOOTHING_HIGH
+  };
+  CAMLreturn(Val_long(map[smoothing]));
+}
+
+image_smoothing_t
+Smoothing_val(
+  value mlSmoothing)
+{
+  CAMLparam1(mlSmoothing);
+  static const image_smoothing_t map[4] = {
+    [TAG_SMOOTHING_OFF]    = IMAGE_SMOOTHING_OFF,
+    [TAG_SMOOTHING_LOW]    = IMAGE_SMOOTHING_LOW,
+    [TAG_SMOOTHING_MEDIUM] = IMAGE_SMOOTHING_MEDIUM,
+    [TAG_SMOOTHING_HIGH]   = IMAGE_SMOOTHING_HIGH
+  };
+  CAMLreturnT(image_smoothing_t, map[Int_val(mlSmoothing)]);
+}
+
 value
 Val_compop(
   composite_operation_t compop)
@@ -23,9 +23,12 @@
 #include "../implem/font_desc.h"
 #include "../implem/transform.h"
 #include "../implem/path2d.h"
+#include "../implem/picture.h"
 #include "../implem/polygonize.h"
 #include "../implem/color_composition.h"
+#include "../implem/image_interpolation.h"
 #include "../implem/pixmap.h"
+#include "../implem/filters.h"
 #include "../implem/event.h"
 #include "../implem/canvas.h"
 
@@ -133,6 +136,14 @@ pattern_t *
 Pattern_val(
   value mlPattern);
 
+value
+Val_picture(
+  picture_t *picture);
+
+picture_t *
+Picture_val(
+  value mlPicture);
+
 value
 Val_repeat(
   pattern_repeat_t repeat);
@@ -149,6 +160,24 @@ draw_style_t
 Style_val(
   value mlStyle);
 
+value
+Val_filter(
+  const filter_t *filter);
+
+filter_t
+Filter_val(
+  value mlFilter);
+
+value
+Val_filter_list(
+  const filter_t *filters,
+  int32_t nb_filters);
+
+filter_t *
+Filter_list_val(
+  value mlList,
+  int32_t *nb_filters);
+
 transform_t
 Transform_val(
   value mlTransform);
@@ -173,6 +202,14 @@ cap_type_t
 Cap_type_val(
   value mlLineCap);
 
+value
+Val_smoothing(
+  image_smoothing_t smoothing);
+
+image_smoothing_t
+Smoothing_val(
+  value mlSmoothing);
+
 value
 Val_compop(
   composite_operation_t compop);
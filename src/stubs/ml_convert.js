@@ -431,6 +431,36 @@ function Draw_style_val(style) {
   return s;
 }
 
+//Provides: Filter_list_val
+//Requires: _color_of_int,FILTER_TAG
+function Filter_list_val(filters) {
+  var f = [];
+  for (; filters !== 0; filters = filters[2]) {
+    var filter = filters[1];
+    switch (filter[0]) {
+      case FILTER_TAG.BLUR:
+        f.push("blur(" + filter[1] + "px)");
+        break;
+      case FILTER_TAG.BRIGHTNESS:
+        f.push("brightness(" + filter[1] + ")");
+        break;
+      case FILTER_TAG.CONTRAST:
+        f.push("contrast(" + filter[1] + ")");
+        break;
+      case FILTER_TAG.GRAYSCALE:
+        f.push("grayscale(" + filter[1] + ")");
+        break;
+      case FILTER_TAG.DROP_SHADOW:
+        f.push("drop-shadow(" + filter[1][1] + "px " + filter[1][2] + "px " +
+               filter[2] + "px " + _color_of_int(filter[3]) + ")");
+        break;
+      default:
+        break;
+    }
+  }
+  return (f.length === 0) ? "none" : f.join(" ");
+}
+
 //Provides: Slant_val
 //Requires: SLANT,SLANT_TAG
 
@@ -496,6 +526,32 @@ function Cap_type_val(cap) {
   return tag_to_cap_type.get(cap);
 }
 
+//Provides: Val_smoothing
+//Requires: SMOOTHING_TAG
+function Val_smoothing(enabled, quality) {
+  if (!enabled) {
+    return SMOOTHING_TAG.OFF;
+  }
+  switch (quality) {
+    case "high": return SMOOTHING_TAG.HIGH;
+    case "medium": return SMOOTHING_TAG.MEDIUM;
+    default: return SMOOTHING_TAG.LOW;
+  }
+}
+
+//Provides: Smoothing_quality_val
+//Requires: SMOOTHING_TAG
+
+var tag_to_smoothing_quality = new joo_global_object.Map([
+  [SMOOTHING_TAG.LOW,    "low"],
+  [SMOOTHING_TAG.MEDIUM, "medium"],
+  [SMOOTHING_TAG.HIGH,   "high"],
+]);
+
+function Smoothing_quality_val(smoothing) {
+  return tag_to_smoothing_quality.get(smoothing);
+}
+
 //Provides: Val_compop
 //Requires: COMPOP_TAG
 
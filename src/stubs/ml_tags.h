@@ -206,6 +206,14 @@ typedef enum style_tag_t {
   TAG_PATTERN  = 2
 } style_tag_t;
 
+typedef enum filter_tag_t {
+  TAG_FILTER_BLUR        = 0,
+  TAG_FILTER_BRIGHTNESS  = 1,
+  TAG_FILTER_CONTRAST    = 2,
+  TAG_FILTER_GRAYSCALE   = 3,
+  TAG_FILTER_DROP_SHADOW = 4
+} filter_tag_t;
+
 typedef enum repeat_tag_t {
   TAG_NO_REPEAT = 0,
   TAG_REPEAT_X  = 1,
@@ -231,6 +239,13 @@ typedef enum cap_type_tag_t {
   TAG_CAP_ROUND  = 2
 } cap_type_tag_t;
 
+typedef enum smoothing_tag_t {
+  TAG_SMOOTHING_OFF    = 0,
+  TAG_SMOOTHING_LOW    = 1,
+  TAG_SMOOTHING_MEDIUM = 2,
+  TAG_SMOOTHING_HIGH   = 3
+} smoothing_tag_t;
+
 typedef enum comp_op_tag_t {
   TAG_OP_SOURCE_OVER      = 0,
   TAG_OP_SOURCE_IN        = 1,
@@ -198,6 +198,15 @@ var STYLE_TAG = {
   PATTERN  : 2
 };
 
+//Provides: FILTER_TAG
+var FILTER_TAG = {
+  BLUR        : 0,
+  BRIGHTNESS  : 1,
+  CONTRAST    : 2,
+  GRAYSCALE   : 3,
+  DROP_SHADOW : 4
+};
+
 //Provides: REPEAT_TAG
 var REPEAT_TAG = {
   NO_REPEAT : 0,
@@ -227,6 +236,14 @@ var CAP_TYPE_TAG = {
   ROUND  : 2
 };
 
+//Provides: SMOOTHING_TAG
+var SMOOTHING_TAG = {
+  OFF    : 0,
+  LOW    : 1,
+  MEDIUM : 2,
+  HIGH   : 3
+};
+
 //Provides : COMPOP_TAG
 var COMPOP_TAG = {
   SOURCE_OVER      : 0,
@@ -0,0 +1,37 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+(* Blitting with a translation must apply the global alpha,
+   as drawing the same image at the same place does *)
+
+open OcamlCanvas.V1
+open Test_util
+
+let () =
+  init ();
+
+  let src = Canvas.createOffscreen ~size:(16, 16) () in
+  Canvas.setFillColor src Color.red;
+  Canvas.fillRect src ~pos:(0.0, 0.0) ~size:(16.0, 16.0);
+
+  List.iter (fun alpha ->
+      let name = Printf.sprintf "alpha %g" alpha in
+      check_same name
+        (render (fun c ->
+             Canvas.setGlobalAlpha c alpha;
+             Canvas.translate c (3.0, 2.0);
+             Canvas.blit ~dst:c ~dpos:(4, 4) ~src ~spos:(0, 0) ~size:(16, 16)))
+        (render (fun c ->
+             Canvas.setGlobalAlpha c alpha;
+             Canvas.drawImage ~dst:c ~dpos:(7.0, 6.0) ~dsize:(16.0, 16.0)
+               ~src ~spos:(0, 0) ~ssize:(16, 16))))
+    [ 1.0; 0.5; 0.3; 0.0 ];
+
+  print_endline "blit: OK"
@@ -0,0 +1,54 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+(* Filling a path that lies entirely off the canvas with a composite
+   operation that also affects the destination outside of the source
+   must clear the whole canvas, without touching memory past it *)
+
+open OcamlCanvas.V1
+open Test_util
+
+let red = (255, 255, 0, 0)
+let clear = (0, 0, 0, 0)
+
+let corners = [ (0, 0); (36, 0); (0, 22); (36, 22); (18, 11) ]
+
+let test op expected draw =
+  (* Odd size, so that rows do not end on an aligned boundary *)
+  let c = Canvas.createOffscreen ~size:(37, 23) () in
+  Canvas.setFillColor c Color.red;
+  Canvas.fillRect c ~pos:(0.0, 0.0) ~size:(37.0, 23.0);
+  Canvas.setGlobalCompositeOperation c op;
+  draw c;
+  List.iter (fun pos -> check_argb "compose_outside" c pos expected) corners
+
+let fill_triangle (x, y) c =
+  Canvas.clearPath c;
+  Canvas.moveTo c (x, y);
+  Canvas.lineTo c (x +. 20.0, y);
+  Canvas.lineTo c (x +. 20.0, y +. 30.0);
+  Canvas.closePath c;
+  Canvas.fill c ~nonzero:true
+
+let () =
+  init ();
+  let draws = [
+    fill_triangle (100.0, 100.0);      (* below right *)
+    fill_triangle (-50.0, 5.0);        (* left *)
+    fill_triangle (5.0, -80.0);        (* above *)
+    (fun c -> Canvas.fillRect c ~pos:(40.0, -10.0) ~size:(10.0, 50.0));
+  ] in
+  List.iter (fun draw ->
+      test CompositeOp.SourceOver red draw;
+      test CompositeOp.Copy clear draw;
+      test CompositeOp.SourceIn clear draw;
+      test CompositeOp.DestinationIn clear draw;
+      test CompositeOp.DestinationAtop clear draw) draws;
+  print_endline "compose_outside: OK"
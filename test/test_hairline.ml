@@ -0,0 +1,39 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+(* Thin strokes must compose shared vertices only once, and
+   keep the spikes of their miter joins *)
+
+open OcamlCanvas.V1
+open Test_util
+
+let polyline coords =
+  Bigarray.Array1.of_array Bigarray.float64 Bigarray.c_layout coords
+
+let stroke join coords =
+  render (fun c ->
+      Canvas.setLineWidth c 1.0;
+      Canvas.setLineJoin c join;
+      Canvas.strokePolyline c (polyline coords))
+
+let () =
+  init ();
+
+  let id = stroke Join.Round [| 2.5; 5.5; 5.5; 5.5; 10.5; 5.5 |] in
+  check "collinear vertex"
+    (ImageData.getPixel id (5, 5) = ImageData.getPixel id (4, 5));
+
+  let v = [| 20.5; 40.5; 30.5; 10.5; 40.5; 40.5 |] in
+  let id = stroke Join.Round v in
+  check "round vertex" (ImageData.getPixel id (30, 10) = Color.black);
+  let id = stroke Join.Miter v in
+  check "miter spike" (ImageData.getPixel id (30, 9) <> Color.white);
+
+  print_endline "hairline: OK"
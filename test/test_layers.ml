@@ -0,0 +1,93 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+(* Layers only compose back the area that was drawn to, but must give
+   the same result as composing a whole separate canvas, including
+   with operations that also affect the destination outside of it *)
+
+open OcamlCanvas.V1
+open Test_util
+
+let background c =
+  for i = 0 to 7 do
+    Canvas.setFillColor c (Color.of_rgb (i * 30) (255 - i * 30) 128);
+    Canvas.fillRect c ~pos:(float_of_int (i * 8), 0.0) ~size:(8.0, 64.0)
+  done
+
+let contents (x, y) c =
+  Canvas.setFillColor c (Color.of_rgb 255 0 0);
+  Canvas.fillRect c ~pos:(x -. 10.0, y -. 10.0) ~size:(12.0, 9.0);
+  Canvas.setFillColor c (Color.of_argb 200 0 0 255);
+  Canvas.clearPath c;
+  Canvas.arc c ~center:(x, y) ~radius:6.0
+    ~theta1:0.0 ~theta2:(2.0 *. Const.pi) ~ccw:false;
+  Canvas.fill c ~nonzero:true
+
+let with_layer pos alpha op c =
+  background c;
+  Canvas.beginLayer ~alpha ~op c;
+  contents pos c;
+  Canvas.endLayer c
+
+let with_canvas pos alpha op c =
+  background c;
+  let l = Canvas.createOffscreen ~size:(64, 64) () in
+  contents pos l;
+  Canvas.setGlobalAlpha c alpha;
+  Canvas.setGlobalCompositeOperation c op;
+  Canvas.drawImage ~dst:c ~dpos:(0.0, 0.0) ~dsize:(64.0, 64.0)
+    ~src:l ~spos:(0, 0) ~ssize:(64, 64)
+
+let () =
+  init ();
+  List.iter (fun pos ->
+      List.iter (fun alpha ->
+          List.iter (fun op ->
+              check_same "layer"
+                (render (with_layer pos alpha op))
+                (render (with_canvas pos alpha op)))
+            CompositeOp.[ SourceOver; DestinationIn; Copy;
+                          Multiply; DestinationOut ])
+        [ 1.0; 0.5; 0.3; 0.77; 0.999 ])
+    [ (40.0, 30.0); (4.0, 60.0); (70.0, 70.0) ];
+
+  (* Unbalanced saves and restores within layers *)
+  let fill c = Color.to_argb (Canvas.getFillColor c) in
+  let c = Canvas.createOffscreen ~size:(16, 16) () in
+  Canvas.setFillColor c (Color.of_rgb 1 1 1);
+  Canvas.save c;
+  Canvas.setFillColor c (Color.of_rgb 2 2 2);
+  Canvas.beginLayer c;
+  Canvas.save c;
+  Canvas.setFillColor c (Color.of_rgb 3 3 3);
+  Canvas.save c;
+  Canvas.setFillColor c (Color.of_rgb 4 4 4);
+  Canvas.endLayer c;
+  check "unbalanced save" (fill c = (255, 2, 2, 2));
+  Canvas.beginLayer c;
+  Canvas.setFillColor c (Color.of_rgb 5 5 5);
+  Canvas.restore c;
+  Canvas.restore c;
+  check "unbalanced restore" (fill c = (255, 5, 5, 5));
+  Canvas.endLayer c;
+  check "end layer" (fill c = (255, 2, 2, 2));
+  Canvas.restore c;
+  check "restore" (fill c = (255, 1, 1, 1));
+
+  (* Layers are refused while recording *)
+  Canvas.beginRecording c;
+  check "layer while recording"
+    (try Canvas.beginLayer c; false with Failure _ -> true);
+  ignore (Canvas.endRecording c);
+  Canvas.beginLayer c;
+  Canvas.endLayer c;
+  check "layer after recording" (fill c = (255, 1, 1, 1));
+
+  print_endline "layers: OK"
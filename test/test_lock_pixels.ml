@@ -0,0 +1,78 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+(* Locked pixels share the canvas memory; the image data they are
+   returned as must become empty as soon as that memory may go away *)
+
+open OcamlCanvas.V1
+open Test_util
+
+let red = (255, 255, 0, 0)
+let blue = (255, 0, 0, 255)
+
+let is_empty id =
+  ImageData.getSize id = (0, 0)
+
+let () =
+  init ();
+
+  let c = Canvas.createOffscreen ~size:(40, 30) () in
+  Canvas.setFillColor c Color.red;
+  Canvas.fillRect c ~pos:(0.0, 0.0) ~size:(40.0, 30.0);
+
+  (* Reads and writes go to the canvas *)
+  let id = Canvas.lockPixels c in
+  check "lock size" (ImageData.getSize id = (40, 30));
+  check "lock read" (Color.to_argb (ImageData.getPixel id (5, 5)) = red);
+  ImageData.putPixel id (5, 5) Color.blue;
+  Canvas.unlockPixels c;
+  check "unlock" (is_empty id);
+  check_argb "lock write" c (5, 5) blue;
+  Canvas.unlockPixels c;
+
+  (* Locking again *)
+  let id1 = Canvas.lockPixels c in
+  let id2 = Canvas.lockPixels c in
+  check "relock" (is_empty id1 && not (is_empty id2));
+
+  (* Resizing *)
+  Canvas.setSize c (80, 60);
+  check "resize" (is_empty id2);
+  check_argb "resize contents" c (5, 5) blue;
+  let id = Canvas.lockPixels c in
+  check "resize lock size" (ImageData.getSize id = (80, 60));
+  Canvas.setSize c (20, 10);
+  check "shrink" (is_empty id);
+
+  (* Destroying *)
+  let lock () =
+    let c = Canvas.createOffscreen ~size:(40, 30) () in
+    Canvas.lockPixels c
+  in
+  let id = lock () in
+  Gc.full_major ();
+  Gc.full_major ();
+  check "destroy" (is_empty id);
+
+  (* Views of the image data outlive the lock, and keep the pixels *)
+  let c = Canvas.createOffscreen ~size:(40, 30) () in
+  Canvas.setFillColor c Color.red;
+  Canvas.fillRect c ~pos:(0.0, 0.0) ~size:(40.0, 30.0);
+  let id = Canvas.lockPixels c in
+  let row = Bigarray.Array3.slice_left_2 (ImageData.to_bigarray id) 5 in
+  Canvas.setSize c (400, 300);
+  Canvas.setFillColor c Color.blue;
+  Canvas.fillRect c ~pos:(0.0, 0.0) ~size:(400.0, 300.0);
+  check "view after resize" (is_empty id && row.{5, 2} = 255);
+  Bigarray.Array2.fill row 0;
+  check_argb "view detached" c (5, 5) blue;
+  Gc.full_major ();
+
+  print_endline "lock_pixels: OK"
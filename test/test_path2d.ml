@@ -0,0 +1,111 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+(* Path objects cache their flattened polygon, outline and coverage
+   masks; drawing a reused path must always give the same result as
+   drawing a new path with the same contents *)
+
+open OcamlCanvas.V1
+open Test_util
+
+let triangle () =
+  let p = Path.create () in
+  Path.moveTo p (0.0, 0.0);
+  Path.lineTo p (20.5, 3.0);
+  Path.lineTo p (7.25, 17.75);
+  Path.close p;
+  p
+
+(* Dense enough for decimation to change its shape *)
+let wave () =
+  let p = Path.create () in
+  Path.moveTo p (2.0, 40.0);
+  for i = 0 to 300 do
+    let x = 2.0 +. float_of_int i *. 0.2 in
+    Path.lineTo p (x, 30.0 +. 10.0 *. sin (float_of_int i *. 1.3))
+  done;
+  Path.lineTo p (62.0, 40.0);
+  Path.close p;
+  p
+
+let positions = [ (0.0, 0.0); (10.0, 5.0); (10.25, 5.5); (33.6, 41.1);
+                  (0.0, 0.0); (10.25, 5.5) ]
+
+let fill_at p (x, y) c =
+  Canvas.save c;
+  Canvas.translate c (x, y);
+  Canvas.fillPath c p ~nonzero:true;
+  Canvas.restore c
+
+let () =
+  init ();
+
+  (* Reuse at various positions and subpixel phases *)
+  let p = triangle () in
+  let c = Canvas.createOffscreen ~size:(64, 64) () in
+  List.iter (fun pos ->
+      let reused = render (fun c -> fill_at p pos c) in
+      let fresh = render (fun c -> fill_at (triangle ()) pos c) in
+      check_same "reuse" reused fresh;
+      fill_at p pos c) positions;
+  let stats = Canvas.getMaskCacheStats c in
+  check "cache hits" (stats.Canvas.hits > 0);
+
+  (* Rotated and scaled *)
+  let transformed c =
+    Canvas.rotate c 0.5;
+    Canvas.scale c (1.5, 0.75)
+  in
+  let reused = render (fun c -> transformed c; fill_at p (10.0, 5.0) c) in
+  let fresh =
+    render (fun c -> transformed c; fill_at (triangle ()) (10.0, 5.0) c) in
+  check_same "transform" reused fresh;
+
+  (* Modified after being drawn *)
+  let reused = render (fun c ->
+      fill_at p (10.0, 5.0) c;
+      Path.lineTo p (40.0, 30.0);
+      Canvas.setFillColor c Color.white;
+      Canvas.fillRect c ~pos:(0.0, 0.0) ~size:(64.0, 64.0);
+      Canvas.setFillColor c Color.black;
+      fill_at p (10.0, 5.0) c) in
+  let fresh = render (fun c ->
+      let q = triangle () in
+      Path.lineTo q (40.0, 30.0);
+      fill_at q (10.0, 5.0) c) in
+  check_same "modify" reused fresh;
+
+  (* Stroked with different widths *)
+  let p = triangle () in
+  List.iter (fun width ->
+      let stroke p c =
+        Canvas.setLineWidth c width;
+        Canvas.translate c (20.0, 20.0);
+        Canvas.strokePath c p
+      in
+      check_same "stroke" (render (stroke p)) (render (stroke (triangle ()))))
+    [ 1.0; 4.0; 1.0; 7.5 ];
+
+  (* Drawn with different path tolerances on the same canvas *)
+  let p = wave () in
+  let c = Canvas.createOffscreen ~size:(64, 64) () in
+  List.iter (fun tol ->
+      Canvas.setPathTolerance c tol;
+      Canvas.setFillColor c Color.white;
+      Canvas.fillRect c ~pos:(0.0, 0.0) ~size:(64.0, 64.0);
+      Canvas.setFillColor c Color.black;
+      fill_at p (0.0, 0.0) c;
+      let reused = Canvas.getImageData c ~pos:(0, 0) ~size:(64, 64) in
+      let fresh = render (fun c ->
+          Canvas.setPathTolerance c tol;
+          fill_at (wave ()) (0.0, 0.0) c) in
+      check_same "tolerance" reused fresh) [ 0.0; 3.0; 0.0; 1.5 ];
+
+  print_endline "path2d: OK"
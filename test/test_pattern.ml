@@ -0,0 +1,39 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+(* Minified repeating patterns are drawn from mipmaps, which are
+   rounded up to whole texels; this must not change their period *)
+
+open OcamlCanvas.V1
+open Test_util
+
+let () =
+  init ();
+
+  (* A 5 pixel wide pattern drawn at 0.4, so with a 2 pixel period *)
+  let id = ImageData.create (5, 5) in
+  ImageData.fill id Color.blue;
+  for y = 0 to 4 do
+    ImageData.putPixel id (0, y) Color.red;
+    ImageData.putPixel id (1, y) Color.red
+  done;
+  let p = Pattern.create id Pattern.RepeatXY in
+
+  let c = Canvas.createOffscreen ~size:(64, 8) () in
+  Canvas.scale c (0.4, 0.4);
+  Canvas.setFillStyle c (Style.Pattern p);
+  Canvas.fillRect c ~pos:(0.0, 0.0) ~size:(160.0, 20.0);
+
+  for x = 0 to 61 do
+    if Canvas.getPixel c (x, 4) <> Canvas.getPixel c (x + 2, 4) then
+      failwith (Printf.sprintf "pattern: period broken at %d" x)
+  done;
+
+  print_endline "pattern: OK"
@@ -0,0 +1,68 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+(* Sprite fields are arbitrary floats: out of range sprites must be
+   restricted to the atlas, or ignored, without overflowing *)
+
+open OcamlCanvas.V1
+open Test_util
+
+let sprites l =
+  Bigarray.Array1.of_array Bigarray.float64 Bigarray.c_layout
+    (Array.of_list (List.concat l))
+
+let atlas () =
+  let a = Canvas.createOffscreen ~size:(32, 32) () in
+  Canvas.setFillColor a Color.red;
+  Canvas.fillRect a ~pos:(0.0, 0.0) ~size:(16.0, 32.0);
+  Canvas.setFillColor a Color.blue;
+  Canvas.fillRect a ~pos:(16.0, 0.0) ~size:(16.0, 32.0);
+  a
+
+let draw l =
+  let a = atlas () in
+  render (fun c -> Canvas.drawSprites c ~src:a (sprites l))
+
+let () =
+  init ();
+
+  let blank = render (fun _ -> ()) in
+
+  (* Entirely outside of the atlas, or invalid *)
+  let big = 2147483000.0 in
+  check_same "outside" blank (draw [
+      [ big; 0.0; big; 5.0; 0.0; 0.0; 1.0; 0.0; 1.0 ];
+      [ 1e300; 0.0; 1e300; 10.0; 0.0; 0.0; 1.0; 0.0; 1.0 ];
+      [ 0.0; -1e300; 32.0; 1e300; 0.0; 0.0; 1.0; 0.0; 1.0 ];
+      [ nan; 0.0; 10.0; 10.0; 0.0; 0.0; 1.0; 0.0; 1.0 ];
+      [ infinity; 0.0; infinity; 1.0; 0.0; 0.0; 1.0; 0.0; 1.0 ];
+      [ neg_infinity; 0.0; infinity; 1.0; 0.0; 0.0; 1.0; 0.5; 1.0 ];
+      [ 0.0; 0.0; 32.0; 32.0; 1e300; 1e300; 1.0; 0.0; 1.0 ];
+    ]);
+
+  (* Non-finite destinations *)
+  check_same "non-finite" blank (draw [
+      [ 0.0; 0.0; 32.0; 32.0; nan; 0.0; 1.0; 0.0; 1.0 ];
+      [ 0.0; 0.0; 32.0; 32.0; 0.0; infinity; 1.0; 0.0; 1.0 ];
+      [ 0.0; 0.0; 32.0; 32.0; neg_infinity; 0.0; 1.0; 0.5; 1.0 ];
+      [ 0.0; 0.0; 32.0; 32.0; 0.0; 0.0; infinity; 0.0; 1.0 ];
+      [ 0.0; 0.0; 32.0; 32.0; 0.0; 0.0; 1.0; nan; 1.0 ];
+      [ 0.0; 0.0; 32.0; 32.0; 0.0; 0.0; 1.0; infinity; 1.0 ];
+    ]);
+
+  (* Partially outside of the atlas *)
+  check_same "clipped"
+    (draw [ [ 0.0; 0.0; 16.0; 16.0; 18.0; 10.0; 1.0; 0.0; 1.0 ] ])
+    (draw [ [ -8.0; 0.0; 24.0; 16.0; 10.0; 10.0; 1.0; 0.0; 1.0 ] ]);
+  check_same "clipped far"
+    (draw [ [ 16.0; 0.0; 16.0; 32.0; 20.0; 4.0; 1.0; 0.0; 1.0 ] ])
+    (draw [ [ 16.0; 0.0; big; big; 20.0; 4.0; 1.0; 0.0; 1.0 ] ]);
+
+  print_endline "sprites: OK"
@@ -0,0 +1,107 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+(* Saved states are shared with the canvas until either is modified;
+   modifying the current state must never leak into a saved state,
+   and restoring must bring back the saved state exactly *)
+
+open OcamlCanvas.V1
+open Test_util
+
+let snapshot c =
+  (Canvas.getLineWidth c, Canvas.getLineDash c,
+   Color.to_argb (Canvas.getFillColor c),
+   Color.to_argb (Canvas.getStrokeColor c),
+   Canvas.getGlobalAlpha c, Canvas.getGlobalCompositeOperation c,
+   Canvas.getShadowBlur c, Canvas.getShadowOffset c, Canvas.getFilter c)
+
+let modify c k =
+  let f = float_of_int k in
+  Canvas.setLineWidth c (1.0 +. f);
+  Canvas.setLineDash c [| f; 2.0 *. f +. 1.0 |];
+  Canvas.setFillColor c (Color.of_rgb (10 * k) 20 30);
+  Canvas.setStrokeColor c (Color.of_rgb 40 (10 * k) 60);
+  Canvas.setGlobalAlpha c (1.0 /. (1.0 +. f));
+  Canvas.setGlobalCompositeOperation c
+    (if k mod 2 = 0 then CompositeOp.Multiply else CompositeOp.XOR);
+  Canvas.setShadowBlur c f;
+  Canvas.setShadowOffset c (f, -. f);
+  Canvas.setFilter c [ Filter.Brightness (1.0 +. f) ]
+
+let fill_all c =
+  Canvas.fillRect c ~pos:(0.0, 0.0) ~size:(64.0, 64.0)
+
+let clip_rect c (x, y) (w, h) =
+  Canvas.clearPath c;
+  Canvas.rect c ~pos:(x, y) ~size:(w, h);
+  Canvas.clip c ~nonzero:true
+
+let () =
+  init ();
+
+  (* Nested saves, modifying each level *)
+  let c = Canvas.createOffscreen ~size:(16, 16) () in
+  let levels = List.map (fun k ->
+      modify c k;
+      let s = snapshot c in
+      Canvas.save c;
+      s) [ 1; 2; 3; 4 ] in
+  modify c 5;
+  List.iter (fun s ->
+      Canvas.restore c;
+      check "nested" (snapshot c = s)) (List.rev levels);
+
+  (* Saving and restoring without any modification in between *)
+  let c = Canvas.createOffscreen ~size:(16, 16) () in
+  modify c 1;
+  let s = snapshot c in
+  Canvas.save c;
+  Canvas.restore c;
+  check "unmodified" (snapshot c = s);
+  Canvas.save c;
+  Canvas.save c;
+  modify c 2;
+  Canvas.restore c;
+  check "shared twice" (snapshot c = s);
+  modify c 3;
+  Canvas.restore c;
+  check "shared twice again" (snapshot c = s);
+
+  (* Transform and clip path *)
+  let clipped_by_a c =
+    Canvas.save c;
+    clip_rect c (8.0, 8.0) (40.0, 30.0);
+    fill_all c;
+    Canvas.restore c
+  in
+  let nested c =
+    Canvas.save c;
+    clip_rect c (8.0, 8.0) (40.0, 30.0);
+    Canvas.save c;
+    Canvas.translate c (5.0, 7.0);
+    clip_rect c (0.0, 0.0) (10.0, 10.0);
+    Canvas.restore c;
+    fill_all c;
+    Canvas.restore c
+  in
+  check_same "clip" (render nested) (render clipped_by_a);
+  let restored c =
+    nested c;
+    Canvas.setFillColor c Color.red;
+    Canvas.fillRect c ~pos:(20.0, 40.0) ~size:(10.0, 10.0)
+  in
+  let reference c =
+    clipped_by_a c;
+    Canvas.setFillColor c Color.red;
+    Canvas.fillRect c ~pos:(20.0, 40.0) ~size:(10.0, 10.0)
+  in
+  check_same "restored" (render restored) (render reference);
+
+  print_endline "state: OK"
@@ -0,0 +1,55 @@
+(**************************************************************************)
+(*                                                                        *)
+(*    Copyright 2022 OCamlPro                                             *)
+(*                                                                        *)
+(*  All rights reserved. This file is distributed under the terms of the  *)
+(*  GNU Lesser General Public License version 2.1, with the special       *)
+(*  exception on linking described in the file LICENSE.                   *)
+(*                                                                        *)
+(**************************************************************************)
+
+open OcamlCanvas.V1
+
+(* Tests run on offscreen canvases, but still need a backend;
+   they are skipped when none is available (e.g. no display) *)
+let init () =
+  try Backend.init ()
+  with Failure _ ->
+    print_endline "No backend available, skipping";
+    exit 0
+
+let check name b =
+  if not b then
+    failwith (Printf.sprintf "%s: check failed" name)
+
+let argb c pos =
+  Color.to_argb (Canvas.getPixel c pos)
+
+let check_argb name c pos expected =
+  let (a, r, g, b) = argb c pos in
+  let (ea, er, eg, eb) = expected in
+  if (a, r, g, b) <> expected then
+    failwith (Printf.sprintf "%s: pixel (%d, %d) is %d,%d,%d,%d, \
+                              expected %d,%d,%d,%d" name (fst pos) (snd pos)
+                a r g b ea er eg eb)
+
+let check_same name id1 id2 =
+  let (w, h) = ImageData.getSize id1 in
+  check (name ^ " size") (ImageData.getSize id2 = (w, h));
+  for y = 0 to h - 1 do
+    for x = 0 to w - 1 do
+      if ImageData.getPixel id1 (x, y) <> ImageData.getPixel id2 (x, y) then
+        failwith (Printf.sprintf "%s: pixel (%d, %d) differs" name x y)
+    done
+  done
+
+(* Draws on a new white canvas, and returns its contents *)
+let render ?(size = (64, 64)) draw =
+  let c = Canvas.createOffscreen ~size () in
+  Canvas.setFillColor c Color.white;
+  Canvas.fillRect c ~pos:(0.0, 0.0)
+    ~size:(float_of_int (fst size), float_of_int (snd size));
+  Canvas.setFillColor c Color.black;
+  Canvas.setStrokeColor c Color.black;
+  draw c;
+  Canvas.getImageData c ~pos:(0, 0) ~size